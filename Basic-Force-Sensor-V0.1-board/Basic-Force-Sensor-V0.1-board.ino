@@ -1,30 +1,83 @@
 #include "HX711.h"
 #include "hwb.hpp"
+#include "hx711_fastio.hpp"
+#include "frame.hpp"
+#include "burst.hpp"
 
-// HX711 circuit wiring
-const int LOADCELL_DOUT_PIN = A1;
-const int LOADCELL_SCK_PIN = A0;
+// HX711 circuit wiring: see the cells declaration below
 const int DATA_RATE_PIN = 11;
 const int DATA_RATE = LOW;  // LOW for 80hz, High for 10hz)
 const int SCALE_OFFSET = 54; // Calibration for weight
 
+// 1: stream raw counts as binary frames (see frame.hpp), 0: print grams as text, one line per
+// conversion with the cells separated by commas
+#define STREAM_BINARY 1
+const uint32_t FRAME_MAX_AGE_US = 50000; // Send a part-filled frame after this long
+const uint8_t INFO_EVERY = 64;           // Repeat offset/scale every this many frames
+
+// 1: only send the conversions around each trigger (see burst.hpp), 0: send them all
+#define CAPTURE_BURSTS 0
+const uint8_t BURST_PRE_SAMPLES = 40;    // Conversions before the trigger (0.5s at 80Hz)
+const uint16_t BURST_POST_SAMPLES = 120; // Conversions from the trigger on
+const float BURST_LEVEL_GRAMS = 100;     // Trigger when the load reaches this (0 for never)...
+const float BURST_SLOPE = 0;             // ...or rises faster than this, in g/s (0 for never)...
+const int BURST_PIN = -1;                // ...or this pin goes to BURST_PIN_LEVEL (-1 for none)
+const uint8_t BURST_PIN_LEVEL = LOW;
+
 
 //Button
 bool isTarePressed() {
   return readHwb();
 }
 
-HX711 scale;
+// Direct port access on the Leonardo.  PD_SCK is A0 = PF7, shared by every load cell, and
+// the first cell's DOUT is A1 = PF6.  For more cells (up to FRAME_MAX_CHANNELS) add their
+// DOUT bits, all on port F: A2 = PF5, A3 = PF4, A4 = PF1, A5 = PF0.
+// e.g. HX711Bank<HX711PortF, HX711PortF, 7, 6, 5, 4, 1> cells;
+// Off the AVR the same pins go by their Arduino numbers, e.g. HX711Bank<A0, A1, A2, A3, A4> cells;
+#if defined(__AVR__)
+HX711Bank<HX711PortF, HX711PortF, 7, 6> cells;
+#else
+HX711Bank<A0, A1> cells;
+#endif
+static_assert(cells.CHANNELS <= FRAME_MAX_CHANNELS, "Too many load cells for the frame format");
+
+#if STREAM_BINARY
+FrameWriter frames;
+#endif
+#if CAPTURE_BURSTS
+#if !STREAM_BINARY
+#error "CAPTURE_BURSTS needs STREAM_BINARY"
+#endif
+BurstCapture<cells.CHANNELS, BURST_PRE_SAMPLES> bursts(BURST_LEVEL_GRAMS, BURST_SLOPE, BURST_PIN, BURST_PIN_LEVEL);
+uint16_t burstNo = 0;
+uint16_t postLeft = 0;  // Conversions still to send in the burst in progress
+#endif
+uint8_t flags = 0;      // SAMPLE_* flags for the next sample
+uint16_t untilInfo = 0; // Samples left before the offset/scale are sent again
+
+void tare() {
+  cells.tare();
+  flags |= SAMPLE_TARED;
+  untilInfo = 0;
+#if CAPTURE_BURSTS
+  bursts.clear(); // Counts against the old offset
+#endif
+}
 
 void setup() {
   Serial.begin(38400);
   while (!Serial) { }
   pinMode(DATA_RATE_PIN, OUTPUT);    // sets the digital pin 11 as output
   digitalWrite(DATA_RATE_PIN, DATA_RATE);
-  scale.begin(LOADCELL_DOUT_PIN, LOADCELL_SCK_PIN);
-  scale.set_scale(SCALE_OFFSET); // 
-  scale.tare(); //Assuming there is no weight on the scale at start up, reset the scale to 0\
+  cells.begin();
+  for (uint8_t c = 0; c < cells.CHANNELS; c++)
+    cells.scale[c] = SCALE_OFFSET;
+  cells.tare(); //Assuming there is no weight on the scale at start up, reset the scale to 0
   setupHwbInput( true );
+#if CAPTURE_BURSTS
+  bursts.begin();
+#endif
   
 }
 
@@ -33,14 +86,74 @@ void loop() {
   if(Serial.available()){ // zeros scale when z is pressed in the Java Script
     char temp = Serial.read();
     if(temp == '1')
-      scale.tare();
+      tare();
 }
  else if(isTarePressed()){
-    scale.tare();
+    flags |= SAMPLE_BUTTON;
+    tare();
 }
 
-  Serial.println(scale.get_units(2));
-  delay(1);        // delay for stability
-  
+  // Only read once a conversion is waiting, so the loop never blocks on the HX711
+  // All the cells are read in one go, and go out as consecutive samples with the same time
+  if (cells.is_ready()) {
+    uint32_t t = micros();
+    long count[cells.CHANNELS];
+    cells.read(count);
+
+#if CAPTURE_BURSTS
+    float grams = 0;
+    for (uint8_t c = 0; c < cells.CHANNELS; c++)
+      grams += cells.get_units(count[c], c);
+    uint8_t source = bursts.trigger(t, grams);
+    if (!postLeft) {
+      bursts.push(t, count, flags);
+      flags = 0;
+      if (!source)
+        return; // Just history for now
+      // Start a burst: the offsets and scales, the header, then the history up to this conversion
+      for (uint8_t c = 0; c < cells.CHANNELS; c++)
+        frames.sendInfo(cells.offset[c], cells.scale[c], DATA_RATE == LOW ? 80 : 10, c);
+      frames.sendBurst(++burstNo, t, bursts.size() - 1, BURST_POST_SAMPLES, source, cells.CHANNELS);
+      for (uint8_t i = 0; i < bursts.size(); i++) {
+        const auto &e = bursts.at(i);
+        uint8_t f = e.flags | (i + 1 == bursts.size() ? SAMPLE_TRIGGER : 0);
+        for (uint8_t c = 0; c < cells.CHANNELS; c++)
+          frames.add(e.t, e.count[c], f | (c << SAMPLE_CHANNEL_SHIFT) |
+                     (e.count[c] >= 0x7FFFFF || e.count[c] <= -0x800000 ? SAMPLE_SATURATED : 0));
+      }
+      bursts.clear();
+      postLeft = BURST_POST_SAMPLES - 1;
+      return;
+    }
+    postLeft--;
+#elif STREAM_BINARY
+    if (untilInfo == 0) {
+      for (uint8_t c = 0; c < cells.CHANNELS; c++)
+        frames.sendInfo(cells.offset[c], cells.scale[c], DATA_RATE == LOW ? 80 : 10, c);
+      untilInfo = INFO_EVERY * FRAME_MAX_SAMPLES;
+    }
+    untilInfo--;
+#endif
+    for (uint8_t c = 0; c < cells.CHANNELS; c++) {
+      uint8_t f = flags | (c << SAMPLE_CHANNEL_SHIFT);
+      if (count[c] >= 0x7FFFFF || count[c] <= -0x800000)
+        f |= SAMPLE_SATURATED;
+#if STREAM_BINARY
+      frames.add(t, count[c], f);
+#else
+      if (c)
+        Serial.print(", ");
+      Serial.print(cells.get_units(count[c], c));
+#endif
+    }
+#if !STREAM_BINARY
+    Serial.println();
+#endif
+    flags = 0;
+  }
+
+#if STREAM_BINARY
+  frames.flushIfOlderThan(micros(), FRAME_MAX_AGE_US);
+#endif
 
 }
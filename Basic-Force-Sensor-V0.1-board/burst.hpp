@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Triggered burst capture (CAPTURE_BURSTS).  Rather than stream every conversion, keep the
+// last PRE of them, and when a trigger fires send those, then the next ones up to the end of
+// the burst.  The triggers are the load rising through a level, rising faster than a slope,
+// or an input pin going to its active level; they re-arm once the load is back under half
+// the level, the slope has eased off to half and the pin is inactive.  The frames are the
+// same as ForceSensorGraph's BURST_SERIAL sends, see host/include/forceFrame.h.
+
+const uint8_t BURST_BY_LEVEL = 0x01;
+const uint8_t BURST_BY_SLOPE = 0x02;
+const uint8_t BURST_BY_PIN = 0x04;
+
+template <uint8_t CHANNELS, uint8_t PRE>
+class BurstCapture {
+  public:
+    struct Entry {
+      uint32_t t;
+      long count[CHANNELS];
+      uint8_t flags;
+    };
+
+    // level in grams, slope in g/s (0 for never), pin -1 for none
+    BurstCapture( float level, float slope, int pin, uint8_t pinLevel )
+      : level( level ), slope( slope ), pin( pin ), pinLevel( pinLevel ) { }
+
+    void begin() {
+      if ( pin >= 0 )
+        pinMode( pin, INPUT_PULLUP );
+    }
+
+    // Call for every conversion with its total load.  Returns the BURST_BY_* sources that
+    // fired, 0 if none did or it is not armed.
+    uint8_t trigger( uint32_t t, float grams ) {
+      uint8_t active = 0;
+      bool clear = true;
+
+      if ( level > 0 ) {
+        if ( grams >= level )
+          active |= BURST_BY_LEVEL;
+        clear = clear && grams < level / 2;
+      }
+      if ( slope > 0 ) {
+        // Over the last SLOPE_SAMPLES conversions
+        if ( slopeFilled == SLOPE_SAMPLES ) {
+          float rate = ( grams - slopeY[slopeNext] ) * 1e6 / ( t - slopeT[slopeNext] );
+          if ( rate >= slope )
+            active |= BURST_BY_SLOPE;
+          clear = clear && rate < slope / 2;
+        }
+        else
+          slopeFilled++;
+        slopeY[slopeNext] = grams;
+        slopeT[slopeNext] = t;
+        slopeNext = ( slopeNext + 1 ) % SLOPE_SAMPLES;
+      }
+      if ( pin >= 0 && digitalRead( pin ) == pinLevel ) {
+        active |= BURST_BY_PIN;
+        clear = false;
+      }
+
+      if ( armed && active ) {
+        armed = false;
+        return active;
+      }
+      armed = armed || clear;
+      return 0;
+    }
+
+    // Keep a conversion as history, dropping the oldest once there are more than PRE before it
+    void push( uint32_t t, const long *count, uint8_t flags ) {
+      if ( held == PRE + 1 ) {
+        first = ( first + 1 ) % ( PRE + 1 );
+        held--;
+      }
+      Entry &e = ring[( first + held++ ) % ( PRE + 1 )];
+      e.t = t;
+      memcpy( e.count, count, sizeof( e.count ) );
+      e.flags = flags;
+    }
+
+    // The history, oldest first; the last is the conversion just pushed
+    uint8_t size() const {
+      return held;
+    }
+    const Entry &at( uint8_t i ) const {
+      return ring[( first + i ) % ( PRE + 1 )];
+    }
+
+    // Forget the history: it has been sent, or was taken against an old tare
+    void clear() {
+      held = 0;
+      slopeFilled = 0;
+    }
+
+  private:
+    static const uint8_t SLOPE_SAMPLES = 4;
+
+    Entry ring[PRE + 1];
+    uint8_t first = 0, held = 0;
+    float level, slope;
+    int pin;
+    uint8_t pinLevel;
+    bool armed = true;
+    float slopeY[SLOPE_SAMPLES];
+    uint32_t slopeT[SLOPE_SAMPLES];
+    uint8_t slopeNext = 0, slopeFilled = 0;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <Arduino.h>
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+// Binary sample stream.  The layout and constants must match host/include/forceFrame.h,
+// which also documents the format:
+//   0xA5 0x5A  type  len  payload[len]  crc16 (CCITT-FALSE over type, len and payload)
+// All multi-byte fields are little-endian.
+
+const uint8_t FRAME_SYNC0 = 0xA5;
+const uint8_t FRAME_SYNC1 = 0x5A;
+
+const uint8_t FRAME_SAMPLES = 0x01; // seq u16, t0 u32 (micros), then per sample: dt u16, count i24, flags u8
+const uint8_t FRAME_INFO = 0x02;    // offset i32, scale f32, rate u8, channel u8
+const uint8_t FRAME_BURST = 0x03;   // burst u16, tTrigger u32, pre u16, post u16, source u8, channels u8
+
+const uint8_t SAMPLE_TARED = 0x01;     // The tare offset changed just before this sample
+const uint8_t SAMPLE_BUTTON = 0x02;    // The tare button was down
+const uint8_t SAMPLE_SATURATED = 0x04; // The ADC is at full scale
+const uint8_t SAMPLE_TRIGGER = 0x08;   // This sample started the burst (CAPTURE_BURSTS)
+const uint8_t SAMPLE_CHANNEL_SHIFT = 6; // Bits 6-7 of the flags: which load cell
+const uint8_t FRAME_MAX_CHANNELS = 4;
+
+// 8 samples make a 60 byte frame, so one frame fits one 64 byte USB packet
+const uint8_t FRAME_MAX_SAMPLES = 8;
+const uint8_t FRAME_SAMPLE_BYTES = 6;
+
+inline uint16_t frameCrc( uint16_t crc, uint8_t b ) {
+#if defined(__AVR__)
+  return _crc_xmodem_update( crc, b );
+#else
+  crc ^= (uint16_t)b << 8;
+  for ( uint8_t i = 0; i < 8; i++ )
+    crc = crc & 0x8000 ? ( crc << 1 ) ^ 0x1021 : crc << 1;
+  return crc;
+#endif
+}
+
+class FrameWriter {
+  public:
+    // Queue one sample, sending the frame once it is full.  t is micros() at data-ready.
+    void add( uint32_t t, long count, uint8_t flags ) {
+      uint32_t dt = n ? t - tLast : 0;
+      if ( n && dt > 0xFFFF )
+        flush(); // Too long since the last sample to express as a delta, start a new frame
+      if ( !n ) {
+        t0 = t;
+        dt = 0;
+      }
+      uint8_t *s = payload + 6 + n * FRAME_SAMPLE_BYTES;
+      s[0] = dt;
+      s[1] = dt >> 8;
+      s[2] = count;
+      s[3] = count >> 8;
+      s[4] = count >> 16;
+      s[5] = flags;
+      tLast = t;
+      if ( ++n == FRAME_MAX_SAMPLES )
+        flush();
+    }
+
+    // Don't sit on a part-filled frame for too long at 10Hz
+    void flushIfOlderThan( uint32_t now, uint32_t maxAge ) {
+      if ( n && now - t0 > maxAge )
+        flush();
+    }
+
+    // Send whatever samples are queued
+    void flush() {
+      if ( !n )
+        return;
+      payload[0] = seq;
+      payload[1] = seq >> 8;
+      put32( payload + 2, t0 );
+      write( FRAME_SAMPLES, payload, 6 + n * FRAME_SAMPLE_BYTES );
+      seq += n;
+      n = 0;
+    }
+
+    // Samples already queued were taken against the previous offset, so they go out first
+    void sendInfo( long offset, float scale, uint8_t rateHz, uint8_t channel = 0 ) {
+      uint8_t p[10];
+      flush();
+      put32( p, offset );
+      memcpy( p + 4, &scale, 4 );
+      p[8] = rateHz;
+      p[9] = channel;
+      write( FRAME_INFO, p, sizeof( p ) );
+    }
+
+    // Header of a triggered burst (see burst.hpp); its samples follow as usual
+    void sendBurst( uint16_t burst, uint32_t tTrigger, uint16_t pre, uint16_t post, uint8_t source, uint8_t channels ) {
+      uint8_t p[12];
+      flush();
+      put16( p, burst );
+      put32( p + 2, tTrigger );
+      put16( p + 6, pre );
+      put16( p + 8, post );
+      p[10] = source;
+      p[11] = channels;
+      write( FRAME_BURST, p, sizeof( p ) );
+    }
+
+  private:
+    static void put16( uint8_t *p, uint16_t v ) {
+      p[0] = v;
+      p[1] = v >> 8;
+    }
+
+    static void put32( uint8_t *p, uint32_t v ) {
+      p[0] = v;
+      p[1] = v >> 8;
+      p[2] = v >> 16;
+      p[3] = v >> 24;
+    }
+
+    // Assemble the whole frame first so it goes out as a single USB packet
+    static void write( uint8_t type, const uint8_t *p, uint8_t len ) {
+      uint8_t out[4 + 6 + FRAME_MAX_SAMPLES * FRAME_SAMPLE_BYTES + 2];
+      uint16_t crc = 0xFFFF;
+      out[0] = FRAME_SYNC0;
+      out[1] = FRAME_SYNC1;
+      out[2] = type;
+      out[3] = len;
+      memcpy( out + 4, p, len );
+      for ( uint8_t i = 2; i < 4 + len; i++ )
+        crc = frameCrc( crc, out[i] );
+      out[4 + len] = crc;
+      out[5 + len] = crc >> 8;
+      Serial.write( out, 6 + len );
+    }
+
+    uint8_t payload[6 + FRAME_MAX_SAMPLES * FRAME_SAMPLE_BYTES];
+    uint8_t n = 0;
+    uint16_t seq = 0;
+    uint32_t t0 = 0, tLast = 0;
+};
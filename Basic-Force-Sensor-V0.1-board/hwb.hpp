@@ -2,6 +2,11 @@
 
 #include <Arduino.h>
 
+// The ATmega32U4's HWB pin (PE2), which has no Arduino pin number, read straight off port E.
+// Off the AVR there is no such pin, and the button reads as never pressed.
+
+#if defined(__AVR__)
+
 inline void setupHwbInput( bool pullup = false ) {
   const uint8_t pinNum = 2;
   DDRE &= ~( 1 << pinNum );
@@ -15,3 +20,13 @@ inline bool readHwb() {
   const uint8_t pinNum = 2;
   return PINE & ( 1 << pinNum );
 }
+
+#else
+
+inline void setupHwbInput( bool = false ) {}
+
+inline bool readHwb() {
+  return false;
+}
+
+#endif
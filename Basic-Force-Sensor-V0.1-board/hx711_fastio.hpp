@@ -0,0 +1,243 @@
+#pragma once
+
+#include <Arduino.h>
+
+// HX711 reader specialised at compile time on the DOUT/PD_SCK port and bits.
+//
+// The generic HX711::read() goes through shiftIn()/digitalWrite()/digitalRead(), which look
+// the pin up in flash tables on every edge, and keeps interrupts off for the whole 25-27
+// pulse transfer.  Here every edge is a single sbi/cbi/in on a register known at compile
+// time (the same trick hwb.hpp uses for PORTE), and interrupts are only held off while
+// PD_SCK is high.  That is the only part of the transfer with a timing limit: a high pulse
+// longer than 60us powers the chip down, while the low phase may be stretched freely.
+// On anything that is not an AVR there are no ports to name, so HX711Bank takes Arduino pin
+// numbers instead and goes through digitalWrite()/digitalRead(), with the same interface.
+// host/bench/hx711Cycles.cpp counts the cycles of both against a simulated port.
+
+#if defined(__AVR__)
+
+#include <avr/io.h>
+
+#define HX711_DECLARE_PORT(letter)                                  \
+  struct HX711Port##letter {                                        \
+    static inline volatile uint8_t &in() { return PIN##letter; }    \
+    static inline volatile uint8_t &out() { return PORT##letter; }  \
+    static inline volatile uint8_t &ddr() { return DDR##letter; }   \
+  };
+
+#ifdef PORTB
+HX711_DECLARE_PORT(B)
+#endif
+#ifdef PORTC
+HX711_DECLARE_PORT(C)
+#endif
+#ifdef PORTD
+HX711_DECLARE_PORT(D)
+#endif
+#ifdef PORTE
+HX711_DECLARE_PORT(E)
+#endif
+#ifdef PORTF
+HX711_DECLARE_PORT(F)
+#endif
+
+#undef HX711_DECLARE_PORT
+
+// Several HX711s sharing one PD_SCK line, each with its DOUT on a different bit of the same
+// port.  Every pulse samples the whole port once, so one 24-pulse transfer clocks all the
+// cells out in the time it takes to read one; the bits are sorted out while PD_SCK is low.
+// The chips' oscillators are not synchronised, so a transfer waits for every DOUT to be low.
+// The extra pulses after the data reach every chip, so they all switch input/gain together.
+//
+// Usage (Leonardo, PD_SCK on A0 = PF7, cells on A1/A2/A3 = PF6/PF5/PF4):
+//   HX711Bank<HX711PortF, HX711PortF, 7, 6, 5, 4> cells;
+template <class DoutPort, class SckPort, uint8_t sckBit, uint8_t... doutBits>
+class HX711Bank {
+  public:
+    static const uint8_t CHANNELS = sizeof...( doutBits );
+
+    long offset[CHANNELS];
+    float scale[CHANNELS];
+
+    void begin( uint8_t gain = 128 ) {
+      SckPort::ddr() |= ( 1 << sckBit );
+      SckPort::out() &= ~( 1 << sckBit );
+      DoutPort::ddr() &= ~mask();
+      DoutPort::out() |= mask(); // Pull-ups, as HX711::begin() does
+      set_gain( gain );
+      for ( uint8_t c = 0; c < CHANNELS; c++ ) {
+        offset[c] = 0;
+        scale[c] = 1;
+      }
+    }
+
+    bool is_ready() {
+      return !( DoutPort::in() & mask() );
+    }
+
+    // Input and gain for the conversion after the next read: 128 or 64 on channel A, 32 on B
+    void set_gain( uint8_t gain ) {
+      pulses = gain == 64 ? 3 : gain == 32 ? 2 : 1;
+    }
+
+    // Clock one conversion out of every chip into counts[CHANNELS]
+    void read( long *counts ) {
+      const uint8_t bits[CHANNELS] = { doutBits... };
+      uint32_t value[CHANNELS];
+
+      while ( !is_ready() )
+        yield();
+
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        value[c] = 0;
+      for ( uint8_t i = 0; i < 24; ++i ) {
+        uint8_t pins = pulse();
+        for ( uint8_t c = 0; c < CHANNELS; c++ )
+          value[c] = ( value[c] << 1 ) | ( ( pins >> bits[c] ) & 1 );
+      }
+      for ( uint8_t i = 0; i < pulses; ++i )
+        pulse();
+
+      for ( uint8_t c = 0; c < CHANNELS; c++ ) {
+        // Replicate the most significant bit to pad out a 32-bit signed integer
+        if ( value[c] & 0x800000UL )
+          value[c] |= 0xFF000000UL;
+        counts[c] = static_cast<long>( value[c] );
+      }
+    }
+
+    // Zero every channel on the average of `times` conversions
+    void tare( uint8_t times = 10 ) {
+      long counts[CHANNELS];
+      int32_t sum[CHANNELS] = { 0 };
+      for ( uint8_t i = 0; i < times; i++ ) {
+        read( counts );
+        for ( uint8_t c = 0; c < CHANNELS; c++ )
+          sum[c] += counts[c];
+      }
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        offset[c] = sum[c] / times;
+    }
+
+    float get_units( long count, uint8_t c ) {
+      return ( count - offset[c] ) / scale[c];
+    }
+
+  private:
+    static inline uint8_t mask() {
+      const uint8_t bits[CHANNELS] = { doutBits... };
+      uint8_t m = 0;
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        m |= 1 << bits[c];
+      return m;
+    }
+
+    // One PD_SCK pulse, returning the whole DOUT port sampled while the clock is high
+    static inline uint8_t pulse() {
+      uint8_t sreg = SREG;
+      cli();
+      SckPort::out() |= ( 1 << sckBit );
+      // DOUT is valid 0.1us after the rising edge, and PD_SCK must stay high for at least 0.2us
+      __builtin_avr_delay_cycles( 3 );
+      uint8_t pins = DoutPort::in();
+      SckPort::out() &= ~( 1 << sckBit );
+      SREG = sreg;
+      return pins;
+    }
+
+    uint8_t pulses = 1;
+};
+
+#else
+
+// The same bank off the AVR: PD_SCK and the DOUTs as Arduino pin numbers, every edge through
+// digitalWrite()/digitalRead().  Slower, but the transfer is the same one, so the cells still
+// share PD_SCK and are clocked out together.
+//
+// Usage: HX711Bank<A0, A1, A2> cells; // PD_SCK, then each cell's DOUT
+template <uint8_t sckPin, uint8_t... doutPins>
+class HX711Bank {
+  public:
+    static const uint8_t CHANNELS = sizeof...( doutPins );
+
+    long offset[CHANNELS];
+    float scale[CHANNELS];
+
+    void begin( uint8_t gain = 128 ) {
+      pinMode( sckPin, OUTPUT );
+      digitalWrite( sckPin, LOW );
+      for ( uint8_t c = 0; c < CHANNELS; c++ ) {
+        pinMode( dout[c], INPUT_PULLUP );
+        offset[c] = 0;
+        scale[c] = 1;
+      }
+      set_gain( gain );
+    }
+
+    bool is_ready() {
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        if ( digitalRead( dout[c] ) )
+          return false;
+      return true;
+    }
+
+    // Input and gain for the conversion after the next read: 128 or 64 on channel A, 32 on B
+    void set_gain( uint8_t gain ) {
+      pulses = gain == 64 ? 3 : gain == 32 ? 2 : 1;
+    }
+
+    // Clock one conversion out of every chip into counts[CHANNELS]
+    void read( long *counts ) {
+      uint32_t value[CHANNELS];
+
+      while ( !is_ready() )
+        yield();
+
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        value[c] = 0;
+      for ( uint8_t i = 0; i < 24; ++i ) {
+        noInterrupts();
+        digitalWrite( sckPin, HIGH );
+        for ( uint8_t c = 0; c < CHANNELS; c++ )
+          value[c] = ( value[c] << 1 ) | ( digitalRead( dout[c] ) ? 1 : 0 );
+        digitalWrite( sckPin, LOW );
+        interrupts();
+      }
+      for ( uint8_t i = 0; i < pulses; ++i ) {
+        noInterrupts();
+        digitalWrite( sckPin, HIGH );
+        digitalWrite( sckPin, LOW );
+        interrupts();
+      }
+
+      for ( uint8_t c = 0; c < CHANNELS; c++ ) {
+        // Replicate the most significant bit to pad out a 32-bit signed integer
+        if ( value[c] & 0x800000UL )
+          value[c] |= 0xFF000000UL;
+        counts[c] = static_cast<int32_t>( value[c] ); // long may be wider than 32 bits here
+      }
+    }
+
+    // Zero every channel on the average of `times` conversions
+    void tare( uint8_t times = 10 ) {
+      long counts[CHANNELS];
+      int32_t sum[CHANNELS] = { 0 };
+      for ( uint8_t i = 0; i < times; i++ ) {
+        read( counts );
+        for ( uint8_t c = 0; c < CHANNELS; c++ )
+          sum[c] += counts[c];
+      }
+      for ( uint8_t c = 0; c < CHANNELS; c++ )
+        offset[c] = sum[c] / times;
+    }
+
+    float get_units( long count, uint8_t c ) {
+      return ( count - offset[c] ) / scale[c];
+    }
+
+  private:
+    const uint8_t dout[CHANNELS] = { doutPins... };
+    uint8_t pulses = 1;
+};
+
+#endif
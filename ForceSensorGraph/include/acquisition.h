@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Arduino.h>
+#include "timebase.h"
+
+// Interrupt-driven acquisition from one or more HX711s.
+// Every load cell has its own HX711 and DOUT line, and all of them share PD_SCK, so a
+// single 24-pulse transfer clocks every channel out at once: N cells cost the same pulses
+// as one.  Once every DOUT is low (all conversions ready) the transfer runs inside the DOUT
+// interrupt and pushes one timestamped sample holding all channels onto a lock-free ring.
+// loop() only has to drain the ring, so a slow redraw or serial print no longer costs us
+// conversions.
+// A DOUT that is not on an external-interrupt pin (e.g. A1 on PCBV1) is covered by polling
+// from acqPoll(), which must then be called from loop().
+// acqOnSample() hooks the ISR, to wake whatever drains the ring; the hook runs with
+// interrupts disabled, so keep it to that.  The transfer itself uses the pins' port
+// registers directly, so interrupts are off for tens of microseconds, not hundreds.
+// Needs LOADCELL_COUNT from setup.h.
+
+#ifndef LOADCELL_COUNT
+#error "Include setup.h before acquisition.h"
+#endif
+
+// HX711 input and gain, as the number of extra PD_SCK pulses after the data
+#define ACQ_A128 1
+#define ACQ_B32 2
+#define ACQ_A64 3
+
+// Conversions to throw away after switching input or gain (50ms at 80Hz, 400ms at 10Hz)
+#define ACQ_SETTLE_CONVERSIONS 4
+
+struct RawSample
+{
+  time_us t;                  // timeUs() when the last DOUT went low
+  long count[LOADCELL_COUNT];  // Signed 24-bit ADC counts, sign-extended
+  uint8_t input;               // ACQ_* the counts were converted with
+};
+
+// One step of the input schedule: convert on this input for this many samples
+struct AcqSlot
+{
+  uint8_t input;
+  uint8_t samples;
+};
+
+void acqBegin(const uint8_t *dout, uint8_t sck);
+void acqOnSample(void (*hook)(const RawSample &s));
+void acqSchedule(const AcqSlot *slots, uint8_t n);
+void acqPoll();
+void acqFlush();
+bool acqRead(RawSample &s);
+uint8_t acqPending();
+uint16_t acqOverruns();
+uint8_t acqInterruptChannels();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include "force.h"
+#include "acquisition.h"
+
+// Triggered burst capture.  Streaming every sample spends nearly all of the serial link,
+// and the host's disk, on the idle time between peels.  Instead only the raw samples around
+// each trigger are sent.  The last BURST_PRE_SAMPLES conversions are kept in a ring.  When a
+// trigger fires they go out, followed by the next BURST_POST_SAMPLES as they arrive.  The ring
+// doubles as the send queue, so only the pre-trigger history takes RAM.
+// A trigger is the force rising through BURST_LEVEL_GRAMS, rising faster than BURST_SLOPE
+// g/s, or BURST_PIN going to BURST_PIN_LEVEL (sampled with every conversion).  It re-arms
+// once all of them have dropped back: the force and the slope to under half, the pin inactive.
+// Each burst is one block in the board sketch's binary frame format (host/include/
+// forceFrame.h): a FRAME_INFO per cell, a FRAME_BURST header, then the raw counts as
+// FRAME_SAMPLES with the trigger sample flagged SAMPLE_TRIGGER.  A frame is only written
+// once the serial port has room for all of it.  A host that stops reading stalls the send
+// queue, and once the queue is full the burst is cut short, but the sampling never waits.
+// Needs the BURST_* settings from setup.h.
+
+// Trigger sources, as reported in the FRAME_BURST header
+#define BURST_BY_LEVEL 0x01
+#define BURST_BY_SLOPE 0x02
+#define BURST_BY_PIN 0x04
+
+struct BurstStats
+{
+  uint16_t bursts;    // Triggers that started a burst
+  uint16_t truncated; // Bursts cut short because the send queue was full
+  uint32_t samples;   // Conversions sent
+};
+
+extern BurstStats burstStats;
+
+void burstBegin();
+// Every raw sample, in order, with its total force (for the trigger)
+void burstFeed(const RawSample &s, force_t f);
+// Send whatever frames the serial port has room for
+void burstPoll();
+// The zero moved (tare, calibration): forget the history and any burst in progress
+void burstReset();
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// Least-squares calibration from raw counts at one or more reference masses.
+// Counts (tared) are added a window at a time, as the sample count, sum and sum of squares
+// of the window, and merged into one point per mass, so the samples themselves are never
+// stored: the fit over every sample equals a fit through the point means weighted by their
+// sample counts, plus the spread within each point.  With two or more different masses the
+// offset is fitted as well as the scale; with one, the line goes through the tare.  With
+// three or more the fit can add a quadratic term, for the load cell's linearity error.
+// Everything is solved in one pass once the points are in.
+
+#define CAL_MAX_POINTS 6
+
+struct CalResult
+{
+  float scale;     // counts per gram
+  float offset;    // counts at zero load, relative to the tare the counts were taken against
+  float curve;     // counts per gram^2 (0 unless the quadratic term was fitted)
+  float rmsGrams;  // Residual standard deviation, in grams
+  float scaleCi;   // 95% confidence interval of the scale, +/- percent
+  uint32_t samples;
+};
+
+class CalFit
+{
+public:
+  void clear() { points = 0; }
+  // A window of n <= 64 samples of counts under `grams`, |counts| < 2^25.  Consecutive
+  // windows of the same mass go to the same point.  False if the points are all used.
+  bool add(float grams, uint8_t n, int64_t sum, int64_t sumSq);
+  bool solve(bool quadratic, CalResult &r) const;
+  uint8_t count() const { return points; }
+
+private:
+  struct Point
+  {
+    float grams;
+    uint32_t n;
+    float mean;
+    float m2; // Sum of squared deviations from the mean, counts^2
+  };
+
+  uint8_t distinctMasses() const;
+
+  Point point[CAL_MAX_POINTS];
+  uint8_t points = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+// Calibration store in EEPROM.  Each save is a new 32 byte record, written to the next free
+// slot of CAL_STORE_SLOTS round-robin, so every cell wears at the same rate, and a record
+// only counts once its CRC checks out - the CRC goes last, so a save cut short by a reset
+// leaves the previous record in force.  Each profile's newest record is never overwritten.
+// Saves are written out a byte at a time from calStorePoll(), whenever the EEPROM is ready,
+// so they never hold up loop() for the 3.4ms that each byte takes.  Needs the CAL_STORE_*
+// settings from setup.h.
+
+#define CAL_RECORD_VERSION 1
+#define CAL_RECORD_CELLS 4
+
+struct CalRecord
+{
+  uint8_t version; // CAL_RECORD_VERSION; records of any other version are ignored
+  uint8_t profile; // CAL_PROFILE it was saved under
+  uint16_t seq;    // Incremented on every save, the newest record of a profile wins
+  float scale;     // counts per gram
+  int32_t curve;   // Linearity correction, Q56 per mg (cellCurve)
+  int32_t offset[CAL_RECORD_CELLS];
+  uint8_t cells;   // LOADCELL_COUNT it was saved with
+  uint8_t reserved;
+  uint16_t crc;    // CRC-16/CCITT-FALSE of everything above
+};
+
+static_assert(sizeof(CalRecord) == 32, "CalRecord must pack into 32 bytes");
+
+bool calStoreLoad(uint8_t profile, CalRecord &r);
+bool calStoreSave(CalRecord &r);
+void calStorePoll();
+bool calStoreBusy();
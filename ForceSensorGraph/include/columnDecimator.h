@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include "force.h"
+
+// One pixel column of the trace: its lowest and highest sample, in the order they came so
+// the trace is drawn through them the way it went, and its last sample, which the next
+// column joins up to.
+struct ColumnPoint
+{
+  uint32_t tMs;  // First sample's time, in ms since the chart's origin
+  force_t first; // The extremes, earlier one first
+  force_t second;
+  force_t last;
+};
+
+// Display decimator.  The trace is captured at the full sample rate, but the screen only
+// has COLS columns for RANGE_MS of it, so every column's worth of samples is boiled down to
+// one ColumnPoint: a peak between two frames still lights its column, however few frames
+// the display manages.  Column k covers [k * RANGE_MS / COLS, (k + 1) * RANGE_MS / COLS)
+// ms, the same as the plot's columns for a chart starting at 0 ms.  Integer maths only, and
+// it never overflows for times up to the 49 days of tMs.
+template <uint32_t RANGE_MS, uint16_t COLS>
+class ColumnDecimator
+{
+public:
+  // Add a sample.  True if it started a new column, with the one it finished in done.
+  bool update(uint32_t tMs, force_t y, ColumnPoint &done)
+  {
+    uint32_t col = tMs / RANGE_MS * COLS + tMs % RANGE_MS * COLS / RANGE_MS;
+    bool finished = false;
+
+    if (open && col != column)
+    {
+      finished = flush(done);
+    }
+    if (!open)
+    {
+      column = col;
+      cur.tMs = tMs;
+      lo = hi = y;
+      hiLast = false;
+    }
+    else if (y < lo)
+    {
+      lo = y;
+      hiLast = false;
+    }
+    else if (y > hi)
+    {
+      hi = y;
+      hiLast = true;
+    }
+    cur.last = y;
+    open = true;
+    return finished;
+  }
+
+  // Hand over the column in progress, if there is one, and start afresh
+  bool flush(ColumnPoint &done)
+  {
+    if (!open)
+    {
+      return false;
+    }
+    cur.first = hiLast ? lo : hi;
+    cur.second = hiLast ? hi : lo;
+    done = cur;
+    open = false;
+    return true;
+  }
+
+  // Forget the column in progress
+  void reset() { open = false; }
+
+private:
+  ColumnPoint cur;
+  uint32_t column = 0;
+  force_t lo = 0, hi = 0;
+  bool hiLast = false; // The high came after the low
+  bool open = false;   // cur has a sample in it
+};
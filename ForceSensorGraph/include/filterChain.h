@@ -0,0 +1,256 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+#include "force.h"
+
+// Streaming filters for force_t samples.  Every stage has the same interface:
+//   bool update(force_t in, force_t &out)  - false if this sample produced no output (decimation)
+//   void reset()                           - forget the history, the next sample primes it
+// and FilterChain<Stage, Stage, ...> runs them in order.  The stages are chosen at compile
+// time, and each has a pass-through specialisation (MedianFilter<1>, LowPass<0, R>,
+// FirDecimator<T, 1>) that compiles away, so a disabled stage costs no cycles.
+// All integer maths per sample; the float coefficient design runs once, in the constructor.
+// A reset stage takes its first sample as the steady state, so there is no start-up transient.
+
+// Median of the last N samples (N odd): any spike shorter than (N + 1) / 2 samples is thrown
+// away, steps pass through unrounded, (N - 1) / 2 samples late.  O(N) per sample.
+template <uint8_t N>
+class MedianFilter
+{
+  static_assert(N & 1, "MedianFilter length must be odd");
+
+public:
+  bool update(force_t in, force_t &out)
+  {
+    uint8_t i;
+
+    if (n < N)
+    {
+      n++;
+    }
+    else
+    {
+      // Take the oldest sample out of the sorted copy
+      for (i = 0; sorted[i] != hist[next]; i++)
+        ;
+      for (; i < N - 1; i++)
+      {
+        sorted[i] = sorted[i + 1];
+      }
+    }
+    hist[next] = in;
+    next = next + 1 < N ? next + 1 : 0;
+
+    // ...and insert the new one
+    for (i = n - 1; i > 0 && sorted[i - 1] > in; i--)
+    {
+      sorted[i] = sorted[i - 1];
+    }
+    sorted[i] = in;
+
+    out = sorted[(n - 1) / 2];
+    return true;
+  }
+
+  void reset() { n = next = 0; }
+
+private:
+  force_t hist[N], sorted[N];
+  uint8_t n = 0, next = 0;
+};
+
+template <>
+class MedianFilter<1>
+{
+public:
+  bool update(force_t in, force_t &out)
+  {
+    out = in;
+    return true;
+  }
+  void reset() {}
+};
+
+// Second order Butterworth low-pass, cutoff CUTOFF_HZ at RATE_HZ samples per second.
+// Coefficients are Q24.  Because b0 = b2 = b1 / 2 for this filter, the numerator is one
+// multiply by s = 4 * b0, and s is worked out from the quantised a1, a2 so the DC gain is
+// exactly 1.  The bits shifted off each output are carried into the next one (first order
+// error feedback), otherwise the rounding leaves a dead band of several milligrams at low
+// cutoffs; with it a constant load comes out unchanged, to the milligram.
+template <uint16_t CUTOFF_HZ, uint16_t RATE_HZ>
+class LowPass
+{
+  static_assert(2 * CUTOFF_HZ < RATE_HZ, "LowPass cutoff must be below half the sample rate");
+
+public:
+  LowPass()
+  {
+    float k = tan(M_PI * CUTOFF_HZ / RATE_HZ);
+    float norm = 1 / (1 + M_SQRT2 * k + k * k);
+
+    a1 = lround(2 * (k * k - 1) * norm * ONE);
+    a2 = lround((1 - M_SQRT2 * k + k * k) * norm * ONE);
+    s = ONE + a1 + a2;
+  }
+
+  bool update(force_t in, force_t &out)
+  {
+    int64_t acc;
+
+    if (!primed)
+    {
+      x1 = x2 = y1 = y2 = in;
+      residue = 0;
+      primed = true;
+    }
+    acc = (int64_t)s * ((int64_t)in + 2 * (int64_t)x1 + x2) - 4 * ((int64_t)a1 * y1 + (int64_t)a2 * y2) + residue;
+    x2 = x1;
+    x1 = in;
+    y2 = y1;
+    y1 = (force_t)(acc >> (SHIFT + 2));
+    residue = (int32_t)(acc - ((int64_t)y1 << (SHIFT + 2)));
+    out = y1;
+    return true;
+  }
+
+  void reset() { primed = false; }
+
+private:
+  static const uint8_t SHIFT = 24;
+  static const int32_t ONE = 1L << SHIFT;
+
+  int32_t a1, a2, s, residue = 0;
+  force_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+  bool primed = false;
+};
+
+template <uint16_t RATE_HZ>
+class LowPass<0, RATE_HZ>
+{
+public:
+  bool update(force_t in, force_t &out)
+  {
+    out = in;
+    return true;
+  }
+  void reset() {}
+};
+
+// Keep one sample in M, after a TAPS long Hamming-windowed sinc that cuts off at the new
+// Nyquist frequency.  The convolution only runs for the samples that are kept, so the cost
+// per input sample is TAPS / M multiplies.  Q15 coefficients, trimmed to sum to exactly 1.
+template <uint8_t TAPS, uint8_t M>
+class FirDecimator
+{
+  static_assert(TAPS & 1, "FirDecimator length must be odd");
+
+public:
+  FirDecimator()
+  {
+    const float mid = (TAPS - 1) / 2.0;
+    int32_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < TAPS; i++)
+    {
+      float x = (i - mid) / M;
+      float h = x == 0 ? 1.0 / M : sin(M_PI * x) / (M_PI * x) / M;
+      h *= 0.54 - 0.46 * cos(2 * M_PI * i / (TAPS - 1));
+      coef[i] = lround(h * (1L << SHIFT));
+      sum += coef[i];
+    }
+    coef[TAPS / 2] += (1L << SHIFT) - sum;
+  }
+
+  bool update(force_t in, force_t &out)
+  {
+    int64_t acc = 0;
+    uint8_t i, j;
+
+    if (!primed)
+    {
+      for (i = 0; i < TAPS; i++)
+      {
+        hist[i] = in;
+      }
+      primed = true;
+      phase = 0;
+    }
+    hist[next] = in;
+    next = next + 1 < TAPS ? next + 1 : 0;
+    if (phase++)
+    {
+      phase = phase < M ? phase : 0;
+      return false;
+    }
+
+    // hist[next] is now the oldest sample; the taps are symmetric, so the order doesn't matter
+    for (i = 0, j = next; i < TAPS; i++)
+    {
+      acc += (int64_t)coef[i] * hist[j];
+      j = j + 1 < TAPS ? j + 1 : 0;
+    }
+    out = (force_t)((acc + (1L << (SHIFT - 1))) >> SHIFT);
+    return true;
+  }
+
+  void reset() { primed = false; }
+
+private:
+  static const uint8_t SHIFT = 15;
+
+  int16_t coef[TAPS];
+  force_t hist[TAPS];
+  uint8_t next = 0, phase = 0;
+  bool primed = false;
+};
+
+template <uint8_t TAPS>
+class FirDecimator<TAPS, 1>
+{
+public:
+  bool update(force_t in, force_t &out)
+  {
+    out = in;
+    return true;
+  }
+  void reset() {}
+};
+
+// Runs the stages in order, stopping at one that produced no output
+template <typename... Stages>
+class FilterChain;
+
+template <>
+class FilterChain<>
+{
+public:
+  bool update(force_t in, force_t &out)
+  {
+    out = in;
+    return true;
+  }
+  void reset() {}
+};
+
+template <typename First, typename... Rest>
+class FilterChain<First, Rest...>
+{
+public:
+  bool update(force_t in, force_t &out)
+  {
+    force_t y;
+    return first.update(in, y) && rest.update(y, out);
+  }
+
+  void reset()
+  {
+    first.reset();
+    rest.reset();
+  }
+
+private:
+  First first;
+  FilterChain<Rest...> rest;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+// Fixed-point force.  Every per-sample step (counts to force, sums, min/max, peel detection,
+// plotting) works in whole milligrams, so the AVR never runs a software float routine at
+// the sample rate.  Floats and text only appear at display rate (legend, axes, autoscale).
+// An int32_t holds +/-2147 kg, far beyond what a 24-bit HX711 can report.
+typedef int32_t force_t;
+
+#define FORCE_PER_GRAM 1000L                             // force_t units in a gram
+#define GRAMS(g) ((force_t)((g) * FORCE_PER_GRAM))       // Constant grams to force_t
+#define FORCE_GAIN_SHIFT 16                              // Raw count gains are Q16 force_t per count
+
+inline float forceToGrams(force_t f)
+{
+  return (float)f / FORCE_PER_GRAM;
+}
+
+inline force_t gramsToForce(float g)
+{
+  return (force_t)(g * FORCE_PER_GRAM + (g < 0 ? -0.5f : 0.5f));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// Stack headroom on the board.  ramPaint(), first thing in setup(), fills the RAM between the
+// heap and the stack with a pattern; ramUntouched() counts how much of it the stack has not
+// yet reached, however deep any call chain or interrupt has gone since.  That is the margin
+// to keep above zero, rather than what the build's .data + .bss leave.  0 off the board.
+void ramPaint();
+uint16_t ramUntouched();
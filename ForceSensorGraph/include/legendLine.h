@@ -0,0 +1,25 @@
+#pragma once
+
+#include <TFT_ILI9341.h>
+
+#define LEGEND_CHARS 15 // Characters per line, 6 pixels each: from x=230 to the right edge
+
+// One line of the legend, a label and a value, in the 6x8 font.  Only the character cells
+// that differ from what is on the screen are drawn, each as an opaque glyph over the old
+// one, so a value that ticks over from 123.4 to 123.5 costs one character, not a line.
+class LegendLine
+{
+public:
+  LegendLine(int16_t x, int16_t y, uint16_t color) : x(x), y(y), color(color) {}
+
+  // Show label (F("...") in flash) then value, blank-padded to LEGEND_CHARS.  Returns the
+  // number of characters drawn.
+  uint8_t draw(TFT_ILI9341 &tft, uint16_t bg, const __FlashStringHelper *label, const char *value);
+  // The screen was cleared under it: draw every character next time
+  void invalidate();
+
+private:
+  int16_t x, y;
+  uint16_t color;
+  char shown[LEGEND_CHARS] = {0}; // What is on the screen, 0 for nothing
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "acquisition.h"
+#include "force.h"
+
+// Per-channel tare offset (raw counts) and gain (Q16 force_t per count, the reciprocal of
+// the counts-per-gram scale) of the load cells
+extern long cellOffset[LOADCELL_COUNT];
+extern int32_t cellGain[LOADCELL_COUNT];
+extern int32_t cellCurve; // Linearity correction of the total (CAL_LINEARISE), Q56 per mg
+
+boolean tareCells(uint8_t times); // Blocking, for setup() only
+void setCellScales(float scale);
+void saveCells();
+boolean restoreCells();
+force_t cellForce(const RawSample &s, uint8_t c);
+force_t totalForce(const RawSample &s);
+
+// Tare and calibration jobs (startTare(), startCalibration()): what changed
+enum CellJobEvent
+{
+  CELL_JOB_NONE,
+  CELL_JOB_TARED,     // New offsets
+  CELL_JOB_CALIBRATED // The calibration screens are gone and the chart is back, maybe with a new scale
+};
+
+uint8_t cellJobFeed(const RawSample &s); // Every ACQ_A128 sample
+uint8_t cellJobTick(TFT_ILI9341 &tft);   // Every few ms, from loop()
+boolean calibrationShown();
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include "force.h"
+#include "timebase.h"
+
+// Streaming peel detector, constant time and memory per sample.
+// While idle it tracks the baseline (the unloaded reading) with a slow average.  A peel
+// starts when the force has risen PEEL_ONSET_GRAMS above the baseline and is still climbing
+// faster than PEEL_ONSET_SLOPE.  From then on the peak is tracked, and the peel is complete
+// (the FEP has let go) when the force falls fast, to below PEEL_RELEASE_PERCENT of the peak
+// above the baseline.  If the peak was under PEEL_MIN_PEAK it was only noise and is dropped.
+// The detector re-arms once the ringing after the release has settled back within
+// PEEL_ONSET_GRAMS of the baseline.  The impulse of the peel, the force above the baseline
+// integrated over time from the onset to the release, comes with the release.  A load that
+// never releases, or never settles after a release, within PEEL_TIMEOUT_MS is taken to be
+// static and becomes the new baseline.
+// All integer maths, run on each sample as it is drained from the acquisition ring.  Needs
+// the PEEL_* settings from setup.h.
+
+enum PeelEventType
+{
+  PEEL_ONSET,
+  PEEL_RELEASE
+};
+
+struct PeelEvent
+{
+  uint8_t type;  // PeelEventType
+  time_us t;     // Data-ready of the sample that triggered it
+  force_t force; // Force above the baseline: at onset, or the peak for a release
+  time_us tPeak; // When the peak was reached (PEEL_RELEASE only)
+  force_t impulse; // Force * seconds, from the onset (PEEL_RELEASE only)
+};
+
+// How long events took to come out, from data-ready to the end of update()
+struct PeelStats
+{
+  uint16_t peels;
+  uint32_t latencyMaxUs;
+  uint32_t latencySumUs;
+  uint16_t latencyCount;
+};
+
+class PeelDetector
+{
+public:
+  void reset();
+  // One sample in: t = timeUs() at data-ready, y the force.  Returns true with ev filled in
+  // if this sample completed an onset or a release.
+  bool update(time_us t, force_t y, PeelEvent &ev);
+
+  PeelStats stats = {0, 0, 0, 0};
+
+private:
+  enum State
+  {
+    IDLE,
+    LOADING,
+    SETTLING
+  };
+
+  bool emit(PeelEvent &ev, uint8_t type, time_us t, force_t force);
+
+  static const uint8_t SLOPE_SAMPLES = 4; // Slope is measured over this many samples
+
+  uint8_t state = IDLE;
+  force_t baseline = 0;
+  boolean primed = false; // Baseline seeded from a first sample
+  force_t peak = 0;
+  int64_t area = 0; // Force * us since the onset
+  time_us tPeak = 0, tState = 0; // tState: when the current state was entered
+  force_t lastY[SLOPE_SAMPLES];
+  uint32_t lastT[SLOPE_SAMPLES];  // Low 32 bits, for the slope
+  uint8_t next = 0, filled = 0;
+};
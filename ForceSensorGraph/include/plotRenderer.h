@@ -0,0 +1,103 @@
+#pragma once
+
+#include <TFT_ILI9341.h>
+#include <TFT_Charts.h>
+#include "force.h"
+#include "columnDecimator.h"
+
+// Dirty-region scrolling plot.
+// The trace is kept as one lit span of pixel rows per screen column, packed into 14 bits a
+// column (setSpan()), which is most of the RAM the plot takes.
+// Every sample only touches the columns between the previous sample and itself, and each
+// touched column is updated by erasing/drawing just the rows that differ from what is on
+// the screen.  When the trace reaches the right edge the plot scrolls by PLOT_SCROLL
+// columns, and again only the per-column differences are pushed to the TFT.
+// Drawing is batched a frame at a time: the columns a frame changes are only noted as they
+// change, and at the end each one gets a single address window over its changed rows,
+// filled with runs of trace and background colour.  Rows changed several times in a frame
+// (the three samples of a decimated column) go out once.
+// The span array is the off-screen copy of the plot: the Y=0 line is composed into every
+// column pushed, under the trace, so erasing never punches holes in it and it is never
+// drawn again over the trace.  The X ticks and labels move with the trace, and are kept
+// here too, so a scroll only redraws the labels that moved rather than the whole axis.
+// Samples are placed with integer maths only; the Y mapping is worked out again whenever the
+// axis limits change.
+class PlotRenderer
+{
+public:
+  // Forget the trace (after a full-screen clear) and start again at time x0Ms, drawing the
+  // Y=0 line and the X ticks and labels.  ChartXY only draws the X axis line itself.
+  void reset(TFT_ILI9341 &tft, ChartXY &chart, uint32_t x0Ms);
+  // Add a decimated column: through its extremes in order, and on to its last sample.  If it
+  // is off the right edge, the plot scrolls first: the column is kept, and drawn once step()
+  // has finished the scroll.  Only call it when !busy().
+  void addColumn(TFT_ILI9341 &tft, ChartXY &chart, const ColumnPoint &p);
+  // A scroll or a rescale is under way
+  boolean busy() { return scrollNext < PLOT_W || rescaleNext < PLOT_W; }
+  // Move PLOT_SCROLL_STEP more columns of it, so the sampling gets a look in between
+  void step(TFT_ILI9341 &tft, ChartXY &chart);
+  // The Y limits changed from (oldMin, oldMax), with a label every tick: re-project the
+  // retained spans onto the new scale, pushing only the rows that change, and move the Y=0
+  // line and the Y ticks and labels.  That is done by step(), like a scroll, so only call it
+  // when !busy().
+  void rescaleY(TFT_ILI9341 &tft, ChartXY &chart, float oldMin, float oldMax, float tick);
+  // The Y labels for the chart's limits, one every tick, where ChartXY::drawLabelsY() puts
+  // them: but only onto a label area that is already clear, as ChartXY clears all of it first
+  void drawLabelsY(TFT_ILI9341 &tft, ChartXY &chart, float tick);
+
+private:
+  static const uint8_t BATCH = 8; // Columns a frame can change before they have to go out
+  static const uint8_t NO_ROW = 0xFF;
+  static const uint8_t TICKS = XRANGE / XTICKTIME + 1;
+  static const uint8_t SPAN_BITS = 14;
+  static const uint16_t EMPTY_SPAN = (1 << SPAN_BITS) - 1;
+  static const uint8_t SPAN_RUN = PLOT_H / 2 + 1; // Longest span of the first kind in setSpan()
+
+  void mapY(ChartXY &chart);
+  uint8_t toRow(force_t y);
+  int16_t toColumn(uint32_t tMs);
+  void addSample(TFT_ILI9341 &tft, ChartXY &chart, uint32_t tMs, force_t y);
+  void rescaleStep(TFT_ILI9341 &tft, ChartXY &chart);
+  void setColumn(TFT_ILI9341 &tft, ChartXY &chart, uint16_t c, uint8_t top, uint8_t bottom);
+  void flush(TFT_ILI9341 &tft, ChartXY &chart);
+  void span(uint16_t c, uint8_t &top, uint8_t &bottom);
+  void setSpan(uint16_t c, uint8_t top, uint8_t bottom);
+  uint16_t colorAt(ChartXY &chart, uint8_t top, uint8_t bottom, uint8_t r);
+  void push(TFT_ILI9341 &tft, ChartXY &chart, uint16_t c, int16_t from, int16_t to);
+  void drawRow0(TFT_ILI9341 &tft, uint16_t color);
+  void drawAxisX(TFT_ILI9341 &tft, ChartXY &chart);
+
+  // Each column's first and last lit row, 0 being the top of the plot, as span() gives them:
+  // bottom < top for an empty column
+  uint8_t spans[(PLOT_W * SPAN_BITS + 7) / 8];
+  uint32_t x0Ms = 0;      // Time of column 0 is x0Ms + scrolled columns
+  uint16_t scrolled = 0;  // Always < PLOT_W, x0Ms moves on by XRANGE instead
+  force_t yTop = 0;       // Force at row 0, at the last row, and rows per force unit (Q24)
+  force_t yBottom = 0;
+  uint32_t rowGain = 0;
+  int16_t lastCol = -1;   // Column and row of the previous sample, to join the trace up
+  uint8_t lastRow = 0;
+  uint8_t row0 = NO_ROW;  // Row of the Y=0 line, NO_ROW when 0 is off the plot
+
+  // The X ticks on the screen: their pixel columns, labelled firstTickS, firstTickS +
+  // XTICKTIME, ... seconds
+  int16_t tickX[TICKS];
+  uint8_t tickCount = 0;
+  uint32_t firstTickS = 0;
+
+  // The columns changed in this frame, as the screen still shows them
+  struct Shown
+  {
+    uint16_t c;
+    uint8_t top, bottom;
+  };
+  Shown shown[BATCH];
+  uint8_t shownCount = 0;
+
+  uint16_t scrollNext = PLOT_W; // Next column to move while scrolling, PLOT_W when not
+  ColumnPoint held;             // The column that set the scroll off, drawn after it
+  uint16_t rescaleNext = PLOT_W; // Likewise, the next column to re-project onto new Y limits...
+  float rescaleK = 1;            // ...as row' = rescaleShift + row * rescaleK
+  float rescaleShift = 0;
+  float yTick = 0;               // The Y labels' step, which ChartXY keeps to itself
+};
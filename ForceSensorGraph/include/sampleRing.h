@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+// Single-producer/single-consumer ring buffer.
+// The producer (the HX711 data-ready ISR) only ever writes head, the consumer (loop())
+// only ever writes tail, so no locking is needed as long as the indices are read and
+// written in one instruction. N must be a power of two and no larger than 128, which
+// keeps the indices in a single byte on the AVR.
+template <typename T, uint8_t N>
+class SampleRing
+{
+  static_assert((N & (N - 1)) == 0, "SampleRing length must be a power of two");
+  static_assert(N <= 128, "SampleRing length must fit a uint8_t index");
+
+public:
+  // Producer side. Returns false (and drops the sample) if the consumer has fallen behind.
+  bool push(const T &item)
+  {
+    uint8_t h = head;
+    if ((uint8_t)(h - tail) >= N)
+    {
+      overruns++;
+      return false;
+    }
+    buf[h & (N - 1)] = item;
+    __asm__ __volatile__("" ::: "memory"); // Data must land before the index is published
+    head = h + 1;
+    return true;
+  }
+
+  // Consumer side. Returns false if there is nothing to read.
+  bool pop(T &item)
+  {
+    uint8_t t = tail;
+    if (t == head)
+    {
+      return false;
+    }
+    item = buf[t & (N - 1)];
+    __asm__ __volatile__("" ::: "memory"); // Copy the slot out before handing it back
+    tail = t + 1;
+    return true;
+  }
+
+  uint8_t count() const { return (uint8_t)(head - tail); }
+  bool isEmpty() const { return head == tail; }
+
+  // Consumer side only - discards everything that has been pushed so far.
+  void flush() { tail = head; }
+
+  // Number of samples dropped because the ring was full
+  volatile uint16_t overruns = 0;
+
+private:
+  T buf[N];
+  volatile uint8_t head = 0;
+  volatile uint8_t tail = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include "timebase.h"
+
+// Fixed-priority cooperative scheduler.  Tasks are listed in priority order, and each
+// schedRun() runs the first one that is due - so after every task, the most urgent work
+// goes next - and returns.  A task is due every periodMs, or for periodMs 0, once
+// schedSignal() has been called for it.  Each task must be signalled from one context only
+// (one ISR, or loop()), which keeps schedSignal() lock-free.  A task that starts more than
+// deadlineMs after it became due counts as a deadline miss.  Times are the low 32 bits of
+// timeUs(), which schedRun() keeps ticking over.
+struct Task
+{
+#ifdef SIM_NATIVE
+  const char *name; // For the simulator's report: the board has no RAM to spare for it
+#endif
+  void (*run)();
+  uint16_t periodMs;   // 0: runs when signalled
+  uint16_t deadlineMs; // Miss if it starts later than this
+
+  // Kept by the scheduler
+  uint32_t dueUs; // When it last fell due: its period came round, or the first signal
+  volatile bool signalled;
+  uint16_t misses;
+#ifdef SIM_NATIVE // The simulator's report and tests only, like name
+  uint32_t wcetUs;    // Longest run
+  uint32_t maxLateUs; // Longest wait from due to started: the jitter
+#endif
+};
+
+// An entry of the task table, its bookkeeping zeroed
+#ifdef SIM_NATIVE
+#define TASK(name, run, periodMs, deadlineMs) {name, run, periodMs, deadlineMs, 0, false, 0, 0, 0}
+#else
+#define TASK(name, run, periodMs, deadlineMs) {run, periodMs, deadlineMs, 0, false, 0}
+#endif
+
+void schedBegin(Task *tasks, uint8_t n);
+void schedSignal(Task &t);
+bool schedRun();
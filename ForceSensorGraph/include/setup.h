@@ -24,6 +24,12 @@ Look for this file in the folder .pio/libdeps/<platform>/TFT_ILI9341
 #define LCD_SPI_EN 5 // Drive LCD_SPI_EN low to enable the 5V -> 3.3V logic converters
 #endif
 
+// Load cells.  Each cell has its own HX711 and DOUT pin, and they all share HX711_SCK so
+// they are read together.  List the DOUT pins here, e.g. one cell per corner of the build
+// plate on PCBV2: {HX711_DOUT, 2, 3, 7} (all external interrupt pins on the Leonardo)
+#define LOADCELL_DOUTS {HX711_DOUT}
+#define LOADCELL_COUNT 1
+
 // If DEBUG is anything but zero, the program will block until a serial monitor is attached/open
 // Set to 1 to get force sensor values on the serial monitor
 // Set to 2 to get more detailed program status
@@ -35,22 +41,99 @@ Look for this file in the folder .pio/libdeps/<platform>/TFT_ILI9341
 // Comment the next line in/out to invert the sign of the load cell values
 // #define INVERT_Y
 
-#define DATA_INTERVAL 333       // How often (ms) to sample and plot data
-#define QUEUE_LENGTH 100        // How many points to keep on the FIFO queue?
+#define DATA_INTERVAL 333       // How often (ms) to update the legend and autoscale (the trace is drawn at the sample rate)
+#define AUTOSCALE_FILL_PERCENT 60   // Autoscale so the queue's window fills this much of the Y axis...
+#define AUTOSCALE_MARGIN_PERCENT 5  // ...once it comes this close to its top or bottom, or would fit in half of it
+#define AUTOSCALE_MIN_GRAMS 20      // Never zoom in further than this, so the noise at rest stays small
+#define AUTOSCALE_HOLD_MS 3000      // Leave the axis alone this long after a rescale, unless the trace goes off it
+#define QUEUE_LENGTH 12         // How many spans of min/max to keep for the legend and autoscaling (10 bytes of RAM each)...
+#define QUEUE_INTERVALS 9       // ...each of this many DATA_INTERVALs, so the window covers the X axis (12 x 9 x 333ms)
+#define SAMPLE_RING_LENGTH 8    // Raw HX711 samples (all cells) buffered by the acquisition ISR (power of 2, 100ms at 80Hz)
+#define PLOT_RING_LENGTH 4      // Pixel columns of filtered samples waiting to be drawn (power of 2, 128ms each)
 #define XRANGE 35               // How many seconds does the X axis represent?
 #define XTICKTIME 5             // How many seconds between X tick marks?
+#define PLOT_X 41               // Plot area on the screen, inside the ChartXY axes (pixels)
+#define PLOT_Y 45
+#define PLOT_W 274
+#define PLOT_H 175
+#define PLOT_SCROLL 8           // How many columns to scroll by when the trace reaches the right edge?
+#define PLOT_SCROLL_STEP 32     // Columns moved per plot task run while scrolling, so sampling gets a look in between
+#define PLOT_COLOR TFT_CYAN     // Trace colour
+#define PLOT_Y0_COLOR TFT_DARKGREY // Y=0 line, under the trace
+#define PLOT_AXIS_COLOR TFT_WHITE  // X ticks and labels, which move with the trace: as ChartXY draws its axes
+#define OUTLIER_GRAMS 20000      // Readings beyond this are glitches, not force
+#define HX711_RATE_HZ 80         // Conversion rate, set by the RATE pin on the HX711 board: 80 or 10
+#define FILTER_MEDIAN 3          // Median of this many samples (odd) removes shorter glitches from the trace (1 for none)
+#define FILTER_LOWPASS_HZ 0      // Butterworth low-pass cutoff for the trace and legend, e.g. 10 (0 for none)
+#define FILTER_DECIMATE 1        // Plot one sample in this many, after an anti-aliasing FIR (1 for none)
+#define FILTER_FIR_TAPS 15       // Length of that FIR (odd)
+#define PEEL_ONSET_GRAMS 50      // Rise above the baseline that starts a peel...
+#define PEEL_ONSET_SLOPE 200     // ...if it is still rising faster than this (g/s)
+#define PEEL_MIN_PEAK 200        // Smaller peaks are noise, not peels (g)
+#define PEEL_RELEASE_PERCENT 50  // The peel is complete when the force drops below this percentage of its peak
+#define PEEL_TIMEOUT_MS 20000    // A load that lasts longer than this is not a peel, but the new baseline
+#define PEEL_TRIGGER_PIN 4       // Pulsed high for one sample period when a peel completes (comment out for none)
+#define PEEL_SERIAL              // Report peel onsets/releases on the serial port (comment out for none)
+#define STREAM_SERIAL            // Send every sample to the serial port as "s,<ms>,<g>" lines, unfiltered (comment out for none)
+// #define BURST_SERIAL          // Instead, send only the raw samples around each trigger, as binary frames (see burstCapture.h)
+#define BURST_PRE_SAMPLES 40     // Samples before the trigger in each burst (0.5s at 80Hz, 8 bytes of RAM each with one cell)
+#define BURST_POST_SAMPLES 120   // Samples from the trigger on
+#define BURST_LEVEL_GRAMS 100    // Trigger when the unfiltered force reaches this (0 for never)...
+#define BURST_SLOPE 0            // ...or rises faster than this (g/s, 0 for never)...
+// #define BURST_PIN 7           // ...or this pin goes to BURST_PIN_LEVEL (comment out for none)
+#define BURST_PIN_LEVEL LOW
+// #define STATS_PERCENTILES {50, 95, 99} // Percentiles of the filtered force since the tare to track (ascending, 1-99), the legend shows the last (comment out for none)
+#define STATS_SERIAL             // Report the statistics since the tare with every peel release (comment out for none)
+// #define HISTORY_SERIAL        // Keep the last few seconds of raw samples, compressed, and send them when the host sends 'h' (see traceLog.h)
+#define HISTORY_BYTES 768        // RAM for that history: 2 to 3 bytes a sample per cell, so some 4s at 80Hz with one
+#define HISTORY_BLOCK_BYTES 128   // It is dropped this many bytes at a time, oldest first
+#define SETTLE_SAMPLES 16        // Tare/calibration: judge whether the load is steady over windows of this many samples
+#define SETTLE_GRAMS 10          // Steady for a tare: consecutive windows' means agree within this...
+#define SETTLE_NOISE_GRAMS 50    // ...and the samples in each have a standard deviation under this
+#define TARE_TIMEOUT_MS 5000     // Give up on a tare if the load has not settled by then
 #define REFERENCE_MASS 1000     // Reference mass for calibration routine, in g
-#define EEPROM_ADDR 1019        // use the last four bytes of the EEPROM for calibration constant
+#define CAL_MASSES {0, REFERENCE_MASS} // Masses to hang in turn for calibration, in g (0: nothing), up to 6.  With a single mass the zero is the last tare
+#define CAL_POINT_WINDOWS 4      // Steady windows (SETTLE_SAMPLES each) to collect at each mass
+// #define CAL_LINEARISE         // Also fit and correct the load cell's linearity error (needs 3 or more different CAL_MASSES)
+#define CAL_WAIT_MS 120000       // Give up waiting for the double-click after this long
+#define CAL_TIMEOUT_MS 30000     // Give up if a mass hasn't settled by then
+#define CAL_SHOW_MS 5000         // How long to show the calibration result
+#define SCREEN_CLEAR_ROWS 8      // Rows of the old screen cleared per control task run when the calibration screens change
+#define CAL_PROFILE 0           // Which stored calibration to use and save: one per load cell/printer (0-254)
+#define CAL_STORE_ADDR 0        // EEPROM given over to the calibration store...
+#define CAL_STORE_SLOTS 31      // ...in 32 byte records, written round-robin so no cell wears out first
+// #define TARE_AT_STARTUP      // Tare at power-up rather than restore the stored zero
+#define EEPROM_ADDR 1019        // Calibration byte of older firmware, read once if the store is empty
 // #define OVERRIDE_CALIBRATION 10 // Override the EEPROM calibration value with this one
 
+#include "force.h"
+
+// One span of the chart queue (QUEUE_INTERVALS of DATA_INTERVAL): the lowest and highest
+// filtered sample in it, so the window's min/max take in every sample, not just the ones
+// the legend showed
+struct ForceSpan
+{
+  force_t lo;
+  force_t hi;
+};
+
 // Function prototypes - DO NOT CHANGE
 void tareHandler();
-void doTare();
+void startTare();
 void calibrateHandler();
-void doCalibration(TFT_ILI9341 &tft);
+void startCalibration(TFT_ILI9341 &tft);
 void endHandler();
 void initChart();
+boolean initChartStep(uint8_t piece);
 ChartXY::point getMinMax();
-boolean scaleY(float yMin, float yMax, String reason);
+boolean queuePush(ForceSpan &p);
+boolean queuePop(ForceSpan &p);
+void queueInterval(const ForceSpan &p);
+boolean scaleY(float yMin, float yMax, float tick, const __FlashStringHelper *reason);
 boolean autoScale(ChartXY::point mm, ChartXY::point p);
+uint8_t updateLegend(force_t curr, force_t mean);
+void updateStatsLegend(force_t sd, force_t peak, force_t impulse);
+#ifdef STATS_PERCENTILES
+void updatePercentileLegend(uint8_t percent, force_t percentile);
+#endif
 void initChart();
\ No newline at end of file
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+// Constant-memory statistics of a sample stream, one sample in at a time.
+
+// Mean, variance and RMS of integer samples (force_t), in integer sums.  A float mean
+// updated a sample at a time stops moving once the steps fall under its precision: after
+// 20M samples a change of load barely shows.  Instead each block of BLOCK samples is summed
+// exactly in int64, taken against the block's first sample so the squares stay small, and
+// only folded into the totals when it is full (Chan et al's pairwise update).  The mean is
+// the exact sum over n; the squared differences from it are a float added to once a block,
+// good to n = 2^32.  Per sample: a subtraction, a 32 x 32 multiply and two int64 additions.
+// Samples must be within 2^26 of each other (OUTLIER_GRAMS keeps them to 2^25.3).
+class RunningStats
+{
+public:
+  static const uint16_t BLOCK = 256;
+
+  void reset() { n = blockN = 0; }
+
+  void add(int32_t x)
+  {
+    int32_t d;
+
+    if (!blockN)
+    {
+      if (!n)
+      {
+        origin = x;
+        sum = 0;
+        m2 = 0;
+      }
+      blockRef = x;
+      blockSum = blockSq = 0;
+    }
+    d = x - blockRef;
+    blockSum += d;
+    blockSq += (int64_t)d * d;
+    if (++blockN == BLOCK)
+    {
+      fold(n, sum, m2);
+      blockN = 0;
+    }
+  }
+
+  uint32_t count() const { return n + blockN; }
+  float mean() const
+  {
+    uint32_t total = n;
+    int64_t s = sum;
+    float m = m2;
+
+    fold(total, s, m);
+    return total ? origin + (float)s / total : 0;
+  }
+  float variance() const // Sample variance
+  {
+    uint32_t total = n;
+    int64_t s = sum;
+    float m = m2;
+
+    fold(total, s, m);
+    return total > 1 ? m / (total - 1) : 0;
+  }
+  float stddev() const { return sqrt(variance()); }
+  float rms() const
+  {
+    uint32_t total = count();
+    float m = mean();
+    return total ? sqrt(m * m + variance() * (total - 1) / total) : 0;
+  }
+
+private:
+  // The block so far into n, the sum (from origin) and the squared differences from the mean
+  void fold(uint32_t &total, int64_t &s, float &m) const
+  {
+    int64_t q;
+    float blockM2, delta;
+
+    if (!blockN)
+    {
+      return;
+    }
+    // Its own squared differences, blockSq - blockSum^2 / blockN, the whole part of the
+    // quotient in int64 so nothing large cancels in float
+    q = blockSum / blockN;
+    blockM2 = blockSq - blockSum * q - (float)(blockSum * (blockSum - q * blockN)) / blockN;
+    // How far its mean is from the mean so far
+    delta = blockRef - origin + (float)blockSum / blockN - (total ? (float)s / total : 0);
+    m += blockM2 + delta * delta * total / (total + blockN) * blockN;
+    s += (int64_t)(blockRef - origin) * blockN + blockSum;
+    total += blockN;
+  }
+
+  uint32_t n = 0;       // Samples in the totals
+  int32_t origin;       // The first sample, the totals' zero
+  int64_t sum;          // Of the samples less origin
+  float m2;             // Squared differences from the mean
+  uint16_t blockN = 0;  // Samples in the block
+  int32_t blockRef;     // The block's first sample
+  int64_t blockSum, blockSq; // Of its samples less blockRef, and their squares
+};
+
+// Approximate percentiles without keeping the samples: the extended P-square algorithm
+// (Jain and Chlamtac, 1985).  2 Q + 3 markers track the minimum, each percentile, the points
+// half way between them and the maximum.  Every sample moves the markers' positions, and a
+// marker that falls a whole position behind or ahead of where its fraction of the samples
+// puts it is moved one step, its height following a parabola through its neighbours.
+// Exact until there are 2 Q + 3 samples, and a few tenths of a percentile out after that on
+// smooth distributions.  percent[] must be ascending, between 1 and 99, and outlive the sketch.
+template <uint8_t Q>
+class QuantileSketch
+{
+public:
+  static const uint8_t MARKERS = 2 * Q + 3;
+
+  explicit QuantileSketch(const uint8_t *percent) : percent(percent) {}
+
+  void reset() { n = 0; }
+
+  void add(float x)
+  {
+    uint8_t i, k;
+
+    if (n < MARKERS)
+    {
+      // Keep the first samples sorted, they are the initial markers
+      for (i = n; i && q[i - 1] > x; i--)
+      {
+        q[i] = q[i - 1];
+      }
+      q[i] = x;
+      pos[n] = n;
+      n++;
+      return;
+    }
+
+    // The cell x lands in.  Every marker above it moves up a position.
+    if (x < q[0])
+    {
+      q[0] = x;
+    }
+    else if (x > q[MARKERS - 1])
+    {
+      q[MARKERS - 1] = x;
+    }
+    for (k = 1; k < MARKERS - 1 && x >= q[k]; k++)
+    {
+    }
+    for (i = k; i < MARKERS; i++)
+    {
+      pos[i]++;
+    }
+    n++;
+
+    for (i = 1; i < MARKERS - 1; i++)
+    {
+      // How far it is from where it should be, in 200ths of a position (positions count from 0)
+      int64_t d = (int64_t)(n - 1) * fraction(i) - (int64_t)pos[i] * 200;
+      int8_t step = d >= 200 && pos[i + 1] - pos[i] > 1 ? 1 : d <= -200 && pos[i] - pos[i - 1] > 1 ? -1 : 0;
+      if (step)
+      {
+        float h = parabolic(i, step);
+        q[i] = q[i - 1] < h && h < q[i + 1] ? h : linear(i, step);
+        pos[i] += step;
+      }
+    }
+  }
+
+  // Percentile j (0 to Q - 1)
+  float value(uint8_t j) const
+  {
+    float r;
+    uint8_t i;
+
+    if (n >= MARKERS)
+    {
+      return q[2 * j + 2];
+    }
+    if (!n)
+    {
+      return 0;
+    }
+    // Too few for the markers to mean anything yet: interpolate the sorted samples
+    r = (n - 1) * percent[j] / 100.0;
+    i = (uint8_t)r;
+    return i + 1u < n ? q[i] + (r - i) * (q[i + 1] - q[i]) : q[i];
+  }
+
+  uint32_t count() const { return n; }
+
+private:
+  // Where marker i should sit, as a fraction of the samples in 200ths: the half way points
+  // between whole percentiles are whole numbers, and there is no division per sample
+  uint8_t fraction(uint8_t i) const
+  {
+    return i & 1 ? p(i / 2) + p(i / 2 + 1) : 2 * p(i / 2);
+  }
+
+  uint8_t p(uint8_t k) const
+  {
+    return !k ? 0 : k > Q ? 100 : percent[k - 1];
+  }
+
+  float parabolic(uint8_t i, int8_t d) const
+  {
+    float n0 = pos[i - 1], n1 = pos[i], n2 = pos[i + 1];
+    return q[i] + d / (n2 - n0) * ((n1 - n0 + d) * (q[i + 1] - q[i]) / (n2 - n1) + (n2 - n1 - d) * (q[i] - q[i - 1]) / (n1 - n0));
+  }
+
+  float linear(uint8_t i, int8_t d) const
+  {
+    return q[i] + d * (q[i + d] - q[i]) / (float)(pos[i + d] - pos[i]);
+  }
+
+  const uint8_t *percent;
+  uint32_t n = 0;
+  float q[MARKERS];      // Marker heights
+  uint32_t pos[MARKERS]; // Marker positions, 0 to n - 1
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include "force.h"
+#include "timebase.h"
+
+// Number formatting into caller-supplied buffers, in integer maths only, for everything
+// printed at display or event rate.  String would take the heap - and in time fragment the
+// Leonardo's 2.5KB of it - on every call, and its float conversion costs thousands of cycles.
+// Each returns buf, so the result can go straight to print().
+
+#define FORCE_TEXT_LEN 13 // "-2147483.648" and the NUL
+#define TIME_TEXT_LEN 25  // 64-bit microseconds as milliseconds, and the NUL
+
+// f in grams, rounded half away from zero to 0-3 decimals: "-12.3"
+char *formatForce(char *buf, force_t f, uint8_t decimals);
+
+// "<ms>.<us>" for the serial protocol, e.g. "5022135.125" - full resolution, however long
+// the board has been up
+char *formatTime(char *buf, time_us t);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Monotonic microsecond timebase.  micros() wraps every 71.6 minutes and millis() every
+// 49.7 days, well inside a long print.  timeUs() extends micros() to 64 bits, which never
+// wraps, and every sample is stamped with it at data-ready.  It has to be called at least
+// once per micros() wrap to see each one go by; the samples and the scheduler see to that.
+// Safe from an ISR and from loop().
+// Shorter intervals can still be taken as differences of the low 32 bits, as long as they
+// are done in uint32_t: unsigned long is 64 bits on the native build and would not wrap.
+typedef uint64_t time_us;
+
+time_us timeUs();
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include "acquisition.h"
+
+// Compressed history of the raw samples, read back oldest first.
+// A RawSample takes 4 + 3 bytes a cell even packed, which buys very little history on the
+// Leonardo.  Between one sample and the next the time barely changes its step and the counts
+// only move by the noise, so each sample is stored as its difference from the one before:
+// - the change in the time step, 0 or one micros() tick either way in 2 bits, and anything
+//   else as a zig-zag varint after the counts
+// - each cell's change in counts as a zig-zag varint (small values of either sign in few
+//   bytes), the first cell's starting in the spare 5 bits of the time byte
+// That is one byte a sample while the load sits still at a few counts of noise, and two
+// while it rises by up to 2047 counts a sample.
+// Deltas can only be decoded from the front, so the history is kept in BLOCK-byte blocks,
+// each starting with a whole key sample, and is dropped a block at a time once all of them
+// are in use.  Readers walk it with a Cursor, which survives the writer moving on: it knows
+// when the block it was in was dropped, and carries on from the oldest one left.
+// Single-threaded: add() and read() from loop(), never from an ISR.
+template <uint16_t BYTES, uint8_t BLOCK>
+class TraceLog
+{
+public:
+  static const uint8_t BLOCKS = BYTES / BLOCK;
+  static const uint8_t KEY_BYTES = 6 + 3 * LOADCELL_COUNT;                 // 48-bit time and each cell's counts
+  static const uint8_t MAX_RECORD = 4 + 4 * (LOADCELL_COUNT - 1) + 5;      // 25-bit deltas, a 32-bit time change
+#if defined(__AVR__)
+  static const int8_t TICK_US = 4; // micros() resolution at 16MHz
+#else
+  static const int8_t TICK_US = 1;
+#endif
+
+  static_assert(BLOCKS >= 2 && BYTES / BLOCK <= 255, "The history needs 2 to 255 blocks");
+  static_assert(BLOCK >= KEY_BYTES + MAX_RECORD, "Blocks too small for a key sample and a delta");
+
+  // Where a reader is up to, and what it has decoded so far
+  struct Cursor
+  {
+    uint16_t block;  // Sequence number of the block
+    uint8_t index;   // Samples already read from it
+    uint8_t offset;  // Bytes already read from it
+    uint16_t lost;   // Blocks dropped before they could be read
+    time_us t;
+    int32_t dt;
+    long count[LOADCELL_COUNT];
+  };
+
+  void clear()
+  {
+    firstBlock += held; // Any reader is now behind the oldest block
+    held = 0;
+  }
+
+  void add(const RawSample &s)
+  {
+    uint8_t rec[MAX_RECORD], n = 0, code, c, slot;
+    uint32_t z;
+    int32_t dt, dd;
+
+    if (held && s.t - lastT < 0x40000000UL)
+    {
+      dt = (uint32_t)(s.t - lastT);
+      dd = dt - lastDt;
+      code = !dd ? 0 : dd == TICK_US ? 1 : dd == -TICK_US ? 2 : 3;
+      z = zigzag(s.count[0] - lastCount[0]);
+      rec[n++] = code << 6 | (z > 0x1F ? 0x20 : 0) | (z & 0x1F);
+      if (z > 0x1F)
+      {
+        n += putVarint(rec + n, z >> 5);
+      }
+      for (c = 1; c < LOADCELL_COUNT; c++)
+      {
+        n += putVarint(rec + n, zigzag(s.count[c] - lastCount[c]));
+      }
+      if (code == 3)
+      {
+        n += putVarint(rec + n, zigzag(dd));
+      }
+      slot = (firstSlot + held - 1) % BLOCKS;
+      if (used + n <= BLOCK && samples[slot] < 255)
+      {
+        memcpy(data[slot] + used, rec, n);
+        used += n;
+        samples[slot]++;
+        lastT = s.t;
+        lastDt = dt;
+        memcpy(lastCount, s.count, sizeof(lastCount));
+        return;
+      }
+    }
+    addKey(s);
+  }
+
+  // Start c at the oldest sample held
+  void rewind(Cursor &c) const
+  {
+    c.block = firstBlock;
+    c.index = c.offset = 0;
+    c.lost = 0;
+  }
+
+  // The sample after the last one c read.  False once c has caught up with the newest.
+  bool read(Cursor &c, RawSample &s) const
+  {
+    uint8_t slot, code, c0, i;
+    uint16_t age = c.block - firstBlock;
+    const uint8_t *p;
+    uint32_t z;
+
+    if ((int16_t)age < 0)
+    {
+      // Dropped under it: go on from the oldest block
+      c.lost += firstBlock - c.block;
+      c.block = firstBlock;
+      c.index = c.offset = 0;
+      age = 0;
+    }
+    if (age >= held)
+    {
+      return false;
+    }
+    slot = (firstSlot + age) % BLOCKS;
+    if (c.index == samples[slot])
+    {
+      if (age + 1 >= held)
+      {
+        return false;
+      }
+      c.block++;
+      c.index = c.offset = 0;
+      slot = (slot + 1) % BLOCKS;
+    }
+
+    p = data[slot] + c.offset;
+    if (!c.index)
+    {
+      c.t = get48(p);
+      for (i = 0; i < LOADCELL_COUNT; i++)
+      {
+        c.count[i] = get24(p + 6 + 3 * i);
+      }
+      c.dt = 0;
+      c.offset = KEY_BYTES;
+    }
+    else
+    {
+      c0 = *p++;
+      code = c0 >> 6;
+      z = c0 & 0x1F;
+      if (c0 & 0x20)
+      {
+        z |= getVarint(p) << 5;
+      }
+      c.count[0] += unzigzag(z);
+      for (i = 1; i < LOADCELL_COUNT; i++)
+      {
+        c.count[i] += unzigzag(getVarint(p));
+      }
+      c.dt += code == 0 ? 0 : code == 1 ? (int32_t)TICK_US : code == 2 ? -TICK_US : unzigzag(getVarint(p));
+      c.t += (uint32_t)c.dt;
+      c.offset = p - data[slot];
+    }
+    c.index++;
+
+    s.t = c.t;
+    memcpy(s.count, c.count, sizeof(s.count));
+    s.input = ACQ_A128;
+    return true;
+  }
+
+  // Samples held, and the bytes they take (key samples and all, not the unused block ends)
+  uint16_t samplesHeld() const
+  {
+    uint16_t n = 0;
+    for (uint8_t i = 0; i < held; i++)
+    {
+      n += samples[(firstSlot + i) % BLOCKS];
+    }
+    return n;
+  }
+
+  uint16_t bytesHeld() const
+  {
+    return held ? (held - 1) * BLOCK + used : 0;
+  }
+
+private:
+  // Start a new block with s as its key, dropping the oldest block if they are all in use
+  void addKey(const RawSample &s)
+  {
+    uint8_t slot, i;
+
+    if (held == BLOCKS)
+    {
+      firstSlot = (firstSlot + 1) % BLOCKS;
+      firstBlock++;
+      held--;
+    }
+    slot = (firstSlot + held++) % BLOCKS;
+    put48(data[slot], s.t);
+    for (i = 0; i < LOADCELL_COUNT; i++)
+    {
+      put24(data[slot] + 6 + 3 * i, s.count[i]);
+    }
+    used = KEY_BYTES;
+    samples[slot] = 1;
+    lastT = s.t;
+    lastDt = 0;
+    memcpy(lastCount, s.count, sizeof(lastCount));
+  }
+
+  static uint32_t zigzag(int32_t d) { return (uint32_t)d << 1 ^ (uint32_t)(d >> 31); }
+  static int32_t unzigzag(uint32_t z) { return (int32_t)(z >> 1) ^ -(int32_t)(z & 1); }
+
+  // 7 bits a byte, low first, the top bit set on all but the last
+  static uint8_t putVarint(uint8_t *p, uint32_t z)
+  {
+    uint8_t n = 0;
+    while (z > 0x7F)
+    {
+      p[n++] = (z & 0x7F) | 0x80;
+      z >>= 7;
+    }
+    p[n++] = z;
+    return n;
+  }
+
+  static uint32_t getVarint(const uint8_t *&p)
+  {
+    uint32_t z = 0;
+    uint8_t shift = 0;
+    do
+    {
+      z |= (uint32_t)(*p & 0x7F) << shift;
+      shift += 7;
+    } while (*p++ & 0x80);
+    return z;
+  }
+
+  static void put24(uint8_t *p, long v)
+  {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+  }
+
+  static long get24(const uint8_t *p)
+  {
+    return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8; // Sign-extended
+  }
+
+  static void put48(uint8_t *p, time_us t)
+  {
+    for (uint8_t i = 0; i < 6; i++, t >>= 8)
+    {
+      p[i] = t;
+    }
+  }
+
+  static time_us get48(const uint8_t *p)
+  {
+    time_us t = 0;
+    for (uint8_t i = 6; i--;)
+    {
+      t = t << 8 | p[i];
+    }
+    return t;
+  }
+
+  uint8_t data[BLOCKS][BLOCK];
+  uint8_t samples[BLOCKS];   // Samples in each block, the key included
+  uint8_t firstSlot = 0;     // Where the oldest block is...
+  uint16_t firstBlock = 0;   // ...and its sequence number, for the cursors
+  uint8_t held = 0;          // Blocks in use
+  uint8_t used = 0;          // Bytes in use in the newest
+  time_us lastT;             // The sample the next one is a delta from
+  int32_t lastDt;
+  long lastCount[LOADCELL_COUNT];
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+// Sliding-window min/max in amortised O(1) per sample (monotonic deques).
+// The window itself lives elsewhere (the fQ chart queue), so the deques only hold sequence
+// numbers - one byte per slot for QUEUE_LENGTH < 255 - and values are fetched through a
+// getter taking the age of a sample, i.e. its index from the oldest one (fQ.peekIdx order).
+// Use a uint16_t Seq for longer windows.  T is the value type (force_t for the chart queue).
+// A slot may hold a low and a high value (the extremes of an interval): the min is then
+// taken over the lows and the max over the highs, each with its own getter.
+// push() must be called after the sample was added to the window, pop() after the oldest
+// sample was removed from it.
+template <uint16_t N, typename Seq = uint8_t, typename T = float>
+class WindowMinMax
+{
+  static_assert((Seq)(N + 1) == N + 1, "Seq type too small for the window length");
+
+public:
+  template <typename Get>
+  void push(T y, Get get)
+  {
+    push(y, y, get, get);
+  }
+
+  template <typename GetLo, typename GetHi>
+  void push(T lo, T hi, GetLo getLo, GetHi getHi)
+  {
+    Seq s = head++;
+
+    while (maxLen && getHi(age(maxQ[back(maxFirst, maxLen)])) <= hi)
+    {
+      maxLen--;
+    }
+    maxQ[slot(maxFirst + maxLen++)] = s;
+
+    while (minLen && getLo(age(minQ[back(minFirst, minLen)])) >= lo)
+    {
+      minLen--;
+    }
+    minQ[slot(minFirst + minLen++)] = s;
+
+    // The fronts only change if the new sample displaced everything else
+    if (maxQ[maxFirst] == s)
+    {
+      maxY = hi;
+    }
+    if (minQ[minFirst] == s)
+    {
+      minY = lo;
+    }
+  }
+
+  template <typename Get>
+  void pop(Get get)
+  {
+    pop(get, get);
+  }
+
+  template <typename GetLo, typename GetHi>
+  void pop(GetLo getLo, GetHi getHi)
+  {
+    Seq s = tail++;
+
+    if (maxLen && maxQ[maxFirst] == s)
+    {
+      maxFirst = slot(maxFirst + 1);
+      if (--maxLen)
+      {
+        maxY = getHi(age(maxQ[maxFirst]));
+      }
+    }
+    if (minLen && minQ[minFirst] == s)
+    {
+      minFirst = slot(minFirst + 1);
+      if (--minLen)
+      {
+        minY = getLo(age(minQ[minFirst]));
+      }
+    }
+  }
+
+  void clear()
+  {
+    head = tail = 0;
+    maxFirst = maxLen = minFirst = minLen = 0;
+    minY = maxY = 0;
+  }
+
+  T min() const { return minY; }
+  T max() const { return maxY; }
+
+private:
+  static const uint16_t SLOTS = N + 1;
+
+  static uint16_t slot(uint16_t i) { return i % SLOTS; }
+  static uint16_t back(uint16_t first, uint16_t len) { return (first + len - 1) % SLOTS; }
+  uint16_t age(Seq s) const { return (Seq)(s - tail); }
+
+  Seq maxQ[SLOTS], minQ[SLOTS];
+  uint16_t maxFirst = 0, maxLen = 0, minFirst = 0, minLen = 0;
+  Seq head = 0, tail = 0;
+  T minY = 0, maxY = 0;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+// Host stand-in for the Arduino core, just enough of it for ForceSensorGraph.
+// Pin numbers and interrupt mapping follow the Leonardo (ATmega32U4).
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define NOT_AN_INTERRUPT -1
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+
+// Strings kept in flash, as <avr/pgmspace.h> and WString.h give them: on the host flash is
+// just memory, but F() still has its own type, so the prints take it as the board's do
+class __FlashStringHelper;
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(PSTR(s)))
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define strcpy_P strcpy
+#define strcat_P strcat
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+
+// Direct port access, as the core's pin tables and <avr/io.h> give it.  A register is a
+// proxy for the pins behind it, so the HX711 model still sees every edge, and it costs what
+// a load or store through a pointer does rather than what digitalWrite() does.
+#define NOT_A_PORT 0
+
+class SimPortRegister
+{
+public:
+  uint8_t port;
+  bool output; // PORTx rather than PINx
+
+  operator uint8_t() const;
+  SimPortRegister &operator=(uint8_t v);
+  SimPortRegister &operator|=(uint8_t v) { return *this = *this | v; }
+  SimPortRegister &operator&=(uint8_t v) { return *this = *this & v; }
+};
+
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+SimPortRegister *portOutputRegister(uint8_t port);
+SimPortRegister *portInputRegister(uint8_t port);
+
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode);
+void detachInterrupt(uint8_t irq);
+void noInterrupts();
+void interrupts();
+
+void simStringAlloc(); // Counts the heap allocations the real String would make
+
+// Number to text on the stack, as Print does it - no String, so no allocation
+std::string simFormat(long v, int base = 10);
+std::string simFormat(unsigned long v, int base = 10);
+std::string simFormat(double v, int decimals);
+
+class String
+{
+public:
+  String(const char *s = "") : str(s) { counted(); }
+  String(const std::string &s) : str(s) { counted(); }
+  explicit String(char c) : str(1, c) { counted(); }
+  explicit String(unsigned char v, unsigned char base = 10);
+  explicit String(int v, unsigned char base = 10);
+  explicit String(unsigned int v, unsigned char base = 10);
+  explicit String(long v, unsigned char base = 10);
+  explicit String(unsigned long v, unsigned char base = 10);
+  explicit String(float v, unsigned char decimals = 2);
+  explicit String(double v, unsigned char decimals = 2);
+
+  const char *c_str() const { return str.c_str(); }
+  unsigned int length() const { return str.length(); }
+  char operator[](unsigned int i) const { return str[i]; }
+  bool operator==(const String &o) const { return str == o.str; }
+  bool operator!=(const String &o) const { return str != o.str; }
+
+  String &operator+=(const String &o)
+  {
+    str += o.str;
+    counted(); // realloc()
+    return *this;
+  }
+  friend String operator+(const String &a, const String &b) { return String(a.str + b.str); }
+  friend String operator+(const String &a, const char *b) { return String(a.str + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.str); }
+
+private:
+  void counted()
+  {
+    if (!str.empty())
+    {
+      simStringAlloc();
+    }
+  }
+
+  std::string str;
+};
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long baud) {}
+  void end() {}
+  operator bool() { return true; }
+  int available();
+  int read();
+  int peek();
+  int availableForWrite() { return 64; }
+  void flush() {}
+
+  size_t write(uint8_t b);
+  size_t write(const uint8_t *buf, size_t len);
+
+  size_t print(const char *s);
+  size_t print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char v, int base = 10) { return print(simFormat((unsigned long)v, base).c_str()); }
+  size_t print(int v, int base = 10) { return print(simFormat((long)v, base).c_str()); }
+  size_t print(unsigned int v, int base = 10) { return print(simFormat((unsigned long)v, base).c_str()); }
+  size_t print(long v, int base = 10) { return print(simFormat(v, base).c_str()); }
+  size_t print(unsigned long v, int base = 10) { return print(simFormat(v, base).c_str()); }
+  size_t print(double v, int decimals = 2) { return print(simFormat(v, decimals).c_str()); }
+
+  size_t println() { return print("\r\n"); }
+  template <typename T>
+  size_t println(const T &v)
+  {
+    size_t n = print(v);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T &v, int fmt)
+  {
+    size_t n = print(v, fmt);
+    return n + println();
+  }
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,49 @@
+#pragma once
+
+// Host stand-in for the AVR EEPROM library: 1KB (ATmega32U4) held in RAM, erased to 0xFF.
+
+#include <stdint.h>
+#include <string.h>
+
+#define SIM_EEPROM_SIZE 1024
+#define E2END (SIM_EEPROM_SIZE - 1) // Last EEPROM address, from <avr/io.h> on the real thing
+
+struct EEPROMClass
+{
+  uint8_t read(int idx) { return data[idx % SIM_EEPROM_SIZE]; }
+  void write(int idx, uint8_t val)
+  {
+    data[idx % SIM_EEPROM_SIZE] = val;
+    writes++;
+  }
+  void update(int idx, uint8_t val)
+  {
+    if (read(idx) != val)
+    {
+      write(idx, val);
+    }
+  }
+  uint16_t length() { return SIM_EEPROM_SIZE; }
+
+  template <typename T>
+  T &get(int idx, T &t)
+  {
+    memcpy((void *)&t, &data[idx], sizeof(T));
+    return t;
+  }
+  template <typename T>
+  const T &put(int idx, const T &t)
+  {
+    const uint8_t *p = (const uint8_t *)&t;
+    for (unsigned int i = 0; i < sizeof(T); i++)
+    {
+      update(idx + i, p[i]);
+    }
+    return t;
+  }
+
+  uint8_t data[SIM_EEPROM_SIZE];
+  unsigned long writes = 0; // Cells actually written, to check wear
+};
+
+extern EEPROMClass EEPROM;
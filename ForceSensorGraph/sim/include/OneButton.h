@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for mathertel/OneButton.  There is no real button: tick() fires the
+// clicks, long presses and double clicks scripted on the simulator command line once the
+// simulated clock reaches them.
+
+typedef void (*callbackFunction)(void);
+
+class OneButton
+{
+public:
+  OneButton(int pin, int activeLow = true, bool pullupActive = false) {}
+
+  void attachClick(callbackFunction f) { clickFunc = f; }
+  void attachDoubleClick(callbackFunction f) { doubleClickFunc = f; }
+  void attachLongPressStart(callbackFunction f) { longPressStartFunc = f; }
+
+  void tick();
+
+private:
+  callbackFunction clickFunc = 0;
+  callbackFunction doubleClickFunc = 0;
+  callbackFunction longPressStartFunc = 0;
+};
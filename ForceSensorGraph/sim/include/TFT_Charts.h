@@ -0,0 +1,43 @@
+#pragma once
+
+// Host stand-in for makermatrix/TFT_Charts.  Same calls as the real ChartXY, mapping data
+// coordinates into a fixed plot rectangle and drawing through the TFT fake.
+
+#include <TFT_ILI9341.h>
+
+class ChartXY
+{
+public:
+  struct point
+  {
+    float x;
+    float y;
+  };
+
+  float xMin = 0, xMax = 1, yMin = 0, yMax = 1;
+  float xTick = 1, yTick = 1;
+  uint16_t tftBGColor = TFT_BLACK;
+  uint16_t axisColor = TFT_WHITE;
+  uint16_t lineColor = TFT_CYAN;
+
+  void begin(TFT_ILI9341 &tft);
+  void tftInfo();
+  void setAxisLimitsX(float min, float max, float tick);
+  void setAxisLimitsY(float min, float max, float tick);
+  void drawTitleChart(TFT_ILI9341 &tft, const char *title);
+  void drawAxisX(TFT_ILI9341 &tft, int tickLength);
+  void drawAxisY(TFT_ILI9341 &tft, int tickLength);
+  void drawLabelsX(TFT_ILI9341 &tft);
+  void drawLabelsY(TFT_ILI9341 &tft);
+  void drawY0(TFT_ILI9341 &tft);
+  void drawLegend(TFT_ILI9341 &tft, String text, int x, int y, int size, uint16_t color);
+  void drawLine(TFT_ILI9341 &tft, float x0, float y0, float x1, float y1);
+  void eraseLine(TFT_ILI9341 &tft, float x0, float y0, float x1, float y1);
+
+private:
+  int32_t toPixelX(float x);
+  int32_t toPixelY(float y);
+
+  // Plot rectangle in screen pixels
+  int32_t left = 40, top = 45, right = 315, bottom = 220;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+// Host stand-in for bodmer/TFT_ILI9341.  Draws into an RGB565 frame buffer and charges the
+// simulated clock for the SPI traffic the real driver would generate: 11 bytes to set an
+// address window (CASET, PASET, RAMWR) and 2 bytes per pixel.  Lines are drawn pixel by
+// pixel, as with FAST_LINE commented out in User_Setup.h.
+
+#include <Arduino.h>
+
+#define TFT_BLACK 0x0000
+#define TFT_NAVY 0x000F
+#define TFT_DARKGREEN 0x03E0
+#define TFT_DARKGREY 0x7BEF
+#define TFT_LIGHTGREY 0xC618
+#define TFT_BLUE 0x001F
+#define TFT_GREEN 0x07E0
+#define TFT_CYAN 0x07FF
+#define TFT_RED 0xF800
+#define TFT_MAGENTA 0xF81F
+#define TFT_YELLOW 0xFFE0
+#define TFT_WHITE 0xFFFF
+#define TFT_ORANGE 0xFD20
+
+#define BLACK TFT_BLACK
+#define BLUE TFT_BLUE
+#define RED TFT_RED
+#define GREEN TFT_GREEN
+#define CYAN TFT_CYAN
+#define MAGENTA TFT_MAGENTA
+#define YELLOW TFT_YELLOW
+#define WHITE TFT_WHITE
+
+class TFT_ILI9341
+{
+public:
+  TFT_ILI9341(int16_t w = 240, int16_t h = 320);
+
+  void begin();
+  void setRotation(uint8_t r) { rotation = r; }
+  int16_t width() { return _width; }
+  int16_t height() { return _height; }
+
+  void fillScreen(uint16_t color);
+  void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color);
+  void drawPixel(int32_t x, int32_t y, uint16_t color);
+  void drawFastHLine(int32_t x, int32_t y, int32_t w, uint16_t color);
+  void drawFastVLine(int32_t x, int32_t y, int32_t h, uint16_t color);
+  void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t color);
+  void drawChar(int32_t x, int32_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+
+  void setAddrWindow(int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+  void pushColor(uint16_t color);
+  void pushColor(uint16_t color, uint32_t len);
+
+  void setCursor(int16_t x, int16_t y)
+  {
+    cursorX = x;
+    cursorY = y;
+  }
+  void setTextColor(uint16_t c) { textColor = textBg = c; }
+  void setTextColor(uint16_t c, uint16_t b)
+  {
+    textColor = c;
+    textBg = b;
+  }
+  void setTextSize(uint8_t s) { textSize = s > 0 ? s : 1; }
+
+  size_t print(const char *s);
+  size_t print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c);
+  size_t print(int v) { return print(simFormat((long)v).c_str()); }
+  size_t print(long v) { return print(simFormat(v).c_str()); }
+  size_t print(unsigned long v) { return print(simFormat(v).c_str()); }
+  size_t print(double v, int decimals = 2) { return print(simFormat(v, decimals).c_str()); }
+  size_t println() { return print('\n'); }
+  template <typename T>
+  size_t println(const T &v)
+  {
+    size_t n = print(v);
+    return n + println();
+  }
+
+private:
+  void plot(int32_t x, int32_t y, uint16_t color);
+  void primitive();
+
+  int16_t _width, _height;
+  uint8_t rotation = 0;
+  int16_t cursorX = 0, cursorY = 0;
+  uint16_t textColor = TFT_WHITE, textBg = TFT_WHITE;
+  uint8_t textSize = 1;
+  int32_t winX0 = 0, winY0 = 0, winX1 = 0, winY1 = 0, winX = 0, winY = 0;
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+// Control and measurement interface of the host simulator ([env:native]).
+// The fakes in this directory stand in for the Arduino core and the TFT_ILI9341,
+// TFT_Charts, EEPROM and OneButton libraries.  Time only moves when the firmware spends
+// it: delay(), GPIO calls, SPI traffic to the TFT and a fixed cost per loop() pass.  An
+// HX711 chip model per load cell converts its share of a force trace into 24-bit counts at
+// 10/80Hz and raises DOUT, so interrupts, dropped conversions and draw costs can all be measured without hardware.
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+
+#define SIM_MAX_CHIPS 4
+
+enum SimTraceType
+{
+  TRACE_PEEL,   // Periodic peel curves: ramp to a peak, sudden release, damped ringing
+  TRACE_STEP,   // Staircase of static loads
+  TRACE_GLITCH, // Peel curves with occasional full-scale spikes
+  TRACE_FILE    // Replay of a recorded "seconds,grams" CSV
+};
+
+enum SimButtonEvent
+{
+  BUTTON_CLICK,
+  BUTTON_LONG_PRESS,
+  BUTTON_DOUBLE_CLICK
+};
+
+struct SimScriptedButton
+{
+  uint64_t atNs;
+  SimButtonEvent event;
+};
+
+struct SimConfig
+{
+  SimTraceType trace = TRACE_PEEL;
+  std::string traceFile;
+  double seconds = 60;         // Simulated run length after setup()
+  double noiseGrams = 2;       // Gaussian noise added to the trace
+  double driftGramsPerMin = 0; // Slow linear drift added to the trace
+  double bowGrams = 0;         // Linearity error: the cell reads this much over at 10 kg, growing as load^2
+  double peelPeriod = 8;       // Seconds per layer for the synthetic peel traces
+  double peelPeak = 1500;      // Peak peel force in grams
+  double countsPerGram = 200;  // HX711 counts per gram, also seeded into EEPROM as the calibration
+  long countsOffset = 8000;    // HX711 count at zero load
+  unsigned sampleRateHz = 80;  // 80Hz (RATE pin low) or 10Hz
+  std::vector<double> shares;  // Fraction of the load on each chip, equal if empty
+  uint32_t seed = 1;
+  uint64_t startNs = 0;        // What the board's clock reads at power-up, to run across the micros()/millis() wraps
+
+  // Cost model, in nanoseconds of simulated time
+  uint32_t gpioWriteNs = 3500; // digitalWrite() on a 16MHz AVR
+  uint32_t gpioReadNs = 3000;  // digitalRead()
+  uint32_t portWriteNs = 250;  // Read-modify-write of a port register through a pointer
+  uint32_t portReadNs = 190;   // Reading a PINx register through a pointer
+  uint32_t spiByteNs = 1000;   // 8MHz hardware SPI
+  uint32_t serialByteNs = 1000; // USB CDC: copying into the endpoint buffer
+  uint32_t drawCallNs = 5000;  // Software overhead per TFT primitive
+  uint32_t isrEntryNs = 3000;  // Interrupt entry/exit
+  uint32_t loopPassNs = 20000; // Fixed cost of one loop() pass outside of what is modelled
+
+  std::vector<SimScriptedButton> buttons;
+  std::vector<uint64_t> gpioPulses; // Times the external trigger input goes active...
+  uint64_t gpioPulseNs = 200000000; // ...for this long
+  uint8_t gpioPin = 0xFF;           // Which input that is, and its active level
+  uint8_t gpioLevel = 0;
+  std::vector<uint64_t> historyRequests; // Times the host sends 'h' for the history
+  bool echoSerial = false;
+  std::string ppmFile; // Dump of the final screen
+  std::string eepromFile; // EEPROM image, loaded before setup() if it exists and saved at the end
+};
+
+struct SimStats
+{
+  // HX711 chip model
+  uint64_t conversions = 0; // Conversions completed by the ADC
+  uint64_t readouts = 0;    // Conversions clocked out by the firmware
+  uint64_t dropped = 0;     // Conversions overwritten before they were read
+  uint64_t powerDowns = 0;  // PD_SCK held high for more than 60us
+
+  // TFT
+  uint64_t drawCalls = 0;   // Primitives issued (pixels, lines, rects, chars)
+  uint64_t windows = 0;     // Address windows set, i.e. SPI transactions
+  uint64_t spiBytes = 0;
+  uint64_t fillScreens = 0;
+  uint64_t yRescales = 0;   // Y axis limits changed
+
+  uint64_t serialBytes = 0;
+  uint64_t interrupts = 0;
+  uint64_t maxIrqOffNs = 0;  // Longest stretch with interrupts off: an ISR, or noInterrupts() to interrupts()
+  uint64_t stringAllocs = 0; // Heap allocations by String
+};
+
+extern SimConfig simConfig;
+extern SimStats simStats;
+
+// Simulated clock
+uint64_t simNow();                   // Nanoseconds since power-up
+void simAdvance(uint64_t ns);        // Spend time; runs conversions and interrupts that fall due
+void simSpi(uint32_t bytes, uint32_t windows = 0);
+
+// HX711 chip model - one per DOUT pin, PD_SCK may be shared
+void simAddChip(uint8_t dout, uint8_t sck);
+uint8_t simChipCount();
+long simTraceCounts(uint8_t chip, uint64_t ns);
+double simTraceGrams(uint8_t chip, uint64_t ns);
+bool simLoadTrace(const std::string &file);
+bool simTraceLastRelease(uint64_t ns, uint64_t &releaseNs); // Latest peel release at or before ns
+
+// Rising edges on an output, e.g. the peel trigger
+void simWatchPin(uint8_t pin);
+const std::vector<uint64_t> &simPinRises();
+
+// Scripted input
+void simSerialInject(const char *bytes);
+bool simNextButtonEvent(SimButtonEvent &event);
+
+// Every complete line the firmware printed
+const std::vector<std::string> &simSerialLines();
+// ...and every byte, for the binary frames
+const std::vector<uint8_t> &simSerialBytes();
+
+// Final screen contents, RGB565
+const uint16_t *simFrameBuffer(int &width, int &height);
+void simWritePpm(const std::string &file);
@@ -0,0 +1,634 @@
+// Simulated clock, GPIO, interrupts and the HX711 chip model behind the Arduino core fake.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include "sim.h"
+
+SimConfig simConfig;
+SimStats simStats;
+HardwareSerial Serial;
+
+static uint64_t clockNs = 0;
+
+// ---------------------------------------------------------------------------------------
+// Interrupts.  Only the Leonardo's external interrupts are modelled, on falling edges.
+
+#define SIM_IRQS 5
+
+static void (*isrs[SIM_IRQS])() = {0};
+static bool pendingIrq[SIM_IRQS] = {false};
+static bool irqEnabled = true;
+static bool inIsr = false;
+static uint64_t irqOffSinceNs;
+
+static void irqsBackOn(uint64_t sinceNs)
+{
+  simStats.maxIrqOffNs = std::max(simStats.maxIrqOffNs, clockNs - sinceNs);
+}
+
+static int8_t pinIrq(uint8_t pin)
+{
+  switch (pin)
+  {
+  case 3:
+    return 0;
+  case 2:
+    return 1;
+  case 0:
+    return 2;
+  case 1:
+    return 3;
+  case 7:
+    return 4;
+  }
+  return NOT_AN_INTERRUPT;
+}
+
+// Run any latched interrupts, like the AVR does as soon as the I flag is set again
+static void serviceIrqs()
+{
+  int8_t i;
+  bool again = true;
+
+  while (again && irqEnabled && !inIsr)
+  {
+    again = false;
+    for (i = 0; i < SIM_IRQS; i++)
+    {
+      if (pendingIrq[i] && isrs[i])
+      {
+        pendingIrq[i] = false;
+        simStats.interrupts++;
+        uint64_t entryNs = clockNs;
+        inIsr = true;
+        irqEnabled = false;
+        simAdvance(simConfig.isrEntryNs);
+        isrs[i]();
+        irqsBackOn(entryNs);
+        irqEnabled = true;
+        inIsr = false;
+        again = true;
+      }
+    }
+  }
+}
+
+static void fallingEdge(uint8_t pin)
+{
+  int8_t irq = pinIrq(pin);
+  if (irq >= 0 && isrs[irq])
+  {
+    pendingIrq[irq] = true;
+  }
+}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+  return pinIrq(pin);
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(), int mode)
+{
+  if (irq < SIM_IRQS)
+  {
+    isrs[irq] = isr;
+    pendingIrq[irq] = false;
+  }
+}
+
+void detachInterrupt(uint8_t irq)
+{
+  if (irq < SIM_IRQS)
+  {
+    isrs[irq] = 0;
+    pendingIrq[irq] = false;
+  }
+}
+
+void noInterrupts()
+{
+  if (irqEnabled && !inIsr)
+  {
+    irqOffSinceNs = clockNs;
+  }
+  irqEnabled = false;
+}
+
+void interrupts()
+{
+  if (!irqEnabled && !inIsr)
+  {
+    irqsBackOn(irqOffSinceNs);
+  }
+  irqEnabled = true;
+  serviceIrqs();
+}
+
+// ---------------------------------------------------------------------------------------
+// HX711 chip model.
+// Each conversion pulls DOUT low.  Every PD_SCK rising edge shifts out the next bit, MSB
+// first, and the 25th edge releases DOUT.  A conversion completing before the previous one
+// was read counts as dropped.  Holding PD_SCK high for more than 60us powers the chip down,
+// which aborts the readout and restarts the conversion cycle.
+
+struct SimChip
+{
+  uint8_t dout, sck;
+  bool doutLevel;
+  bool ready;      // A conversion is waiting in the output register
+  uint8_t pulses;  // PD_SCK rising edges since the conversion completed
+  uint8_t gain;    // Extra pulses seen on the last readout (1 = A/128, 2 = B/32, 3 = A/64)
+  long data;
+  uint64_t nextConversionNs;
+  uint64_t sckHighSinceNs;
+};
+
+static int watchedPin = -1;
+static std::vector<uint64_t> watchedRises;
+
+void simWatchPin(uint8_t pin)
+{
+  watchedPin = pin;
+}
+
+const std::vector<uint64_t> &simPinRises()
+{
+  return watchedRises;
+}
+
+static SimChip chips[SIM_MAX_CHIPS];
+static uint8_t nChips = 0;
+static uint8_t pinLevel[32];
+
+static uint64_t conversionPeriodNs()
+{
+  return 1000000000ULL / (simConfig.sampleRateHz ? simConfig.sampleRateHz : 80);
+}
+
+void simAddChip(uint8_t dout, uint8_t sck)
+{
+  uint8_t i;
+
+  for (i = 0; i < nChips; i++)
+  {
+    if (chips[i].dout == dout)
+    {
+      chips[i].sck = sck;
+      return;
+    }
+  }
+  if (nChips < SIM_MAX_CHIPS)
+  {
+    SimChip &c = chips[nChips];
+    c.dout = dout;
+    c.sck = sck;
+    c.doutLevel = HIGH;
+    c.ready = false;
+    c.pulses = 0;
+    c.gain = 1;
+    c.data = 0;
+    // Stagger the chips slightly, their oscillators are not synchronised
+    c.nextConversionNs = clockNs + conversionPeriodNs() + nChips * 137000ULL;
+    c.sckHighSinceNs = 0;
+    nChips++;
+  }
+}
+
+uint8_t simChipCount()
+{
+  return nChips;
+}
+
+static void setDout(SimChip &c, bool level)
+{
+  if (c.doutLevel == HIGH && level == LOW)
+  {
+    fallingEdge(c.dout);
+  }
+  c.doutLevel = level;
+}
+
+static void conversionDone(uint8_t i)
+{
+  SimChip &c = chips[i];
+
+  simStats.conversions++;
+  if (c.ready && c.pulses == 0)
+  {
+    simStats.dropped++; // Nobody read the last one
+  }
+  else if (c.ready)
+  {
+    // Readout in progress - the output register is not updated under it
+    simStats.dropped++;
+    return;
+  }
+  c.data = simTraceCounts(i, clockNs) & 0xFFFFFFL;
+  c.ready = true;
+  c.pulses = 0;
+  setDout(c, LOW);
+}
+
+static void clockEdge(SimChip &c, bool rising)
+{
+  if (rising)
+  {
+    c.sckHighSinceNs = clockNs;
+    if (!c.ready)
+    {
+      if (c.pulses >= 24 && c.pulses < 27)
+      {
+        c.pulses++;
+        c.gain = c.pulses - 24;
+      }
+      return;
+    }
+    c.pulses++;
+    if (c.pulses <= 24)
+    {
+      setDout(c, (c.data >> (24 - c.pulses)) & 1);
+    }
+    else
+    {
+      // 25th pulse: data consumed, DOUT back high until the next conversion
+      c.ready = false;
+      c.gain = 1;
+      simStats.readouts++;
+      setDout(c, HIGH);
+    }
+  }
+  else if (clockNs - c.sckHighSinceNs > 60000)
+  {
+    simStats.powerDowns++;
+    c.ready = false;
+    c.pulses = 0;
+    setDout(c, HIGH);
+    c.nextConversionNs = clockNs + conversionPeriodNs();
+  }
+}
+
+// ---------------------------------------------------------------------------------------
+// Clock
+
+uint64_t simNow()
+{
+  return clockNs;
+}
+
+void simAdvance(uint64_t ns)
+{
+  uint64_t target = clockNs + ns;
+  uint8_t i, next;
+
+  while (nChips)
+  {
+    next = 0;
+    for (i = 1; i < nChips; i++)
+    {
+      if (chips[i].nextConversionNs < chips[next].nextConversionNs)
+      {
+        next = i;
+      }
+    }
+    if (chips[next].nextConversionNs > target)
+    {
+      break;
+    }
+    // A nested call from an ISR may already have moved the clock past this point
+    if (chips[next].nextConversionNs > clockNs)
+    {
+      clockNs = chips[next].nextConversionNs;
+    }
+    chips[next].nextConversionNs += conversionPeriodNs();
+    conversionDone(next);
+    serviceIrqs();
+  }
+  if (clockNs < target)
+  {
+    clockNs = target;
+  }
+}
+
+void simSpi(uint32_t bytes, uint32_t windows)
+{
+  simStats.spiBytes += bytes;
+  simStats.windows += windows;
+  simAdvance((uint64_t)bytes * simConfig.spiByteNs);
+}
+
+// Both wrap at 32 bits like the AVR's, counting from simConfig.startNs
+unsigned long millis()
+{
+  return (unsigned long)(uint32_t)((simConfig.startNs + clockNs) / 1000000ULL);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)(uint32_t)((simConfig.startNs + clockNs) / 1000ULL);
+}
+
+void delay(unsigned long ms)
+{
+  simAdvance(ms * 1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  simAdvance(us * 1000ULL);
+}
+
+// ---------------------------------------------------------------------------------------
+// GPIO
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < sizeof(pinLevel) && mode == INPUT_PULLUP)
+  {
+    pinLevel[pin] = HIGH;
+  }
+}
+
+// A pin driven to val, and the edge passed on to whatever listens to it
+static void pinWrite(uint8_t pin, uint8_t val)
+{
+  uint8_t i;
+  bool rising = false, falling = false;
+
+  if (pin < sizeof(pinLevel))
+  {
+    rising = !pinLevel[pin] && val;
+    falling = pinLevel[pin] && !val;
+    pinLevel[pin] = val ? HIGH : LOW;
+  }
+  if (rising && pin == watchedPin)
+  {
+    watchedRises.push_back(clockNs);
+  }
+  for (i = 0; i < nChips; i++)
+  {
+    if (chips[i].sck == pin && (rising || falling))
+    {
+      clockEdge(chips[i], rising);
+    }
+  }
+}
+
+static int pinRead(uint8_t pin)
+{
+  uint8_t i;
+
+  for (i = 0; i < nChips; i++)
+  {
+    if (chips[i].dout == pin)
+    {
+      return chips[i].doutLevel;
+    }
+  }
+  if (pin == simConfig.gpioPin)
+  {
+    for (uint64_t at : simConfig.gpioPulses)
+    {
+      if (simNow() >= at && simNow() < at + simConfig.gpioPulseNs)
+      {
+        return simConfig.gpioLevel;
+      }
+    }
+    return !simConfig.gpioLevel;
+  }
+  return pin < sizeof(pinLevel) ? pinLevel[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  simAdvance(simConfig.gpioWriteNs);
+  pinWrite(pin, val);
+  serviceIrqs();
+}
+
+int digitalRead(uint8_t pin)
+{
+  simAdvance(simConfig.gpioReadNs);
+  return pinRead(pin);
+}
+
+// The Leonardo's pins 0-23 as (port, bit), PB = 2 ... PF = 6 as in the core
+static const uint8_t pinPorts[24][2] = {
+    {4, 2}, {4, 3}, {4, 1}, {4, 0}, {4, 4}, {3, 6}, {4, 7}, {5, 6}, {2, 4}, {2, 5}, {2, 6}, {2, 7},
+    {4, 6}, {3, 7}, {2, 3}, {2, 1}, {2, 2}, {2, 0}, {6, 7}, {6, 6}, {6, 5}, {6, 4}, {6, 1}, {6, 0}};
+static SimPortRegister portOut[7], portIn[7];
+
+uint8_t digitalPinToPort(uint8_t pin)
+{
+  return pin < 24 ? pinPorts[pin][0] : NOT_A_PORT;
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin)
+{
+  return pin < 24 ? 1 << pinPorts[pin][1] : 0;
+}
+
+SimPortRegister *portOutputRegister(uint8_t port)
+{
+  portOut[port] = {port, true};
+  return &portOut[port];
+}
+
+SimPortRegister *portInputRegister(uint8_t port)
+{
+  portIn[port] = {port, false};
+  return &portIn[port];
+}
+
+SimPortRegister::operator uint8_t() const
+{
+  uint8_t pin, v = 0;
+
+  simAdvance(output ? 0 : simConfig.portReadNs); // A PORTx read is part of the write's cost
+  for (pin = 0; pin < 24; pin++)
+  {
+    if (pinPorts[pin][0] == port && (output ? pinLevel[pin] : pinRead(pin)))
+    {
+      v |= 1 << pinPorts[pin][1];
+    }
+  }
+  return v;
+}
+
+SimPortRegister &SimPortRegister::operator=(uint8_t v)
+{
+  uint8_t pin;
+
+  simAdvance(simConfig.portWriteNs);
+  for (pin = 0; pin < 24; pin++)
+  {
+    if (pinPorts[pin][0] == port)
+    {
+      pinWrite(pin, v >> pinPorts[pin][1] & 1);
+    }
+  }
+  serviceIrqs();
+  return *this;
+}
+
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder)
+{
+  uint8_t value = 0;
+  uint8_t i;
+
+  for (i = 0; i < 8; ++i)
+  {
+    digitalWrite(clockPin, HIGH);
+    if (bitOrder == LSBFIRST)
+      value |= digitalRead(dataPin) << i;
+    else
+      value |= digitalRead(dataPin) << (7 - i);
+    digitalWrite(clockPin, LOW);
+  }
+  return value;
+}
+
+// ---------------------------------------------------------------------------------------
+// String and Serial
+
+static std::string formatInt(unsigned long v, bool negative, unsigned char base)
+{
+  char buf[40];
+  int i = sizeof(buf) - 1;
+
+  if (base < 2)
+  {
+    base = 10;
+  }
+  buf[i] = 0;
+  do
+  {
+    buf[--i] = "0123456789ABCDEF"[v % base];
+    v /= base;
+  } while (v && i > 1);
+  if (negative)
+  {
+    buf[--i] = '-';
+  }
+  return std::string(buf + i);
+}
+
+std::string simFormat(long v, int base)
+{
+  return base == 10 && v < 0 ? formatInt(-(unsigned long)v, true, base) : formatInt((unsigned long)v, false, base);
+}
+
+std::string simFormat(unsigned long v, int base)
+{
+  return formatInt(v, false, base);
+}
+
+std::string simFormat(double v, int decimals)
+{
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  return buf;
+}
+
+void simStringAlloc()
+{
+  simStats.stringAllocs++;
+}
+
+String::String(unsigned char v, unsigned char base) : str(formatInt(v, false, base)) { counted(); }
+String::String(int v, unsigned char base) : str(base == 10 && v < 0 ? formatInt(-(long)v, true, base) : formatInt((unsigned int)v, false, base)) { counted(); }
+String::String(unsigned int v, unsigned char base) : str(formatInt(v, false, base)) { counted(); }
+String::String(long v, unsigned char base) : str(base == 10 && v < 0 ? formatInt(-(unsigned long)v, true, base) : formatInt((unsigned long)v, false, base)) { counted(); }
+String::String(unsigned long v, unsigned char base) : str(formatInt(v, false, base)) { counted(); }
+String::String(float v, unsigned char decimals) : String((double)v, decimals) {}
+String::String(double v, unsigned char decimals)
+{
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  str = buf;
+  counted();
+}
+
+static std::deque<uint8_t> serialIn;
+
+void simSerialInject(const char *bytes)
+{
+  while (*bytes)
+  {
+    serialIn.push_back((uint8_t)*bytes++);
+  }
+}
+
+int HardwareSerial::available()
+{
+  return serialIn.size();
+}
+
+int HardwareSerial::read()
+{
+  int c;
+  if (serialIn.empty())
+  {
+    return -1;
+  }
+  c = serialIn.front();
+  serialIn.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek()
+{
+  return serialIn.empty() ? -1 : serialIn.front();
+}
+
+static std::string serialLine;
+static std::vector<std::string> serialLines;
+
+const std::vector<std::string> &simSerialLines()
+{
+  return serialLines;
+}
+
+static std::vector<uint8_t> serialBytes;
+
+const std::vector<uint8_t> &simSerialBytes()
+{
+  return serialBytes;
+}
+
+size_t HardwareSerial::write(uint8_t b)
+{
+  simStats.serialBytes++;
+  serialBytes.push_back(b);
+  simAdvance(simConfig.serialByteNs);
+  if (simConfig.echoSerial)
+  {
+    fputc(b, stdout);
+  }
+  if (b == '\n')
+  {
+    serialLines.push_back(serialLine);
+    serialLine.clear();
+  }
+  else if (b != '\r')
+  {
+    serialLine += (char)b;
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len)
+{
+  size_t i;
+  for (i = 0; i < len; i++)
+  {
+    write(buf[i]);
+  }
+  return len;
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+  return write((const uint8_t *)s, strlen(s));
+}
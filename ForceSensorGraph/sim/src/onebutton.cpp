@@ -0,0 +1,26 @@
+#include <OneButton.h>
+#include "sim.h"
+
+void OneButton::tick()
+{
+  SimButtonEvent event;
+
+  while (simNextButtonEvent(event))
+  {
+    switch (event)
+    {
+    case BUTTON_CLICK:
+      if (clickFunc)
+        clickFunc();
+      break;
+    case BUTTON_LONG_PRESS:
+      if (longPressStartFunc)
+        longPressStartFunc();
+      break;
+    case BUTTON_DOUBLE_CLICK:
+      if (doubleClickFunc)
+        doubleClickFunc();
+      break;
+    }
+  }
+}
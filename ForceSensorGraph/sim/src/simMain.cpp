@@ -0,0 +1,776 @@
+// Entry point of the native build: runs setup() and loop() against the simulated hardware
+// and reports what the firmware cost.
+//
+//   .pio/build/native/program [--trace peel|step|glitch|FILE.csv] [--seconds N]
+//       [--noise GRAMS] [--drift GRAMS_PER_MIN] [--bow GRAMS] [--rate 10|80] [--seed N]
+//       [--click S] [--long S] [--double S] [--shares F,F,...] [--serial] [--ppm FILE]
+//       [--eeprom FILE] [--start S] [--gpio S,S,...] [--history S,S,...]
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <EEPROM.h>
+#include <TFT_Charts.h>
+#include "setup.h"
+#include "sim.h"
+#include "loadCell.h"
+#include "scheduler.h"
+#include "sampleRing.h"
+#include "columnDecimator.h"
+#include "acquisition.h"
+#include "burstCapture.h"
+#include "streamStats.h"
+#include "traceLog.h"
+
+void setup();
+void loop();
+extern Task tasks[];
+extern const uint8_t taskCount;
+extern SampleRing<ColumnPoint, PLOT_RING_LENGTH> plotColumns;
+extern uint16_t streamDropped;
+
+static std::vector<SimScriptedButton> pendingButtons;
+
+bool simNextButtonEvent(SimButtonEvent &event)
+{
+  if (pendingButtons.empty() || pendingButtons.front().atNs > simNow())
+  {
+    return false;
+  }
+  event = pendingButtons.front().event;
+  pendingButtons.erase(pendingButtons.begin());
+  return true;
+}
+
+// pio test links the same fakes into the tests in test/, which bring their own main()
+#ifndef PIO_UNIT_TESTING
+
+static void usage()
+{
+  fprintf(stderr, "usage: program [--trace peel|step|glitch|FILE.csv] [--seconds N] [--noise G] [--drift G/min] [--bow G]\n"
+                  "               [--rate 10|80] [--seed N] [--click S] [--long S] [--double S]\n"
+                  "               [--shares F,F,...] [--serial] [--ppm FILE] [--eeprom FILE] [--start S|micros|millis]\n"
+                  "               [--gpio S,S,...] [--history S,S,...]\n");
+  exit(2);
+}
+
+static void parseArgs(int argc, char **argv)
+{
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : 0;
+    bool takesValue = true;
+
+    if (!strcmp(a, "--serial"))
+    {
+      simConfig.echoSerial = true;
+      takesValue = false;
+    }
+    else if (!v)
+      usage();
+    else if (!strcmp(a, "--trace"))
+    {
+      if (!strcmp(v, "peel"))
+        simConfig.trace = TRACE_PEEL;
+      else if (!strcmp(v, "step"))
+        simConfig.trace = TRACE_STEP;
+      else if (!strcmp(v, "glitch"))
+        simConfig.trace = TRACE_GLITCH;
+      else
+      {
+        simConfig.trace = TRACE_FILE;
+        simConfig.traceFile = v;
+      }
+    }
+    else if (!strcmp(a, "--seconds"))
+      simConfig.seconds = atof(v);
+    else if (!strcmp(a, "--noise"))
+      simConfig.noiseGrams = atof(v);
+    else if (!strcmp(a, "--drift"))
+      simConfig.driftGramsPerMin = atof(v);
+    else if (!strcmp(a, "--bow"))
+      simConfig.bowGrams = atof(v);
+    else if (!strcmp(a, "--rate"))
+      simConfig.sampleRateHz = atoi(v);
+    else if (!strcmp(a, "--seed"))
+      simConfig.seed = atoi(v);
+    else if (!strcmp(a, "--click"))
+      simConfig.buttons.push_back({(uint64_t)(atof(v) * 1e9), BUTTON_CLICK});
+    else if (!strcmp(a, "--long"))
+      simConfig.buttons.push_back({(uint64_t)(atof(v) * 1e9), BUTTON_LONG_PRESS});
+    else if (!strcmp(a, "--double"))
+      simConfig.buttons.push_back({(uint64_t)(atof(v) * 1e9), BUTTON_DOUBLE_CLICK});
+    else if (!strcmp(a, "--ppm"))
+      simConfig.ppmFile = v;
+    else if (!strcmp(a, "--eeprom"))
+      simConfig.eepromFile = v;
+    else if (!strcmp(a, "--start"))
+    {
+      // Power up just short of a wrap, or at any time in seconds
+      if (!strcmp(v, "micros"))
+        simConfig.startNs = (1ULL << 32) * 1000 - 10000000000ULL;
+      else if (!strcmp(v, "millis"))
+        simConfig.startNs = (1ULL << 32) * 1000000 - 10000000000ULL;
+      else
+        simConfig.startNs = (uint64_t)(atof(v) * 1e9);
+    }
+    else if (!strcmp(a, "--gpio"))
+    {
+      // Pulse the burst trigger input at these times
+      for (const char *p = v; p; p = strchr(p, ','))
+        simConfig.gpioPulses.push_back((uint64_t)(atof(*p == ',' ? ++p : p) * 1e9));
+    }
+    else if (!strcmp(a, "--history"))
+    {
+      // Ask for the history dump at these times
+      for (const char *p = v; p; p = strchr(p, ','))
+        simConfig.historyRequests.push_back((uint64_t)(atof(*p == ',' ? ++p : p) * 1e9));
+    }
+    else if (!strcmp(a, "--shares"))
+    {
+      // Fraction of the load on each cell, in LOADCELL_DOUTS order
+      for (const char *p = v; p; p = strchr(p, ','))
+        simConfig.shares.push_back(atof(*p == ',' ? ++p : p));
+    }
+    else
+      usage();
+    if (takesValue)
+      i++;
+  }
+}
+
+// Match the trigger pulses against the releases in the synthetic peel trace
+static void peelReport()
+{
+  const std::vector<uint64_t> &rises = simPinRises();
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz, release, lastRelease = 0;
+  uint64_t latency, sum = 0, worst = 0;
+  unsigned matched = 0, releases = 0;
+  size_t i;
+
+  if (!simTraceLastRelease(simNow(), lastRelease))
+  {
+    printf("Peel trigger: %zu pulses\n", rises.size());
+    return;
+  }
+  for (release = lastRelease % (uint64_t)(simConfig.peelPeriod * 1e9); release <= lastRelease;
+       release += (uint64_t)(simConfig.peelPeriod * 1e9))
+  {
+    releases++;
+  }
+  for (i = 0; i < rises.size(); i++)
+  {
+    if (simTraceLastRelease(rises[i], release) && (latency = rises[i] - release) < 4 * period)
+    {
+      matched++;
+      sum += latency;
+      worst = std::max(worst, latency);
+    }
+  }
+  printf("Peel trigger: %u of %u releases, %zu false; latency mean %.2f / max %.2f samples\n", matched, releases,
+         rises.size() - matched, matched ? (double)sum / matched / period : 0.0, (double)worst / period);
+}
+
+// The peel lines on the serial port: their data-ready timestamps must keep counting up
+// across the micros()/millis() wraps, and each release must land on one in the trace
+static void peelSerialReport()
+{
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz, ns, release, worst = 0;
+  uint64_t bootNs = simConfig.startNs % ((1ULL << 32) * 1000); // timeUs() at setup(): it missed earlier wraps
+  unsigned lines = 0, releases = 0, matched = 0;
+  bool monotonic = true;
+  double ms, lastMs = -1;
+
+  for (const std::string &serial : simSerialLines())
+  {
+    std::string line = serial.substr(std::min(serial.find("peel,"), serial.size())); // After any binary frames
+    if (sscanf(line.c_str(), "peel,%*[a-z],%lf", &ms) != 1)
+    {
+      continue;
+    }
+    lines++;
+    monotonic = monotonic && ms >= lastMs;
+    lastMs = ms;
+    if (line.compare(0, 13, "peel,release,"))
+    {
+      continue;
+    }
+    releases++;
+    ns = (uint64_t)(ms * 1e6 + 0.5) - bootNs; // Back to the simulated clock
+    if (ms * 1e6 >= bootNs && simTraceLastRelease(ns, release) && ns - release < 4 * period)
+    {
+      matched++;
+      worst = std::max(worst, ns - release);
+    }
+  }
+  if (lines)
+  {
+    printf("Peel serial: %u lines, timestamps %s; %u of %u releases stamped within %.2f samples of the trace\n",
+           lines, monotonic ? "monotonic" : "OUT OF ORDER", matched, releases, (double)worst / period);
+  }
+}
+
+// Each release's peak and impulse on the serial port, against the trace from its onset to
+// the release
+static void peelSummaryReport()
+{
+  uint64_t bootNs = simConfig.startNs % ((1ULL << 32) * 1000); // As in peelSerialReport()
+  uint64_t onsetNs = 0, releaseNs, ns;
+  double ms, peak, impulse, truePeak, trueImpulse, g;
+  double peakErr = 0, peakWorst = 0, impulseErr = 0, impulseWorst = 0;
+  unsigned peels = 0;
+  bool onset = false;
+
+  for (const std::string &serial : simSerialLines())
+  {
+    std::string line = serial.substr(std::min(serial.find("peel,"), serial.size()));
+    if (sscanf(line.c_str(), "peel,onset,%lf", &ms) == 1)
+    {
+      onsetNs = (uint64_t)(ms * 1e6 + 0.5) - bootNs;
+      onset = ms * 1e6 >= bootNs;
+      continue;
+    }
+    if (!onset || sscanf(line.c_str(), "peel,release,%lf,%lf,%*f,%*u,%lf", &ms, &peak, &impulse) != 3)
+    {
+      continue;
+    }
+    onset = false;
+    releaseNs = (uint64_t)(ms * 1e6 + 0.5) - bootNs;
+    truePeak = trueImpulse = 0;
+    for (ns = onsetNs; ns < releaseNs; ns += 100000)
+    {
+      g = simTraceGrams(0, ns);
+      truePeak = std::max(truePeak, g);
+      trueImpulse += g * 1e-4;
+    }
+    peels++;
+    peakErr += fabs(peak - truePeak);
+    peakWorst = std::max(peakWorst, fabs(peak - truePeak));
+    impulseErr += fabs(impulse / trueImpulse - 1) * 100;
+    impulseWorst = std::max(impulseWorst, fabs(impulse / trueImpulse - 1) * 100);
+  }
+  if (peels)
+  {
+    printf("Peel summaries: %u releases; peak off the trace's by mean %.1f / max %.1f g, impulse by mean %.2f / max %.2f%%\n",
+           peels, peakErr / peels, peakWorst, impulseErr / peels, impulseWorst);
+  }
+}
+
+// The statistics classes against exact computations, over an hour of the trace at the
+// sample rate: Welford's mean, SD and RMS against two passes in double, and each P-square
+// percentile by the rank its estimate really has among the sorted samples
+static void statsReport()
+{
+#ifdef STATS_PERCENTILES
+  static const uint8_t percent[] = STATS_PERCENTILES;
+#else
+  static const uint8_t percent[] = {50, 95, 99}; // The class is checked whether the firmware keeps it or not
+#endif
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz, i, n = 3600ULL * simConfig.sampleRateHz;
+  RunningStats stats;
+  QuantileSketch<sizeof(percent)> sketch(percent);
+  std::vector<float> v;
+  double sum = 0, ss = 0, sq = 0, mean, sd, rms, x;
+
+  for (i = 0; i < n; i++)
+  {
+    // In force_t units, as the firmware sees them, outliers dropped
+    x = round((simTraceCounts(0, simNow() + i * period) - simConfig.countsOffset) / simConfig.countsPerGram * FORCE_PER_GRAM);
+    if (fabs(x) > GRAMS(OUTLIER_GRAMS))
+    {
+      continue;
+    }
+    v.push_back(x);
+    stats.add(x);
+    sketch.add(x);
+    sum += x;
+    sq += x * x;
+  }
+  mean = sum / v.size();
+  for (float y : v)
+  {
+    ss += (y - mean) * (y - mean);
+  }
+  sd = sqrt(ss / (v.size() - 1));
+  rms = sqrt(sq / v.size());
+  std::sort(v.begin(), v.end());
+  printf("Stats check: %zu trace samples, mean off by %.4f g, SD by %+.3f%%, RMS by %+.3f%%; percentile ranks (error)",
+         v.size(), fabs(stats.mean() - mean) / FORCE_PER_GRAM, (stats.stddev() / sd - 1) * 100, (stats.rms() / rms - 1) * 100);
+  for (uint8_t j = 0; j < sizeof(percent); j++)
+  {
+    printf(" %u: %.2f (%+.2f g)", percent[j],
+           100.0 * (std::upper_bound(v.begin(), v.end(), sketch.value(j)) - v.begin()) / v.size(),
+           (sketch.value(j) - v[(size_t)(percent[j] / 100.0 * (v.size() - 1))]) / FORCE_PER_GRAM);
+  }
+  printf("\n");
+}
+
+// The compressed history (traceLog.h) at HISTORY_BYTES, fed an hour of the trace at the
+// sample rate: how many samples it holds and in how many bytes a sample, against packing
+// them raw, what reading it all back costs, and whether every sample comes back exact
+static void historyReport()
+{
+  static TraceLog<HISTORY_BYTES, HISTORY_BLOCK_BYTES> log;
+  TraceLog<HISTORY_BYTES, HISTORY_BLOCK_BYTES>::Cursor cursor;
+  std::deque<RawSample> recent;
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz, i, n = 3600ULL * simConfig.sampleRateHz;
+  uint64_t checks = 0, held = 0, bytes = 0, decoded = 0, decodeNs = 0, wrong = 0;
+  RawSample s = {}, got;
+
+  for (i = 0; i < n; i++)
+  {
+    // As the acquisition ISR stamps and sign-extends them
+    s.t = (simNow() + i * period) / 1000;
+    for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+    {
+      s.count[c] = ((simTraceCounts(c, simNow() + i * period) & 0xFFFFFFL) ^ 0x800000L) - 0x800000L;
+    }
+    log.add(s);
+    recent.push_back(s);
+    while (recent.size() > log.samplesHeld())
+    {
+      recent.pop_front();
+    }
+
+    // Read it all back every few seconds
+    if (i % 997 == 996)
+    {
+      size_t k = 0;
+      checks++;
+      held += log.samplesHeld();
+      bytes += log.bytesHeld();
+      log.rewind(cursor);
+      auto t0 = std::chrono::steady_clock::now();
+      while (log.read(cursor, got))
+      {
+        wrong += k >= recent.size() || got.t != recent[k].t || memcmp(got.count, recent[k].count, sizeof(got.count));
+        k++;
+      }
+      decodeNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+      decoded += k;
+      wrong += k != recent.size();
+    }
+  }
+  printf("History: %u bytes hold %.0f samples (%.1f s), %.2f bytes a sample against %u packed raw (%.1f:1); "
+         "reading back %.0f ns host per sample, %llu of %llu samples wrong\n",
+         HISTORY_BYTES, (double)held / checks, (double)held / checks / simConfig.sampleRateHz, (double)bytes / held,
+         4 + 3 * LOADCELL_COUNT, (4 + 3 * LOADCELL_COUNT) * (double)held / bytes,
+         decoded ? (double)decodeNs / decoded : 0.0, (unsigned long long)wrong, (unsigned long long)decoded);
+}
+
+#ifdef HISTORY_SERIAL
+// The history dumps the firmware sent back for --history: each one finished, a line per
+// sample with no gaps, and each line the same as the stream's for that sample
+static void historyDumpReport(size_t firstLine)
+{
+  const std::vector<std::string> &serial = simSerialLines();
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz;
+  std::map<std::string, std::string> stream;
+  unsigned ended = 0, lines = 0, gaps = 0, matched = 0, lost = 0, n, l;
+  double ms, lastMs = -1, span = 0, first = 0;
+  char t[32], g[32];
+
+  for (size_t i = firstLine; i < serial.size(); i++)
+  {
+    if (sscanf(serial[i].c_str(), "s,%31[^,],%31s", t, g) == 2)
+    {
+      stream[t] = g;
+    }
+  }
+  for (size_t i = firstLine; i < serial.size(); i++)
+  {
+    const char *line = strstr(serial[i].c_str(), "h,");
+    if (!line)
+    {
+      continue;
+    }
+    if (sscanf(line, "h,end,%u,%u", &n, &l) == 2)
+    {
+      ended++;
+      lost += l;
+      span = std::max(span, lastMs - first);
+      lastMs = -1;
+    }
+    else if (sscanf(line, "h,%31[^,],%31s", t, g) == 2)
+    {
+      ms = atof(t);
+      if (lastMs < 0)
+      {
+        first = ms;
+      }
+      else
+      {
+        gaps += ms <= lastMs || (ms - lastMs) * 1e6 > 1.5 * period;
+      }
+      lastMs = ms;
+      lines++;
+      matched += stream.count(t) && stream[t] == g;
+    }
+  }
+  printf("History dumps: %u of %zu requests ended, %u lines (longest %.1f s), %u gaps, %u blocks lost; %u lines match the stream\n",
+         ended, simConfig.historyRequests.size(), lines, span / 1000, gaps, lost, matched);
+}
+#endif
+
+// The full-rate sample stream on the serial port: a line for every conversion read after
+// setup(), each a sample period after the last, and what the capture path had to drop
+static void streamReport(uint64_t readouts, size_t firstLine, uint16_t overruns)
+{
+  const std::vector<std::string> &serial = simSerialLines();
+  uint64_t period = 1000000000ULL / simConfig.sampleRateHz;
+  unsigned lines = 0, gaps = 0;
+  bool monotonic = true;
+  double ms, g, lastMs = -1;
+
+  for (size_t i = firstLine; i < serial.size(); i++)
+  {
+    if (sscanf(serial[i].c_str(), "s,%lf,%lf", &ms, &g) != 2)
+    {
+      continue;
+    }
+    if (lines)
+    {
+      monotonic = monotonic && ms > lastMs;
+      gaps += (ms - lastMs) * 1e6 > 1.5 * period;
+    }
+    lastMs = ms;
+    lines++;
+  }
+  printf("Capture: %u stream lines for %llu samples read after setup(), %u gaps, timestamps %s; "
+         "%u lines dropped, %u plot column overruns, %u acquisition overruns\n",
+         lines, (unsigned long long)readouts, gaps, monotonic ? "monotonic" : "OUT OF ORDER", streamDropped,
+         plotColumns.overruns, acqOverruns() - overruns);
+}
+
+#ifdef BURST_SERIAL
+static uint16_t frameCrc(const uint8_t *p, size_t len)
+{
+  uint16_t crc = 0xFFFF;
+  while (len--)
+  {
+    crc ^= (uint16_t)*p++ << 8;
+    for (int i = 0; i < 8; i++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// The burst frames on the serial port: every one intact, each burst BURST_PRE_SAMPLES +
+// BURST_POST_SAMPLES consecutive samples (fewer pre-trigger ones just after a reset) with the
+// trigger flagged at the right one and over the level, and what that saved on the link
+static void burstReport(uint64_t readouts)
+{
+  const std::vector<uint8_t> &serial = simSerialBytes();
+  uint64_t period = 1000000 / simConfig.sampleRateHz;
+  unsigned frames = 0, bad = 0, bursts = 0, complete = 0, gaps = 0, misplaced = 0, early = 0;
+  unsigned got = 0, want = 0, pre = 0, source = 0;
+  uint32_t t = 0, lastT = 0;
+  uint16_t seq = 0;
+  double offset[LOADCELL_COUNT] = {}, scale[LOADCELL_COUNT] = {}, grams = 0, lastGrams = 0;
+  size_t i = 0, bytes = 0, sampleBytes = 0, samples = 0;
+
+  auto finish = [&]()
+  {
+    if (bursts && got == want)
+      complete++;
+  };
+  while (i + 6 <= serial.size())
+  {
+    const uint8_t *p = &serial[i];
+    if (p[0] != 0xA5 || p[1] != 0x5A || i + 6 + p[3] > serial.size() ||
+        frameCrc(p + 2, p[3] + 2) != (p[4 + p[3]] | p[5 + p[3]] << 8))
+    {
+      bad += p[0] == 0xA5 && p[1] == 0x5A;
+      i++; // Peel lines, or a broken frame
+      continue;
+    }
+    const uint8_t *q = p + 4;
+    frames++;
+    bytes += p[3] + 6;
+    if (p[2] == 0x02)
+    {
+      float f;
+      memcpy(&f, q + 4, 4);
+      offset[q[9] % LOADCELL_COUNT] = (int32_t)get32(q);
+      scale[q[9] % LOADCELL_COUNT] = f;
+    }
+    else if (p[2] == 0x03)
+    {
+      finish();
+      bursts++;
+      pre = q[6] | q[7] << 8;
+      want = pre + (q[8] | q[9] << 8);
+      source = q[10];
+      got = 0;
+    }
+    else if (p[2] == 0x01)
+    {
+      if (got && (uint16_t)(q[0] | q[1] << 8) != seq)
+        gaps++;
+      t = get32(q + 2);
+      for (const uint8_t *s = q + 6; s < q + p[3]; s += 6 * LOADCELL_COUNT)
+      {
+        t += s[0] | s[1] << 8;
+        if (got && (t - lastT > 1.5 * period || t - lastT < 0.5 * period))
+          gaps++;
+        grams = 0;
+        for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+        {
+          const uint8_t *e = s + 6 * c;
+          grams += (((int32_t)(e[2] | e[3] << 8 | e[4] << 16) << 8 >> 8) - offset[c]) / scale[c];
+        }
+        if (s[5] & 0x08)
+        {
+          misplaced += got != pre;
+          early += source == BURST_BY_LEVEL && (grams < BURST_LEVEL_GRAMS || (got && lastGrams >= BURST_LEVEL_GRAMS));
+        }
+        lastT = t;
+        lastGrams = grams;
+        got++;
+      }
+      seq = (q[0] | q[1] << 8) + (p[3] - 6) / 6;
+      sampleBytes += p[3] + 6;
+      samples += (p[3] - 6) / (6 * LOADCELL_COUNT);
+    }
+    i += p[3] + 6;
+  }
+  finish();
+  printf("Bursts: %u (%u by the firmware, %u cut short), %u complete; %u frames, %u bad, %u sample gaps; "
+         "%u triggers misplaced, %u off the level\n",
+         bursts, burstStats.bursts, burstStats.truncated, complete, frames, bad, gaps, misplaced, early);
+  printf("Burst link: %.0f bytes/min, against %.0f for every sample in the same frames\n",
+         bytes * 60 / simConfig.seconds,
+         samples ? readouts * sampleBytes / samples * 60.0 / simConfig.seconds : 0.0);
+}
+#endif
+
+// What each task of loop() cost, and how late it started: the jitter
+// Each task's run() is wrapped to add up what its runs cost: simulated time, host time,
+// and heap allocations (String).  Wrappers are plain functions, one per slot of the table.
+#define SIM_MAX_TASKS 8
+
+struct TaskCost
+{
+  void (*run)();
+  uint64_t runs, ns, hostNs, allocs, spiBytes, windows;
+};
+
+static TaskCost taskCosts[SIM_MAX_TASKS];
+
+template <uint8_t I>
+static void measuredTask()
+{
+  TaskCost &c = taskCosts[I];
+  uint64_t t0 = simNow(), allocs = simStats.stringAllocs, spiBytes = simStats.spiBytes, windows = simStats.windows;
+  auto h0 = std::chrono::steady_clock::now();
+
+  c.run();
+  c.hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - h0).count();
+  c.ns += simNow() - t0;
+  c.allocs += simStats.stringAllocs - allocs;
+  c.spiBytes += simStats.spiBytes - spiBytes;
+  c.windows += simStats.windows - windows;
+  c.runs++;
+}
+
+static void (*const measuredTasks[SIM_MAX_TASKS])() = {measuredTask<0>, measuredTask<1>, measuredTask<2>,
+                                                       measuredTask<3>, measuredTask<4>, measuredTask<5>,
+                                                       measuredTask<6>, measuredTask<7>};
+
+static void measureTasks()
+{
+  for (uint8_t i = 0; i < taskCount && i < SIM_MAX_TASKS; i++)
+  {
+    taskCosts[i].run = tasks[i].run;
+    tasks[i].run = measuredTasks[i];
+  }
+}
+
+static void taskReport()
+{
+  printf("Tasks: runs, mean simulated us (16MHz cycles) / WCET, host ns, String allocations, TFT SPI bytes and windows per run; "
+         "worst start latency\n");
+  for (uint8_t i = 0; i < taskCount && i < SIM_MAX_TASKS; i++)
+  {
+    const TaskCost &c = taskCosts[i];
+    double runs = c.runs ? c.runs : 1;
+    printf("  %-8s %6s: %6llu, %8.1f (%8.0f) / %7lu us, %6.0f ns, %.2f allocs, %6.0f B %5.1f win; late %7lu us "
+           "(deadline %4u ms), %u misses\n",
+           tasks[i].name, tasks[i].periodMs ? (std::to_string(tasks[i].periodMs) + " ms").c_str() : "event",
+           (unsigned long long)c.runs, c.ns / runs / 1e3, c.ns / runs * 16e-3, (unsigned long)tasks[i].wcetUs,
+           c.hostNs / runs, c.allocs / runs, c.spiBytes / runs, c.windows / runs, (unsigned long)tasks[i].maxLateUs,
+           tasks[i].deadlineMs, tasks[i].misses);
+  }
+}
+
+// Where the last tare and calibration left each cell, against the simulated one
+static void cellReport()
+{
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    printf("Cell %u: offset %ld counts (%+.1f g), %.2f counts/g (%+.2f%%)\n", c, cellOffset[c],
+           (cellOffset[c] - simConfig.countsOffset) / simConfig.countsPerGram,
+           FORCE_PER_GRAM * 65536.0 / cellGain[c],
+           (FORCE_PER_GRAM * 65536.0 / cellGain[c] / simConfig.countsPerGram - 1) * 100);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint64_t end, passStart, passNs, maxPassNs = 0, passes = 0, frames = 0;
+  uint64_t calls, bytes, windows, maxCalls = 0, maxBytes = 0, maxWindows = 0;
+  uint64_t frameCalls = 0, frameBytes = 0, frameWindows = 0, frameNs = 0, maxFrameNs = 0;
+  uint64_t hostNs = 0, startReadouts;
+  size_t startLines, historyNext = 0;
+  uint16_t startOverruns;
+  SimStats before, started;
+  double seconds;
+
+  parseArgs(argc, argv);
+  if (simConfig.trace == TRACE_FILE && !simLoadTrace(simConfig.traceFile))
+  {
+    fprintf(stderr, "Cannot read trace %s\n", simConfig.traceFile.c_str());
+    return 1;
+  }
+  pendingButtons = simConfig.buttons;
+  std::sort(simConfig.historyRequests.begin(), simConfig.historyRequests.end());
+  std::sort(pendingButtons.begin(), pendingButtons.end(),
+            [](const SimScriptedButton &a, const SimScriptedButton &b)
+            { return a.atNs < b.atNs; });
+
+  // One chip per load cell, as wired in setup.h
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    simAddChip(douts[c], HX711_SCK);
+  }
+
+  // Factory state: erased EEPROM holding the calibration for the simulated load cell, as
+  // older firmware left it.  Or what an earlier run left behind.
+  FILE *f = simConfig.eepromFile.empty() ? 0 : fopen(simConfig.eepromFile.c_str(), "rb");
+  if (!f || fread(EEPROM.data, sizeof(EEPROM.data), 1, f) != 1)
+  {
+    memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+    EEPROM.data[EEPROM_ADDR] = (uint8_t)simConfig.countsPerGram;
+  }
+  if (f)
+  {
+    fclose(f);
+  }
+
+#ifdef PEEL_TRIGGER_PIN
+  simWatchPin(PEEL_TRIGGER_PIN);
+#endif
+#ifdef BURST_PIN
+  simConfig.gpioPin = BURST_PIN;
+  simConfig.gpioLevel = BURST_PIN_LEVEL;
+#endif
+
+  setup();
+  measureTasks();
+  started = simStats;
+
+  startReadouts = simStats.readouts;
+  startLines = simSerialLines().size();
+  startOverruns = acqOverruns();
+  end = simNow() + (uint64_t)(simConfig.seconds * 1e9);
+  while (simNow() < end)
+  {
+    before = simStats;
+    passStart = simNow();
+    if (historyNext < simConfig.historyRequests.size() && simConfig.historyRequests[historyNext] <= passStart)
+    {
+      simSerialInject("h");
+      historyNext++;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    loop();
+    hostNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+
+    simAdvance(simConfig.loopPassNs);
+    passes++;
+    passNs = simNow() - passStart;
+    maxPassNs = std::max(maxPassNs, passNs);
+
+    calls = simStats.drawCalls - before.drawCalls;
+    bytes = simStats.spiBytes - before.spiBytes;
+    windows = simStats.windows - before.windows;
+    if (calls)
+    {
+      frames++;
+      frameCalls += calls;
+      frameBytes += bytes;
+      frameWindows += windows;
+      frameNs += passNs;
+      maxFrameNs = std::max(maxFrameNs, passNs);
+      maxCalls = std::max(maxCalls, calls);
+      maxBytes = std::max(maxBytes, bytes);
+      maxWindows = std::max(maxWindows, windows);
+    }
+  }
+
+  seconds = simConfig.seconds;
+  printf("\nSimulated %.1f s after setup(), %u Hz HX711\n", seconds, simConfig.sampleRateHz);
+  printf("HX711: %llu conversions, %llu read (%llu after setup), %llu dropped (%.2f%%), %llu power-downs\n",
+         (unsigned long long)simStats.conversions, (unsigned long long)simStats.readouts,
+         (unsigned long long)(simStats.readouts - startReadouts), (unsigned long long)simStats.dropped,
+         simStats.conversions ? 100.0 * simStats.dropped / simStats.conversions : 0.0,
+         (unsigned long long)simStats.powerDowns);
+  printf("loop(): %llu passes, mean %.1f us, max %.1f us simulated, %.0f ns host per pass\n",
+         (unsigned long long)passes, passes ? seconds * 1e6 / passes : 0.0, maxPassNs / 1e3,
+         passes ? (double)hostNs / passes : 0.0);
+  printf("Frames: %llu, %.1f/s; per frame mean %.0f / max %llu draw calls, %.0f / %llu SPI bytes, %.0f / %llu windows, "
+         "%.2f / %.2f ms\n",
+         (unsigned long long)frames, frames / seconds,
+         frames ? (double)frameCalls / frames : 0.0, (unsigned long long)maxCalls,
+         frames ? (double)frameBytes / frames : 0.0, (unsigned long long)maxBytes,
+         frames ? (double)frameWindows / frames : 0.0, (unsigned long long)maxWindows,
+         frames ? frameNs / 1e6 / frames : 0.0, maxFrameNs / 1e6);
+  printf("TFT: %llu full-screen clears (%.1f/min), %llu Y rescales (%.1f/min), %llu SPI bytes total; serial: %llu bytes; "
+         "%llu interrupts (at most %.1f us with them off); %lu EEPROM writes\n",
+         (unsigned long long)(simStats.fillScreens - started.fillScreens), (simStats.fillScreens - started.fillScreens) * 60 / seconds,
+         (unsigned long long)(simStats.yRescales - started.yRescales), (simStats.yRescales - started.yRescales) * 60 / seconds,
+         (unsigned long long)simStats.spiBytes,
+         (unsigned long long)simStats.serialBytes, (unsigned long long)simStats.interrupts,
+         simStats.maxIrqOffNs / 1e3, EEPROM.writes);
+
+  taskReport();
+  peelReport();
+  peelSerialReport();
+  peelSummaryReport();
+  streamReport(simStats.readouts - startReadouts, startLines, startOverruns);
+#ifdef BURST_SERIAL
+  burstReport((simStats.readouts - startReadouts) / simChipCount());
+#endif
+  cellReport();
+  statsReport();
+  historyReport();
+#ifdef HISTORY_SERIAL
+  historyDumpReport(startLines);
+#endif
+
+  if (!simConfig.ppmFile.empty())
+  {
+    simWritePpm(simConfig.ppmFile);
+  }
+  if (!simConfig.eepromFile.empty() && (f = fopen(simConfig.eepromFile.c_str(), "wb")))
+  {
+    fwrite(EEPROM.data, sizeof(EEPROM.data), 1, f);
+    fclose(f);
+  }
+  return 0;
+}
+#endif
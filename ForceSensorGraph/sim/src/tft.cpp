@@ -0,0 +1,403 @@
+// TFT_ILI9341 and ChartXY fakes.  Every primitive is costed in SPI bytes and address
+// windows and charged to the simulated clock (see simSpi()).
+
+#include <stdio.h>
+#include <TFT_ILI9341.h>
+#include <TFT_Charts.h>
+#include "sim.h"
+
+#define WINDOW_BYTES 11    // CASET + 4, PASET + 4, RAMWR
+#define GLYPH_LIT_PIXELS 12 // Typical number of set pixels in a 5x7 GLCD glyph
+
+static uint16_t frame[320 * 320];
+static int16_t frameW = 320, frameH = 240;
+
+const uint16_t *simFrameBuffer(int &width, int &height)
+{
+  width = frameW;
+  height = frameH;
+  return frame;
+}
+
+void simWritePpm(const std::string &file)
+{
+  FILE *f = fopen(file.c_str(), "wb");
+  int i;
+
+  if (!f)
+  {
+    return;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", frameW, frameH);
+  for (i = 0; i < frameW * frameH; i++)
+  {
+    uint16_t c = frame[i];
+    fputc((c >> 8) & 0xF8, f);
+    fputc((c >> 3) & 0xFC, f);
+    fputc((c << 3) & 0xF8, f);
+  }
+  fclose(f);
+}
+
+TFT_ILI9341::TFT_ILI9341(int16_t w, int16_t h) : _width(w), _height(h)
+{
+  frameW = w;
+  frameH = h;
+}
+
+void TFT_ILI9341::begin()
+{
+  // Reset and init sequence, roughly 80 command/data bytes
+  simSpi(80);
+}
+
+void TFT_ILI9341::primitive()
+{
+  simStats.drawCalls++;
+  simAdvance(simConfig.drawCallNs);
+}
+
+void TFT_ILI9341::plot(int32_t x, int32_t y, uint16_t color)
+{
+  if (x >= 0 && y >= 0 && x < _width && y < _height)
+  {
+    frame[y * _width + x] = color;
+  }
+}
+
+void TFT_ILI9341::fillScreen(uint16_t color)
+{
+  simStats.fillScreens++;
+  fillRect(0, 0, _width, _height, color);
+}
+
+void TFT_ILI9341::fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color)
+{
+  int32_t i, j;
+
+  primitive();
+  if (x < 0)
+  {
+    w += x;
+    x = 0;
+  }
+  if (y < 0)
+  {
+    h += y;
+    y = 0;
+  }
+  if (x + w > _width)
+    w = _width - x;
+  if (y + h > _height)
+    h = _height - y;
+  if (w <= 0 || h <= 0)
+  {
+    return;
+  }
+  for (j = y; j < y + h; j++)
+    for (i = x; i < x + w; i++)
+      plot(i, j, color);
+  simSpi(WINDOW_BYTES + 2 * w * h, 1);
+}
+
+void TFT_ILI9341::drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color)
+{
+  drawFastHLine(x, y, w, color);
+  drawFastHLine(x, y + h - 1, w, color);
+  drawFastVLine(x, y, h, color);
+  drawFastVLine(x + w - 1, y, h, color);
+}
+
+void TFT_ILI9341::drawPixel(int32_t x, int32_t y, uint16_t color)
+{
+  primitive();
+  if (x < 0 || y < 0 || x >= _width || y >= _height)
+  {
+    return;
+  }
+  plot(x, y, color);
+  simSpi(WINDOW_BYTES + 2, 1);
+}
+
+void TFT_ILI9341::drawFastHLine(int32_t x, int32_t y, int32_t w, uint16_t color)
+{
+  fillRect(x, y, w, 1, color);
+}
+
+void TFT_ILI9341::drawFastVLine(int32_t x, int32_t y, int32_t h, uint16_t color)
+{
+  fillRect(x, y, 1, h, color);
+}
+
+void TFT_ILI9341::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t color)
+{
+  int32_t dx, dy, sx, sy, err, e2, pixels = 0;
+
+  if (y0 == y1)
+  {
+    drawFastHLine(x0 < x1 ? x0 : x1, y0, abs(x1 - x0) + 1, color);
+    return;
+  }
+  if (x0 == x1)
+  {
+    drawFastVLine(x0, y0 < y1 ? y0 : y1, abs(y1 - y0) + 1, color);
+    return;
+  }
+
+  // Bresenham, one address window per pixel
+  primitive();
+  dx = abs(x1 - x0);
+  dy = -abs(y1 - y0);
+  sx = x0 < x1 ? 1 : -1;
+  sy = y0 < y1 ? 1 : -1;
+  err = dx + dy;
+  for (;;)
+  {
+    if (x0 >= 0 && y0 >= 0 && x0 < _width && y0 < _height)
+    {
+      plot(x0, y0, color);
+      pixels++;
+    }
+    if (x0 == x1 && y0 == y1)
+      break;
+    e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+  simSpi(pixels * (WINDOW_BYTES + 2), pixels);
+}
+
+void TFT_ILI9341::drawChar(int32_t x, int32_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size)
+{
+  int32_t i, cw = 6 * size, ch = 8 * size;
+
+  primitive();
+  if (bg != color)
+  {
+    // Opaque text: one window for the whole cell
+    for (i = 0; i < cw * ch; i++)
+      plot(x + i % cw, y + i / cw, bg);
+    simSpi(WINDOW_BYTES + 2 * cw * ch, 1);
+  }
+  else if (c != ' ')
+  {
+    // Transparent text: the set pixels one by one
+    simSpi(GLYPH_LIT_PIXELS * (WINDOW_BYTES + 2 * size * size), GLYPH_LIT_PIXELS);
+  }
+  if (c != ' ')
+  {
+    // No font data in the simulator - draw the glyph's bounding box instead
+    for (i = 0; i < 5 * size; i++)
+    {
+      plot(x + i, y, color);
+      plot(x + i, y + 7 * size - 1, color);
+    }
+    for (i = 0; i < 7 * size; i++)
+    {
+      plot(x, y + i, color);
+      plot(x + 5 * size - 1, y + i, color);
+    }
+  }
+}
+
+void TFT_ILI9341::setAddrWindow(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+  primitive();
+  winX0 = winX = x0;
+  winY0 = winY = y0;
+  winX1 = x1;
+  winY1 = y1;
+  simSpi(WINDOW_BYTES, 1);
+}
+
+void TFT_ILI9341::pushColor(uint16_t color)
+{
+  pushColor(color, 1);
+}
+
+void TFT_ILI9341::pushColor(uint16_t color, uint32_t len)
+{
+  uint32_t i;
+
+  primitive();
+  for (i = 0; i < len; i++)
+  {
+    plot(winX, winY, color);
+    if (++winX > winX1)
+    {
+      winX = winX0;
+      if (++winY > winY1)
+        winY = winY0;
+    }
+  }
+  simSpi(2 * len);
+}
+
+size_t TFT_ILI9341::print(char c)
+{
+  if (c == '\n')
+  {
+    cursorX = 0;
+    cursorY += 8 * textSize;
+  }
+  else if (c != '\r')
+  {
+    drawChar(cursorX, cursorY, c, textColor, textBg, textSize);
+    cursorX += 6 * textSize;
+  }
+  return 1;
+}
+
+size_t TFT_ILI9341::print(const char *s)
+{
+  size_t n = 0;
+  while (*s)
+  {
+    n += print(*s++);
+  }
+  return n;
+}
+
+// ---------------------------------------------------------------------------------------
+// ChartXY
+
+void ChartXY::begin(TFT_ILI9341 &tft)
+{
+  right = tft.width() - 5;
+  bottom = tft.height() - 20;
+}
+
+void ChartXY::tftInfo()
+{
+  Serial.println("ChartXY (simulated)");
+}
+
+void ChartXY::setAxisLimitsX(float min, float max, float tick)
+{
+  xMin = min;
+  xMax = max;
+  xTick = tick;
+}
+
+void ChartXY::setAxisLimitsY(float min, float max, float tick)
+{
+  if (min != yMin || max != yMax)
+  {
+    simStats.yRescales++;
+  }
+  yMin = min;
+  yMax = max;
+  yTick = tick;
+}
+
+int32_t ChartXY::toPixelX(float x)
+{
+  float px = left + (x - xMin) * (right - left) / (xMax - xMin);
+  if (px < left)
+    px = left;
+  if (px > right)
+    px = right;
+  return (int32_t)px;
+}
+
+int32_t ChartXY::toPixelY(float y)
+{
+  float py = bottom - (y - yMin) * (bottom - top) / (yMax - yMin);
+  if (py < top)
+    py = top;
+  if (py > bottom)
+    py = bottom;
+  return (int32_t)py;
+}
+
+void ChartXY::drawTitleChart(TFT_ILI9341 &tft, const char *title)
+{
+  tft.setTextSize(2);
+  tft.setTextColor(axisColor, tftBGColor);
+  tft.setCursor(5, 5);
+  tft.print(title);
+}
+
+void ChartXY::drawAxisX(TFT_ILI9341 &tft, int tickLength)
+{
+  float x;
+
+  tft.drawFastHLine(left, bottom, right - left, axisColor);
+  for (x = xMin; x <= xMax && xTick > 0; x += xTick)
+  {
+    tft.drawFastVLine(toPixelX(x), bottom, tickLength / 2, axisColor);
+  }
+}
+
+void ChartXY::drawAxisY(TFT_ILI9341 &tft, int tickLength)
+{
+  float y;
+
+  tft.drawFastVLine(left, top, bottom - top, axisColor);
+  for (y = yMin; y <= yMax && yTick > 0; y += yTick)
+  {
+    tft.drawFastHLine(left - tickLength / 2, toPixelY(y), tickLength / 2, axisColor);
+  }
+}
+
+void ChartXY::drawLabelsX(TFT_ILI9341 &tft)
+{
+  float x;
+
+  tft.fillRect(left - 10, bottom + 6, right - left + 20, 12, tftBGColor);
+  tft.setTextSize(1);
+  tft.setTextColor(axisColor, tftBGColor);
+  for (x = xMin; x <= xMax && xTick > 0; x += xTick)
+  {
+    tft.setCursor(toPixelX(x) - 6, bottom + 8);
+    tft.print(String((int)x));
+  }
+}
+
+void ChartXY::drawLabelsY(TFT_ILI9341 &tft)
+{
+  float y;
+
+  tft.fillRect(0, top - 6, left - 6, bottom - top + 12, tftBGColor);
+  tft.setTextSize(1);
+  tft.setTextColor(axisColor, tftBGColor);
+  for (y = yMin; y <= yMax && yTick > 0; y += yTick)
+  {
+    tft.setCursor(0, toPixelY(y) - 4);
+    tft.print(String((int)y));
+  }
+}
+
+void ChartXY::drawY0(TFT_ILI9341 &tft)
+{
+  if (yMin < 0 && yMax > 0)
+  {
+    tft.drawFastHLine(left, toPixelY(0), right - left, TFT_DARKGREY);
+  }
+}
+
+void ChartXY::drawLegend(TFT_ILI9341 &tft, String text, int x, int y, int size, uint16_t color)
+{
+  tft.setTextSize(size);
+  tft.setTextColor(color, tftBGColor);
+  tft.setCursor(x, y);
+  tft.print(text);
+}
+
+void ChartXY::drawLine(TFT_ILI9341 &tft, float x0, float y0, float x1, float y1)
+{
+  tft.drawLine(toPixelX(x0), toPixelY(y0), toPixelX(x1), toPixelY(y1), lineColor);
+}
+
+void ChartXY::eraseLine(TFT_ILI9341 &tft, float x0, float y0, float x1, float y1)
+{
+  tft.drawLine(toPixelX(x0), toPixelY(y0), toPixelX(x1), toPixelY(y1), tftBGColor);
+}
@@ -0,0 +1,172 @@
+// Force traces for the HX711 chip model: synthetic peel curves, step loads and glitches,
+// or a recorded "seconds,grams" CSV, plus noise and drift.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include "sim.h"
+
+#define GLITCH_EVERY 297 // Conversions between spikes in TRACE_GLITCH
+
+static std::vector<double> fileT, fileG;
+
+bool simLoadTrace(const std::string &file)
+{
+  FILE *f = fopen(file.c_str(), "r");
+  char line[128];
+  double t, g;
+
+  if (!f)
+  {
+    return false;
+  }
+  fileT.clear();
+  fileG.clear();
+  while (fgets(line, sizeof(line), f))
+  {
+    if (line[0] != '#' && sscanf(line, "%lf,%lf", &t, &g) == 2)
+    {
+      fileT.push_back(t);
+      fileG.push_back(g);
+    }
+  }
+  fclose(f);
+  return fileT.size() > 1;
+}
+
+// One layer: idle, lift with the FEP suction building up, release, ringing
+static double peel(double t)
+{
+  double period = simConfig.peelPeriod;
+  double phase = fmod(t, period);
+  double liftStart = 0.3 * period, release = 0.6 * period;
+  double u;
+
+  if (phase < liftStart)
+  {
+    return 0;
+  }
+  if (phase < release)
+  {
+    u = (phase - liftStart) / (release - liftStart);
+    return simConfig.peelPeak * (1 - exp(-3 * u)) / (1 - exp(-3));
+  }
+  u = phase - release;
+  return simConfig.peelPeak * 0.15 * exp(-u / 0.08) * sin(2 * M_PI * 12 * u);
+}
+
+bool simTraceLastRelease(uint64_t ns, uint64_t &releaseNs)
+{
+  double period = simConfig.peelPeriod, t = ns / 1e9, release;
+
+  if (simConfig.trace != TRACE_PEEL && simConfig.trace != TRACE_GLITCH)
+  {
+    return false;
+  }
+  release = floor(t / period) * period + 0.6 * period; // As in peel()
+  if (release > t)
+  {
+    release -= period;
+  }
+  if (release < 0)
+  {
+    return false;
+  }
+  releaseNs = (uint64_t)(release * 1e9);
+  return true;
+}
+
+static double step(double t)
+{
+  static const double levels[] = {0, 500, 1500, 250, 1000, 0};
+  int n = sizeof(levels) / sizeof(levels[0]);
+  return levels[(long)(t / 5) % n];
+}
+
+static double replay(double t)
+{
+  size_t lo = 0, hi = fileT.size() - 1, mid;
+  double span = fileT.back() - fileT.front();
+
+  t = fileT.front() + fmod(t, span);
+  while (hi - lo > 1)
+  {
+    mid = (lo + hi) / 2;
+    if (fileT[mid] <= t)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return fileG[lo] + (fileG[hi] - fileG[lo]) * (t - fileT[lo]) / (fileT[hi] - fileT[lo]);
+}
+
+double simTraceGrams(uint8_t chip, uint64_t ns)
+{
+  double t = ns / 1e9;
+
+  switch (simConfig.trace)
+  {
+  case TRACE_STEP:
+    return step(t);
+  case TRACE_FILE:
+    return fileT.size() > 1 ? replay(t) : 0;
+  case TRACE_GLITCH:
+  case TRACE_PEEL:
+  default:
+    return peel(t);
+  }
+}
+
+// Deterministic per-chip Gaussian noise (xorshift + Box-Muller)
+static double gauss(uint8_t chip)
+{
+  static uint32_t state[SIM_MAX_CHIPS];
+  double u1, u2;
+  uint32_t &s = state[chip];
+  int i;
+
+  if (!s)
+  {
+    s = simConfig.seed * 2654435761u + chip + 1;
+  }
+  for (i = 0; i < 2; i++)
+  {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    if (i == 0)
+      u1 = (s + 1.0) / 4294967297.0;
+    else
+      u2 = (s + 1.0) / 4294967297.0;
+  }
+  return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+long simTraceCounts(uint8_t chip, uint64_t ns)
+{
+  static uint64_t conversions[SIM_MAX_CHIPS];
+  double grams = simTraceGrams(chip, ns);
+  long counts;
+
+  // Split the load between the cells
+  if (chip < simConfig.shares.size())
+    grams *= simConfig.shares[chip];
+  else if (simChipCount() > 1)
+    grams /= simChipCount();
+
+  grams += simConfig.noiseGrams * gauss(chip);
+  grams += simConfig.driftGramsPerMin * ns / 60e9;
+  grams += simConfig.bowGrams * (grams / 10000) * (grams / 10000);
+  if (simConfig.trace == TRACE_GLITCH && ++conversions[chip] % GLITCH_EVERY == 0)
+  {
+    grams = (conversions[chip] / GLITCH_EVERY) & 1 ? 30000 : -30000;
+  }
+
+  counts = simConfig.countsOffset + lround(grams * simConfig.countsPerGram);
+  if (counts > 0x7FFFFF)
+    counts = 0x7FFFFF;
+  if (counts < -0x800000)
+    counts = -0x800000;
+  return counts;
+}
@@ -0,0 +1,229 @@
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include "setup.h"
+#include "acquisition.h"
+#include "sampleRing.h"
+
+#define ACQ_MAX_SLOTS 4
+
+// The pins' port registers and bits, looked up once so the transfer is a load or store
+// a bit rather than a digitalRead()/digitalWrite() with its table lookups (about 4 cycles
+// against 50)
+typedef decltype(portInputRegister(0)) AcqPort;
+
+static SampleRing<RawSample, SAMPLE_RING_LENGTH> ring;
+static AcqPort acqDoutIn[LOADCELL_COUNT];
+static uint8_t acqDoutBit[LOADCELL_COUNT];
+static AcqPort acqSckOut;
+static uint8_t acqSckBit;
+static uint8_t acqIrqs = 0; // Channels whose DOUT has an external interrupt
+static void (*acqHook)(const RawSample &s) = 0;
+
+// Input schedule, applied to every channel because they share PD_SCK
+static AcqSlot acqSlots[ACQ_MAX_SLOTS] = {{ACQ_A128, 1}};
+static uint8_t acqNSlots = 1, acqSlot = 0, acqSlotLeft = 1;
+static uint8_t acqInput = ACQ_A128; // Input of the conversion currently in the chips
+static uint8_t acqSettle = 0;       // Conversions left to throw away after a switch
+
+static inline void sckPulse()
+{
+  *acqSckOut |= acqSckBit;
+  *acqSckOut &= ~acqSckBit;
+}
+
+// Clock one conversion out of every HX711 and queue it.  Called with interrupts disabled,
+// either from the ISR or from acqPoll(), so PD_SCK can never be stretched past the 60us
+// that would power the chips down.
+static void acqReadAll()
+{
+  unsigned long value[LOADCELL_COUNT];
+  uint8_t i, c, next;
+  boolean discard;
+
+  // The chips are not synchronised, so wait for the last one.  Clocking the data out also
+  // toggles DOUT, which re-arms the edge interrupts; those re-entries land here after DOUT
+  // has gone back high and are ignored too.
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    if (*acqDoutIn[c] & acqDoutBit[c])
+    {
+      return;
+    }
+    value[c] = 0;
+  }
+
+  RawSample s;
+  s.t = timeUs();
+  s.input = acqInput;
+
+  // Fetching the pointer and reading through it puts more than the 0.1us DOUT needs after
+  // the rising edge, and the 0.2us PD_SCK must stay high, between the two stores
+  for (i = 0; i < 24; i++)
+  {
+    *acqSckOut |= acqSckBit;
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+      value[c] = (value[c] << 1) | ((*acqDoutIn[c] & acqDoutBit[c]) != 0);
+    }
+    *acqSckOut &= ~acqSckBit;
+  }
+
+  // Conversions still settling after a switch are thrown away.  The rest count towards
+  // the current slot of the schedule, and the extra pulses select the input for the next
+  // conversion.
+  discard = acqSettle != 0;
+  if (discard)
+  {
+    acqSettle--;
+  }
+  else if (--acqSlotLeft == 0)
+  {
+    acqSlot = acqSlot + 1 < acqNSlots ? acqSlot + 1 : 0;
+    acqSlotLeft = acqSlots[acqSlot].samples;
+  }
+  next = acqSlots[acqSlot].input;
+  for (i = 0; i < next; i++)
+  {
+    sckPulse();
+  }
+  if (next != acqInput)
+  {
+    acqSettle = ACQ_SETTLE_CONVERSIONS;
+    acqInput = next;
+  }
+  if (discard)
+  {
+    return;
+  }
+
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    // Replicate the most significant bit to pad out a 32-bit signed integer (through
+    // int32_t, as long is wider than that off the AVR)
+    if (value[c] & 0x800000UL)
+    {
+      value[c] |= 0xFF000000UL;
+    }
+    s.count[c] = (int32_t)value[c];
+  }
+  ring.push(s);
+  if (acqHook)
+  {
+    acqHook(s);
+  }
+}
+
+static void acqIsr()
+{
+  acqReadAll();
+}
+
+void acqBegin(const uint8_t *dout, uint8_t sck)
+{
+  uint8_t c;
+  int8_t irq;
+
+  pinMode(sck, OUTPUT);
+  digitalWrite(sck, LOW);
+  acqSckOut = portOutputRegister(digitalPinToPort(sck));
+  acqSckBit = digitalPinToBitMask(sck);
+
+  // Any channel's DOUT edge may be the last one we are waiting for
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    pinMode(dout[c], INPUT_PULLUP);
+    acqDoutIn[c] = portInputRegister(digitalPinToPort(dout[c]));
+    acqDoutBit[c] = digitalPinToBitMask(dout[c]);
+    irq = digitalPinToInterrupt(dout[c]);
+    if (irq != NOT_AN_INTERRUPT)
+    {
+      attachInterrupt(irq, acqIsr, FALLING);
+      acqIrqs++;
+    }
+    if (DEBUG == 2)
+    {
+      Serial.print(F("HX711 "));
+      Serial.print(c);
+      if (irq == NOT_AN_INTERRUPT)
+      {
+        Serial.println(F(" DOUT is not an interrupt pin, polling for data"));
+      }
+      else
+      {
+        Serial.print(F(" DOUT on external interrupt "));
+        Serial.println(irq);
+      }
+    }
+  }
+
+  // A conversion may already be waiting, and we would never see its edge
+  acqPoll();
+}
+
+// Have hook called with every sample as it is queued, from the ISR
+void acqOnSample(void (*hook)(const RawSample &s))
+{
+  noInterrupts();
+  acqHook = hook;
+  interrupts();
+}
+
+// Cycle through the inputs in slots, e.g. {{ACQ_A128, 40}, {ACQ_B32, 1}} for 40 samples of
+// the load cells on channel A and then one of whatever is wired to channel B.  Every switch
+// costs ACQ_SETTLE_CONVERSIONS conversions on top of the samples asked for.
+void acqSchedule(const AcqSlot *slots, uint8_t n)
+{
+  uint8_t i;
+
+  if (n == 0 || n > ACQ_MAX_SLOTS)
+  {
+    return;
+  }
+  noInterrupts();
+  for (i = 0; i < n; i++)
+  {
+    acqSlots[i] = slots[i];
+  }
+  acqNSlots = n;
+  acqSlot = 0;
+  acqSlotLeft = slots[0].samples;
+  interrupts();
+}
+
+// Polling fallback.  Harmless to call when the ISR is in charge.
+void acqPoll()
+{
+  noInterrupts();
+  acqReadAll();
+  interrupts();
+}
+
+// Throw away everything queued so far, e.g. before averaging fresh samples
+void acqFlush()
+{
+  ring.flush();
+}
+
+bool acqRead(RawSample &s)
+{
+  return ring.pop(s);
+}
+
+uint8_t acqPending()
+{
+  return ring.count();
+}
+
+uint16_t acqOverruns()
+{
+  uint16_t n;
+  noInterrupts();
+  n = ring.overruns;
+  interrupts();
+  return n;
+}
+
+uint8_t acqInterruptChannels()
+{
+  return acqIrqs;
+}
@@ -0,0 +1,332 @@
+#include <Arduino.h>
+#include <string.h>
+#include <TFT_Charts.h>
+#include <TFT_ILI9341.h>
+#include "setup.h"
+#include "burstCapture.h"
+#include "loadCell.h"
+#if defined(__AVR__)
+#include <util/crc16.h>
+#endif
+
+// The board sketch's frame format, see host/include/forceFrame.h
+#define FRAME_SYNC0 0xA5
+#define FRAME_SYNC1 0x5A
+#define FRAME_SAMPLES 0x01
+#define FRAME_INFO 0x02
+#define FRAME_BURST 0x03
+#define FRAME_MAX_SAMPLES 8
+#define FRAME_SAMPLE_BYTES 6
+#define SAMPLE_SATURATED 0x04
+#define SAMPLE_TRIGGER 0x08
+#define SAMPLE_CHANNEL_SHIFT 6
+
+static_assert(LOADCELL_COUNT <= 4, "The frame format has room for 4 load cells");
+
+#define CONVERSIONS_PER_FRAME (FRAME_MAX_SAMPLES / LOADCELL_COUNT)
+#define BURST_RING (BURST_PRE_SAMPLES + 1 + CONVERSIONS_PER_FRAME) // The history, the trigger and a frame in flight
+
+static_assert(BURST_RING <= 255, "BURST_PRE_SAMPLES too long for a byte index");
+
+// One conversion, packed: 4 + 3 bytes per cell + 1
+struct BurstEntry
+{
+  uint32_t t;                       // Data-ready, low 32 bits of timeUs()
+  uint8_t count[LOADCELL_COUNT][3]; // Raw 24-bit counts, little-endian
+  uint8_t flags;                    // SAMPLE_TRIGGER
+};
+
+static BurstEntry ring[BURST_RING];
+static uint8_t first, held; // Oldest entry, and how many there are
+
+// The burst in progress
+static boolean sending = false;
+static uint16_t postLeft;   // Conversions still to capture
+static uint8_t preambleSent; // FRAME_INFOs, then the FRAME_BURST
+static uint8_t source, pre;
+static uint32_t tTrigger;
+static uint16_t burstNo, seq; // Bursts, and samples sent, for the headers
+
+// Trigger state
+static boolean armed = true;
+#if BURST_SLOPE
+#define SLOPE_SAMPLES 4 // The slope is measured over this many samples
+static force_t slopeY[SLOPE_SAMPLES];
+static uint32_t slopeT[SLOPE_SAMPLES];
+static uint8_t slopeNext, slopeFilled;
+#endif
+
+BurstStats burstStats;
+
+static uint16_t crc16(uint16_t crc, const uint8_t *p, uint8_t len)
+{
+  while (len--)
+  {
+#if defined(__AVR__)
+    crc = _crc_xmodem_update(crc, *p++);
+#else
+    crc ^= (uint16_t)*p++ << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+#endif
+  }
+  return crc;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+// Write a whole frame as one USB packet, or nothing if the port has no room for it yet
+static boolean sendFrame(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  uint8_t out[4 + 6 + FRAME_MAX_SAMPLES * FRAME_SAMPLE_BYTES + 2];
+  uint16_t crc;
+
+  if (Serial.availableForWrite() < len + 6)
+  {
+    return false;
+  }
+  out[0] = FRAME_SYNC0;
+  out[1] = FRAME_SYNC1;
+  out[2] = type;
+  out[3] = len;
+  memcpy(out + 4, payload, len);
+  crc = crc16(0xFFFF, out + 2, len + 2);
+  put16(out + 4 + len, crc);
+  Serial.write(out, len + 6);
+  return true;
+}
+
+// The FRAME_INFO for cell c (grams = (count - offset) / scale), then the FRAME_BURST header
+static boolean sendPreamble(uint8_t step)
+{
+  uint8_t p[12];
+  float scale;
+
+  if (step < LOADCELL_COUNT)
+  {
+    scale = (float)FORCE_PER_GRAM * (1L << FORCE_GAIN_SHIFT) / cellGain[step];
+#ifdef INVERT_Y
+    scale = -scale;
+#endif
+    put32(p, cellOffset[step]);
+    memcpy(p + 4, &scale, 4);
+    p[8] = HX711_RATE_HZ;
+    p[9] = step;
+    return sendFrame(FRAME_INFO, p, 10);
+  }
+  put16(p, burstNo);
+  put32(p + 2, tTrigger);
+  put16(p + 6, pre);
+  put16(p + 8, BURST_POST_SAMPLES);
+  p[10] = source;
+  p[11] = LOADCELL_COUNT;
+  return sendFrame(FRAME_BURST, p, 12);
+}
+
+// Up to n conversions off the front of the ring as one FRAME_SAMPLES.  A frame only spans
+// gaps that fit its 16-bit deltas, so at 10Hz it may take fewer.  Returns how many it took.
+static uint8_t sendSamples(uint8_t n)
+{
+  uint8_t p[6 + FRAME_MAX_SAMPLES * FRAME_SAMPLE_BYTES], *s = p + 6;
+  uint8_t c, idx, flags, taken;
+  uint32_t tLast = ring[first].t, dt;
+
+  for (taken = 0; taken < n; taken++)
+  {
+    idx = (first + taken) % BURST_RING;
+    dt = ring[idx].t - tLast;
+    if (dt > 0xFFFF)
+    {
+      break;
+    }
+    tLast = ring[idx].t;
+    for (c = 0; c < LOADCELL_COUNT; c++, s += FRAME_SAMPLE_BYTES)
+    {
+      const uint8_t *count = ring[idx].count[c];
+      put16(s, c ? 0 : dt);
+      memcpy(s + 2, count, 3);
+      flags = ring[idx].flags | (c << SAMPLE_CHANNEL_SHIFT);
+      if ((count[2] == 0x7F && count[1] == 0xFF && count[0] == 0xFF) || (count[2] == 0x80 && !count[1] && !count[0]))
+      {
+        flags |= SAMPLE_SATURATED;
+      }
+      s[5] = flags;
+    }
+  }
+  put16(p, seq);
+  put32(p + 2, ring[first].t);
+  if (!sendFrame(FRAME_SAMPLES, p, s - p))
+  {
+    return 0;
+  }
+  seq += taken * LOADCELL_COUNT;
+  burstStats.samples += taken;
+  return taken;
+}
+
+// Which sources fire on this sample, if armed.  Re-arms once every source has dropped back.
+static uint8_t trigger(force_t f, uint32_t t)
+{
+  uint8_t active = 0;
+  boolean clear = true;
+
+#if BURST_LEVEL_GRAMS
+  if (f >= GRAMS(BURST_LEVEL_GRAMS))
+  {
+    active |= BURST_BY_LEVEL;
+  }
+  clear = clear && f < GRAMS(BURST_LEVEL_GRAMS) / 2;
+#endif
+#if BURST_SLOPE
+  // Force units per second, as force * 1e6 against us
+  if (slopeFilled == SLOPE_SAMPLES)
+  {
+    int64_t rise = (int64_t)(f - slopeY[slopeNext]) * 1000000L;
+    int64_t dt = t - slopeT[slopeNext];
+    if (rise >= (int64_t)GRAMS(BURST_SLOPE) * dt)
+    {
+      active |= BURST_BY_SLOPE;
+    }
+    clear = clear && rise < (int64_t)GRAMS(BURST_SLOPE) / 2 * dt;
+  }
+  else
+  {
+    slopeFilled++;
+  }
+  slopeY[slopeNext] = f;
+  slopeT[slopeNext] = t;
+  slopeNext = (slopeNext + 1) % SLOPE_SAMPLES;
+#else
+  (void)t; // Only the slope needs the time
+#endif
+#ifdef BURST_PIN
+  if (digitalRead(BURST_PIN) == BURST_PIN_LEVEL)
+  {
+    active |= BURST_BY_PIN;
+    clear = false;
+  }
+#endif
+
+  if (armed && active)
+  {
+    armed = false;
+    return active;
+  }
+  armed = armed || clear;
+  return 0;
+}
+
+void burstBegin()
+{
+#ifdef BURST_PIN
+  pinMode(BURST_PIN, INPUT_PULLUP);
+#endif
+  burstReset();
+}
+
+void burstFeed(const RawSample &s, force_t f)
+{
+  uint8_t fired = trigger(labs(f) < GRAMS(OUTLIER_GRAMS) ? f : 0, (uint32_t)s.t);
+  uint8_t c, idx;
+
+  if (sending && !postLeft)
+  {
+    return; // Still sending the burst: the history starts again after it
+  }
+  if (held == BURST_RING)
+  {
+    // Only while sending: the host has stopped reading
+    postLeft = 0;
+    burstStats.truncated++;
+    return;
+  }
+  if (!sending && held > BURST_PRE_SAMPLES)
+  {
+    first = (first + 1) % BURST_RING; // Too old to go in a burst
+    held--;
+  }
+
+  idx = (first + held++) % BURST_RING;
+  ring[idx].t = s.t;
+  ring[idx].flags = 0;
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    ring[idx].count[c][0] = s.count[c];
+    ring[idx].count[c][1] = s.count[c] >> 8;
+    ring[idx].count[c][2] = s.count[c] >> 16;
+  }
+
+  if (sending)
+  {
+    postLeft--;
+  }
+  else if (fired)
+  {
+    ring[idx].flags = SAMPLE_TRIGGER;
+    sending = true;
+    preambleSent = 0;
+    source = fired;
+    pre = held - 1;
+    postLeft = BURST_POST_SAMPLES - 1; // The trigger sample is the first of them
+    tTrigger = s.t;
+    burstNo++;
+    burstStats.bursts++;
+  }
+}
+
+void burstPoll()
+{
+  uint8_t n;
+
+  while (sending)
+  {
+    if (preambleSent <= LOADCELL_COUNT)
+    {
+      if (!sendPreamble(preambleSent))
+      {
+        return;
+      }
+      preambleSent++;
+      continue;
+    }
+
+    // Whole frames while the capture goes on, then whatever is left
+    n = held < CONVERSIONS_PER_FRAME ? held : CONVERSIONS_PER_FRAME;
+    if (n < CONVERSIONS_PER_FRAME && postLeft)
+    {
+      return;
+    }
+    if (n && !(n = sendSamples(n)))
+    {
+      return;
+    }
+    first = (first + n) % BURST_RING;
+    held -= n;
+    if (!held && !postLeft)
+    {
+      sending = false;
+    }
+  }
+}
+
+void burstReset()
+{
+  first = held = 0;
+  sending = false;
+  armed = true;
+#if BURST_SLOPE
+  slopeFilled = 0;
+#endif
+}
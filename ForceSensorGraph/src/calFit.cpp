@@ -0,0 +1,161 @@
+#include <math.h>
+#include "calFit.h"
+
+bool CalFit::add(float grams, uint8_t n, int64_t sum, int64_t sumSq)
+{
+  float mean, m2, delta;
+  Point *p;
+
+  if (!n)
+  {
+    return true;
+  }
+  // The window's own spread, exact: n sum(v^2) - sum(v)^2 fits 63 bits for these limits
+  mean = (float)sum / n;
+  m2 = (float)(n * sumSq - sum * sum) / n;
+  if (points && point[points - 1].grams == grams)
+  {
+    // Merge it with the point so far (Chan et al.'s pairwise update)
+    p = &point[points - 1];
+    delta = mean - p->mean;
+    p->mean += delta * n / (p->n + n);
+    p->m2 += m2 + delta * delta * p->n * n / (p->n + n);
+    p->n += n;
+    return true;
+  }
+  if (points == CAL_MAX_POINTS)
+  {
+    return false;
+  }
+  p = &point[points++];
+  p->grams = grams;
+  p->n = n;
+  p->mean = mean;
+  p->m2 = m2;
+  return true;
+}
+
+uint8_t CalFit::distinctMasses() const
+{
+  uint8_t i, j, distinct = 0;
+
+  for (i = 0; i < points; i++)
+  {
+    for (j = 0; j < i && point[j].grams != point[i].grams; j++)
+      ;
+    distinct += j == i;
+  }
+  return distinct;
+}
+
+// Weighted least squares through the point means, counts = offset + scale*g (+ curve*g^2),
+// or counts = scale*g through the tare with a single mass.  The normal equations are at most
+// 3x3, so they are inverted outright: the diagonal of the inverse gives the parameter
+// variances.  Masses are in kg inside, to keep the matrix well conditioned in floats.
+bool CalFit::solve(bool quadratic, CalResult &r) const
+{
+  uint8_t distinct = distinctMasses(), np, i, j, k, piv;
+  bool intercept = distinct >= 2;
+  float a[3][3] = {}, inv[3][3] = {}, rhs[3] = {}, theta[3] = {}, phi[3], x, t, e, sse = 0;
+  uint32_t n = 0;
+
+  quadratic = quadratic && distinct >= 3;
+  np = intercept ? (quadratic ? 3 : 2) : 1;
+  for (i = 0; i < points; i++)
+  {
+    n += point[i].n;
+  }
+  if (!distinct || n <= np)
+  {
+    return false;
+  }
+
+  // Basis: [1, x, x^2] or [x]
+  for (k = 0; k < points; k++)
+  {
+    x = point[k].grams / 1000;
+    phi[0] = intercept ? 1 : x;
+    phi[1] = x;
+    phi[2] = x * x;
+    for (i = 0; i < np; i++)
+    {
+      for (j = 0; j < np; j++)
+      {
+        a[i][j] += point[k].n * phi[i] * phi[j];
+      }
+      rhs[i] += point[k].n * phi[i] * point[k].mean;
+    }
+  }
+
+  // Gauss-Jordan with partial pivoting
+  for (i = 0; i < np; i++)
+  {
+    inv[i][i] = 1;
+  }
+  for (i = 0; i < np; i++)
+  {
+    for (piv = i, j = i + 1; j < np; j++)
+    {
+      if (fabs(a[j][i]) > fabs(a[piv][i]))
+      {
+        piv = j;
+      }
+    }
+    if (a[piv][i] == 0)
+    {
+      return false;
+    }
+    for (j = 0; j < np; j++)
+    {
+      t = a[i][j], a[i][j] = a[piv][j], a[piv][j] = t;
+      t = inv[i][j], inv[i][j] = inv[piv][j], inv[piv][j] = t;
+    }
+    t = a[i][i];
+    for (j = 0; j < np; j++)
+    {
+      a[i][j] /= t;
+      inv[i][j] /= t;
+    }
+    for (k = 0; k < np; k++)
+    {
+      if (k != i)
+      {
+        t = a[k][i];
+        for (j = 0; j < np; j++)
+        {
+          a[k][j] -= t * a[i][j];
+          inv[k][j] -= t * inv[i][j];
+        }
+      }
+    }
+  }
+  for (i = 0; i < np; i++)
+  {
+    for (j = 0; j < np; j++)
+    {
+      theta[i] += inv[i][j] * rhs[j];
+    }
+  }
+
+  // Residuals: the spread within each point, and each mean's distance from the curve
+  for (k = 0; k < points; k++)
+  {
+    x = point[k].grams / 1000;
+    e = point[k].mean - (intercept ? theta[0] + theta[1] * x + theta[2] * x * x : theta[0] * x);
+    sse += point[k].m2 + point[k].n * e * e;
+  }
+
+  k = intercept ? 1 : 0; // Which parameter is the scale
+  r.scale = theta[k] / 1000;
+  r.offset = intercept ? theta[0] : 0;
+  r.curve = quadratic ? theta[2] / 1e6 : 0;
+  r.samples = n;
+  if (r.scale <= 0)
+  {
+    return false;
+  }
+  t = sse / (n - np); // Residual variance
+  r.rmsGrams = sqrt(t) / r.scale;
+  r.scaleCi = 1.96 * sqrt(t * inv[k][k]) / theta[k] * 100;
+  return true;
+}
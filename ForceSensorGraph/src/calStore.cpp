@@ -0,0 +1,173 @@
+#include <Arduino.h>
+#include <stddef.h>
+#include <EEPROM.h>
+#include <TFT_Charts.h>
+#include "setup.h"
+#include "calStore.h"
+#if defined(__AVR__)
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#endif
+
+#define NO_PROFILE 0xFF // CAL_PROFILE only goes to 254
+
+static_assert(CAL_PROFILE != NO_PROFILE, "CAL_PROFILE must be 0-254");
+static_assert(CAL_STORE_SLOTS >= 2, "The store needs a spare slot to write into");
+static_assert(CAL_STORE_ADDR + CAL_STORE_SLOTS * sizeof(CalRecord) <= E2END + 1, "The store doesn't fit the EEPROM");
+
+// The save being written out: the record, where it goes, and how many bytes are done
+static CalRecord pending;
+static uint16_t pendingAddr;
+static uint8_t pendingDone = sizeof(CalRecord);
+
+static uint16_t crc16(const uint8_t *p, uint8_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (len--)
+  {
+#if defined(__AVR__)
+    crc = _crc_xmodem_update(crc, *p++);
+#else
+    crc ^= (uint16_t)*p++ << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+#endif
+  }
+  return crc;
+}
+
+static uint16_t slotAddr(uint8_t slot)
+{
+  return CAL_STORE_ADDR + slot * sizeof(CalRecord);
+}
+
+// Read a slot, true if it holds a whole record of this version
+static bool readSlot(uint8_t slot, CalRecord &r)
+{
+  uint8_t *p = (uint8_t *)&r;
+  uint16_t addr = slotAddr(slot);
+  uint8_t i;
+
+  for (i = 0; i < sizeof(CalRecord); i++)
+  {
+    p[i] = EEPROM.read(addr + i);
+  }
+  return r.version == CAL_RECORD_VERSION && r.crc == crc16(p, offsetof(CalRecord, crc));
+}
+
+// A slot's seq, straight from the EEPROM, for a slot readSlot() has passed
+static uint16_t slotSeq(uint8_t slot)
+{
+  uint16_t addr = slotAddr(slot) + offsetof(CalRecord, seq);
+
+  return EEPROM.read(addr) | (uint16_t)EEPROM.read(addr + 1) << 8;
+}
+
+// Sequence numbers wrap, a is newer if it is less than half the range ahead of b
+static bool newer(uint16_t a, uint16_t b)
+{
+  return (int16_t)(a - b) > 0;
+}
+
+// The newest record saved under this profile
+bool calStoreLoad(uint8_t profile, CalRecord &r)
+{
+  CalRecord slot;
+  bool found = false;
+  uint8_t s;
+
+  for (s = 0; s < CAL_STORE_SLOTS; s++)
+  {
+    if (readSlot(s, slot) && slot.profile == profile && (!found || newer(slot.seq, r.seq)))
+    {
+      r = slot;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// Queue r (version, seq and crc are filled in) to go in the slot after the newest record,
+// skipping over any profile's newest record, the one being replaced included.  A save that
+// was still being written is abandoned in favour of this one.  False if every slot is in use.
+// Runs deep in the calibration's call chain, so only the profiles are kept on the stack
+// (NO_PROFILE for a slot without a valid record), and the seqs are read again as needed.
+bool calStoreSave(CalRecord &r)
+{
+  CalRecord slot;
+  bool live, any = false;
+  uint8_t profile[CAL_STORE_SLOTS];
+  uint16_t seq, maxSeq = 0;
+  uint8_t s, t, newest = CAL_STORE_SLOTS - 1, tries;
+
+  for (s = 0; s < CAL_STORE_SLOTS; s++)
+  {
+    profile[s] = readSlot(s, slot) ? slot.profile : NO_PROFILE;
+    if (profile[s] != NO_PROFILE && (!any || newer(slot.seq, maxSeq)))
+    {
+      maxSeq = slot.seq;
+      newest = s;
+      any = true;
+    }
+  }
+
+  for (s = newest, tries = 0; tries < CAL_STORE_SLOTS; tries++)
+  {
+    s = s + 1 < CAL_STORE_SLOTS ? s + 1 : 0;
+    live = profile[s] != NO_PROFILE;
+    seq = live ? slotSeq(s) : 0;
+    for (t = 0; live && t < CAL_STORE_SLOTS; t++)
+    {
+      live = !(profile[t] == profile[s] && t != s && newer(slotSeq(t), seq));
+    }
+    if (!live)
+    {
+      break;
+    }
+  }
+  if (tries == CAL_STORE_SLOTS)
+  {
+    return false;
+  }
+
+  r.version = CAL_RECORD_VERSION;
+  r.seq = maxSeq + 1;
+  r.reserved = 0;
+  r.crc = crc16((const uint8_t *)&r, offsetof(CalRecord, crc));
+  pending = r;
+  pendingAddr = slotAddr(s);
+  pendingDone = 0;
+  return true;
+}
+
+// Write out the next byte of a save, if the EEPROM has finished the last one.  Bytes that
+// are already right are skipped without a write.
+void calStorePoll()
+{
+  const uint8_t *p = (const uint8_t *)&pending;
+
+  while (pendingDone < sizeof(CalRecord))
+  {
+#if defined(__AVR__)
+    if (!eeprom_is_ready())
+    {
+      return;
+    }
+#endif
+    if (EEPROM.read(pendingAddr + pendingDone) != p[pendingDone])
+    {
+      EEPROM.write(pendingAddr + pendingDone, p[pendingDone]);
+      pendingDone++;
+      return;
+    }
+    pendingDone++;
+  }
+}
+
+bool calStoreBusy()
+{
+  return pendingDone < sizeof(CalRecord);
+}
@@ -2,13 +2,69 @@
 #include <TFT_ILI9341.h>
 #include <cppQueue.h>
 #include "setup.h"
+#include "windowMinMax.h"
+#include "plotRenderer.h"
+#include "legendLine.h"
+#include "textFormat.h"
 
 extern cppQueue fQ;
 extern ChartXY xyChart;
 extern TFT_ILI9341 tft;
 
+#define INIT_Y_TICK 25 // The Y axis starts at -100 to 100 g, a label every this many
+
+// Running min of the lows and max of the highs in fQ, kept in step by queuePush()/queuePop()
+WindowMinMax<QUEUE_LENGTH, uint8_t, force_t> fWindow;
+
+// The span being filled, and how many DATA_INTERVALs it holds so far
+static ForceSpan openSpan;
+static uint8_t openIntervals = 0;
+
+// The trace itself, drawn at the full sample rate
+PlotRenderer plot;
+
+// Live legend with current/min/max/mean values, top right
+static LegendLine legendCurr(230, 0, YELLOW), legendMax(230, 10, RED), legendMean(230, 20, GREEN),
+    legendMin(230, 30, BLUE);
+
+// Statistics since the tare and the last peel, under the title
+static LegendLine legendSd(0, 22, WHITE), legendPeak(115, 22, MAGENTA), legendImpulse(115, 32, MAGENTA);
+#ifdef STATS_PERCENTILES
+static LegendLine legendPercentile(0, 32, WHITE);
+#endif
+
+static void invalidateLegend()
+{
+  legendCurr.invalidate();
+  legendMax.invalidate();
+  legendMean.invalidate();
+  legendMin.invalidate();
+  legendSd.invalidate();
+#ifdef STATS_PERCENTILES
+  legendPercentile.invalidate();
+#endif
+  legendPeak.invalidate();
+  legendImpulse.invalidate();
+}
+
+static force_t queueLo(uint16_t idx)
+{
+  ForceSpan p;
+  fQ.peekIdx(&p, idx);
+  return p.lo;
+}
+
+static force_t queueHi(uint16_t idx)
+{
+  ForceSpan p;
+  fQ.peekIdx(&p, idx);
+  return p.hi;
+}
+
 void initChart()
 {
+  uint8_t piece;
+
   // Initialize the screen
   tft.begin();
   xyChart.begin(tft);
@@ -19,128 +75,256 @@ void initChart()
 #endif
 
   tft.fillScreen(xyChart.tftBGColor);
-  xyChart.setAxisLimitsX(0, XRANGE, XTICKTIME);
-  xyChart.setAxisLimitsY(-100, 100, 25);
-  xyChart.drawTitleChart(tft, "Z-Axis Force");
-  xyChart.drawAxisX(tft, 10);
-  xyChart.drawAxisY(tft, 10);
-  xyChart.drawLabelsX(tft);
-  xyChart.drawLabelsY(tft);
-  xyChart.drawY0(tft);
-  delay(400); // Let noise settle
-
-  if (DEBUG == 2)
+  for (piece = 0; initChartStep(piece); piece++)
   {
-    xyChart.tftInfo();
   }
+}
 
-  // Flush the queue if there is already data there
-  if (fQ.nbRecs())
+// Draw the chart on a clear screen, and start it afresh, a piece a call: piece 0, 1, ... until
+// it returns false.  After a calibration it goes up like this, a piece per control task run,
+// so the samples are not held up.
+boolean initChartStep(uint8_t piece)
+{
+  char title[13];
+
+  switch (piece)
   {
+  case 0:
+    xyChart.setAxisLimitsX(0, XRANGE, XTICKTIME);
+    xyChart.setAxisLimitsY(-100, 100, INIT_Y_TICK);
+    strcpy_P(title, PSTR("Z-Axis Force")); // ChartXY takes it from RAM, but only for the call
+    xyChart.drawTitleChart(tft, title);
+    xyChart.drawAxisX(tft, 0); // Just the line: the ticks move with the trace, and plot draws them
+    xyChart.drawAxisY(tft, 10);
     if (DEBUG == 2)
     {
-      Serial.println("Flushing the queue...");
+      xyChart.tftInfo();
+    }
+    return (true);
+
+  case 1:
+    plot.drawLabelsY(tft, xyChart, INIT_Y_TICK); // ChartXY's would clear under them first
+    return (true);
+
+  case 2:
+    // Flush the queue if there is already data there
+    if (fQ.nbRecs())
+    {
+      if (DEBUG == 2)
+      {
+        Serial.println(F("Flushing the queue..."));
+      }
+      fQ.flush();
     }
-    fQ.flush();
+    fWindow.clear();
+    openIntervals = 0;
+    plot.reset(tft, xyChart, 0); // And the X ticks, X labels and Y=0 line
+    invalidateLegend();
+
+    // Seed the queue with the origin
+    ForceSpan p;
+    p.lo = p.hi = 0;
+    queuePush(p);
+    return (true);
   }
+  return (false);
+}
 
-  // Seed the queue with the origin coords
-  ChartXY::point p;
-  p.x = 0.;
-  p.y = 0.;
-  fQ.push(&p);
+// Add a span to the chart queue, tracking the window min/max
+boolean queuePush(ForceSpan &p)
+{
+  if (!fQ.push(&p))
+  {
+    return (false);
+  }
+  fWindow.push(p.lo, p.hi, queueLo, queueHi);
+  return (true);
 }
 
-ChartXY::point getMinMax()
+// Drop the oldest span from the chart queue
+boolean queuePop(ForceSpan &p)
 {
-  int i;
-  float min, max;
-  ChartXY::point p;
+  if (!fQ.pop(&p))
+  {
+    return (false);
+  }
+  fWindow.pop(queueLo, queueHi);
+  return (true);
+}
 
-  // Initialize fmin, fMax with the first y-value on the queue
-  fQ.peekIdx(&p, 0);
-  min = p.y;
-  max = p.y;
+// Add a DATA_INTERVAL's min/max to the window.  They are folded together into the newest
+// span, which goes on the queue once it holds QUEUE_INTERVALS of them, the oldest dropping
+// off when it is full.  Until then the span counts in the window's min/max as it stands.
+void queueInterval(const ForceSpan &p)
+{
+  ForceSpan oldest;
 
-  for (i = 1; i <= QUEUE_LENGTH; i++)
+  if (!openIntervals)
   {
-    fQ.peekIdx(&p, i);
-    if (p.y < min)
-    {
-      min = p.y;
-    }
-    if (p.y > max)
-    {
-      max = p.y;
-    }
+    openSpan = p;
+  }
+  openSpan.lo = p.lo < openSpan.lo ? p.lo : openSpan.lo;
+  openSpan.hi = p.hi > openSpan.hi ? p.hi : openSpan.hi;
+  if (++openIntervals < QUEUE_INTERVALS)
+  {
+    return;
+  }
+  if (fQ.isFull())
+  {
+    queuePop(oldest);
   }
-  p.x = min; // Return min as the x-coord of this "point"
-  p.y = max; // Return max as the y-coord of this "point"
+  queuePush(openSpan);
+  openIntervals = 0;
+}
+
+// The window's min and max: the queue's, and the span still being filled
+static force_t windowMin()
+{
+  return openIntervals && openSpan.lo < fWindow.min() ? openSpan.lo : fWindow.min();
+}
+
+static force_t windowMax()
+{
+  return openIntervals && openSpan.hi > fWindow.max() ? openSpan.hi : fWindow.max();
+}
+
+// Redraw whatever changed in the legend: the latest force and mean, and the window max/min.
+// Returns the number of characters drawn.
+uint8_t updateLegend(force_t curr, force_t mean)
+{
+  char value[FORCE_TEXT_LEN];
+  uint8_t n;
+
+  n = legendCurr.draw(tft, xyChart.tftBGColor, F("Curr:"), formatForce(value, curr, 1));
+  n += legendMax.draw(tft, xyChart.tftBGColor, F(" Max:"), formatForce(value, windowMax(), 1));
+  n += legendMean.draw(tft, xyChart.tftBGColor, F("Mean:"), formatForce(value, mean, 1));
+  n += legendMin.draw(tft, xyChart.tftBGColor, F(" Min:"), formatForce(value, windowMin(), 1));
+  return n;
+}
+
+// The spread of the force since the tare, and the last peel's peak and impulse (g s), 0
+// before the first
+void updateStatsLegend(force_t sd, force_t peak, force_t impulse)
+{
+  char value[FORCE_TEXT_LEN];
+
+  legendSd.draw(tft, xyChart.tftBGColor, F("   SD:"), formatForce(value, sd, 2));
+  legendPeak.draw(tft, xyChart.tftBGColor, F(" Peak:"), formatForce(value, peak, 1));
+  legendImpulse.draw(tft, xyChart.tftBGColor, F("  Imp:"), formatForce(value, impulse, 1));
+}
+
+#ifdef STATS_PERCENTILES
+// A percentile of the force since the tare, under the spread
+void updatePercentileLegend(uint8_t percent, force_t percentile)
+{
+  char rank[3 + FORCE_TEXT_LEN];
+
+  rank[0] = '0' + percent / 10; // "  P" then "95:", and the value
+  rank[1] = '0' + percent % 10;
+  rank[2] = ':';
+  formatForce(rank + 3, percentile, 1);
+  legendPercentile.draw(tft, xyChart.tftBGColor, F("  P"), rank);
+}
+#endif
+
+// Window min/max in grams, for autoscaling
+ChartXY::point getMinMax()
+{
+  ChartXY::point p;
+
+  p.x = forceToGrams(windowMin()); // Return min as the x-coord of this "point"
+  p.y = forceToGrams(windowMax()); // Return max as the y-coord of this "point"
   return (p);
 }
 
-boolean scaleY(float yMin, float yMax, String reason)
+// Change the Y limits without clearing the screen: only the Y labels and ticks are redrawn,
+// and the trace is re-projected a column at a time, pushing just the rows that change.  The
+// plot task does that over its next few runs (PlotRenderer::step()), so signal it.
+boolean scaleY(float yMin, float yMax, float tick, const __FlashStringHelper *reason)
 {
+  float oldMin = xyChart.yMin, oldMax = xyChart.yMax;
 
   if (DEBUG == 2)
   {
     Serial.println(reason);
-    Serial.println("Current Y limits: " + String(xyChart.yMin) + ", " + String(xyChart.yMax));
-    Serial.println("Scaling Y to range " + String(yMin) + ", " + String(yMax));
+    Serial.print(F("Current Y limits: "));
+    Serial.print(xyChart.yMin);
+    Serial.print(F(", "));
+    Serial.println(xyChart.yMax);
+    Serial.print(F("Scaling Y to range "));
+    Serial.print(yMin);
+    Serial.print(F(", "));
+    Serial.println(yMax);
   }
-  tft.fillScreen(xyChart.tftBGColor);
-  xyChart.setAxisLimitsY(yMin, yMax, (yMax - yMin) / 8);
-  xyChart.drawAxisY(tft, 10);
-  xyChart.drawLabelsY(tft);
-  xyChart.drawAxisX(tft, 10);
-  xyChart.drawLabelsX(tft);
-  xyChart.drawY0(tft);
-  xyChart.drawTitleChart(tft, "Load Cell A");
+  xyChart.setAxisLimitsY(yMin, yMax, tick);
+  plot.rescaleY(tft, xyChart, oldMin, oldMax, tick);
   return (true);
 }
 
-// Scale the Y axis if needed
+// 1, 2 or 5 times a power of ten, at least x
+static float niceStep(float x)
+{
+  float p = pow(10, floor(log10(x)));
+
+  x /= p;
+  return (x <= 1 ? 1 : x <= 2 ? 2 : x <= 5 ? 5 : 10) * p;
+}
+
+// Scale the Y axis if needed.  The limits are picked so the window's data fills about
+// AUTOSCALE_FILL_PERCENT of the axis, centred and snapped to ticks of 1, 2 or 5 times a power
+// of ten - so a trace that only wanders a little lands on the same limits, and nothing is
+// redrawn.  Between rescales there is hysteresis: the axis only moves for a trace that has
+// come within AUTOSCALE_MARGIN_PERCENT of an edge, or to zoom in by two or more.  Once it
+// has moved, it is left alone for AUTOSCALE_HOLD_MS unless the trace is off the plot.
 boolean autoScale(ChartXY::point mm, ChartXY::point p)
 {
-  float fMin = mm.x;
-  float fMax = mm.y;
-  float expandFactor = 7;  // Determines the default Y range in relation to the current min/max values when expanding limits
-  float limitFactor = 0.1; // Determines the additional Y range added to the current min/max values when expanding limits
-  boolean scaled = false;
+  static uint32_t lastScaleMs = 0;
+  float lo = p.y < mm.x ? p.y : mm.x, hi = p.y > mm.y ? p.y : mm.y;
+  float range = xyChart.yMax - xyChart.yMin, margin = range * AUTOSCALE_MARGIN_PERCENT / 100;
+  float span = (hi - lo > AUTOSCALE_MIN_GRAMS ? hi - lo : AUTOSCALE_MIN_GRAMS) * 100 / AUTOSCALE_FILL_PERCENT;
+  float tick = niceStep(span / 8); // About 8 ticks
+  float yMin = floor(((lo + hi) / 2 - span / 2) / tick) * tick;
+  float yMax = ceil(((lo + hi) / 2 + span / 2) / tick) * tick;
+  const __FlashStringHelper *reason;
 
   if (DEBUG == 2)
   {
-    Serial.println("\nCheck limits: Current Y value is " + String(p.y));
-    Serial.println("fMin = " + String(fMin) + ", fMax = " + String(fMax));
+    Serial.print(F("\nCheck limits: Current Y value is "));
+    Serial.println(p.y);
+    Serial.print(F("fMin = "));
+    Serial.print(mm.x);
+    Serial.print(F(", fMax = "));
+    Serial.println(mm.y);
   }
 
-  if (p.y < xyChart.yMin)
+  if (lo < xyChart.yMin || hi > xyChart.yMax)
+  {
+    reason = F("Trace off the plot");
+  }
+  else if ((uint32_t)(millis() - lastScaleMs) < AUTOSCALE_HOLD_MS)
   {
-    scaled = scaleY(p.y - (limitFactor * fabs(p.y)), xyChart.yMax, "New Y value less than yMin");
-    xyChart.drawTitleChart(tft, "Z-Axis Force");
+    return (false);
   }
-  else if (p.y > xyChart.yMax)
+  else if (lo < xyChart.yMin + margin || hi > xyChart.yMax - margin)
   {
-    scaled = scaleY(xyChart.yMin, p.y + (limitFactor * fabs(p.y)), "New Y value more than yMax");
-    xyChart.drawTitleChart(tft, "Z-Axis Force");
+    reason = F("Trace near the edge");
   }
-  // Expansion heuristic (make the data fill at least 1/expandFract of the y range )
-  else if ((xyChart.yMax - xyChart.yMin) > (expandFactor * (fMax - fMin)))
+  else if (2 * (yMax - yMin) <= range)
   {
-    float yRange = fMax - fMin;
-    float yMid = fMin + (yRange / 2);
-    float yLimit = yRange * (expandFactor - 2) / 2;
-    scaled = scaleY(yMid - yLimit, yMid + yLimit, "Y limits too large relative to Y range");
-    xyChart.drawTitleChart(tft, "Z-Axis Force");
+    reason = F("Y limits too large relative to Y range");
   }
-  // Centering heuristic (keep y range centered to within 40% of the y limits)
-  else if (fabs((xyChart.yMax - fMax) - (fMin - xyChart.yMin)) > fabs(0.4 * (fMax - fMin)))
+  else
   {
-    float yRange = fMax - fMin;
-    float yMid = fMin + (yRange / 2);
-    float yLimit = (xyChart.yMax - xyChart.yMin);
-    scaled = scaleY(yMid - (yLimit / 2), yMid + (yLimit / 2), "Y range not centered");
-    xyChart.drawTitleChart(tft, "Z-Axis Force");
+    return (false);
   }
-  return (scaled);
-}
\ No newline at end of file
+  if (yMin == xyChart.yMin && yMax == xyChart.yMax)
+  {
+    return (false);
+  }
+  if (plot.busy())
+  {
+    return (false); // Scrolling, or still re-projecting the last rescale: next interval
+  }
+  lastScaleMs = millis();
+  return (scaleY(yMin, yMax, tick, reason));
+}
@@ -0,0 +1,47 @@
+#include <Arduino.h>
+#include "freeRam.h"
+
+#if defined(__AVR__)
+#define RAM_PAINT 0xA5
+#define PAINT_MARGIN 16 // Below the stack pointer, for ramPaint()'s own frame
+
+extern char __heap_start;
+extern char *__brkval;
+
+// The heap's top, from the free RAM's side: malloc() moves it up into the paint
+static uint8_t *heapEnd()
+{
+  return (uint8_t *)(__brkval ? __brkval : &__heap_start);
+}
+
+void ramPaint()
+{
+  uint8_t *p = heapEnd(), *end = (uint8_t *)SP - PAINT_MARGIN;
+
+  while (p < end)
+  {
+    *p++ = RAM_PAINT;
+  }
+}
+
+uint16_t ramUntouched()
+{
+  const uint8_t *p = heapEnd();
+  uint16_t n = 0;
+
+  while (*p++ == RAM_PAINT)
+  {
+    n++;
+  }
+  return n;
+}
+#else
+void ramPaint()
+{
+}
+
+uint16_t ramUntouched()
+{
+  return 0;
+}
+#endif
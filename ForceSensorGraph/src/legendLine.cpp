@@ -0,0 +1,35 @@
+#include <Arduino.h>
+#include <string.h>
+#include "legendLine.h"
+
+uint8_t LegendLine::draw(TFT_ILI9341 &tft, uint16_t bg, const __FlashStringHelper *label, const char *value)
+{
+  const char *l = reinterpret_cast<const char *>(label);
+  uint8_t i, n = 0;
+  char c;
+
+  for (i = 0; i < LEGEND_CHARS; i++)
+  {
+    c = pgm_read_byte(l);
+    if (c)
+    {
+      l++;
+    }
+    else
+    {
+      c = *value ? *value++ : ' ';
+    }
+    if (c != shown[i])
+    {
+      tft.drawChar(x + 6 * i, y, c, color, bg, 1);
+      shown[i] = c;
+      n++;
+    }
+  }
+  return n;
+}
+
+void LegendLine::invalidate()
+{
+  memset(shown, 0, sizeof(shown));
+}
@@ -1,12 +1,14 @@
 #include <Arduino.h>
-#include <HX711.h>
 #include <EEPROM.h>
 #include <OneButton.h>
 #include <TFT_ILI9341.h>
 #include <TFT_Charts.h>
 #include "setup.h"
+#include "loadCell.h"
+#include "calFit.h"
+#include "calStore.h"
 
-// Global variables to accumulate all-time (between tares) mean force, and handle button state
+// Button state
 boolean taring = false;      // Taring button activated?
 boolean calibrating = false; // Calibration button activated?
 boolean done;                // Done calibrating?
@@ -14,10 +16,189 @@ boolean done;                // Done calibrating?
 // External globals for the chart object
 extern TFT_ILI9341 tft;
 extern ChartXY xyChart;
-extern float fMean, allTimeSum, allTimeSamples, t_offset;
 
 OneButton tareButton(TARE_PIN, INPUT); // OneButton constructor | the button is pulled down by default
-HX711 hx711;                           // HX711 constructor
+
+long cellOffset[LOADCELL_COUNT];
+int32_t cellGain[LOADCELL_COUNT];
+int32_t cellCurve;
+static float cellScale; // As last set, for the store
+
+static const float calMasses[] = CAL_MASSES;
+static const uint8_t CAL_POINTS = sizeof(calMasses) / sizeof(calMasses[0]);
+static_assert(CAL_POINTS <= CAL_MAX_POINTS, "Too many CAL_MASSES");
+
+// Average the next `times` samples from the acquisition ring into mean[], per channel.
+// Anything already queued may be stale (we were probably just sitting in a delay), so it
+// is thrown away first.  False if they don't come in twice the time they should (a cell
+// unplugged or powered down), leaving mean[] alone.
+static boolean meanCounts(uint8_t times, float *mean)
+{
+    RawSample s;
+    float sum[LOADCELL_COUNT];
+    uint32_t start = millis(), timeout = 2000UL * times / HX711_RATE_HZ + 100;
+    uint8_t n = 0, c;
+
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        sum[c] = 0;
+    }
+    acqFlush();
+    while (n < times)
+    {
+        if (millis() - start > timeout)
+        {
+            return false;
+        }
+        acqPoll(); // No-op unless a DOUT is on a non-interrupt pin
+        if (!acqRead(s))
+        {
+            delay(1); // Nothing yet: the ring keeps whatever comes meanwhile
+        }
+        else if (s.input == ACQ_A128)
+        {
+            for (c = 0; c < LOADCELL_COUNT; c++)
+            {
+                sum[c] += s.count[c];
+            }
+            n++;
+        }
+    }
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        mean[c] = sum[c] / times;
+    }
+    return true;
+}
+
+// Zero every channel on the average of `times` samples.  False, with the offsets as they
+// were, if the samples never came.
+boolean tareCells(uint8_t times)
+{
+    float mean[LOADCELL_COUNT];
+    uint8_t c;
+
+    if (!meanCounts(times, mean))
+    {
+        return false;
+    }
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        cellOffset[c] = lround(mean[c]);
+    }
+    return true;
+}
+
+// Scale in counts per gram, as calibrated.  The one float division happens here, not per sample.
+void setCellScales(float scale)
+{
+    int32_t gain;
+    uint8_t c;
+
+    if (!(scale > 0))
+    {
+        return; // Nothing to divide by (an unset calibration)
+    }
+    gain = lround(FORCE_PER_GRAM * (float)(1L << FORCE_GAIN_SHIFT) / scale);
+    cellScale = scale;
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        cellGain[c] = gain;
+    }
+}
+
+// Save the offsets, scale and linearity correction under CAL_PROFILE, to be restored at
+// the next power-up.  The EEPROM is written from calStorePoll().
+void saveCells()
+{
+    CalRecord r;
+    uint8_t c;
+
+    r.profile = CAL_PROFILE;
+    r.scale = cellScale;
+    r.curve = cellCurve;
+    r.cells = LOADCELL_COUNT;
+    for (c = 0; c < CAL_RECORD_CELLS; c++)
+    {
+        r.offset[c] = c < LOADCELL_COUNT ? cellOffset[c] : 0;
+    }
+    if (!calStoreSave(r) && DEBUG)
+    {
+        Serial.println(F("Calibration store full, not saved"));
+    }
+}
+
+// Take the offsets, scale and linearity correction saved under CAL_PROFILE, false if there
+// are none (for this many cells)
+boolean restoreCells()
+{
+    CalRecord r;
+    uint8_t c;
+
+    if (!calStoreLoad(CAL_PROFILE, r) || r.cells != LOADCELL_COUNT)
+    {
+        return false;
+    }
+    setCellScales(r.scale);
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        cellOffset[c] = r.offset[c];
+    }
+#ifdef CAL_LINEARISE
+    cellCurve = r.curve;
+#endif
+    if (DEBUG == 2)
+    {
+        Serial.print(F("Calibration "));
+        Serial.print(r.scale, 3);
+        Serial.print(F(" counts/g restored from profile "));
+        Serial.print(CAL_PROFILE);
+        Serial.print(F(", record "));
+        Serial.println(r.seq);
+    }
+    return true;
+}
+
+// Load on channel c.  The product needs up to 24 + 26 bits, hence the 64-bit multiply.
+force_t cellForce(const RawSample &s, uint8_t c)
+{
+    int64_t f = (int64_t)(s.count[c] - cellOffset[c]) * cellGain[c];
+    return (force_t)((f + (1L << (FORCE_GAIN_SHIFT - 1))) >> FORCE_GAIN_SHIFT);
+}
+
+// Total load on all the cells
+force_t totalForce(const RawSample &s)
+{
+    force_t sum = 0;
+    uint8_t c;
+
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+        sum += cellForce(s, c);
+    }
+#ifdef CAL_LINEARISE
+    // Linearity correction: f + k f^2, k is Q56 per mg.  (f^2 >> 24) < 2^26 for 20 kg.
+    sum += ((((int64_t)sum * sum) >> 24) * cellCurve) >> 32;
+#endif
+    return sum;
+}
+
+#ifdef CAL_LINEARISE
+// From a fit of counts = scale g + curve g^2: the first order inverse is
+// g = g0 - (curve / scale) g0^2, with g0 = counts / scale, so k = -(curve / scale) / 1000
+// per mg.  Too bent to fit 32 bits (over about 3% at 1 kg) and it is left uncorrected.
+static boolean setCellCurve(float curve, float scale)
+{
+    float k = -curve / scale / 1000 * 72057594037927936.0; // 2^56
+
+    if (fabs(k) > 2147483647.0)
+    {
+        return false;
+    }
+    cellCurve = lround(k);
+    return true;
+}
+#endif
 
 // This is what happens when you short-press the tare button
 void tareHandler()
@@ -37,120 +218,476 @@ void endHandler()
     done = true;
 }
 
-// This should happen when taring == true
-void doTare()
+// Tare and calibration run as a job alongside the sampling and plotting: cellJobFeed() sees
+// every sample, cellJobTick() runs every few ms.  The load has settled once a window
+// of SETTLE_SAMPLES samples is quiet and its mean agrees with the window before.
+enum CellJobState
 {
-    if (DEBUG)
+    JOB_IDLE,
+    JOB_TARE,        // Waiting for the load to settle, then taking the offsets
+    JOB_CAL_WAIT,    // Waiting for the double-click that says the next mass is hung
+    JOB_CAL_MEASURE, // Collecting steady windows of it
+    JOB_CAL_SHOW,    // Showing the result before going back to the chart
+    JOB_CAL_CHART    // Putting the chart back up
+};
+
+static uint8_t jobState = JOB_IDLE;
+static uint32_t jobStart; // millis() when jobState last changed
+
+// The window being filled: per-channel count sums for the tare, and the sum and sum of
+// squares of the value being tested for settling
+static int64_t winCounts[LOADCELL_COUNT];
+static int64_t winSum, winSumSq;
+static uint8_t winN;
+static int32_t lastMean;
+static boolean haveLast;
+
+// Calibration: which of CAL_MASSES is hanging, the tared counts of the window being filled,
+// the steady windows of this mass so far, and how many dots are on the screen
+static CalFit calFit;
+static uint8_t calPoint;
+static int64_t calWinSum, calWinSumSq;
+static uint8_t calWindows, calDots;
+static CalResult calResult; // For the result screen
+static boolean calLinear;
+
+// A full-screen redraw is far longer than the samples can wait, so the calibration screens
+// go up a piece per cellJobTick(): SCREEN_CLEAR_ROWS rows of the old screen at a time, then
+// a line of text at a time
+enum CalScreen
+{
+    SCREEN_NONE,      // Nothing to draw
+    SCREEN_PROMPT,    // Hang the next mass and double-click
+    SCREEN_MEASURING, // Under the prompt, which stays: do not touch
+    SCREEN_SOLVED,    // The new scale, and how good a fit it was
+    SCREEN_NO_FIT,    // Failed: no fit to the masses
+    SCREEN_UNSETTLED, // Failed: the load never settled
+    SCREEN_CANCELLED, // No double-click came
+    SCREEN_CHART      // Back to the chart (initChartStep())
+};
+
+static uint8_t screen = SCREEN_NONE;
+static uint16_t screenRow; // Cleared down to here
+static uint8_t screenLine; // Next line of text, or piece of the chart
+
+static void windowRestart()
+{
+    winSum = winSumSq = winN = 0;
+    for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
     {
-        Serial.print("Taring...");
+        winCounts[c] = 0;
     }
-    delay(1000);  // Let things settle for 1s before reading.
-    hx711.tare(); // Take the tare reading (10 samples is default)
-    if (DEBUG)
+}
+
+static void setJobState(uint8_t state)
+{
+    jobState = state;
+    jobStart = millis();
+    windowRestart();
+    haveLast = false;
+}
+
+// Add one value to the window, true when that completed it
+static boolean windowAdd(const RawSample &s, int32_t v)
+{
+    for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
     {
-        Serial.println("...Done.");
+        winCounts[c] += s.count[c];
     }
-    fMean = allTimeSum = allTimeSamples = 0; // Reset the legend stats
+    winSum += v;
+    winSumSq += (int64_t)v * v;
+    return ++winN == SETTLE_SAMPLES;
 }
 
-// This should happen when calibrating == true
-void doCalibration(TFT_ILI9341 &tft)
+// Close the completed window: its mean, and whether it was steady - a standard deviation
+// of at most `noise`, and a mean within `drift` of the previous window's, which must have
+// been quiet too.  That catches a slow drift as well as a swinging load.
+static boolean windowSteady(int32_t noise, int32_t drift, int32_t &mean)
 {
+    // n^2 var = n sum(v^2) - sum(v)^2, exact in 64 bits for 24-bit counts or 20 kg in mg
+    boolean quiet = SETTLE_SAMPLES * winSumSq - winSum * winSum <=
+                      (int64_t)SETTLE_SAMPLES * SETTLE_SAMPLES * noise * noise;
+    boolean steady;
 
-    // Initialize the double-click variable to false
-    done = false;
-
-    float calFactor, calSum, calAvg, kgForce;
-    int converged = 0;
+    mean = winSum / SETTLE_SAMPLES;
+    steady = quiet && haveLast && labs(mean - lastMean) <= drift;
+    lastMean = mean;
+    haveLast = quiet;
+    return steady;
+}
 
-    if (DEBUG)
-    {
-        Serial.println("Calibrating...");
-    }
+// Put up screen s: clear from row `from` down, then draw it
+static void showScreen(uint8_t s, uint16_t from)
+{
+    screen = s;
+    screenRow = from;
+    screenLine = 0;
+}
 
-    tft.fillScreen(xyChart.tftBGColor);
+static void calibrationTitle(TFT_ILI9341 &tft)
+{
     tft.drawRect(55, 3, 206, 33, YELLOW);
     tft.setTextColor(WHITE);
     tft.setTextSize(3);
     tft.setCursor(60, 10);
-    tft.println("CALIBRATION");
+    tft.print(F("CALIBRATION"));
     tft.setTextSize(2);
+}
 
-    tft.setCursor(0, 60);
-    tft.println(" Carefully hang a 1.0kg\n mass from the build plate");
-    tft.setCursor(0, 120);
-    tft.setTextColor(GREEN);
-    tft.println(" Then, double-click the\n tare button to calibrate");
+// Line n of the calibration screen going up, under its title (line 0).  False past the last.
+static boolean calibrationLine(TFT_ILI9341 &tft, uint8_t n)
+{
+    const float mass = calMasses[calPoint];
 
-    while (!done) // Wait for the user to setup the reference mass
+    if (n == 0 && screen != SCREEN_MEASURING)
     {
-        tareButton.tick(); // We are looking for a double-click
-        delay(10);
+        calibrationTitle(tft);
+        return true;
     }
+    switch (screen * 8 + n)
+    {
+    case SCREEN_PROMPT * 8 + 1:
+        tft.setCursor(0, 60);
+        if (mass == 0)
+        {
+            tft.print(F(" Take everything off"));
+        }
+        else
+        {
+            tft.print(F(" Carefully hang a "));
+            tft.print(mass / 1000, 1);
+            tft.print(F("kg"));
+        }
+        return true;
+    case SCREEN_PROMPT * 8 + 2:
+        tft.setCursor(0, 76);
+        tft.print(mass == 0 ? F(" the build plate") : F(" mass from the build plate"));
+        return true;
+    case SCREEN_PROMPT * 8 + 3:
+        tft.setCursor(0, 120);
+        tft.setTextColor(GREEN);
+        tft.print(F(" Then, double-click the"));
+        return true;
+    case SCREEN_PROMPT * 8 + 4:
+        tft.setCursor(0, 136);
+        tft.print(F(" tare button to calibrate"));
+        return true;
 
-    // Clear the double-click message and inform the user what's happening
-    tft.fillRect(0, 120, tft.width(), tft.height(), xyChart.tftBGColor);
-    tft.setCursor(0, 120);
-    tft.setTextColor(RED);
-    tft.println(" CALIBRATING, DO NOT TOUCH");
-    tft.print("  .");
+    case SCREEN_MEASURING * 8 + 0:
+        tft.setCursor(0, 120);
+        tft.setTextColor(RED);
+        tft.print(F(" CALIBRATING, DO NOT TOUCH"));
+        return true;
+    case SCREEN_MEASURING * 8 + 1:
+        tft.setCursor(0, 136);
+        tft.print(F("  .")); // And a dot per steady window from here
+        return true;
 
-    kgForce = calSum = 0;
-    calFactor = 1;
+    case SCREEN_SOLVED * 8 + 1:
+        tft.setCursor(0, 76);
+        tft.print(F(" Calibration Converged!"));
+        return true;
+    case SCREEN_SOLVED * 8 + 2:
+        tft.setCursor(0, 92);
+        tft.print(F(" Constant = "));
+        tft.print(calResult.scale, 2);
+        return true;
+    case SCREEN_SOLVED * 8 + 3:
+        tft.setCursor(0, 108);
+        tft.print(F(" Fit error "));
+        tft.print(calResult.rmsGrams, 1);
+        tft.print(F("g rms"));
+        return true;
+    case SCREEN_SOLVED * 8 + 4:
+        tft.setCursor(0, 124);
+        tft.print(F(" Scale +/-"));
+        tft.print(calResult.scaleCi, 2);
+        tft.print(F("%"));
+        return true;
+    case SCREEN_SOLVED * 8 + 5:
+        if (calLinear)
+        {
+            return false;
+        }
+        tft.setCursor(0, 140);
+        tft.print(F(" Too bent to linearise"));
+        return true;
+
+    case SCREEN_NO_FIT * 8 + 1:
+    case SCREEN_UNSETTLED * 8 + 1:
+        tft.setCursor(0, 76);
+        tft.print(F(" Calibration FAILED:"));
+        return true;
+    case SCREEN_NO_FIT * 8 + 2:
+        tft.setCursor(0, 92);
+        tft.print(F(" no fit to the masses."));
+        return true;
+    case SCREEN_UNSETTLED * 8 + 2:
+        tft.setCursor(0, 92);
+        tft.print(F(" the load never settled."));
+        return true;
+    case SCREEN_NO_FIT * 8 + 3:
+    case SCREEN_UNSETTLED * 8 + 3:
+        tft.setCursor(0, 108);
+        tft.print(F(" Keeping the old value."));
+        return true;
+
+    case SCREEN_CANCELLED * 8 + 1:
+        tft.setCursor(0, 76);
+        tft.print(F(" Calibration cancelled"));
+        return true;
+    }
+    return false;
+}
+
+// One piece of the screen going up: SCREEN_CLEAR_ROWS rows of the old one, or a line of the
+// new.  False once it is all there.
+static boolean screenStep(TFT_ILI9341 &tft)
+{
+    uint16_t rows;
+
+    if (screen == SCREEN_NONE)
+    {
+        return false;
+    }
+    if (screenRow < tft.height())
+    {
+        rows = tft.height() - screenRow < SCREEN_CLEAR_ROWS ? tft.height() - screenRow : SCREEN_CLEAR_ROWS;
+        tft.fillRect(0, screenRow, tft.width(), rows, xyChart.tftBGColor);
+        screenRow += rows;
+        return true;
+    }
+    if (screen == SCREEN_CHART ? initChartStep(screenLine) : calibrationLine(tft, screenLine))
+    {
+        screenLine++;
+        return true;
+    }
+    screen = SCREEN_NONE;
+    return false;
+}
+
+// All the masses are in: fit, and take the new scale (and offset, and linearity
+// correction) if it worked
+static void calibrationSolve()
+{
+    long shift;
+    uint8_t c;
+
+#ifdef CAL_LINEARISE
+    const boolean quadratic = true;
+#else
+    const boolean quadratic = false;
+#endif
+
+    if (!calFit.solve(quadratic, calResult))
+    {
+        showScreen(SCREEN_NO_FIT, 0);
+        return;
+    }
+
+    setCellScales(calResult.scale);
+    if (calResult.offset != 0)
+    {
+        // The fitted zero, shared out between the cells
+        shift = lround(calResult.offset);
+        for (c = 0; c < LOADCELL_COUNT; c++)
+        {
+            cellOffset[c] += shift / LOADCELL_COUNT + (c ? 0 : shift % LOADCELL_COUNT);
+        }
+    }
+    calLinear = true;
+#ifdef CAL_LINEARISE
+    calLinear = setCellCurve(calResult.curve, calResult.scale);
+#endif
+    showScreen(SCREEN_SOLVED, 0);
+
+    if (DEBUG)
+    {
+        Serial.print(F("Calibration: "));
+        Serial.print(calResult.scale, 3);
+        Serial.print(F(" counts/g, offset "));
+        Serial.print(calResult.offset, 1);
+        Serial.print(F(", curve "));
+        Serial.print(calResult.curve * 1e6, 3);
+        Serial.print(F(" counts/kg^2, "));
+        Serial.print(calResult.rmsGrams, 2);
+        Serial.print(F(" g rms, +/-"));
+        Serial.print(calResult.scaleCi, 3);
+        Serial.print(F("% from "));
+        Serial.print((unsigned long)calResult.samples);
+        Serial.println(F(" samples"));
+    }
+
+    saveCells();
+}
+
+// This should happen when taring == true.  Ignored while calibrating.
+void startTare()
+{
+    if (jobState != JOB_IDLE && jobState != JOB_TARE)
+    {
+        return;
+    }
+    if (DEBUG)
+    {
+        Serial.print(F("Taring..."));
+    }
+    setJobState(JOB_TARE);
+}
+
+// This should happen when calibrating == true.  Any tare in progress is dropped.
+void startCalibration(TFT_ILI9341 &)
+{
+    if (DEBUG)
+    {
+        Serial.println(F("Calibrating..."));
+    }
+    done = false; // Wait for a fresh double-click
+    setJobState(JOB_CAL_WAIT);
+    calFit.clear();
+    calPoint = 0;
+    showScreen(SCREEN_PROMPT, 0);
+}
+
+// The calibration screens are up, so the chart must not be drawn
+boolean calibrationShown()
+{
+    return jobState >= JOB_CAL_WAIT;
+}
+
+uint8_t cellJobFeed(const RawSample &s)
+{
+    int32_t v = 0, mean;
+    uint8_t c;
 
-    // Calibration scale minimizer/de-noiser
-    while (converged < 10)
+    switch (jobState)
     {
-        if (hx711.is_ready())
+    case JOB_TARE:
+        if (!windowAdd(s, totalForce(s)))
         {
-            hx711.set_scale(calFactor);
-            kgForce = hx711.get_units(10);           // Get a sample -> we are trying to make this value be 1000g
-            if ((kgForce < 1005) && (kgForce > 995)) // Did this calibration factor produce a 1kg +/- 0.5% output?
+            break;
+        }
+        if (!windowSteady(GRAMS(SETTLE_NOISE_GRAMS), GRAMS(SETTLE_GRAMS), mean))
+        {
+            windowRestart();
+            break;
+        }
+        for (c = 0; c < LOADCELL_COUNT; c++)
+        {
+            cellOffset[c] = (winCounts[c] + SETTLE_SAMPLES / 2) / SETTLE_SAMPLES;
+        }
+        setJobState(JOB_IDLE);
+        saveCells();
+        if (DEBUG)
+        {
+            Serial.println(F("...Done."));
+        }
+        return CELL_JOB_TARED;
+
+    case JOB_CAL_MEASURE:
+        // The fit takes the tared counts, steady is judged in force with the old scale,
+        // which only needs to be roughly right
+        for (c = 0; c < LOADCELL_COUNT; c++)
+        {
+            v += s.count[c] - cellOffset[c];
+        }
+        calWinSum += v;
+        calWinSumSq += (int64_t)v * v;
+        if (windowAdd(s, totalForce(s)))
+        {
+            if (windowSteady(GRAMS(SETTLE_NOISE_GRAMS), GRAMS(SETTLE_GRAMS), mean) && calWindows < CAL_POINT_WINDOWS)
             {
-                converged++;         // We are one count closer to convergence
-                calSum += calFactor; // Build a sum so we can average the successful values later
-                if (DEBUG)
-                {
-                    Serial.print("Success #");
-                    Serial.println(converged);
-                }
+                calFit.add(calMasses[calPoint], SETTLE_SAMPLES, calWinSum, calWinSumSq);
+                calWindows++;
             }
-            // Normalize the calibration factor by the get_units() return value and reference mass
-            calFactor = calFactor * kgForce / REFERENCE_MASS;
-            tft.print(".");
+            windowRestart();
+            calWinSum = calWinSumSq = 0;
+        }
+        break;
+    }
+    return CELL_JOB_NONE;
+}
+
+uint8_t cellJobTick(TFT_ILI9341 &tft)
+{
+    uint32_t elapsed = millis() - jobStart;
 
+    if (screenStep(tft))
+    {
+        return CELL_JOB_NONE; // The job goes on once the screen is up
+    }
+    switch (jobState)
+    {
+    case JOB_TARE:
+        if (elapsed > TARE_TIMEOUT_MS)
+        {
+            setJobState(JOB_IDLE);
             if (DEBUG)
             {
-                Serial.print("get_units returned ");
-                Serial.println(kgForce);
-                Serial.print("Trying new calFactor = ");
-                Serial.println(calFactor);
+                Serial.println(F("...the load never settled, tare cancelled."));
             }
         }
-    }
+        break;
 
-    calAvg = calSum / converged; // The average of all the converged values will be our actual scale
-    hx711.set_scale(calAvg);
-    tft.fillScreen(xyChart.tftBGColor);
-    tft.drawRect(55, 3, 206, 33, YELLOW);
-    tft.setTextColor(WHITE);
-    tft.setTextSize(3);
-    tft.setCursor(60, 10);
-    tft.println("CALIBRATION");
-    tft.setTextSize(2);
+    case JOB_CAL_WAIT:
+        if (done)
+        {
+            // Clear the double-click message and inform the user what's happening
+            showScreen(SCREEN_MEASURING, 120);
+            calWinSum = calWinSumSq = 0;
+            calWindows = calDots = 0;
+            setJobState(JOB_CAL_MEASURE);
+        }
+        else if (elapsed > CAL_WAIT_MS)
+        {
+            setJobState(JOB_CAL_SHOW);
+            showScreen(SCREEN_CANCELLED, 0);
+        }
+        break;
 
-    tft.setCursor(0, 60);
-    tft.print("\n Calibration Converged!\n Constant = ");
-    tft.println(round(calAvg));
+    case JOB_CAL_MEASURE:
+        for (; calDots < calWindows; calDots++)
+        {
+            tft.print(F("."));
+        }
+        if (calWindows >= CAL_POINT_WINDOWS)
+        {
+            if (++calPoint < CAL_POINTS)
+            {
+                done = false;
+                setJobState(JOB_CAL_WAIT);
+                showScreen(SCREEN_PROMPT, 0);
+            }
+            else
+            {
+                setJobState(JOB_CAL_SHOW);
+                calibrationSolve();
+            }
+        }
+        else if (elapsed > CAL_TIMEOUT_MS)
+        {
+            setJobState(JOB_CAL_SHOW);
+            showScreen(SCREEN_UNSETTLED, 0);
+            if (DEBUG)
+            {
+                Serial.print(F("Calibration timed out after "));
+                Serial.print(calWindows);
+                Serial.println(F(" steady windows"));
+            }
+        }
+        break;
 
-    EEPROM.write(EEPROM_ADDR, round(calAvg));
-    if (DEBUG == 2)
-    {
-        Serial.print("Wrote calibration value = " + String(round(calAvg)) + " to EEPROM address " + String(EEPROM_ADDR));
-    }
-    
-    delay(5000); // Let the user read the last onscreen msg
+    case JOB_CAL_SHOW:
+        if (elapsed > CAL_SHOW_MS) // Let the user read the last onscreen msg
+        {
+            setJobState(JOB_CAL_CHART);
+            showScreen(SCREEN_CHART, 0); // Reinitialize the chart
+        }
+        break;
 
-    calibrating = false; // We are done, reset the calibration flag
-    initChart();         // Reinitialize the chart
-}
\ No newline at end of file
+    case JOB_CAL_CHART: // It is all back up
+        setJobState(JOB_IDLE);
+        return CELL_JOB_CALIBRATED;
+    }
+    return CELL_JOB_NONE;
+}
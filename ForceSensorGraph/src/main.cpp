@@ -13,28 +13,88 @@ https://github.com/KrisKasprzak/GraphingFunction/blob/master/Graph.ino
 */
 
 #include <Arduino.h>
+#include <string.h>
 #include <TFT_Charts.h>
-#include <HX711.h>
 #include <OneButton.h>
 #include <cppQueue.h>
 #include <EEPROM.h>
 #include "setup.h"
-
-// Initialize some global variables
-float fMean, allTimeSum, allTimeSamples;
-float lastT = 0, t_offset = 0; // Offset for t=0 on X.
+#include "loadCell.h"
+#include "plotRenderer.h"
+#include "legendLine.h"
+#include "peelDetector.h"
+#include "sampleRing.h"
+#include "columnDecimator.h"
+#include "filterChain.h"
+#include "calStore.h"
+#include "scheduler.h"
+#include "timebase.h"
+#include "textFormat.h"
+#include "burstCapture.h"
+#include "streamStats.h"
+#include "traceLog.h"
+#include "freeRam.h"
+
+// Initialize some global variables.  The sums are integers so they never lose precision.
+force_t fMean;
+int64_t allTimeSum;
+uint32_t allTimeSamples;
+time_us chartOriginUs = 0;         // t=0 on X
+static force_t y = 0;              // Latest load cell value, for the legend
+static boolean fresh = false;      // y has moved on since the legend was drawn
+static RawSample last;             // Sample behind y, for the per-cell values
+
+// Spread and percentiles of the filtered force since the tare, for the legend and the serial
+// port, and the last peel's summary.  Not static: the simulator checks them.
+RunningStats fStats;
+#ifdef STATS_PERCENTILES
+static const uint8_t statsPercent[] = STATS_PERCENTILES;
+QuantileSketch<sizeof(statsPercent)> fQuantiles(statsPercent);
+#endif
+static PeelEvent lastPeel;
 
 // Global external variables
 extern boolean taring;      // Taring button activated?
 extern boolean calibrating; // Calibration button activated?
-extern boolean done;        // Done calibrating?
 
-// Button and ADC objects
+// Button and display objects
 extern OneButton tareButton; // OneButton constructor
-extern HX711 hx711;          // HX711 constructor
+extern PlotRenderer plot;    // Scrolling trace
+
+// Peel detection runs on every sample as samplesTask() drains it, peelTask() reports the events
+PeelDetector peel;
+static SampleRing<PeelEvent, 2> peelEvents; // An onset and its release: peelTask() is due long before the next
+
+// Smoothing for the trace and legend (FILTER_* in setup.h).  The peel detector works on the
+// raw samples, it can't wait for the filters.
+static FilterChain<MedianFilter<FILTER_MEDIAN>, LowPass<FILTER_LOWPASS_HZ, HX711_RATE_HZ>,
+                   FirDecimator<FILTER_FIR_TAPS, FILTER_DECIMATE>>
+    filters;
+
+// Filtered samples, boiled down to a point per pixel column, waiting for plotTask() to draw
+// them.  Not static: the simulator reports the overruns.
+static ColumnDecimator<XRANGE * 1000UL, PLOT_W> columns;
+SampleRing<ColumnPoint, PLOT_RING_LENGTH> plotColumns;
+
+// Lowest and highest filtered sample since legendTask() last queued them
+static ForceSpan interval;
+static boolean intervalOpen = false;
+
+uint16_t streamDropped = 0; // Sample lines the serial port had no room for
+
+#ifdef HISTORY_SERIAL
+// The last few seconds of raw samples, compressed, and how far a dump of them has got
+static TraceLog<HISTORY_BYTES, HISTORY_BLOCK_BYTES> history;
+static TraceLog<HISTORY_BYTES, HISTORY_BLOCK_BYTES>::Cursor dump;
+static boolean dumping = false;
+static uint16_t dumped;
+#endif
+
+const uint8_t cellDouts[] = LOADCELL_DOUTS;
+static_assert(sizeof(cellDouts) == LOADCELL_COUNT, "LOADCELL_DOUTS must list LOADCELL_COUNT pins");
 
-// Instantiate a cppQueue to store QUEUE_LENGTH number of points
-cppQueue fQ(sizeof(ChartXY::point), QUEUE_LENGTH, FIFO);
+// Instantiate a cppQueue to store QUEUE_LENGTH spans of min/max
+cppQueue fQ(sizeof(ForceSpan), QUEUE_LENGTH, FIFO);
 
 // ILI9341 constructor: This library takes width/height for the arguments.
 // Hardware SPI pins are required, and are read from TFT_ILI9341/User_Setup.h
@@ -42,10 +102,128 @@ TFT_ILI9341 tft = TFT_ILI9341(320, 240);
 
 ChartXY xyChart; // ChartXY constructor
 
+// Each part of the old loop() is a task.  In priority order: sampling can't wait, drawing can.
+static void acquireTask();
+static void samplesTask();
+static void controlTask();
+static void peelTask();
+static void plotTask();
+static void legendTask();
+static void storeTask();
+
+enum
+{
+  TASK_ACQUIRE,
+  TASK_SAMPLES,
+  TASK_CONTROL,
+  TASK_PEEL,
+  TASK_PLOT,
+  TASK_LEGEND,
+  TASK_STORE,
+  TASK_COUNT
+};
+
+#define SAMPLE_MS (1000 / HX711_RATE_HZ)
+#define COLUMN_MS (XRANGE * 1000L / PLOT_W)
+
+// name, run, period (ms, 0 when signalled), deadline (ms)
+Task tasks[TASK_COUNT] = {
+    TASK("acquire", acquireTask, 1, SAMPLE_MS),              // Polled DOUTs, before the next conversion
+    TASK("samples", samplesTask, 0, SAMPLE_MS),              // Signalled by sampleHook
+    TASK("control", controlTask, 10, 50),                    // Button and tare/calibration
+    TASK("peel", peelTask, 0, 100),                          // Signalled by peelFeed
+    TASK("plot", plotTask, 0, COLUMN_MS * PLOT_RING_LENGTH), // Signalled by samplesTask, before plotColumns fills
+    TASK("legend", legendTask, DATA_INTERVAL, DATA_INTERVAL),
+    TASK("store", storeTask, 4, 100), // A byte per EEPROM write time
+};
+extern const uint8_t taskCount = TASK_COUNT; // For the simulator's report
+
+// Called from the acquisition ISR with every sample: wake the task that drains them.  All
+// the work on the sample, peel detection included, is left to it, so the ISR stays short.
+static void sampleHook(const RawSample &)
+{
+  schedSignal(tasks[TASK_SAMPLES]);
+}
+
+// Total force of a sample, the right way up
+static force_t sampleForce(const RawSample &s)
+{
+  force_t f = totalForce(s); // Sum of all the cells
+
+#ifdef INVERT_Y
+  f = -f; // Invert the hx711 reading - this is dependent on the orientation.
+#endif
+  return f;
+}
+
+// Every sample goes through the peel detector first thing, as it comes off the ring, so the
+// trigger pin goes high within a sample period of the release unless a task holds the loop
+// up for longer.  The pulse lasts until the next sample.
+static void peelFeed(time_us t, force_t f)
+{
+  PeelEvent ev;
+
+#ifdef PEEL_TRIGGER_PIN
+  digitalWrite(PEEL_TRIGGER_PIN, LOW);
+#endif
+  if (labs(f) < GRAMS(OUTLIER_GRAMS) && peel.update(t, f, ev))
+  {
+#ifdef PEEL_TRIGGER_PIN
+    if (ev.type == PEEL_RELEASE)
+    {
+      digitalWrite(PEEL_TRIGGER_PIN, HIGH);
+    }
+#endif
+    peelEvents.push(ev);
+    schedSignal(tasks[TASK_PEEL]);
+  }
+}
+
+// The zero moved (tare, calibration): start looking for peels afresh
+static void peelReset()
+{
+  peel.reset();
+}
+
+// A tare or calibration finished: the zero, the scale or the whole chart changed, so start
+// the stats, filters and peel detection afresh
+static void cellJobDone(uint8_t ev)
+{
+  if (ev == CELL_JOB_NONE)
+  {
+    return;
+  }
+  peelReset();
+  filters.reset();
+#ifdef BURST_SERIAL
+  burstReset(); // Its history is in the old counts, and its header in the old scale
+#endif
+#ifdef HISTORY_SERIAL
+  history.clear(); // Likewise, and a dump would show it in the new zero
+#endif
+  plotColumns.flush(); // Drawn against the old zero or the old chart
+  columns.reset();
+  intervalOpen = false;
+  fMean = allTimeSum = allTimeSamples = 0; // Reset the legend stats
+  fStats.reset();
+#ifdef STATS_PERCENTILES
+  fQuantiles.reset();
+#endif
+  lastPeel.force = lastPeel.impulse = 0;
+  if (ev == CELL_JOB_CALIBRATED)
+  {
+    // ...and the time, for the fresh chart
+    chartOriginUs = timeUs();
+  }
+}
+
+// On the board, pio test brings its own setup() and loop(); the simulator's tests use these
+#if !defined(PIO_UNIT_TESTING) || defined(SIM_NATIVE)
 void setup()
 {
   uint8_t hx711Cal;
 
+  ramPaint();
   if (DEBUG)
   {
     Serial.begin(9600);
@@ -53,10 +231,10 @@ void setup()
     while (!Serial)
       ;
     Serial.println();
-    Serial.println("Starting...");
-    Serial.print("Queue size is ");
+    Serial.println(F("Starting..."));
+    Serial.print(F("Queue size is "));
     Serial.print(QUEUE_LENGTH);
-    Serial.println(" points.");
+    Serial.println(F(" spans."));
   }
 
 #ifdef PCBV2
@@ -67,29 +245,59 @@ void setup()
 
   fMean = allTimeSum = allTimeSamples = 0; // Initialize fMean
 
-  // Initialize the force sensor
-  hx711.begin(HX711_DOUT, HX711_SCK);
-  hx711.tare(20); // Tare with 20 readings (default is 10)
+  // Start interrupt-driven sampling of the force sensor(s), and pick up the stored zero and
+  // scale - no tare needed
+  acqBegin(cellDouts, HX711_SCK);
+  if (!restoreCells())
+  {
+    // Nothing stored yet: the one byte calibration of old firmware, and tare with 20 readings
+    hx711Cal = EEPROM.read(EEPROM_ADDR);
+    if (DEBUG == 2)
+    {
+      Serial.print(F("Calibration value "));
+      Serial.print(hx711Cal);
+      Serial.print(F(" read from EEPROM Address "));
+      Serial.println(EEPROM_ADDR);
+    }
+    setCellScales(hx711Cal);
+    if (tareCells(20))
+    {
+      saveCells();
+    }
+    else if (DEBUG)
+    {
+      Serial.println(F("No samples from the load cell, not tared"));
+    }
+  }
+#ifdef TARE_AT_STARTUP
+  else if (!tareCells(20) && DEBUG)
+  {
+    Serial.println(F("No samples from the load cell, not tared"));
+  }
+#endif
 
 #ifdef OVERRIDE_CALIBRATION
   hx711Cal = OVERRIDE_CALIBRATION;
   if (DEBUG == 2)
   {
-    Serial.println("Calibration overridden with value " + String(hx711Cal));
-  }
-#else
-  hx711Cal = EEPROM.read(EEPROM_ADDR);
-  if (DEBUG == 2)
-  {
-    Serial.println("Calibration value " + String(hx711Cal) + " read from EEPROM Address " + String(EEPROM_ADDR));
+    Serial.print(F("Calibration overridden with value "));
+    Serial.println(hx711Cal);
   }
+  setCellScales(hx711Cal);
 #endif
 
-  hx711.set_scale(hx711Cal);
+#ifdef PEEL_TRIGGER_PIN
+  pinMode(PEEL_TRIGGER_PIN, OUTPUT);
+  digitalWrite(PEEL_TRIGGER_PIN, LOW);
+#endif
+  acqOnSample(sampleHook);
+#ifdef BURST_SERIAL
+  burstBegin();
+#endif
 
   if (DEBUG == 2)
   {
-    Serial.println("Finished initializing load cell.");
+    Serial.println(F("Finished initializing load cell."));
   }
 
   // Tare button setup:
@@ -101,141 +309,381 @@ void setup()
   // Initialize the chart
   initChart();
 
-  // Set x-axis (time) offset to now (in seconds)
-  t_offset = millis() / 1000;
+  // Set x-axis (time) offset to now, and start the trace and the stream from here: what
+  // queued up while the chart was drawn would otherwise overrun the ring
+  chartOriginUs = timeUs();
+  acqFlush();
+
+  schedBegin(tasks, TASK_COUNT);
 }
 
 // Read data and throw it at the screen forever
 void loop(void)
 {
-  uint8_t i;                // Loop indices
-  ChartXY::point p, p0, p1; // Temporary points to hold queue values
-  float dx;                 // Delta-X, for interleaved line scrolling on X axis
-  float fMin = 0, fMax = 0;
-  boolean scrolling = false, noise = false;
-  String legend;
+  schedRun();
+}
+#endif
+
+static void acquireTask()
+{
+  acqPoll(); // No-op unless a DOUT is on a non-interrupt pin
+}
+
+#if defined(STREAM_SERIAL) && defined(BURST_SERIAL)
+#error "STREAM_SERIAL and BURST_SERIAL share the serial port: pick one"
+#endif
+
+#ifdef STREAM_SERIAL
+#define STREAM_LINE_LEN (TIME_TEXT_LEN + FORCE_TEXT_LEN + 4) // "s,", ",", CR LF and the NUL
+
+// One "s,<ms>,<g>" line per sample, as measured, with the same timestamps as the peel lines.
+// A line goes out whole or not at all: if the host isn't keeping up it loses lines, counted
+// in streamDropped, rather than hold up the sampling.
+static void streamSample(time_us t, force_t f)
+{
+  char line[STREAM_LINE_LEN], text[TIME_TEXT_LEN];
+  uint8_t len;
+
+  strcpy_P(line, PSTR("s,"));
+  strcat(line, formatTime(text, t));
+  strcat_P(line, PSTR(","));
+  strcat(line, formatForce(text, f, 2));
+  strcat_P(line, PSTR("\r\n"));
+  len = strlen(line);
+  if (Serial.availableForWrite() < len)
+  {
+    streamDropped++;
+    return;
+  }
+  Serial.write((const uint8_t *)line, len);
+}
+#endif
+
+#ifdef HISTORY_SERIAL
+#define HISTORY_LINE_LEN (TIME_TEXT_LEN + FORCE_TEXT_LEN + 4) // "h,", ",", CR LF and the NUL
+#define HISTORY_LINES_PER_RUN 4                              // Catches up at 4 times the sample rate
+
+// An 'h' from the host dumps the history, oldest first, as "h,<ms>,<g>" lines timestamped
+// like the stream's, then "h,end,<samples>,<blocks lost>".  A few lines go out per run, each
+// once the serial port has room for it.  The history stops recording until the dump is out,
+// so it is the seconds before the 'h', whole; only a tare meanwhile loses blocks of it.
+static void historyPoll()
+{
+  char line[HISTORY_LINE_LEN], text[TIME_TEXT_LEN];
+  RawSample s;
+  force_t f;
+  uint8_t lines;
+
+  while (Serial.available())
+  {
+    if (Serial.read() == 'h' && !dumping)
+    {
+      history.rewind(dump);
+      dumped = 0;
+      dumping = true;
+    }
+  }
+  for (lines = 0; dumping && lines < HISTORY_LINES_PER_RUN && Serial.availableForWrite() >= HISTORY_LINE_LEN; lines++)
+  {
+    if (!history.read(dump, s))
+    {
+      Serial.print(F("h,end,"));
+      Serial.print(dumped);
+      Serial.print(',');
+      Serial.println(dump.lost);
+      dumping = false;
+      break;
+    }
+    f = sampleForce(s);
+    strcpy_P(line, PSTR("h,"));
+    strcat(line, formatTime(text, s.t));
+    strcat_P(line, PSTR(","));
+    strcat(line, formatForce(text, f, 2));
+    strcat_P(line, PSTR("\r\n"));
+    Serial.write((const uint8_t *)line, strlen(line));
+    dumped++;
+  }
+}
+#endif
+
+// Drain everything the acquisition ISR has queued.  Every sample goes out on the serial
+// stream.  Every sample out of the filters goes into the running mean, the legend's
+// interval min/max and a pixel column of the trace; the latest one also feeds the legend.
+static void samplesTask()
+{
+  RawSample raw; // Raw HX711 counts from the acquisition ring
+  force_t f;     // Unfiltered total of the latest sample
+  uint8_t ev;    // CELL_JOB_* the sample finished
+  uint32_t tMs;
+  ColumnPoint col;
+
+  while (acqRead(raw))
+  {
+    if (raw.input != ACQ_A128)
+    {
+      continue; // Only taken if someone scheduled the other inputs
+    }
+    f = sampleForce(raw);
+    peelFeed(raw.t, f);
+    ev = cellJobFeed(raw);
+    if (ev != CELL_JOB_NONE)
+    {
+      cellJobDone(ev);
+      f = sampleForce(raw); // In the new zero and scale
+    }
+#ifdef STREAM_SERIAL
+    streamSample(raw.t, f); // Through the calibration screens too, in the scale of the moment
+#endif
+    if (calibrationShown())
+    {
+      continue; // Nowhere to draw it
+    }
+#ifdef HISTORY_SERIAL
+    if (!dumping)
+    {
+      history.add(raw); // Held still while it is dumped
+    }
+#endif
+#ifdef BURST_SERIAL
+    burstFeed(raw, f);
+#endif
 
+    // Check for an outlier (presumed glitch/noise).  Drop it rather than let it ring the low-pass.
+    if (labs(f) > GRAMS(OUTLIER_GRAMS))
+    {
+      if (DEBUG == 2)
+      {
+        Serial.print(F("DETECTED OUTLIER "));
+        Serial.print(forceToGrams(f));
+        Serial.print(F(" - IGNORING THIS VALUE."));
+      }
+      continue;
+    }
+    if (!filters.update(f, y))
+    {
+      continue; // Decimated away
+    }
+
+    allTimeSamples += 1;
+    allTimeSum += y;
+    fStats.add(y);
+#ifdef STATS_PERCENTILES
+    fQuantiles.add(y);
+#endif
+    fresh = true;
+    last = raw;
+
+    if (!intervalOpen)
+    {
+      interval.lo = interval.hi = y;
+      intervalOpen = true;
+    }
+    interval.lo = y < interval.lo ? y : interval.lo;
+    interval.hi = y > interval.hi ? y : interval.hi;
+
+    tMs = raw.t > chartOriginUs ? (raw.t - chartOriginUs) / 1000 : 0; // Queued before a new chart
+    if (columns.update(tMs, y, col) && plotColumns.push(col))
+    {
+      schedSignal(tasks[TASK_PLOT]);
+    }
+  }
+#ifdef BURST_SERIAL
+  burstPoll();
+#endif
+#ifdef HISTORY_SERIAL
+  historyPoll();
+#endif
+}
+
+static void controlTask()
+{
   tareButton.tick(); // Check the tare button
 
   // Single click
   if (taring)
   {
     taring = false;
-    doTare();
+    startTare();
   }
 
   // Long press
   if (calibrating)
   {
-    done = false;
-    doCalibration(tft);
+    calibrating = false;
+    startCalibration(tft);
+  }
+  cellJobDone(cellJobTick(tft));
+}
 
-    // Reset stats and time
-    t_offset = millis() / 1000;
-    lastT = allTimeSamples = allTimeSum = fMean = 0;
+// Statistics float in force_t units, rounded
+static force_t toForce(float f)
+{
+  return (force_t)(f + (f < 0 ? -0.5f : 0.5f));
+}
+
+#ifdef STATS_SERIAL
+// "stats,<ms>,<samples>,<mean g>,<sd g>,<rms g>,<percentile g>..." for the filtered force
+// since the tare, one line per layer so the spread can be followed over a print
+static void statsSerial(time_us t)
+{
+  char text[TIME_TEXT_LEN];
+
+  Serial.print(F("stats,"));
+  Serial.print(formatTime(text, t));
+  Serial.print(',');
+  Serial.print((unsigned long)fStats.count());
+  Serial.print(',');
+  Serial.print(formatForce(text, toForce(fStats.mean()), 2));
+  Serial.print(',');
+  Serial.print(formatForce(text, toForce(fStats.stddev()), 2));
+  Serial.print(',');
+  Serial.print(formatForce(text, toForce(fStats.rms()), 2));
+#ifdef STATS_PERCENTILES
+  for (uint8_t j = 0; j < sizeof(statsPercent); j++)
+  {
+    Serial.print(',');
+    Serial.print(formatForce(text, toForce(fQuantiles.value(j)), 2));
   }
+#endif
+  Serial.println();
+}
+#endif
 
-  // Get smoothed value from the dataset:
-  if (hx711.is_ready())
+// Peel events, for whatever drives the printer
+static void peelTask()
+{
+  PeelEvent ev; // Peel detected by peelFeed()
+  char text[TIME_TEXT_LEN];
+
+  while (peelEvents.pop(ev))
   {
-    // All of the time-based logic will blow up when millis() overflows (~49 days).
-    if (millis() > (((lastT + t_offset) * 1000) + DATA_INTERVAL))
+#ifdef PEEL_SERIAL
+    if (ev.type == PEEL_ONSET)
     {
-      p.y = hx711.get_units();                   // Read the load cell value as a float (4 bytes on 8-bit AVRs)
-      p.x = (float(millis()) / 1000 - t_offset); // Elapsed time in seconds.  (Why must I cast millis() here?)
-#ifdef INVERT_Y
-      p.y = -p.y; // Invert the hx711 reading - this is dependent on the orientation.
+      Serial.print(F("peel,onset,"));
+      Serial.print(formatTime(text, ev.t));
+      Serial.print(',');
+      Serial.println(formatForce(text, ev.force, 1));
+    }
+    else
+    {
+      Serial.print(F("peel,release,"));
+      Serial.print(formatTime(text, ev.t));
+      Serial.print(',');
+      Serial.print(formatForce(text, ev.force, 1));
+      Serial.print(',');
+      Serial.print(formatTime(text, ev.tPeak));
+      Serial.print(',');
+      Serial.print(peel.stats.latencyMaxUs);
+      Serial.print(',');
+      Serial.println(formatForce(text, ev.impulse, 1));
+    }
 #endif
+    if (ev.type == PEEL_RELEASE)
+    {
+      lastPeel = ev;
+#ifdef STATS_SERIAL
+      statsSerial(ev.t);
+#endif
+    }
+  }
+}
 
-      // Check for an outlier (presumed glitch/noise)
-      if (fabs(p.y) > 20000)
-      {
-        if (DEBUG == 2)
-        {
-          Serial.print("DETECTED OUTLIER " + String(p.y) + " - IGNORING THIS VALUE.");
-        }
-        p.y = fMean;
-      }
+// One column, or one step of a scroll, per run, so sampling and the button get a look in
+// between
+static void plotTask()
+{
+  ColumnPoint col;
 
-      allTimeSamples += 1;
-      allTimeSum += p.y;
-      fMean = allTimeSum / allTimeSamples;
+  if (calibrationShown())
+  {
+    return; // A scroll under way is dropped: the chart is drawn afresh after
+  }
+  if (plot.busy())
+  {
+    plot.step(tft, xyChart);
+  }
+  else if (plotColumns.pop(col))
+  {
+    plot.addColumn(tft, xyChart, col);
+  }
+  if (plot.busy() || !plotColumns.isEmpty())
+  {
+    schedSignal(tasks[TASK_PLOT]);
+  }
+}
 
-      // Report the current [time, force] value
-      if (DEBUG == 2)
-      {
-        Serial.print("\nCurrent time, force point: ");
-        Serial.print(p.x);
-        Serial.print(", ");
-      }
+// Legend and autoscaling every DATA_INTERVAL, from the latest sample
+static void legendTask()
+{
+  ChartXY::point p, p0; // Latest point and window min/max, in grams
 
-      if (DEBUG)
-      {
-        Serial.println(p.y);
-      }
+  if (!fresh || calibrationShown())
+  {
+    return;
+  }
 
-      if (fQ.getCount() > 20)
-      {
-        p0 = getMinMax();
-        fMin = p0.x;
-        fMax = p0.y;              // Work out the min/max values we have in the queue
-        noise = autoScale(p0, p); // Autoscale the data in Y
-
-        // Draw a live legend with current/min/max/mean values
-        legend = "Curr:" + String(p.y, 1) + "    ";
-        xyChart.drawLegend(tft, legend, 230, 0, 1, YELLOW);
-        legend = " Max:" + String(fMax, 1) + "    ";
-        xyChart.drawLegend(tft, legend, 230, 10, 1, RED);
-        legend = "Mean:" + String(fMean, 1) + "    ";
-        xyChart.drawLegend(tft, legend, 230, 20, 1, GREEN);
-        legend = " Min:" + String(fMin, 1) + "    ";
-        xyChart.drawLegend(tft, legend, 230, 30, 1, BLUE);
-
-        legend = "";
-      }
+  // Floats from here on: this runs at display rate, not per sample
+  fMean = allTimeSamples ? allTimeSum / allTimeSamples : 0;
+  p.y = forceToGrams(y); // Latest load cell value, in grams
+  p.x = last.t > chartOriginUs ? (last.t - chartOriginUs) / 1e6 : 0; // Elapsed seconds, for display only
 
-      // Check if the queue is full
-      if (fQ.isFull())
-      {
-        scrolling = true;
-        fQ.pop(&p0);                                                // Pop the oldest point
-        fQ.peek(&p1);                                               // Peek at the new oldest point -> New xMin
-        dx = p1.x - p0.x;                                           // We will move the axis right by dx, remember it
-        xyChart.setAxisLimitsX(p1.x, xyChart.xMax + dx, XTICKTIME); // New X axis limits run from oldest point to xMax+dx
-      }
-      else
-      {
-        fQ.peek(&p0);       // or peek the oldest point -> "New" xMin
-        fQ.peekIdx(&p1, 1); // and peek at the second oldest point
-        dx = 0;
-      }
+  // Report the current [time, force] value
+  if (DEBUG == 2)
+  {
+    Serial.print(F("\nStack headroom: "));
+    Serial.print(ramUntouched());
+    Serial.println(F(" bytes never touched"));
+    Serial.print(F("Current time, force point: "));
+    Serial.print(p.x);
+    Serial.print(F(", "));
+  }
 
-      lastT = p.x;
-      fQ.push(&p); // Update the queue with latest value
-
-      if (scrolling)
-      { // Erase the line between between two oldest points.
-        xyChart.eraseLine(tft, p0.x + dx, p0.y, p1.x + dx, p1.y);
-        // Redraw the axes/labels
-        xyChart.drawAxisX(tft, 10);
-        xyChart.drawLabelsX(tft);
-        xyChart.drawAxisY(tft, 10);
-        xyChart.drawY0(tft);
-      }
-      // Now move lines one by one (looks SO much better than clearing/drawing, but bookeeping...)
-      for (i = 1; i <= QUEUE_LENGTH; i++)
-      {
-        fQ.peekIdx(&p0, i - 1);                                   // Peek at tail of line to move
-        fQ.peekIdx(&p1, i);                                       // Peek at head of line to move
-        xyChart.eraseLine(tft, p0.x + dx, p0.y, p1.x + dx, p1.y); // erase it at the old x-axis limits
-        xyChart.drawLine(tft, p0.x, p0.y, p1.x, p1.y);            // draw it at the current x-axis limits
-      }
-      // Wait here for noise to decay (after the graph is drawn) - it looks prettier.
-      if (noise)
-      {
-        delay(300);
-        noise = false;
-      }
+  if (DEBUG)
+  {
+    Serial.print(p.y);
+#if LOADCELL_COUNT > 1
+    // Each cell's share, to see where the load is
+    for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+    {
+      Serial.print(F(", "));
+      Serial.print(forceToGrams(cellForce(last, c)));
+    }
+#endif
+    Serial.println();
+  }
+
+  // Every sample since the last run, peaks and all, joins the window the min/max are taken
+  // over
+  if (intervalOpen)
+  {
+    queueInterval(interval);
+    intervalOpen = false;
+  }
+
+  if (fQ.getCount() * QUEUE_INTERVALS > 20) // Some 6 s in it
+  {
+    p0 = getMinMax(); // Work out the min/max values we have in the queue
+    if (autoScale(p0, p)) // Autoscale the data in Y
+    {
+      schedSignal(tasks[TASK_PLOT]); // Which moves the trace a few columns a run
+    }
+
+    // The whole legend at once, after a clear, would hold the samples up past their deadline:
+    // the stats lines wait a run when the live ones took more than a couple of lines' worth
+    if (updateLegend(y, fMean) <= 2 * LEGEND_CHARS)
+    {
+      updateStatsLegend(toForce(fStats.stddev()), lastPeel.force, lastPeel.impulse);
+#ifdef STATS_PERCENTILES
+      updatePercentileLegend(statsPercent[sizeof(statsPercent) - 1],
+                             toForce(fQuantiles.value(sizeof(statsPercent) - 1)));
+#endif
     }
   }
-}
\ No newline at end of file
+  fresh = false;
+}
+
+static void storeTask()
+{
+  calStorePoll(); // Write out a saved calibration, a byte at a time
+}
@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include "setup.h"
+#include "peelDetector.h"
+
+#define BASELINE_SHIFT 5 // Each new idle sample moves the baseline 1/32 of the way
+
+void PeelDetector::reset()
+{
+  state = IDLE;
+  primed = false;
+  next = filled = 0;
+}
+
+bool PeelDetector::emit(PeelEvent &ev, uint8_t type, time_us t, force_t force)
+{
+  uint32_t latency;
+
+  ev.type = type;
+  ev.t = t;
+  ev.force = force;
+  ev.tPeak = tPeak;
+  ev.impulse = type == PEEL_RELEASE ? area / 1000000 : 0;
+
+  latency = (uint32_t)micros() - (uint32_t)t;
+  stats.latencyMaxUs = latency > stats.latencyMaxUs ? latency : stats.latencyMaxUs;
+  stats.latencySumUs += latency;
+  stats.latencyCount++;
+  return true;
+}
+
+bool PeelDetector::update(time_us t, force_t y, PeelEvent &ev)
+{
+  force_t rise = 0, steep = 0;
+  force_t yPrev = y;
+  uint32_t dt = 0;
+  uint8_t oldest, prev = next ? next - 1 : SLOPE_SAMPLES - 1;
+
+  if (!primed)
+  {
+    baseline = y;
+    primed = true;
+  }
+
+  // Change since the oldest of the last SLOPE_SAMPLES samples, against the change
+  // PEEL_ONSET_SLOPE (g/s, i.e. mg/ms) would have made in that time.  No division by time.
+  oldest = filled < SLOPE_SAMPLES ? 0 : next;
+  if (filled)
+  {
+    rise = y - lastY[oldest];
+    yPrev = lastY[prev];
+    dt = (uint32_t)t - lastT[prev];
+    steep = PEEL_ONSET_SLOPE * (force_t)(((uint32_t)t - lastT[oldest]) / 1000) * (FORCE_PER_GRAM / 1000);
+  }
+  lastY[next] = y;
+  lastT[next] = (uint32_t)t;
+  next = next + 1 < SLOPE_SAMPLES ? next + 1 : 0;
+  filled = filled < SLOPE_SAMPLES ? filled + 1 : filled;
+
+  switch (state)
+  {
+  case IDLE:
+    if (y - baseline > GRAMS(PEEL_ONSET_GRAMS) && rise > steep)
+    {
+      state = LOADING;
+      peak = y;
+      tPeak = tState = t;
+      area = 0;
+      return emit(ev, PEEL_ONSET, t, y - baseline);
+    }
+    baseline += (y - baseline) >> BASELINE_SHIFT;
+    break;
+
+  case LOADING:
+    area += (int64_t)((y + yPrev) / 2 - baseline) * dt; // Trapezoids
+    if (y > peak)
+    {
+      peak = y;
+      tPeak = t;
+    }
+    else if (rise < -steep && y - baseline < (peak - baseline) / 100 * PEEL_RELEASE_PERCENT)
+    {
+      if (peak - baseline < GRAMS(PEEL_MIN_PEAK))
+      {
+        state = IDLE; // Just noise
+        break;
+      }
+      state = SETTLING;
+      tState = t;
+      stats.peels++;
+      return emit(ev, PEEL_RELEASE, t, peak - baseline);
+    }
+    break;
+
+  case SETTLING:
+    if (labs(y - baseline) < GRAMS(PEEL_ONSET_GRAMS) && labs(rise) < steep)
+    {
+      state = IDLE;
+    }
+    break;
+  }
+
+  if (state != IDLE && t - tState > PEEL_TIMEOUT_MS * 1000ULL)
+  {
+    // Somebody put something on the plate, or took it off - treat it as the new zero
+    state = IDLE;
+    baseline = y;
+  }
+  return false;
+}
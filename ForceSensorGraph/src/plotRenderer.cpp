@@ -0,0 +1,571 @@
+#include <Arduino.h>
+#include <string.h>
+#include <TFT_Charts.h>
+#include <TFT_ILI9341.h>
+#include "setup.h"
+#include "plotRenderer.h"
+
+#define EMPTY_TOP 0xFF
+#define EMPTY_BOTTOM 0
+#define MERGE_ROWS 4 // Pushing this many unchanged rows again costs about what a second address window does
+#define AXIS_Y (PLOT_Y + PLOT_H) // The X axis line, ChartXY's bottom
+#define TICK_ROWS 5              // X ticks, from the axis line down, as long as ChartXY::drawAxisX(tft, 10) makes them
+#define LABEL_Y (AXIS_Y + 8)     // X labels, where ChartXY::drawLabelsX() puts them...
+#define LABEL_DX 6               // ...this far left of their tick
+#define Y_LABELS_Y (PLOT_Y - 6)  // Y labels and ticks, left of the axis line: what scaleY() used to clear
+#define Y_LABELS_H (PLOT_H + 11)
+
+static_assert(PLOT_H * (PLOT_H / 2 + 1) <= (1 << 14) - 1, "PLOT_H too tall for the spans' 14 bits");
+
+static uint8_t clampRow(float r)
+{
+  if (r < 0)
+  {
+    return 0;
+  }
+  if (r > PLOT_H - 1)
+  {
+    return PLOT_H - 1;
+  }
+  return (uint8_t)(r + 0.5);
+}
+
+void PlotRenderer::reset(TFT_ILI9341 &tft, ChartXY &chart, uint32_t x)
+{
+  memset(spans, 0xFF, sizeof(spans)); // All EMPTY_SPAN
+  x0Ms = x;
+  scrolled = 0;
+  lastCol = -1;
+  shownCount = 0;
+  scrollNext = PLOT_W;
+  rescaleNext = PLOT_W;
+  mapY(chart);
+  drawRow0(tft, PLOT_Y0_COLOR);
+  tickCount = 0;
+  drawAxisX(tft, chart);
+}
+
+// Take the Y limits from the chart.  (yTop - y) * rowGain fits 32 bits for any y on the plot,
+// and is off by less than one row for spans up to 2^24 force units (16.7 kg).
+void PlotRenderer::mapY(ChartXY &chart)
+{
+  yTop = gramsToForce(chart.yMax);
+  yBottom = gramsToForce(chart.yMin);
+  rowGain = yTop > yBottom ? (uint32_t)((uint64_t)(PLOT_H - 1) << 24) / (uint32_t)(yTop - yBottom) : 0;
+  row0 = yBottom < 0 && yTop > 0 ? toRow(0) : NO_ROW;
+}
+
+uint8_t PlotRenderer::toRow(force_t y)
+{
+  if (y >= yTop)
+  {
+    return 0;
+  }
+  if (y <= yBottom)
+  {
+    return PLOT_H - 1;
+  }
+  return ((uint32_t)(yTop - y) * rowGain + ((uint32_t)1 << 23)) >> 24;
+}
+
+// Screen column of time tMs, PLOT_W or more once it is off the right edge
+int16_t PlotRenderer::toColumn(uint32_t tMs)
+{
+  int16_t col = (int32_t)(tMs - x0Ms) * PLOT_W / (XRANGE * 1000L) - scrolled;
+
+  return col < 0 ? 0 : col;
+}
+
+// Column c's span, EMPTY_TOP and EMPTY_BOTTOM for none
+void PlotRenderer::span(uint16_t c, uint8_t &top, uint8_t &bottom)
+{
+  uint16_t bit = c * SPAN_BITS, v, t, d;
+  const uint8_t *p = spans + bit / 8;
+  uint32_t w = p[0] | (uint16_t)p[1] << 8;
+
+  if (bit % 8 + SPAN_BITS > 16)
+  {
+    w |= (uint32_t)p[2] << 16;
+  }
+  v = (w >> bit % 8) & EMPTY_SPAN;
+  if (v == EMPTY_SPAN)
+  {
+    top = EMPTY_TOP;
+    bottom = EMPTY_BOTTOM;
+    return;
+  }
+  t = v / SPAN_RUN;
+  d = v % SPAN_RUN;
+  if (t + d < PLOT_H)
+  {
+    top = t;
+    bottom = t + d;
+  }
+  else
+  {
+    top = PLOT_H - 1 - t;
+    bottom = d + SPAN_RUN - 1;
+  }
+}
+
+// A span of PLOT_H rows has some 15,400 (top, bottom) pairs, so it fits 14 bits rather than
+// two bytes: top * SPAN_RUN + (bottom - top), with the spans too long for that folded into
+// the codes it leaves unused, the ones whose top + length would run off the plot
+void PlotRenderer::setSpan(uint16_t c, uint8_t top, uint8_t bottom)
+{
+  uint16_t bit = c * SPAN_BITS, v, d = bottom - top;
+  uint8_t *p = spans + bit / 8, s = bit % 8;
+  uint32_t mask, w;
+
+  if (bottom < top)
+  {
+    v = EMPTY_SPAN;
+  }
+  else if (d < SPAN_RUN)
+  {
+    v = top * SPAN_RUN + d;
+  }
+  else
+  {
+    v = (PLOT_H - 1 - top) * SPAN_RUN + d - (SPAN_RUN - 1) + top;
+  }
+  mask = (uint32_t)EMPTY_SPAN << s;
+  w = (uint32_t)v << s;
+  p[0] = (p[0] & ~mask) | w;
+  p[1] = (p[1] & ~(mask >> 8)) | w >> 8;
+  if (s + SPAN_BITS > 16)
+  {
+    p[2] = (p[2] & ~(mask >> 16)) | w >> 16;
+  }
+}
+
+// What row r of a column with the span top..bottom should show: the trace, over the Y=0
+// line, over the background
+uint16_t PlotRenderer::colorAt(ChartXY &chart, uint8_t top, uint8_t bottom, uint8_t r)
+{
+  if (r >= top && r <= bottom)
+  {
+    return PLOT_COLOR;
+  }
+  return r == row0 ? PLOT_Y0_COLOR : chart.tftBGColor;
+}
+
+// Change column c to show rows top..bottom.  The screen catches up in flush().
+void PlotRenderer::setColumn(TFT_ILI9341 &tft, ChartXY &chart, uint16_t c, uint8_t newTop, uint8_t newBottom)
+{
+  uint8_t i, top, bottom;
+
+  span(c, top, bottom);
+  if ((top == newTop && bottom == newBottom) || (bottom < top && newBottom < newTop))
+  {
+    return;
+  }
+
+  // Note what the screen shows, the first time the column changes in this frame
+  i = 0;
+  while (i < shownCount && shown[i].c != c)
+  {
+    i++;
+  }
+  if (i == shownCount)
+  {
+    if (shownCount == BATCH)
+    {
+      flush(tft, chart);
+      i = 0;
+    }
+    shown[i].c = c;
+    shown[i].top = top;
+    shown[i].bottom = bottom;
+    shownCount = i + 1;
+  }
+
+  setSpan(c, newTop, newBottom);
+}
+
+// Push the frame's changes.  In each column that is the rows above and below the part the
+// old and new spans have in common - in one address window, if few rows lie in between.
+void PlotRenderer::flush(TFT_ILI9341 &tft, ChartXY &chart)
+{
+  uint8_t i, top, bottom;
+  uint16_t c;
+  int16_t ot, ob, nt, nb, a0, a1, b0, b1;
+  boolean oldEmpty, newEmpty;
+
+  for (i = 0; i < shownCount; i++)
+  {
+    c = shown[i].c;
+    ot = shown[i].top;
+    ob = shown[i].bottom;
+    span(c, top, bottom);
+    nt = top;
+    nb = bottom;
+    oldEmpty = ob < ot;
+    newEmpty = nb < nt;
+
+    // The rows that change: a0..a1, and below them b0..b1
+    if (oldEmpty || newEmpty || nb < ot || nt > ob)
+    {
+      // No overlap: all of both spans
+      boolean newFirst = oldEmpty || (!newEmpty && nt < ot);
+      a0 = newFirst ? nt : ot;
+      a1 = newFirst ? nb : ob;
+      b0 = oldEmpty || newEmpty ? 1 : newFirst ? ot : nt;
+      b1 = oldEmpty || newEmpty ? 0 : newFirst ? ob : nb;
+    }
+    else
+    {
+      a0 = ot < nt ? ot : nt;
+      a1 = (ot > nt ? ot : nt) - 1;
+      b0 = (ob < nb ? ob : nb) + 1;
+      b1 = ob > nb ? ob : nb;
+    }
+    if (a1 < a0)
+    {
+      a0 = b0;
+      a1 = b1;
+      b1 = b0 - 1;
+    }
+    if (a1 < a0)
+    {
+      continue; // Back where it was
+    }
+
+    // Push the rows in between again rather than start a second window
+    if (b1 >= b0 && b0 - a1 - 1 <= MERGE_ROWS)
+    {
+      a1 = b1;
+      b1 = b0 - 1;
+    }
+    push(tft, chart, c, a0, a1);
+    if (b1 >= b0)
+    {
+      push(tft, chart, c, b0, b1);
+    }
+  }
+  shownCount = 0;
+}
+
+// Rows from..to of column c as they now should be, composed by colorAt().  In one colour
+// that is a single line; otherwise an address window and a run of each colour.
+void PlotRenderer::push(TFT_ILI9341 &tft, ChartXY &chart, uint16_t c, int16_t from, int16_t to)
+{
+  int16_t r = from, n;
+  uint16_t color;
+  uint8_t top, bottom;
+
+  span(c, top, bottom);
+  while (r <= to)
+  {
+    color = colorAt(chart, top, bottom, r);
+    for (n = 1; r + n <= to && colorAt(chart, top, bottom, r + n) == color; n++)
+    {
+    }
+    if (r == from)
+    {
+      if (n == to - from + 1)
+      {
+        tft.drawFastVLine(PLOT_X + c, PLOT_Y + from, n, color);
+        return;
+      }
+      tft.setAddrWindow(PLOT_X + c, PLOT_Y + from, PLOT_X + c, PLOT_Y + to);
+    }
+    tft.pushColor(color, n);
+    r += n;
+  }
+}
+
+// The Y=0 row right across the plot, in color wherever the trace does not cover it: one
+// address window, a run of pixels a colour
+void PlotRenderer::drawRow0(TFT_ILI9341 &tft, uint16_t color)
+{
+  uint16_t c, n;
+  uint8_t top, bottom;
+  boolean lit;
+
+  if (row0 == NO_ROW)
+  {
+    return;
+  }
+  tft.setAddrWindow(PLOT_X, PLOT_Y + row0, PLOT_X + PLOT_W - 1, PLOT_Y + row0);
+  span(0, top, bottom);
+  for (c = 0; c < PLOT_W; c += n)
+  {
+    lit = row0 >= top && row0 <= bottom;
+    for (n = 1; c + n < PLOT_W; n++)
+    {
+      span(c + n, top, bottom);
+      if ((row0 >= top && row0 <= bottom) != lit)
+      {
+        break;
+      }
+    }
+    tft.pushColor(lit ? PLOT_COLOR : color, n);
+  }
+}
+
+// Pixels across the label for s seconds
+static int16_t labelWidth(uint32_t s)
+{
+  int16_t w = 6;
+
+  for (; s >= 10; s /= 10)
+  {
+    w += 6;
+  }
+  return w;
+}
+
+// Put the X ticks and labels where the trace now has them.  A tick left where it was is left
+// alone; of a label that moved, only the part its new place does not cover is erased.
+void PlotRenderer::drawAxisX(TFT_ILI9341 &tft, ChartXY &chart)
+{
+  int16_t x[TICKS], col, a, b, w;
+  uint32_t s, firstS = 0;
+  uint8_t n = 0, i, j;
+
+  // Every XTICKTIME seconds from the left edge to the right one, inclusive
+  for (s = (x0Ms / 1000 + XTICKTIME - 1) / XTICKTIME * XTICKTIME; n < TICKS; s += XTICKTIME)
+  {
+    col = (int32_t)(s * 1000 - x0Ms) * PLOT_W / (XRANGE * 1000L) - scrolled;
+    if (col > PLOT_W)
+    {
+      break;
+    }
+    if (col >= 0)
+    {
+      firstS = n ? firstS : s;
+      x[n++] = PLOT_X + col;
+    }
+  }
+
+  for (i = 0; i < tickCount; i++)
+  {
+    for (j = 0; j < n && x[j] != tickX[i]; j++)
+    {
+    }
+    if (j == n)
+    {
+      tft.drawFastVLine(tickX[i], AXIS_Y + 1, TICK_ROWS - 1, chart.tftBGColor);
+    }
+
+    // The label it had, less the box the same label has now
+    s = firstTickS + i * XTICKTIME;
+    w = labelWidth(s);
+    a = tickX[i] - LABEL_DX;
+    b = a + w;
+    if (s >= firstS && s < firstS + n * XTICKTIME)
+    {
+      col = x[(s - firstS) / XTICKTIME] - LABEL_DX;
+      if (col == a)
+      {
+        b = a;
+      }
+      else if (col < a && col + w > a)
+      {
+        a = col + w;
+      }
+      else if (col > a && col < b)
+      {
+        b = col;
+      }
+    }
+    if (b > a)
+    {
+      tft.fillRect(a, LABEL_Y, b - a, 8, chart.tftBGColor);
+    }
+  }
+
+  tft.setTextSize(1);
+  tft.setTextColor(PLOT_AXIS_COLOR, chart.tftBGColor);
+  for (j = 0; j < n; j++)
+  {
+    s = firstS + j * XTICKTIME;
+    for (i = 0; i < tickCount && tickX[i] != x[j]; i++)
+    {
+    }
+    if (i < tickCount && firstTickS + i * XTICKTIME == s)
+    {
+      continue; // Already there
+    }
+    if (i == tickCount)
+    {
+      tft.drawFastVLine(x[j], AXIS_Y, TICK_ROWS, PLOT_AXIS_COLOR);
+    }
+    tft.setCursor(x[j] - LABEL_DX, LABEL_Y);
+    tft.print((unsigned long)s);
+  }
+
+  for (j = 0; j < n; j++)
+  {
+    tickX[j] = x[j];
+  }
+  tickCount = n;
+  firstTickS = firstS;
+}
+
+// Move the trace PLOT_SCROLL columns to the left, PLOT_SCROLL_STEP columns a call, and then
+// the X axis with it.  Going left to right, each column is read before it is overwritten.
+// A rescale is carried on the same way.
+void PlotRenderer::step(TFT_ILI9341 &tft, ChartXY &chart)
+{
+  uint16_t c, end = scrollNext + PLOT_SCROLL_STEP < PLOT_W ? scrollNext + PLOT_SCROLL_STEP : PLOT_W;
+  uint8_t top, bottom;
+
+  if (rescaleNext < PLOT_W)
+  {
+    rescaleStep(tft, chart);
+    return;
+  }
+  for (c = scrollNext; c < end; c++)
+  {
+    if (c + PLOT_SCROLL < PLOT_W)
+    {
+      span(c + PLOT_SCROLL, top, bottom);
+      setColumn(tft, chart, c, top, bottom);
+    }
+    else
+    {
+      setColumn(tft, chart, c, EMPTY_TOP, EMPTY_BOTTOM);
+    }
+  }
+  flush(tft, chart);
+  scrollNext = end;
+  if (scrollNext < PLOT_W)
+  {
+    return;
+  }
+
+  lastCol -= PLOT_SCROLL;
+  scrolled += PLOT_SCROLL;
+  if (scrolled >= PLOT_W)
+  {
+    scrolled -= PLOT_W;
+    x0Ms += XRANGE * 1000UL;
+  }
+  float xStart = x0Ms / 1000.0 + (float)scrolled * XRANGE / PLOT_W;
+  chart.setAxisLimitsX(xStart, xStart + XRANGE, XTICKTIME);
+  drawAxisX(tft, chart);
+
+  // Now the column that set it off, which may need another
+  addColumn(tft, chart, held);
+}
+
+void PlotRenderer::addSample(TFT_ILI9341 &tft, ChartXY &chart, uint32_t tMs, force_t y)
+{
+  int16_t c, col = toColumn(tMs);
+  uint8_t row = toRow(y), r0, r1, rt, rb, top, bottom;
+
+  if (col >= PLOT_W)
+  {
+    col = PLOT_W - 1; // addColumn() scrolls first
+  }
+
+  if (lastCol < 0 || col <= lastCol)
+  {
+    // Same column (or the first sample): widen the span to cover this row
+    c = col;
+    rt = rb = row;
+    if (lastCol >= 0)
+    {
+      rt = lastRow < rt ? lastRow : rt;
+      rb = lastRow > rb ? lastRow : rb;
+    }
+    span(c, top, bottom);
+    if (bottom >= top)
+    {
+      rt = top < rt ? top : rt;
+      rb = bottom > rb ? bottom : rb;
+    }
+    setColumn(tft, chart, c, rt, rb);
+  }
+  else
+  {
+    // Join the previous sample to this one, interpolating across the columns in between
+    r0 = lastRow;
+    for (c = lastCol + 1; c <= col; c++)
+    {
+      r1 = lastRow + (int16_t)(row - lastRow) * (c - lastCol) / (col - lastCol);
+      setColumn(tft, chart, c, r0 < r1 ? r0 : r1, r0 < r1 ? r1 : r0);
+      r0 = r1;
+    }
+  }
+  lastCol = col;
+  lastRow = row;
+}
+
+// All three land in the column of p.tMs, so they only widen its span.  The last sample is
+// where the join to the next column starts.
+void PlotRenderer::addColumn(TFT_ILI9341 &tft, ChartXY &chart, const ColumnPoint &p)
+{
+  if (toColumn(p.tMs) >= PLOT_W)
+  {
+    held = p;
+    scrollNext = 0;
+    return;
+  }
+  addSample(tft, chart, p.tMs, p.first);
+  addSample(tft, chart, p.tMs, p.second);
+  addSample(tft, chart, p.tMs, p.last);
+  flush(tft, chart);
+}
+
+void PlotRenderer::rescaleY(TFT_ILI9341 &tft, ChartXY &chart, float oldMin, float oldMax, float tick)
+{
+  yTick = tick;
+  rescaleK = (oldMax - oldMin) / (chart.yMax - chart.yMin);
+  rescaleShift = (chart.yMax - oldMax) * (PLOT_H - 1) / (chart.yMax - chart.yMin);
+
+  // The old Y=0 line goes, but not the trace over it
+  drawRow0(tft, chart.tftBGColor);
+  mapY(chart);
+  lastRow = clampRow(rescaleShift + lastRow * rescaleK);
+  rescaleNext = 0;
+}
+
+// row' = shift + row * k, for both ends of every span in the next PLOT_SCROLL_STEP columns,
+// and only the rows that differ from the old span are pushed.  The old Y labels are cleared
+// a band a call alongside, and the new Y=0 line, ticks and labels go in once every column
+// is done.
+void PlotRenderer::rescaleStep(TFT_ILI9341 &tft, ChartXY &chart)
+{
+  uint16_t c, end = rescaleNext + PLOT_SCROLL_STEP < PLOT_W ? rescaleNext + PLOT_SCROLL_STEP : PLOT_W;
+  uint16_t a, b;
+  uint8_t top, bottom;
+
+  for (c = rescaleNext; c < end; c++)
+  {
+    span(c, top, bottom);
+    if (bottom < top)
+    {
+      continue;
+    }
+    setColumn(tft, chart, c, clampRow(rescaleShift + top * rescaleK), clampRow(rescaleShift + bottom * rescaleK));
+  }
+  flush(tft, chart);
+
+  // And the matching band of the old Y labels
+  a = (uint32_t)Y_LABELS_H * rescaleNext / PLOT_W;
+  b = (uint32_t)Y_LABELS_H * end / PLOT_W;
+  tft.fillRect(0, Y_LABELS_Y + a, PLOT_X - 1, b - a, chart.tftBGColor);
+  rescaleNext = end;
+  if (rescaleNext == PLOT_W)
+  {
+    drawRow0(tft, PLOT_Y0_COLOR);
+    chart.drawAxisY(tft, 10);
+    drawLabelsY(tft, chart, yTick);
+  }
+}
+
+void PlotRenderer::drawLabelsY(TFT_ILI9341 &tft, ChartXY &chart, float tick)
+{
+  float y;
+
+  tft.setTextSize(1);
+  tft.setTextColor(PLOT_AXIS_COLOR, chart.tftBGColor);
+  for (y = chart.yMin; y <= chart.yMax && tick > 0; y += tick)
+  {
+    tft.setCursor(0, (int16_t)(AXIS_Y - (y - chart.yMin) * PLOT_H / (chart.yMax - chart.yMin)) - 4);
+    tft.print((int)y);
+  }
+}
@@ -0,0 +1,88 @@
+#include <Arduino.h>
+#include "scheduler.h"
+
+static Task *schedTasks;
+static uint8_t schedCount;
+
+void schedBegin(Task *tasks, uint8_t n)
+{
+  uint32_t now = micros();
+  uint8_t i;
+
+  schedTasks = tasks;
+  schedCount = n;
+  for (i = 0; i < n; i++)
+  {
+    tasks[i].dueUs = now;
+    tasks[i].signalled = false;
+    tasks[i].misses = 0;
+#ifdef SIM_NATIVE
+    tasks[i].wcetUs = tasks[i].maxLateUs = 0;
+#endif
+  }
+}
+
+// Mark an event task due.  Only the first signal sets the due time, so the lateness is
+// measured from the oldest unhandled event.
+void schedSignal(Task &t)
+{
+  if (!t.signalled)
+  {
+    t.dueUs = micros();
+    t.signalled = true;
+  }
+}
+
+bool schedRun()
+{
+  uint32_t now = timeUs(), due, start, late;
+  bool ready;
+  uint8_t i;
+
+  for (i = 0; i < schedCount; i++)
+  {
+    Task &t = schedTasks[i];
+
+    noInterrupts(); // dueUs may be written by an ISR
+    due = t.dueUs;
+    ready = t.periodMs ? (int32_t)(now - due) >= 0 : t.signalled;
+    if (ready)
+    {
+      t.signalled = false; // Signals from here on mean another run
+    }
+    interrupts();
+    if (!ready)
+    {
+      continue;
+    }
+
+    start = micros();
+    t.run();
+
+#ifdef SIM_NATIVE
+    uint32_t took = micros() - start;
+    if (took > t.wcetUs)
+    {
+      t.wcetUs = took;
+    }
+#endif
+    late = start - due;
+#ifdef SIM_NATIVE
+    if (late > t.maxLateUs)
+    {
+      t.maxLateUs = late;
+    }
+#endif
+    if (late > t.deadlineMs * 1000UL)
+    {
+      t.misses++;
+    }
+    if (t.periodMs)
+    {
+      // Keep to the period's phase, unless a whole period was lost: then start again from now
+      t.dueUs = late < t.periodMs * 1000UL ? due + t.periodMs * 1000UL : start + t.periodMs * 1000UL;
+    }
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,61 @@
+#include <Arduino.h>
+#include <string.h>
+#include "textFormat.h"
+
+// Write v's digits backwards from end, at least minDigits of them, and return the first.
+// Only the digits above 32 bits take the AVR's slow 64-bit division.
+static char *digits(char *end, uint64_t v, uint8_t minDigits)
+{
+  uint32_t v32;
+  uint8_t n = 0;
+
+  while (v >> 32)
+  {
+    *--end = '0' + (uint8_t)(v % 10);
+    v /= 10;
+    n++;
+  }
+  v32 = v;
+  do
+  {
+    *--end = '0' + (uint8_t)(v32 % 10);
+    v32 /= 10;
+    n++;
+  } while (v32 || n < minDigits);
+  return end;
+}
+
+char *formatForce(char *buf, force_t f, uint8_t decimals)
+{
+  static const uint16_t unit[] = {1000, 100, 10, 1}; // force_t per last digit, by decimals
+  char *p = buf + FORCE_TEXT_LEN - 1;
+  uint32_t u = f < 0 ? -(uint32_t)f : f;
+
+  decimals = decimals > 3 ? 3 : decimals;
+  u = (u + unit[decimals] / 2) / unit[decimals];
+
+  *p = 0;
+  if (decimals)
+  {
+    p = digits(p, u % unit[3 - decimals], decimals);
+    *--p = '.';
+  }
+  p = digits(p, u / unit[3 - decimals], 1);
+  if (f < 0 && u)
+  {
+    *--p = '-';
+  }
+  return (char *)memmove(buf, p, buf + FORCE_TEXT_LEN - p);
+}
+
+char *formatTime(char *buf, time_us t)
+{
+  char *p = buf + TIME_TEXT_LEN - 1;
+  uint64_t ms = t / 1000;
+
+  *p = 0;
+  p = digits(p, (uint16_t)(t - ms * 1000), 3);
+  *--p = '.';
+  p = digits(p, ms, 1);
+  return (char *)memmove(buf, p, buf + TIME_TEXT_LEN - p);
+}
@@ -0,0 +1,29 @@
+#include <Arduino.h>
+#include "timebase.h"
+#if defined(__AVR__)
+#include <util/atomic.h>
+#endif
+
+static uint32_t lastUs = 0; // micros() at the last call...
+static uint32_t wraps = 0;  // ...and how many times it has wrapped
+
+time_us timeUs()
+{
+  uint32_t now;
+  time_us t;
+
+#if defined(__AVR__)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) // Called from the ISR too, and it must not enable interrupts there
+#endif
+  {
+    now = micros();
+    if (now < lastUs)
+    {
+      wraps++;
+    }
+    lastUs = now;
+    t = (time_us)wraps << 32 | now;
+  }
+  return t;
+}
+
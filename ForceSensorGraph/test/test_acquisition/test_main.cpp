@@ -0,0 +1,228 @@
+// Acquisition against the simulated HX711 (sim/src/arduino.cpp): the chip model raises
+// DOUT at the conversion rate, shifts a bit out on every PD_SCK rising edge and powers
+// down if PD_SCK stays high for more than 60us, so these check the port-register transfer
+// bit for bit and its timing.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <unity.h>
+#include "setup.h"
+#include "sim.h"
+#include "sampleRing.h"
+#include "acquisition.h"
+
+static const uint64_t CONVERSION_NS = 1000000000ULL / HX711_RATE_HZ;
+
+// Let n conversions happen, draining the ring as loop() would
+static uint16_t drain(uint16_t n, RawSample *last = 0)
+{
+  RawSample s;
+  uint16_t got = 0;
+
+  while (n--)
+  {
+    simAdvance(CONVERSION_NS);
+    while (acqRead(s))
+    {
+      got++;
+      if (last)
+      {
+        *last = s;
+      }
+    }
+  }
+  return got;
+}
+
+void setUp()
+{
+  simConfig.trace = TRACE_FILE; // No trace loaded: zero load, so the counts are countsOffset
+  simConfig.noiseGrams = 0;
+  simConfig.driftGramsPerMin = 0;
+  simConfig.countsOffset = 8000;
+  drain(2);
+}
+
+void tearDown()
+{
+}
+
+static void test_ring_wraps_and_drops_when_full()
+{
+  SampleRing<uint16_t, 8> r;
+  uint16_t v, i, next = 0;
+
+  // Run the indices round the uint8_t a few times
+  for (i = 0; i < 1000; i++)
+  {
+    TEST_ASSERT_TRUE(r.push(i));
+    if (i % 3 != 0)
+    {
+      TEST_ASSERT_TRUE(r.pop(v));
+      TEST_ASSERT_EQUAL(next++, v);
+    }
+    if (r.count() == 8)
+    {
+      while (r.pop(v))
+      {
+        TEST_ASSERT_EQUAL(next++, v);
+      }
+    }
+  }
+  while (r.pop(v))
+  {
+    TEST_ASSERT_EQUAL(next++, v);
+  }
+  TEST_ASSERT_EQUAL(1000, next);
+  TEST_ASSERT_EQUAL(0, r.overruns);
+
+  for (i = 0; i < 10; i++)
+  {
+    r.push(i);
+  }
+  TEST_ASSERT_EQUAL(8, r.count());
+  TEST_ASSERT_EQUAL(2, r.overruns);
+  TEST_ASSERT_TRUE(r.pop(v));
+  TEST_ASSERT_EQUAL(0, v); // The oldest are kept, the newest dropped
+  r.flush();
+  TEST_ASSERT_TRUE(r.isEmpty());
+}
+
+static void test_counts_are_clocked_out_bit_for_bit()
+{
+  const long counts[] = {0, 1, -1, 0x5A5A5A, -0x5A5A5A, 123456, -123456, 0x7FFFFF, -0x800000};
+  RawSample s;
+  uint8_t i, c;
+
+  for (i = 0; i < sizeof(counts) / sizeof(counts[0]); i++)
+  {
+    simConfig.countsOffset = counts[i];
+    drain(2); // Flush out the conversion that was already in the chips
+    TEST_ASSERT_EQUAL(3, drain(3, &s));
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+      TEST_ASSERT_EQUAL(counts[i], s.count[c]);
+    }
+    TEST_ASSERT_EQUAL(ACQ_A128, s.input);
+  }
+}
+
+static void test_every_conversion_is_read_in_time()
+{
+  SimStats before = simStats;
+  uint64_t start = simNow();
+  RawSample s;
+  time_us lastT = 0;
+  uint16_t n = 0;
+
+  simStats.maxIrqOffNs = 0;
+  while (simNow() - start < 10000000000ULL)
+  {
+    simAdvance(CONVERSION_NS / 3);
+    while (acqRead(s))
+    {
+      // Timestamped at the readout, one conversion period apart
+      if (n++)
+      {
+        TEST_ASSERT_INT_WITHIN(200, CONVERSION_NS / 1000, s.t - lastT);
+      }
+      lastT = s.t;
+    }
+  }
+  TEST_ASSERT_INT_WITHIN(1, 10 * HX711_RATE_HZ, n);
+  TEST_ASSERT_EQUAL(simStats.conversions - before.conversions, simStats.readouts - before.readouts);
+  TEST_ASSERT_EQUAL(0, simStats.dropped - before.dropped);
+  TEST_ASSERT_EQUAL(0, simStats.powerDowns - before.powerDowns);
+  // The whole transfer, ISR entry included, stays under the 60us that powers the chip down
+  TEST_ASSERT_LESS_THAN(60000, simStats.maxIrqOffNs);
+  TEST_ASSERT_EQUAL(0, acqOverruns());
+}
+
+static void test_poll_is_harmless_alongside_the_interrupt()
+{
+  SimStats before = simStats;
+  uint16_t i, got = 0;
+
+  // Emptied as it goes: the 10 conversions are more than the ring holds
+  for (i = 0; i < 1000; i++)
+  {
+    acqPoll();
+    simAdvance(CONVERSION_NS / 100);
+    if (i % 100 == 99)
+    {
+      got += acqPending();
+      acqFlush();
+    }
+  }
+  TEST_ASSERT_INT_WITHIN(1, 10, got + acqPending());
+  acqFlush();
+  TEST_ASSERT_EQUAL(0, simStats.dropped - before.dropped);
+}
+
+static void test_full_ring_drops_the_newest()
+{
+  uint16_t before = acqOverruns();
+
+  acqFlush();
+  simAdvance(CONVERSION_NS * (SAMPLE_RING_LENGTH + 10) + CONVERSION_NS / 2);
+  TEST_ASSERT_EQUAL(SAMPLE_RING_LENGTH, acqPending());
+  TEST_ASSERT_EQUAL(10, acqOverruns() - before);
+  acqFlush();
+  TEST_ASSERT_EQUAL(0, acqPending());
+}
+
+static void test_schedule_switches_inputs_after_settling()
+{
+  const AcqSlot slots[] = {{ACQ_A128, 2}, {ACQ_B32, 1}};
+  const AcqSlot channelA[] = {{ACQ_A128, 1}};
+  RawSample s;
+  uint8_t inputs[32], n = 0, i;
+
+  acqSchedule(slots, 2);
+  drain(2 * (ACQ_SETTLE_CONVERSIONS + 3));
+  // Each cycle: 2 samples on A, the switch, 1 on B, the switch back
+  for (i = 0; i < 4 * (2 * ACQ_SETTLE_CONVERSIONS + 3); i++)
+  {
+    simAdvance(CONVERSION_NS);
+    while (acqRead(s) && n < sizeof(inputs))
+    {
+      inputs[n++] = s.input;
+    }
+  }
+  TEST_ASSERT_INT_WITHIN(1, 12, n);
+  for (i = 0; i + 3 < n; i++)
+  {
+    if (inputs[i] == ACQ_B32)
+    {
+      TEST_ASSERT_EQUAL(ACQ_A128, inputs[i + 1]);
+      TEST_ASSERT_EQUAL(ACQ_A128, inputs[i + 2]);
+      TEST_ASSERT_EQUAL(ACQ_B32, inputs[i + 3]);
+    }
+  }
+
+  acqSchedule(channelA, 1);
+  drain(ACQ_SETTLE_CONVERSIONS + 2);
+  TEST_ASSERT_EQUAL(3, drain(3, &s));
+  TEST_ASSERT_EQUAL(ACQ_A128, s.input);
+}
+
+int main()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint8_t c;
+
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    simAddChip(douts[c], HX711_SCK);
+  }
+  acqBegin(douts, HX711_SCK);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_wraps_and_drops_when_full);
+  RUN_TEST(test_counts_are_clocked_out_bit_for_bit);
+  RUN_TEST(test_every_conversion_is_read_in_time);
+  RUN_TEST(test_poll_is_harmless_alongside_the_interrupt);
+  RUN_TEST(test_full_ring_drops_the_newest);
+  RUN_TEST(test_schedule_switches_inputs_after_settling);
+  return UNITY_END();
+}
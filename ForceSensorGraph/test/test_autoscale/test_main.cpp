@@ -0,0 +1,110 @@
+// The whole firmware on the simulator under loads that swing between a few grams and a few
+// kilograms, which has the Y axis rescaled out as each one comes and back in once it has left
+// the window.  The re-projection of the trace and the new Y labels are spread over the plot
+// task's runs, so the samples must keep to their schedule while it happens.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <TFT_Charts.h>
+#include <EEPROM.h>
+#include <unity.h>
+#include "setup.h"
+#include "sim.h"
+#include "scheduler.h"
+
+void setup();
+void loop();
+
+extern Task tasks[];
+extern const uint8_t taskCount;
+
+static const uint64_t SECOND_NS = 1000000000ULL;
+static const char TRACE[] = "test_autoscale.csv";
+
+// A load held LOAD_S seconds at each level, longer than the autoscale window, stepping to the
+// next in a tenth of a second
+#define LOAD_S 45
+static const int LEVELS[] = {100, 3000, 100, 3000, 100};
+
+static void writeTrace()
+{
+  FILE *f = fopen(TRACE, "w");
+  uint8_t i;
+
+  TEST_ASSERT_NOT_NULL(f);
+  fprintf(f, "# seconds,grams\n");
+  for (i = 0; i < sizeof(LEVELS) / sizeof(LEVELS[0]); i++)
+  {
+    fprintf(f, "%d.1,%d\n%d,%d\n", i * LOAD_S, LEVELS[i], (i + 1) * LOAD_S, LEVELS[i]);
+  }
+  fclose(f);
+}
+
+static void runFirmwareUntil(uint64_t ns)
+{
+  while (simNow() < ns)
+  {
+    loop();
+    simAdvance(simConfig.loopPassNs);
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Past the first full legend and autoscale, the loads: several rescales, and through them no
+// task misses a deadline or starts later than it allows, and no conversion is dropped
+static void test_samples_on_time_through_autoscale()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint64_t rescales, dropped;
+  uint16_t misses[16], i;
+  char line[100];
+
+  writeTrace();
+  TEST_ASSERT_TRUE(simLoadTrace(TRACE));
+  remove(TRACE);
+  simConfig.trace = TRACE_FILE;
+  for (i = 0; i < LOADCELL_COUNT; i++)
+  {
+    simAddChip(douts[i], HX711_SCK);
+  }
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.data[EEPROM_ADDR] = (uint8_t)simConfig.countsPerGram;
+  setup();
+  runFirmwareUntil(20 * SECOND_NS);
+  for (i = 0; i < taskCount; i++)
+  {
+    misses[i] = tasks[i].misses;
+    tasks[i].maxLateUs = 0;
+  }
+  rescales = simStats.yRescales;
+  dropped = simStats.dropped;
+  runFirmwareUntil((sizeof(LEVELS) / sizeof(LEVELS[0]) - 1) * LOAD_S * SECOND_NS);
+
+  snprintf(line, sizeof(line), "%lu Y rescales", (unsigned long)(simStats.yRescales - rescales));
+  TEST_MESSAGE(line);
+  TEST_ASSERT_GREATER_OR_EQUAL(3, simStats.yRescales - rescales);
+  for (i = 0; i < taskCount; i++)
+  {
+    snprintf(line, sizeof(line), "%-8s late %lu us (deadline %u ms), %u misses", tasks[i].name,
+             (unsigned long)tasks[i].maxLateUs, tasks[i].deadlineMs, tasks[i].misses - misses[i]);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(misses[i], tasks[i].misses);
+    TEST_ASSERT_TRUE(tasks[i].maxLateUs <= tasks[i].deadlineMs * 1000UL);
+  }
+  TEST_ASSERT_TRUE(simStats.dropped == dropped);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_samples_on_time_through_autoscale);
+  return UNITY_END();
+}
@@ -0,0 +1,163 @@
+// On the board only: pio test -e leonardo -f test_avr_cycles, with the Leonardo plugged in.
+// CPU cycles per sample of the fixed-point path (cellForce(), the int64_t running sum and
+// integer min/max, as samplesTask() does them) against the float path it replaced
+// (HX711::get_units()'s float division, a float sum and float min/max), and of each filter
+// stage (filterChain.h) and the chain setup.h configures.  Timer1 runs at the CPU clock, so
+// TCNT1 read before and after counts cycles, less what an empty measurement costs.  Also the
+// time setup() spends restoring the calibration from the store.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <unity.h>
+#include "setup.h"
+#include "loadCell.h"
+#include "filterChain.h"
+#include "calStore.h"
+
+static const uint8_t RUNS = 64;
+
+static volatile long countIn;
+static volatile force_t forceOut;
+static volatile float floatOut;
+
+static int64_t sum;
+static force_t fMin, fMax;
+static float floatSum, floatMin, floatMax, scale = 212.5f;
+static long offset = 8000;
+
+static void empty()
+{
+  forceOut = countIn;
+}
+
+static void fixedPath()
+{
+  RawSample s;
+
+  s.count[0] = countIn;
+  force_t f = cellForce(s, 0);
+  sum += f;
+  fMin = f < fMin ? f : fMin;
+  fMax = f > fMax ? f : fMax;
+  forceOut = f;
+}
+
+static void floatPath()
+{
+  float g = (float)(countIn - offset) / scale;
+
+  floatSum += g;
+  floatMin = g < floatMin ? g : floatMin;
+  floatMax = g > floatMax ? g : floatMax;
+  floatOut = g;
+}
+
+static MedianFilter<3> median3;
+static MedianFilter<5> median5;
+static LowPass<10, HX711_RATE_HZ> lowPass;
+static FirDecimator<15, 4> fir;
+static FilterChain<MedianFilter<FILTER_MEDIAN>, LowPass<FILTER_LOWPASS_HZ, HX711_RATE_HZ>,
+                   FirDecimator<FILTER_FIR_TAPS, FILTER_DECIMATE>>
+    chain;
+
+template <typename Filter, Filter &filter>
+static void filterSample()
+{
+  force_t out;
+
+  filter.update(countIn, out);
+  forceOut = out;
+}
+
+// Mean cycles of f() over RUNS counts across the 24-bit range, interrupts off
+static uint16_t cycles(void (*f)())
+{
+  uint32_t total = 0;
+  uint16_t t0;
+  uint8_t i, sreg;
+
+  for (i = 0; i < RUNS; i++)
+  {
+    countIn = ((long)i * 262139L) - 0x800000L;
+    sreg = SREG;
+    cli();
+    t0 = TCNT1;
+    f();
+    total += (uint16_t)(TCNT1 - t0);
+    SREG = sreg;
+  }
+  return total / RUNS;
+}
+
+static void test_fixed_point_beats_float()
+{
+  char line[80];
+  uint16_t base, fixed, viaFloat;
+
+  cellOffset[0] = offset;
+  setCellScales(scale);
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10); // Clock / 1
+  base = cycles(empty);
+  fixed = cycles(fixedPath) - base;
+  viaFloat = cycles(floatPath) - base;
+  snprintf(line, sizeof(line), "Cycles per sample: fixed point %u, float %u", fixed, viaFloat);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(viaFloat, fixed);
+}
+
+// Each stage, per input sample, within 5% of an 80Hz sample period
+static void test_filter_stage_cycles()
+{
+  const uint16_t budget = F_CPU / 80 / 20;
+  char line[100];
+  uint16_t base = cycles(empty), m3, m5, lp, decimate, configured;
+
+  m3 = cycles(filterSample<MedianFilter<3>, median3>) - base;
+  m5 = cycles(filterSample<MedianFilter<5>, median5>) - base;
+  lp = cycles(filterSample<LowPass<10, HX711_RATE_HZ>, lowPass>) - base;
+  decimate = cycles(filterSample<FirDecimator<15, 4>, fir>) - base;
+  configured = cycles(filterSample<decltype(chain), chain>) - base;
+  snprintf(line, sizeof(line), "Cycles per sample: median 3 %u, median 5 %u, low-pass %u, FIR 15/4 %u", m3, m5, lp,
+           decimate);
+  TEST_MESSAGE(line);
+  snprintf(line, sizeof(line), "Cycles per sample: setup.h's chain %u", configured);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(budget, m5);
+  TEST_ASSERT_LESS_THAN(budget, lp);
+  TEST_ASSERT_LESS_THAN(budget, decimate);
+  TEST_ASSERT_LESS_THAN(budget, configured);
+}
+
+// calStoreLoad() reads every slot and checks each CRC: the whole of a restore at startup
+static void test_restore_time()
+{
+  CalRecord r;
+  char line[60];
+  uint16_t t0, ticks;
+
+  TCCR1B = _BV(CS11); // Clock / 8: half a microsecond a tick
+  cli();
+  t0 = TCNT1;
+  calStoreLoad(CAL_PROFILE, r);
+  ticks = TCNT1 - t0;
+  sei();
+  TCCR1B = _BV(CS10);
+  snprintf(line, sizeof(line), "calStoreLoad() over %u slots: %u us", CAL_STORE_SLOTS, ticks / 2);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_LESS_THAN(5000, ticks / 2);
+}
+
+void setup()
+{
+  delay(2000); // For the host to open the port after the reset
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_point_beats_float);
+  RUN_TEST(test_filter_stage_cycles);
+  RUN_TEST(test_restore_time);
+  UNITY_END();
+}
+
+void loop()
+{
+}
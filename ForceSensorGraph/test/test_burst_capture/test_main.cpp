@@ -0,0 +1,323 @@
+// Burst capture (burstCapture.cpp) on synthetic trigger sequences, fed straight to
+// burstFeed() and read back off the simulator's serial port: one burst per rise through
+// BURST_LEVEL_GRAMS, each with its history and BURST_POST_SAMPLES from the trigger on, in
+// order and with the counts intact; re-arming only below half the level; short histories
+// after a reset or a burst; and a burst cut short, not the sampling stalled, when nothing
+// sends it.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "setup.h"
+#include "sim.h"
+#include "burstCapture.h"
+
+static const uint32_t PERIOD_US = 12500;
+
+struct Burst
+{
+  uint16_t burst, pre, post;
+  uint8_t source, channels;
+  uint32_t tTrigger;
+  uint8_t infos;                  // FRAME_INFOs before it
+  std::vector<uint32_t> t;        // Every conversion, unwrapped from the deltas
+  std::vector<long> count;        // The first cell's count of each
+  std::vector<uint8_t> flags;     // ...and its flags
+  uint16_t seqGaps;
+};
+
+static size_t readFrom; // Serial bytes already parsed
+static uint32_t tNow;
+static long counter;    // Each conversion's count, so none can be mistaken for another
+
+static uint16_t crc16(const uint8_t *p, uint8_t len)
+{
+  uint16_t crc = 0xFFFF;
+
+  while (len--)
+  {
+    crc ^= (uint16_t)*p++ << 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+  return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+// The bursts sent since the last call.  Every byte must be part of an intact frame.
+static std::vector<Burst> sent()
+{
+  const std::vector<uint8_t> &serial = simSerialBytes();
+  std::vector<Burst> bursts;
+  uint8_t infos = 0;
+  uint16_t seq = 0;
+
+  while (readFrom < serial.size())
+  {
+    const uint8_t *p = &serial[readFrom], *q = p + 4;
+    TEST_ASSERT_TRUE(readFrom + 6 <= serial.size());
+    TEST_ASSERT_EQUAL_HEX8(0xA5, p[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x5A, p[1]);
+    TEST_ASSERT_TRUE(readFrom + 6 + p[3] <= serial.size());
+    TEST_ASSERT_EQUAL(crc16(p + 2, p[3] + 2), get16(q + p[3]));
+    readFrom += p[3] + 6;
+
+    if (p[2] == 0x02)
+    {
+      infos++;
+    }
+    else if (p[2] == 0x03)
+    {
+      Burst b;
+      b.burst = get16(q);
+      b.tTrigger = get32(q + 2);
+      b.pre = get16(q + 6);
+      b.post = get16(q + 8);
+      b.source = q[10];
+      b.channels = q[11];
+      b.infos = infos;
+      b.seqGaps = 0;
+      bursts.push_back(b);
+      infos = 0;
+    }
+    else
+    {
+      TEST_ASSERT_EQUAL(0x01, p[2]);
+      TEST_ASSERT_FALSE(bursts.empty());
+      Burst &b = bursts.back();
+      uint32_t t = get32(q + 2);
+      b.seqGaps += !b.t.empty() && get16(q) != seq;
+      for (const uint8_t *s = q + 6; s < q + p[3]; s += 6 * LOADCELL_COUNT)
+      {
+        t += get16(s);
+        b.t.push_back(t);
+        b.count.push_back((int32_t)((uint32_t)s[2] | s[3] << 8 | (uint32_t)s[4] << 16) << 8 >> 8);
+        b.flags.push_back(s[5]);
+        for (uint8_t c = 1; c < LOADCELL_COUNT; c++)
+        {
+          TEST_ASSERT_EQUAL(0, get16(s + 6 * c)); // Later cells of a conversion: dt 0
+          TEST_ASSERT_EQUAL(c, s[6 * c + 5] >> 6);
+        }
+      }
+      seq = get16(q) + (p[3] - 6) / 6;
+    }
+  }
+  TEST_ASSERT_EQUAL(0, infos); // No FRAME_INFO without its burst
+  return bursts;
+}
+
+// A conversion with `grams` on the plate, sent as burstPoll() would be from loop()
+static void conversion(double grams, bool poll = true, uint32_t periodUs = PERIOD_US)
+{
+  RawSample s;
+
+  tNow += periodUs;
+  s.t = tNow;
+  s.input = ACQ_A128;
+  counter = counter >= 0x7FFFFE ? -0x7FFFFF : counter + 1;
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    s.count[c] = counter;
+  }
+  burstFeed(s, gramsToForce(grams));
+  if (poll)
+  {
+    burstPoll();
+  }
+}
+
+static void conversions(uint16_t n, double grams)
+{
+  while (n--)
+  {
+    conversion(grams);
+  }
+}
+
+// Each burst whole: pre + post conversions a period apart with nothing skipped, the
+// trigger flagged on the pre-th, where the load reached the level
+static void checkBurst(const Burst &b, uint16_t pre, uint32_t periodUs = PERIOD_US)
+{
+  size_t i;
+
+  TEST_ASSERT_EQUAL(LOADCELL_COUNT, b.infos);
+  TEST_ASSERT_EQUAL(LOADCELL_COUNT, b.channels);
+  TEST_ASSERT_EQUAL(pre, b.pre);
+  TEST_ASSERT_EQUAL(BURST_POST_SAMPLES, b.post);
+  TEST_ASSERT_EQUAL(b.pre + b.post, b.t.size());
+  TEST_ASSERT_EQUAL(0, b.seqGaps);
+  for (i = 0; i < b.t.size(); i++)
+  {
+    TEST_ASSERT_EQUAL(i == b.pre, !!(b.flags[i] & 0x08));
+    if (i)
+    {
+      TEST_ASSERT_EQUAL(periodUs, b.t[i] - b.t[i - 1]);
+      TEST_ASSERT_EQUAL(b.count[i - 1] == 0x7FFFFE ? -0x7FFFFF : b.count[i - 1] + 1, b.count[i]);
+    }
+  }
+  TEST_ASSERT_EQUAL(b.tTrigger, b.t[b.pre]);
+}
+
+void setUp()
+{
+  burstBegin();
+  memset(&burstStats, 0, sizeof(burstStats));
+  readFrom = simSerialBytes().size();
+  tNow = 0xFFFFFFFF - 5000000; // The low 32 bits of timeUs() wrap 5 s in
+}
+
+void tearDown()
+{
+}
+
+// Loads put on and taken off: a burst each time it rises through the level, with the
+// whole history, its counts intact across the micros() wrap and the 24-bit one
+static void test_level_bursts()
+{
+  std::vector<Burst> bursts;
+  uint8_t i;
+
+  counter = 0x7FFFFF - 700;
+  for (i = 0; i < 5; i++)
+  {
+    conversions(200, 0);
+    conversions(1, BURST_LEVEL_GRAMS / 2.0);
+    conversions(300, BURST_LEVEL_GRAMS * 3);
+  }
+  bursts = sent();
+  TEST_ASSERT_EQUAL(5, bursts.size());
+  for (i = 0; i < 5; i++)
+  {
+    checkBurst(bursts[i], BURST_PRE_SAMPLES);
+    TEST_ASSERT_EQUAL(BURST_BY_LEVEL, bursts[i].source);
+    TEST_ASSERT_EQUAL(bursts[0].burst + i, bursts[i].burst);
+  }
+  TEST_ASSERT_EQUAL(5, burstStats.bursts);
+  TEST_ASSERT_EQUAL(5 * (BURST_PRE_SAMPLES + BURST_POST_SAMPLES), burstStats.samples);
+  TEST_ASSERT_EQUAL(0, burstStats.truncated);
+  TEST_ASSERT_TRUE(bursts[0].t[0] > bursts[4].t[0]); // Wrapped
+}
+
+// A load hovering about the level fires once, and only again once it has been under half
+static void test_level_hysteresis()
+{
+  std::vector<Burst> bursts;
+  uint16_t i;
+
+  for (i = 0; i < 2000; i++)
+  {
+    conversion(BURST_LEVEL_GRAMS * (1 + 0.1 * sin(i * 0.7)));
+  }
+  conversions(200, BURST_LEVEL_GRAMS * 0.6);
+  conversions(200, BURST_LEVEL_GRAMS * 1.2);
+  TEST_ASSERT_EQUAL(1, sent().size());
+
+  conversions(200, BURST_LEVEL_GRAMS * 0.4);
+  conversions(200, BURST_LEVEL_GRAMS * 1.2);
+  bursts = sent();
+  TEST_ASSERT_EQUAL(1, bursts.size());
+  checkBurst(bursts[0], BURST_PRE_SAMPLES);
+
+  // A single spike an outlier filter would drop doesn't count
+  conversions(200, 0);
+  conversion(OUTLIER_GRAMS * 2);
+  conversions(200, 0);
+  TEST_ASSERT_EQUAL(0, sent().size());
+}
+
+// Just after a reset, or a burst, the history is only what came since: triggers in the post
+// samples belong to that burst
+static void test_short_history()
+{
+  std::vector<Burst> bursts;
+
+  conversions(10, 0);
+  conversions(300, BURST_LEVEL_GRAMS); // 10 in
+  bursts = sent();
+  TEST_ASSERT_EQUAL(1, bursts.size());
+  checkBurst(bursts[0], 10);
+
+  // Off and on again inside the burst from the next
+  conversions(200, 0);
+  conversions(50, BURST_LEVEL_GRAMS);
+  conversions(20, 0);
+  conversions(BURST_POST_SAMPLES - 70, BURST_LEVEL_GRAMS);
+  conversions(15, 0);
+  conversions(200, BURST_LEVEL_GRAMS);
+  bursts = sent();
+  TEST_ASSERT_EQUAL(2, bursts.size());
+  checkBurst(bursts[0], BURST_PRE_SAMPLES);
+  checkBurst(bursts[1], 15);
+
+  // A tare half way through a burst drops it, and the next has only what came after
+  conversions(200, 0);
+  conversions(60, BURST_LEVEL_GRAMS);
+  burstReset();
+  readFrom = simSerialBytes().size();
+  conversions(25, 0);
+  conversions(200, BURST_LEVEL_GRAMS);
+  bursts = sent();
+  TEST_ASSERT_EQUAL(1, bursts.size());
+  checkBurst(bursts[0], 25);
+}
+
+// At 10Hz the gaps don't fit a frame's 16-bit deltas: a conversion a frame, still whole
+static void test_slow_rate()
+{
+  std::vector<Burst> bursts;
+  uint16_t i;
+
+  for (i = 0; i < 300; i++)
+  {
+    conversion(i < 100 ? 0 : BURST_LEVEL_GRAMS, true, 100000);
+  }
+  bursts = sent();
+  TEST_ASSERT_EQUAL(1, bursts.size());
+  checkBurst(bursts[0], BURST_PRE_SAMPLES, 100000);
+}
+
+// Nothing sending (the host stopped reading): the ring fills, the burst is cut short and
+// counted, and the next one is whole once sending resumes
+static void test_stalled_send_cuts_the_burst()
+{
+  std::vector<Burst> bursts;
+
+  conversions(100, 0);
+  for (uint16_t i = 0; i < 200; i++)
+  {
+    conversion(BURST_LEVEL_GRAMS, false);
+  }
+  TEST_ASSERT_EQUAL(1, burstStats.truncated);
+  conversions(100, 0);
+  conversions(200, BURST_LEVEL_GRAMS);
+  bursts = sent();
+  TEST_ASSERT_EQUAL(2, bursts.size());
+  TEST_ASSERT_TRUE(bursts[0].t.size() < (size_t)BURST_PRE_SAMPLES + BURST_POST_SAMPLES);
+  TEST_ASSERT_TRUE(bursts[0].t.size() > BURST_PRE_SAMPLES);
+  checkBurst(bursts[1], BURST_PRE_SAMPLES);
+  TEST_ASSERT_EQUAL(1, burstStats.truncated);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_level_bursts);
+  RUN_TEST(test_level_hysteresis);
+  RUN_TEST(test_short_history);
+  RUN_TEST(test_slow_rate);
+  RUN_TEST(test_stalled_send_cuts_the_burst);
+  return UNITY_END();
+}
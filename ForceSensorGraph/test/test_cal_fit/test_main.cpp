@@ -0,0 +1,253 @@
+// CalFit on synthetic noisy counts, added a window at a time as the calibration job does:
+// scale, offset and linearity recovered, the same answer as a least-squares fit over every
+// sample in double, a 95% interval that holds the true scale 95% of the time, and the fits
+// it must refuse.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "calFit.h"
+
+static const uint8_t WINDOW = 16; // SETTLE_SAMPLES
+static const double SCALE = 212.5, OFFSET = -1234;
+
+static uint32_t noiseState;
+
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// Every sample, for the reference fit in double: sums of x (kg), x^2, y, xy, y^2
+struct Sums
+{
+  double n, x, xx, y, xy, yy;
+};
+
+// `windows` windows of counts under `grams`, with noise of `noiseGrams` rms, a `curve` in
+// counts per g^2, into the fit and the sums
+static void hang(CalFit &fit, Sums &s, double grams, uint8_t windows, double noiseGrams, double curve = 0)
+{
+  int64_t sum, sumSq;
+  long v;
+  uint8_t w, i;
+
+  for (w = 0; w < windows; w++)
+  {
+    sum = sumSq = 0;
+    for (i = 0; i < WINDOW; i++)
+    {
+      v = lround(OFFSET + SCALE * (grams + noise(noiseGrams)) + curve * grams * grams);
+      sum += v;
+      sumSq += (int64_t)v * v;
+      s.n++;
+      s.x += grams / 1000;
+      s.xx += grams / 1000 * grams / 1000;
+      s.y += v;
+      s.xy += grams / 1000 * v;
+      s.yy += (double)v * v;
+    }
+    TEST_ASSERT_TRUE(fit.add(grams, WINDOW, sum, sumSq));
+  }
+}
+
+void setUp()
+{
+  noiseState = 12345;
+}
+
+void tearDown()
+{
+}
+
+// Zero and a kilogram, four windows each as the job collects them (0.8 s of data a mass at
+// 80Hz): the scale and offset of the straight line through every sample, in double
+static void test_two_masses_match_the_exact_fit()
+{
+  CalFit fit;
+  CalResult r;
+  Sums s = {};
+  double scale, offset, rms;
+  char line[120];
+
+  fit.clear();
+  hang(fit, s, 0, 4, 5);
+  hang(fit, s, 1000, 4, 5);
+  TEST_ASSERT_EQUAL(2, fit.count());
+  TEST_ASSERT_TRUE(fit.solve(false, r));
+
+  scale = (s.n * s.xy - s.x * s.y) / (s.n * s.xx - s.x * s.x);
+  offset = (s.y - scale * s.x) / s.n;
+  rms = sqrt((s.yy - offset * s.y - scale * s.xy) / (s.n - 2)) / (scale / 1000);
+  snprintf(line, sizeof(line), "Scale %.4f (exact fit %.4f, true %.1f), offset %.1f (%.1f), %.2f g rms (%.2f), +/-%.3f%%",
+           r.scale, scale / 1000, SCALE, r.offset, offset, r.rmsGrams, rms, r.scaleCi);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(128, r.samples);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5 * SCALE, scale / 1000, r.scale);
+  TEST_ASSERT_FLOAT_WITHIN(0.5, offset, r.offset);
+  TEST_ASSERT_FLOAT_WITHIN(0.01 * rms, rms, r.rmsGrams);
+  TEST_ASSERT_FLOAT_WITHIN(0, 0, r.curve);
+  // 5 g of noise over 64 samples a mass: a fraction of a percent
+  TEST_ASSERT_TRUE(r.scaleCi < 0.2);
+  TEST_ASSERT_TRUE(fabs(r.scale - SCALE) / SCALE * 100 <= 2 * r.scaleCi);
+}
+
+// Over many calibrations, the 95% interval holds the true scale about 95% of the time
+static void test_confidence_interval_covers()
+{
+  const uint16_t trials = 1000;
+  uint16_t t, covered = 0;
+  CalFit fit;
+  CalResult r;
+  Sums s;
+  char line[80];
+
+  for (t = 0; t < trials; t++)
+  {
+    fit.clear();
+    hang(fit, s, 0, 4, 20);
+    hang(fit, s, 500, 4, 20);
+    hang(fit, s, 2000, 4, 20);
+    TEST_ASSERT_TRUE(fit.solve(false, r));
+    covered += fabs(r.scale - SCALE) / SCALE * 100 <= r.scaleCi;
+  }
+  snprintf(line, sizeof(line), "95%% interval held the scale in %u of %u calibrations", covered, trials);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_INT_WITHIN(25, 950, covered);
+}
+
+// One mass: the line goes through the tare, and only the scale is fitted
+static void test_single_mass_goes_through_the_tare()
+{
+  CalFit fit;
+  CalResult r;
+  Sums s = {};
+
+  fit.clear();
+  hang(fit, s, 1000, 4, 5);
+  TEST_ASSERT_TRUE(fit.solve(false, r));
+  TEST_ASSERT_EQUAL(0, r.offset);
+  // The tare it goes through is OFFSET, which the counts here weren't taken against.  Within
+  // 3 sd of the mean of 64 samples.
+  TEST_ASSERT_FLOAT_WITHIN(3 * 5 / 8.0 * SCALE / 1000, (OFFSET + 1000 * SCALE) / 1000, r.scale);
+}
+
+// A cell reading 2% over at 10 kg: three masses or more fit the bow, and the fit without it
+// shows it in its residual
+static void test_quadratic_fits_the_bow()
+{
+  const double curve = 0.02 * SCALE / 10000; // Counts per g^2
+  CalFit fit;
+  CalResult linear, bent;
+  Sums s = {};
+  char line[120];
+
+  fit.clear();
+  hang(fit, s, 0, 4, 2, curve);
+  hang(fit, s, 2000, 4, 2, curve);
+  hang(fit, s, 5000, 4, 2, curve);
+  hang(fit, s, 10000, 4, 2, curve);
+  TEST_ASSERT_TRUE(fit.solve(false, linear));
+  TEST_ASSERT_TRUE(fit.solve(true, bent));
+  snprintf(line, sizeof(line), "Curve %.3e counts/g^2 (true %.3e), %.2f g rms; straight line %.2f g rms",
+           bent.curve, curve, bent.rmsGrams, linear.rmsGrams);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_FLOAT_WITHIN(0.02 * curve, curve, bent.curve);
+  TEST_ASSERT_FLOAT_WITHIN(0.001 * SCALE, SCALE, bent.scale);
+  TEST_ASSERT_FLOAT_WITHIN(SCALE, OFFSET, bent.offset); // A gram
+  TEST_ASSERT_TRUE(bent.rmsGrams < 2.5);
+  TEST_ASSERT_TRUE(linear.rmsGrams > 10 * bent.rmsGrams);
+
+  // Two masses can't show a bow: a straight line
+  fit.clear();
+  hang(fit, s, 0, 4, 2, curve);
+  hang(fit, s, 10000, 4, 2, curve);
+  TEST_ASSERT_TRUE(fit.solve(true, bent));
+  TEST_ASSERT_EQUAL(0, bent.curve);
+}
+
+// Windows of one mass merge into one point, the same as one window of all of them: a mass
+// hung again after another becomes a point of its own
+static void test_windows_merge()
+{
+  CalFit merged, single;
+  CalResult a, b;
+  Sums s = {};
+  int64_t sum = 0, sumSq = 0;
+  long v;
+  uint8_t i;
+
+  merged.clear();
+  single.clear();
+  for (i = 0; i < 64; i++)
+  {
+    v = lround(OFFSET + SCALE * (1000 + noise(10)));
+    sum += v;
+    sumSq += (int64_t)v * v;
+    if (i % WINDOW == WINDOW - 1)
+    {
+      merged.add(1000, WINDOW, sum, sumSq);
+      sum = sumSq = 0;
+    }
+  }
+  noiseState = 12345;
+  hang(single, s, 1000, 4, 10);
+  TEST_ASSERT_EQUAL(1, merged.count());
+  TEST_ASSERT_TRUE(merged.solve(false, a));
+  TEST_ASSERT_TRUE(single.solve(false, b));
+  TEST_ASSERT_FLOAT_WITHIN(1e-6 * a.scale, a.scale, b.scale);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4 * a.rmsGrams, a.rmsGrams, b.rmsGrams);
+
+  hang(merged, s, 0, 1, 10);
+  hang(merged, s, 1000, 1, 10);
+  TEST_ASSERT_EQUAL(3, merged.count());
+}
+
+static void test_refuses_what_it_cannot_fit()
+{
+  CalFit fit;
+  CalResult r;
+  Sums s = {};
+  uint8_t i;
+
+  fit.clear();
+  TEST_ASSERT_FALSE(fit.solve(false, r)); // Nothing
+  TEST_ASSERT_TRUE(fit.add(1000, 0, 0, 0)); // An empty window adds nothing
+  TEST_ASSERT_EQUAL(0, fit.count());
+
+  hang(fit, s, 0, 4, 5);
+  TEST_ASSERT_FALSE(fit.solve(false, r)); // Only the zero: no scale
+
+  // Counts going down as the mass goes up: wired backwards
+  fit.clear();
+  fit.add(0, WINDOW, 0, 0);
+  fit.add(1000, WINDOW, -(int64_t)WINDOW * 212500, (int64_t)WINDOW * 212500 * 212500);
+  TEST_ASSERT_FALSE(fit.solve(false, r));
+
+  // No room for a seventh point
+  fit.clear();
+  for (i = 0; i < CAL_MAX_POINTS; i++)
+  {
+    hang(fit, s, i % 2 ? 1000 : 0, 1, 5);
+  }
+  TEST_ASSERT_FALSE(fit.add(500, WINDOW, 0, 0));
+  TEST_ASSERT_TRUE(fit.solve(false, r));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_two_masses_match_the_exact_fit);
+  RUN_TEST(test_confidence_interval_covers);
+  RUN_TEST(test_single_mass_goes_through_the_tare);
+  RUN_TEST(test_quadratic_fits_the_bow);
+  RUN_TEST(test_windows_merge);
+  RUN_TEST(test_refuses_what_it_cannot_fit);
+  return UNITY_END();
+}
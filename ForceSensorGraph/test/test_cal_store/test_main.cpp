@@ -0,0 +1,273 @@
+// The calibration store (calStore.cpp) against the simulator's in-memory EEPROM: records
+// round trip at full precision, profiles keep their newest record, wear spreads evenly over
+// the slots, a save cut short or corrupted leaves the last good record in force, and the
+// sequence numbers wrap.  Then saveCells()/restoreCells() through it.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <EEPROM.h>
+#include <unity.h>
+#include "setup.h"
+#include "calStore.h"
+#include "loadCell.h"
+
+static uint32_t slotWrites[CAL_STORE_SLOTS]; // Saves that changed each slot
+
+// Write out the queued save, a byte per poll as loop() would
+static void flush()
+{
+  uint8_t before[CAL_STORE_SLOTS * sizeof(CalRecord)];
+  uint16_t i;
+
+  memcpy(before, EEPROM.data + CAL_STORE_ADDR, sizeof(before));
+  while (calStoreBusy())
+  {
+    calStorePoll();
+  }
+  for (i = 0; i < sizeof(before); i++)
+  {
+    if (before[i] != EEPROM.data[CAL_STORE_ADDR + i])
+    {
+      slotWrites[i / sizeof(CalRecord)]++;
+      i = (i / sizeof(CalRecord) + 1) * sizeof(CalRecord) - 1;
+    }
+  }
+}
+
+static CalRecord record(uint8_t profile, float scale)
+{
+  CalRecord r;
+
+  memset(&r, 0, sizeof(r));
+  r.profile = profile;
+  r.scale = scale;
+  r.curve = -144115188; // -2e-9 per mg, Q56
+  r.cells = LOADCELL_COUNT;
+  for (uint8_t c = 0; c < CAL_RECORD_CELLS; c++)
+  {
+    r.offset[c] = -8388608 + 1234567 * c; // Down to the 24-bit minimum
+  }
+  return r;
+}
+
+static bool save(uint8_t profile, float scale)
+{
+  CalRecord r = record(profile, scale);
+
+  if (!calStoreSave(r))
+  {
+    return false;
+  }
+  flush();
+  return true;
+}
+
+void setUp()
+{
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  memset(slotWrites, 0, sizeof(slotWrites));
+  EEPROM.writes = 0;
+}
+
+void tearDown()
+{
+}
+
+static void test_round_trip_at_full_precision()
+{
+  CalRecord in = record(3, 212.537f), out;
+
+  TEST_ASSERT_FALSE(calStoreLoad(3, out)); // Erased EEPROM
+  TEST_ASSERT_TRUE(calStoreSave(in));
+  TEST_ASSERT_TRUE(calStoreBusy());
+  TEST_ASSERT_FALSE(calStoreLoad(3, out)); // Not until the CRC is written
+  flush();
+  TEST_ASSERT_TRUE(calStoreLoad(3, out));
+  TEST_ASSERT_EQUAL_MEMORY(&in, &out, sizeof(CalRecord));
+  TEST_ASSERT_TRUE(out.scale == 212.537f);
+  TEST_ASSERT_FALSE(calStoreLoad(4, out));
+}
+
+// Profiles side by side, each loading its own newest record however many saves of another
+// come after it
+static void test_profiles_keep_their_newest()
+{
+  CalRecord r;
+  uint16_t i;
+
+  TEST_ASSERT_TRUE(save(0, 100));
+  TEST_ASSERT_TRUE(save(1, 200));
+  TEST_ASSERT_TRUE(save(0, 101));
+  for (i = 0; i < 10 * CAL_STORE_SLOTS; i++)
+  {
+    TEST_ASSERT_TRUE(save(2, 300 + i));
+  }
+  TEST_ASSERT_TRUE(calStoreLoad(0, r));
+  TEST_ASSERT_TRUE(r.scale == 101);
+  TEST_ASSERT_TRUE(calStoreLoad(1, r));
+  TEST_ASSERT_TRUE(r.scale == 200);
+  TEST_ASSERT_TRUE(calStoreLoad(2, r));
+  TEST_ASSERT_TRUE(r.scale == 300 + i - 1);
+}
+
+// A thousand recalibrations, every slot written as often as the next: one record's worth
+// of bytes each time, less those that happened to be right already
+static void test_wear_is_level()
+{
+  uint32_t least = UINT32_MAX, most = 0;
+  uint16_t i;
+  uint8_t s;
+  char line[100];
+
+  save(1, 200); // Another profile's record, which the round-robin steps over
+  for (i = 0; i < 1000; i++)
+  {
+    TEST_ASSERT_TRUE(save(0, 100 + i * 0.01f));
+  }
+  for (s = 0; s < CAL_STORE_SLOTS; s++)
+  {
+    least = slotWrites[s] < least ? slotWrites[s] : least;
+    most = slotWrites[s] > most ? slotWrites[s] : most;
+  }
+  snprintf(line, sizeof(line), "1000 saves: %lu bytes written, %lu to %lu saves per slot",
+           (unsigned long)EEPROM.writes, (unsigned long)least, (unsigned long)most);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(EEPROM.writes <= 1001UL * sizeof(CalRecord));
+  // The other profile's slot is written once; the rest share the thousand
+  TEST_ASSERT_EQUAL(1, least);
+  least = UINT32_MAX;
+  for (s = 0; s < CAL_STORE_SLOTS; s++)
+  {
+    least = slotWrites[s] > 1 && slotWrites[s] < least ? slotWrites[s] : least;
+  }
+  TEST_ASSERT_TRUE(most - least <= 1);
+}
+
+// A reset partway through a save, at every byte: the record before it is still loaded
+static void test_save_cut_short()
+{
+  CalRecord r, out;
+  uint8_t stop, b;
+  bool cut;
+
+  for (stop = 0; stop < sizeof(CalRecord); stop++)
+  {
+    setUp();
+    save(0, 100);
+    r = record(0, 150);
+    calStoreSave(r);
+    for (b = 0; b < stop; b++)
+    {
+      calStorePoll();
+    }
+    // Power cut here: the rest never gets written.  Bytes that were right already take no
+    // poll, so the last few stops may have finished it.
+    cut = calStoreBusy();
+    r = record(0, 0);
+    calStoreSave(r); // Queues a new save, dropping the old one...
+    TEST_ASSERT_TRUE(calStoreLoad(0, out));
+    TEST_ASSERT_TRUE(out.scale == (cut ? 100 : 150));
+    flush(); // ...which replaces it whole
+    TEST_ASSERT_TRUE(calStoreLoad(0, out));
+    TEST_ASSERT_TRUE(out.scale == 0);
+  }
+}
+
+// A flipped bit anywhere in the newest record, the version included, passes it over for
+// the one before
+static void test_corrupt_records_are_ignored()
+{
+  CalRecord out;
+  uint16_t addr, i;
+
+  save(0, 100);
+  save(0, 200);
+  addr = CAL_STORE_ADDR + sizeof(CalRecord); // The second slot, the first save went in the first
+  for (i = 0; i < sizeof(CalRecord) * 8; i++)
+  {
+    EEPROM.data[addr + i / 8] ^= 1 << i % 8;
+    TEST_ASSERT_TRUE(calStoreLoad(0, out));
+    TEST_ASSERT_TRUE(out.scale == 100);
+    EEPROM.data[addr + i / 8] ^= 1 << i % 8;
+  }
+  TEST_ASSERT_TRUE(calStoreLoad(0, out));
+  TEST_ASSERT_TRUE(out.scale == 200);
+}
+
+// Sequence numbers wrap after 65536 saves; the newest still wins
+static void test_sequence_wraps()
+{
+  CalRecord out;
+  uint32_t i;
+
+  for (i = 0; i < 70000; i++)
+  {
+    save(0, i);
+  }
+  TEST_ASSERT_TRUE(calStoreLoad(0, out));
+  TEST_ASSERT_TRUE(out.scale == 69999);
+  TEST_ASSERT_EQUAL(70000 & 0xFFFF, out.seq);
+}
+
+// One newest record per slot leaves nowhere to write: the save is refused and nothing lost
+static void test_full_store_refuses()
+{
+  CalRecord out;
+  uint8_t p;
+
+  for (p = 0; p < CAL_STORE_SLOTS; p++)
+  {
+    TEST_ASSERT_TRUE(save(p, p));
+  }
+  TEST_ASSERT_FALSE(save(CAL_STORE_SLOTS, 1));
+  TEST_ASSERT_FALSE(save(0, 1));
+  for (p = 0; p < CAL_STORE_SLOTS; p++)
+  {
+    TEST_ASSERT_TRUE(calStoreLoad(p, out));
+    TEST_ASSERT_TRUE(out.scale == p);
+  }
+}
+
+// The load cell's side: what saveCells() stores, restoreCells() puts back, no tare needed
+static void test_cells_restore()
+{
+  RawSample s;
+  force_t before;
+  uint8_t c;
+
+  setCellScales(212.537f);
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    cellOffset[c] = -765432 + c;
+    s.count[c] = 1000000;
+  }
+  before = totalForce(s);
+  saveCells();
+  flush();
+
+  setCellScales(1);
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    cellOffset[c] = 0;
+  }
+  TEST_ASSERT_TRUE(restoreCells());
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    TEST_ASSERT_EQUAL(-765432 + c, cellOffset[c]);
+  }
+  TEST_ASSERT_EQUAL(before, totalForce(s));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_round_trip_at_full_precision);
+  RUN_TEST(test_profiles_keep_their_newest);
+  RUN_TEST(test_wear_is_level);
+  RUN_TEST(test_save_cut_short);
+  RUN_TEST(test_corrupt_records_are_ignored);
+  RUN_TEST(test_sequence_wraps);
+  RUN_TEST(test_full_store_refuses);
+  RUN_TEST(test_cells_restore);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// A calibration through the whole firmware on the simulator, the button pressed as a user
+// would: nothing on the plate, then the reference mass.  The calibration screens, and the
+// chart after them, go up a piece per control task run, so the sampling must not notice:
+// every conversion read and streamed, and no task late.
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <TFT_Charts.h>
+#include <EEPROM.h>
+#include <unity.h>
+#include "setup.h"
+#include "sim.h"
+#include "scheduler.h"
+#include "acquisition.h"
+#include "loadCell.h"
+
+void setup();
+void loop();
+
+extern Task tasks[];
+extern const uint8_t taskCount;
+
+static const uint64_t SECOND_NS = 1000000000ULL;
+static const char TRACE[] = "test_calibration_screens.csv";
+
+// The reference mass goes on at MASS_S seconds
+#define MASS_S 25
+
+static void writeTrace()
+{
+  FILE *f = fopen(TRACE, "w");
+
+  TEST_ASSERT_NOT_NULL(f);
+  fprintf(f, "# seconds,grams\n0,0\n%d,0\n%d.1,%d\n%d,%d\n", MASS_S, MASS_S, REFERENCE_MASS, 10 * MASS_S,
+          REFERENCE_MASS);
+  fclose(f);
+}
+
+static void runFirmwareUntil(uint64_t ns)
+{
+  while (simNow() < ns)
+  {
+    loop();
+    simAdvance(simConfig.loopPassNs);
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Long press at 5 s, double-clicks once the plate is empty and once the mass is on.  The
+// screens come and go, the stream carries a line for every sample without a gap, and the
+// new scale reads the mass.
+static void test_calibration_loses_no_samples()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint64_t readouts, dropped, period = SECOND_NS / simConfig.sampleRateHz;
+  uint16_t misses[16], overruns, i, lines = 0, gaps = 0;
+  size_t firstLine;
+  double ms, g = 0, lastMs = 0;
+  char line[100];
+
+  writeTrace();
+  TEST_ASSERT_TRUE(simLoadTrace(TRACE));
+  remove(TRACE);
+  simConfig.trace = TRACE_FILE;
+  simConfig.countsPerGram = 200;
+  for (i = 0; i < LOADCELL_COUNT; i++)
+  {
+    simAddChip(douts[i], HX711_SCK);
+  }
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.data[EEPROM_ADDR] = 180; // 10% out
+  setup();
+  runFirmwareUntil(5 * SECOND_NS);
+  for (i = 0; i < taskCount; i++)
+  {
+    misses[i] = tasks[i].misses;
+    tasks[i].maxLateUs = 0;
+  }
+  readouts = simStats.readouts;
+  dropped = simStats.dropped;
+  overruns = acqOverruns();
+  firstLine = simSerialLines().size();
+
+  calibrateHandler();
+  runFirmwareUntil(6 * SECOND_NS);
+  TEST_ASSERT_TRUE(calibrationShown());
+  runFirmwareUntil(12 * SECOND_NS);
+  endHandler();
+  runFirmwareUntil((MASS_S + 5) * SECOND_NS);
+  endHandler();
+  while (calibrationShown() && simNow() < (MASS_S + 30) * SECOND_NS)
+  {
+    runFirmwareUntil(simNow() + SECOND_NS / 10);
+  }
+  TEST_ASSERT_FALSE(calibrationShown());
+  runFirmwareUntil(simNow() + 2 * SECOND_NS);
+
+  for (i = 0; i < taskCount; i++)
+  {
+    snprintf(line, sizeof(line), "%-8s late %lu us (deadline %u ms), %u misses", tasks[i].name,
+             (unsigned long)tasks[i].maxLateUs, tasks[i].deadlineMs, tasks[i].misses - misses[i]);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(misses[i], tasks[i].misses);
+    TEST_ASSERT_TRUE(tasks[i].maxLateUs <= tasks[i].deadlineMs * 1000UL);
+  }
+  TEST_ASSERT_TRUE(simStats.dropped == dropped);
+  TEST_ASSERT_EQUAL(overruns, acqOverruns());
+
+#ifdef STREAM_SERIAL
+  for (size_t l = firstLine; l < simSerialLines().size(); l++)
+  {
+    if (sscanf(simSerialLines()[l].c_str(), "s,%lf,%lf", &ms, &g) != 2)
+    {
+      continue;
+    }
+    gaps += lines && (ms - lastMs) * 1e6 > 1.5 * period;
+    lastMs = ms;
+    lines++;
+  }
+  snprintf(line, sizeof(line), "%u stream lines for %lu samples, %u gaps, last %.1f g", lines,
+           (unsigned long)(simStats.readouts - readouts), gaps, g);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(0, gaps);
+  TEST_ASSERT_INT_WITHIN(2, simStats.readouts - readouts, lines); // The ring holds a couple at the end
+  TEST_ASSERT_TRUE(fabs(g - REFERENCE_MASS) < 10);
+#endif
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_calibration_loses_no_samples);
+  return UNITY_END();
+}
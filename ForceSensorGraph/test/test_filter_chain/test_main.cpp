@@ -0,0 +1,208 @@
+// The filter stages (filterChain.h): the low-pass and the FIR decimator's frequency response
+// against the designs they come from, measured with sine waves through the integer code,
+// the median's spike rejection, and the pass-through stages.  Cycles per sample on the
+// board are test_avr_cycles.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include "filterChain.h"
+
+static const uint16_t RATE_HZ = 80;
+static const double AMPLITUDE = 1000; // Grams
+
+// Gain of `filter` at hz: a sine through it, long enough to settle, then the output's
+// component at hz over a whole number of periods, against the input's amplitude.  Samples
+// dropped by a decimator are simply missing from the sum.
+template <typename Filter>
+static double gainAt(Filter &filter, double hz)
+{
+  const uint32_t settle = 40 * RATE_HZ, measure = 40 * RATE_HZ;
+  double re = 0, im = 0, w = 2 * M_PI * hz / RATE_HZ;
+  force_t out;
+  uint32_t i, n = 0;
+
+  filter.reset();
+  for (i = 0; i < settle + measure; i++)
+  {
+    if (filter.update(gramsToForce((float)(AMPLITUDE * sin(w * i) + 2 * AMPLITUDE)), out) && i >= settle)
+    {
+      re += (out - GRAMS(2 * AMPLITUDE)) * cos(w * i);
+      im += (out - GRAMS(2 * AMPLITUDE)) * sin(w * i);
+      n++;
+    }
+  }
+  return 2 * sqrt(re * re + im * im) / n / GRAMS(AMPLITUDE);
+}
+
+// The bilinear transform's second order Butterworth
+static double butterworth(double hz, double cutoffHz)
+{
+  double r = tan(M_PI * hz / RATE_HZ) / tan(M_PI * cutoffHz / RATE_HZ);
+  return 1 / sqrt(1 + r * r * r * r);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_low_pass_follows_butterworth()
+{
+  LowPass<10, RATE_HZ> lp10;
+  LowPass<2, RATE_HZ> lp2;
+  const double hz[] = {0.5, 1, 2, 5, 8, 10, 15, 20, 30, 38};
+  uint8_t i;
+  char line[120];
+
+  for (i = 0; i < sizeof(hz) / sizeof(hz[0]); i++)
+  {
+    double g10 = gainAt(lp10, hz[i]), g2 = gainAt(lp2, hz[i]);
+    snprintf(line, sizeof(line), "%5.1f Hz: 10 Hz low-pass %.4f (design %.4f), 2 Hz %.4f (design %.4f)", hz[i],
+             g10, butterworth(hz[i], 10), g2, butterworth(hz[i], 2));
+    TEST_MESSAGE(line);
+    // Within 0.1% of the input, and 1% of the design's gain
+    TEST_ASSERT_FLOAT_WITHIN(0.001 + 0.01 * butterworth(hz[i], 10), butterworth(hz[i], 10), g10);
+    TEST_ASSERT_FLOAT_WITHIN(0.001 + 0.01 * butterworth(hz[i], 2), butterworth(hz[i], 2), g2);
+  }
+  // -3 dB at the cutoff
+  TEST_ASSERT_FLOAT_WITHIN(0.01, M_SQRT1_2, gainAt(lp10, 10));
+}
+
+// A constant load comes out to the milligram, whatever came before it
+static void test_low_pass_dc_is_exact()
+{
+  LowPass<1, RATE_HZ> lp;
+  force_t out = 0;
+  uint32_t i;
+
+  for (i = 0; i < 2000; i++)
+  {
+    lp.update(i < 500 ? GRAMS(5000) : 12345, out);
+  }
+  TEST_ASSERT_EQUAL(12345, out);
+
+  lp.reset();
+  lp.update(-777, out); // A reset primes with the first sample: no transient
+  TEST_ASSERT_EQUAL(-777, out);
+}
+
+// The Hamming-windowed sinc FirDecimator designs, its middle tap trimmed for a DC gain of
+// 1, in double
+static double firDesign(double hz, uint8_t taps, uint8_t m)
+{
+  double mid = (taps - 1) / 2.0, re = 0, im = 0, x, h[255], sum = 0, w = 2 * M_PI * hz / RATE_HZ;
+  uint8_t i;
+
+  for (i = 0; i < taps; i++)
+  {
+    x = (i - mid) / m;
+    h[i] = x == 0 ? 1.0 / m : sin(M_PI * x) / (M_PI * x) / m;
+    h[i] *= 0.54 - 0.46 * cos(2 * M_PI * i / (taps - 1));
+    sum += h[i];
+  }
+  h[taps / 2] += 1 - sum;
+  for (i = 0; i < taps; i++)
+  {
+    re += h[i] * cos(w * i);
+    im += h[i] * sin(w * i);
+  }
+  return sqrt(re * re + im * im);
+}
+
+// Passes what the decimated rate can carry and stops what would alias into it, as designed.
+// 15 taps leave a transition band from the new Nyquist frequency to about twice it.  No
+// multiples of 10 Hz, which land on DC or the new Nyquist, where one phase can't tell.
+static void test_fir_decimator_response()
+{
+  FirDecimator<15, 4> fir; // 80 Hz down to 20 Hz: Nyquist 10 Hz
+  const double hz[] = {0.5, 1, 3, 5, 8, 12, 15, 18, 22, 25, 33, 38};
+  uint8_t i;
+  char line[100];
+
+  for (i = 0; i < sizeof(hz) / sizeof(hz[0]); i++)
+  {
+    double g = gainAt(fir, hz[i]), design = firDesign(hz[i], 15, 4);
+    snprintf(line, sizeof(line), "%5.1f Hz: FIR 15/4 %.4f (design %.4f)", hz[i], g, design);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_FLOAT_WITHIN(0.001 + 0.01 * design, design, g);
+    if (hz[i] <= 3)
+    {
+      TEST_ASSERT_TRUE(g > 0.95);
+    }
+    if (hz[i] >= 20)
+    {
+      TEST_ASSERT_TRUE(g < 0.01); // 40 dB down
+    }
+  }
+}
+
+static void test_fir_decimator_keeps_one_in_m()
+{
+  FirDecimator<15, 4> fir;
+  force_t out;
+  uint16_t i, n = 0;
+
+  for (i = 0; i < 400; i++)
+  {
+    n += fir.update(GRAMS(100), out);
+    if (n)
+    {
+      TEST_ASSERT_EQUAL(GRAMS(100), out); // The taps sum to exactly 1
+    }
+  }
+  TEST_ASSERT_EQUAL(100, n);
+}
+
+// Spikes up to (N - 1) / 2 samples long vanish, steps come through whole, (N - 1) / 2 late
+static void test_median_rejects_spikes()
+{
+  MedianFilter<5> m;
+  force_t in, out;
+  uint16_t i;
+
+  for (i = 0; i < 200; i++)
+  {
+    in = GRAMS(100);
+    if (i % 20 == 10 || i % 20 == 11)
+    {
+      in = GRAMS(20000); // Two sample glitch
+    }
+    if (i >= 150)
+    {
+      in = GRAMS(300); // Step
+    }
+    m.update(in, out);
+    TEST_ASSERT_EQUAL(i < 152 ? GRAMS(100) : GRAMS(300), out);
+  }
+}
+
+static void test_disabled_stages_pass_through()
+{
+  FilterChain<MedianFilter<1>, LowPass<0, RATE_HZ>, FirDecimator<15, 1>> chain;
+  force_t out;
+  int32_t i;
+
+  for (i = -100000; i < 100000; i += 77)
+  {
+    TEST_ASSERT_TRUE(chain.update(i, out));
+    TEST_ASSERT_EQUAL(i, out);
+  }
+  // Nothing kept: a byte per empty stage, to keep their addresses apart
+  TEST_ASSERT_EQUAL(4, sizeof(chain));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_low_pass_follows_butterworth);
+  RUN_TEST(test_low_pass_dc_is_exact);
+  RUN_TEST(test_fir_decimator_response);
+  RUN_TEST(test_fir_decimator_keeps_one_in_m);
+  RUN_TEST(test_median_rejects_spikes);
+  RUN_TEST(test_disabled_stages_pass_through);
+  return UNITY_END();
+}
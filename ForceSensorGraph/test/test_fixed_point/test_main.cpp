@@ -0,0 +1,175 @@
+// The fixed-point sample path (force.h, loadCell.cpp) against the float maths it replaced:
+// HX711::get_units() dividing the tared count by the float scale, and the float running sum.
+// Both are checked against exact double arithmetic.  Cycles per sample on the board are
+// test_avr_cycles.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <unity.h>
+#include <stdlib.h>
+#include <math.h>
+#include "setup.h"
+#include "loadCell.h"
+
+static uint32_t randState = 1;
+
+static int32_t randomCount()
+{
+  randState = randState * 1664525u + 1013904223u;
+  return (int32_t)(randState << 8) >> 8; // Anywhere in the 24-bit range
+}
+
+void setUp()
+{
+  uint8_t c;
+
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    cellOffset[c] = 0;
+  }
+  cellCurve = 0;
+}
+
+void tearDown()
+{
+}
+
+// cellForce() is within half a milligram, plus a count's worth of the Q16 gain's rounding
+// per count, of the exact (count - offset) / scale, for scales from a coarse 2 counts/g to
+// a fine 2000, offsets anywhere and counts across the whole 24-bit range.  The float path
+// it replaced is measured against the same.
+static void test_counts_to_force_against_exact()
+{
+  const float scales[] = {2, 21.7f, 200, 420.5f, 2000};
+  RawSample s;
+  double exact, worstFixed = 0, worstFloat = 0, err;
+  float viaFloat;
+  force_t f;
+  uint8_t i;
+  uint32_t n;
+  char line[100];
+
+  for (i = 0; i < sizeof(scales) / sizeof(scales[0]); i++)
+  {
+    setCellScales(scales[i]);
+    for (n = 0; n < 200000; n++)
+    {
+      cellOffset[0] = randomCount() / 4;
+      s.count[0] = randomCount();
+      exact = (double)(s.count[0] - cellOffset[0]) / scales[i] * FORCE_PER_GRAM;
+      if (fabs(exact) > INT32_MAX)
+      {
+        continue; // Over 2147 kg, more than force_t holds: only the coarsest scales get there
+      }
+      f = cellForce(s, 0);
+      viaFloat = (float)(s.count[0] - cellOffset[0]) / scales[i]; // get_units()
+
+      err = fabs(f - exact);
+      TEST_ASSERT_TRUE(err <= 0.5 + fabs((double)(s.count[0] - cellOffset[0])) / (1 << FORCE_GAIN_SHIFT));
+      worstFixed = err > worstFixed ? err : worstFixed;
+      err = fabs(viaFloat * FORCE_PER_GRAM - exact);
+      worstFloat = err > worstFloat ? err : worstFloat;
+    }
+  }
+  snprintf(line, sizeof(line), "Worst error: fixed point %.2f mg, float %.2f mg", worstFixed, worstFloat);
+  TEST_MESSAGE(line);
+}
+
+// At the scales load cells actually have, within a milligram and 5 ppm across +/-20 kg
+static void test_usual_scales_within_5_ppm()
+{
+  const float scales[] = {180, 212.5f, 420};
+  RawSample s;
+  double exact;
+  uint8_t i;
+  int32_t g;
+
+  for (i = 0; i < sizeof(scales) / sizeof(scales[0]); i++)
+  {
+    setCellScales(scales[i]);
+    for (g = -20000; g <= 20000; g += 7)
+    {
+      s.count[0] = lround(g * scales[i]);
+      exact = s.count[0] / (double)scales[i] * FORCE_PER_GRAM;
+      TEST_ASSERT_TRUE(fabs(cellForce(s, 0) - exact) <= 1 + fabs(exact) * 5e-6);
+    }
+  }
+}
+
+// The linearity correction f + k f^2 (CAL_LINEARISE) against the same in double, or none
+static void test_linearity_correction_against_exact()
+{
+  RawSample s;
+  double k = -2e-9, f, exact; // Per mg: 2% low at 10 kg
+  uint8_t c;
+  int32_t g;
+
+  setCellScales(200);
+  cellCurve = lround(k * 72057594037927936.0); // Q56
+  for (g = -20000; g <= 20000; g += 13)
+  {
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+      s.count[c] = (long)g * 200 / LOADCELL_COUNT;
+    }
+    f = 0;
+    for (c = 0; c < LOADCELL_COUNT; c++)
+    {
+      f += cellForce(s, c);
+    }
+#ifdef CAL_LINEARISE
+    exact = f + k * f * f;
+#else
+    exact = f;
+#endif
+    TEST_ASSERT_INT_WITHIN(2, lround(exact), totalForce(s));
+  }
+}
+
+// The running sum behind the legend's mean: 24 hours at 80Hz of 150 g, +/-1 g.  A float
+// sum stops growing once each sample is under half its last bit; the int64_t one is exact.
+static void test_running_sum_stays_exact()
+{
+  const uint32_t samples = 24UL * 3600 * 80;
+  int64_t sum = 0;
+  float floatSum = 0;
+  force_t f;
+  uint32_t i;
+  char line[100];
+
+  for (i = 0; i < samples; i++)
+  {
+    f = GRAMS(150) + (i & 1 ? 1 : -1) * (int32_t)(i / 2 % 1001); // Pairs cancel
+    sum += f;
+    floatSum += forceToGrams(f);
+  }
+  TEST_ASSERT_TRUE(sum == (int64_t)samples * GRAMS(150));
+  snprintf(line, sizeof(line), "Mean of %lu samples: int64_t %.3f g, float %.3f g",
+           (unsigned long)samples, (double)sum / samples / FORCE_PER_GRAM, floatSum / samples);
+  TEST_MESSAGE(line);
+  // What the float sum made of it, to show why it went
+  TEST_ASSERT_TRUE(fabs(floatSum / samples - 150) > 1);
+}
+
+static void test_grams_round_trip()
+{
+  int32_t mg;
+
+  for (mg = -2000000; mg <= 2000000; mg += 997)
+  {
+    TEST_ASSERT_EQUAL(mg, gramsToForce(forceToGrams(mg)));
+  }
+  TEST_ASSERT_EQUAL(-1500, gramsToForce(-1.5f));
+  TEST_ASSERT_EQUAL(1500, gramsToForce(1.5f));
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_counts_to_force_against_exact);
+  RUN_TEST(test_usual_scales_within_5_ppm);
+  RUN_TEST(test_linearity_correction_against_exact);
+  RUN_TEST(test_running_sum_stays_exact);
+  RUN_TEST(test_grams_round_trip);
+  return UNITY_END();
+}
@@ -0,0 +1,278 @@
+// PeelDetector over the simulator's peel traces (sim/src/trace.cpp: idle, the lift with the
+// suction building up, the sudden release and the ringing after it) at the HX711's sample
+// rates, with noise, drift and a range of peak forces.  Latency is counted in samples, from
+// the first sample taken at or after the release in the trace to the one that reports it.
+// Then the whole firmware on the simulator, for the trigger pin.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <EEPROM.h>
+#include <unity.h>
+#include <math.h>
+#include "setup.h"
+#include "sim.h"
+#include "peelDetector.h"
+
+void setup();
+void loop();
+
+struct Run
+{
+  uint16_t layers;          // Releases in the trace
+  uint16_t onsets, releases; // Events reported
+  uint16_t missed, extra;   // Releases not reported within 4 samples, and releases reported elsewhere
+  uint16_t latencyMax;      // Samples
+  uint32_t latencySum;
+};
+
+static uint32_t noiseState;
+
+// Deterministic Gaussian noise, grams
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// seconds of the peel trace at rateHz, with noise and drift (g/min) on top, through a
+// fresh detector
+static Run runTrace(double seconds, unsigned rateHz, double noiseGrams, double driftGramsPerMin)
+{
+  PeelDetector d;
+  PeelEvent ev;
+  Run r = {0, 0, 0, 0, 0, 0, 0};
+  uint64_t periodNs = 1000000000ULL / rateHz, ns, release, counted = 0;
+  uint32_t n = (uint32_t)(seconds * rateHz), i, latency;
+  double g;
+
+  simConfig.trace = TRACE_PEEL;
+  noiseState = 12345;
+  d.reset();
+  for (i = 1; i <= n; i++)
+  {
+    ns = i * periodNs;
+    g = simTraceGrams(0, ns) + noise(noiseGrams) + driftGramsPerMin * ns / 60e9;
+    if (simTraceLastRelease(ns, release) && release > counted)
+    {
+      r.layers++;
+      counted = release;
+    }
+    if (!d.update(ns / 1000, gramsToForce((float)g), ev))
+    {
+      continue;
+    }
+    if (ev.type == PEEL_ONSET)
+    {
+      r.onsets++;
+      continue;
+    }
+    r.releases++;
+    // Samples since the first one at or after the release
+    if (simTraceLastRelease(ns, release) && (latency = (ns - release) / periodNs) < 4)
+    {
+      r.latencyMax = latency > r.latencyMax ? latency : r.latencyMax;
+      r.latencySum += latency;
+    }
+    else
+    {
+      r.extra++;
+    }
+  }
+  r.missed = r.layers - (r.releases - r.extra);
+  return r;
+}
+
+void setUp()
+{
+  simConfig.peelPeriod = 8;
+  simConfig.peelPeak = 1500;
+}
+
+void tearDown()
+{
+}
+
+static void test_every_release_within_a_sample_at_80hz()
+{
+  Run r = runTrace(200, 80, 2, 0);
+  char line[80];
+
+  snprintf(line, sizeof(line), "80Hz release latency: mean %.2f, max %u samples", (double)r.latencySum / r.releases,
+           r.latencyMax);
+  TEST_MESSAGE(line);
+
+  TEST_ASSERT_EQUAL(25, r.layers);
+  TEST_ASSERT_EQUAL(25, r.onsets);
+  TEST_ASSERT_EQUAL(25, r.releases);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.extra);
+  TEST_ASSERT_LESS_OR_EQUAL(1, r.latencyMax);
+}
+
+static void test_every_release_within_a_sample_at_10hz()
+{
+  Run r = runTrace(200, 10, 2, 0);
+
+  TEST_ASSERT_EQUAL(25, r.releases);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.extra);
+  TEST_ASSERT_LESS_OR_EQUAL(1, r.latencyMax);
+}
+
+// From a layer just over PEEL_MIN_PEAK to large ones, on short and long layer times.  A
+// lift that never climbs faster than PEEL_ONSET_SLOPE is a load being put down, not a peel,
+// so it reports nothing.
+static void test_peaks_and_layer_times()
+{
+  const double peaks[] = {PEEL_MIN_PEAK * 1.5, 500, 1500, 5000};
+  const double periods[] = {3, 8, 20};
+  double steepest;
+  uint8_t i, j;
+
+  for (i = 0; i < sizeof(peaks) / sizeof(peaks[0]); i++)
+  {
+    for (j = 0; j < sizeof(periods) / sizeof(periods[0]); j++)
+    {
+      simConfig.peelPeak = peaks[i];
+      simConfig.peelPeriod = periods[j];
+      // The trace's lift is steepest at its start, over 0.3 of the layer time (trace.cpp)
+      steepest = peaks[i] * 3 / (1 - exp(-3)) / (0.3 * periods[j]);
+      Run r = runTrace(periods[j] * 10, 80, 2, 0);
+      TEST_ASSERT_EQUAL(10, r.layers);
+      TEST_ASSERT_EQUAL(0, r.extra);
+      if (steepest < PEEL_ONSET_SLOPE)
+      {
+        TEST_ASSERT_EQUAL(0, r.onsets);
+        TEST_ASSERT_EQUAL(0, r.releases);
+        continue;
+      }
+      TEST_ASSERT_EQUAL(10, r.releases);
+      TEST_ASSERT_LESS_OR_EQUAL(1, r.latencyMax);
+    }
+  }
+}
+
+// Noise well below PEEL_ONSET_GRAMS, and the cell drifting, must not cost a release or add one
+static void test_noise_and_drift()
+{
+  Run r = runTrace(400, 80, 8, 0);
+
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.extra);
+  TEST_ASSERT_LESS_OR_EQUAL(1, r.latencyMax);
+
+  r = runTrace(400, 80, 2, 100);
+  TEST_ASSERT_EQUAL(0, r.missed);
+  TEST_ASSERT_EQUAL(0, r.extra);
+  TEST_ASSERT_LESS_OR_EQUAL(1, r.latencyMax);
+}
+
+// Layers too weak to be peels, and noise alone, report nothing
+static void test_small_bumps_are_not_peels()
+{
+  simConfig.peelPeak = PEEL_MIN_PEAK * 0.7;
+  Run r = runTrace(80, 80, 2, 0);
+  TEST_ASSERT_EQUAL(0, r.releases);
+
+  simConfig.peelPeak = 0;
+  r = runTrace(80, 80, 10, 0);
+  TEST_ASSERT_EQUAL(0, r.onsets);
+  TEST_ASSERT_EQUAL(0, r.releases);
+}
+
+// Something put on the plate and left there becomes the baseline, and peels on top of it
+// are found as usual
+static void test_static_load_becomes_the_baseline()
+{
+  PeelDetector d;
+  PeelEvent ev;
+  uint64_t periodNs = 1000000000ULL / 80, ns;
+  uint32_t i, releases = 0, onsets = 0;
+  double g;
+
+  simConfig.trace = TRACE_PEEL;
+  d.reset();
+  for (i = 1; i <= 80 * 100; i++)
+  {
+    ns = i * periodNs;
+    g = i < 80 * 10 ? 0 : 2000; // A 2 kg weight at 10 s...
+    if (ns > 40000000000ULL)
+    {
+      g += simTraceGrams(0, ns); // ...and peels on top of it from 40 s
+    }
+    if (d.update(ns / 1000, gramsToForce((float)g), ev))
+    {
+      onsets += ev.type == PEEL_ONSET;
+      releases += ev.type == PEEL_RELEASE;
+      if (ev.type == PEEL_RELEASE)
+      {
+        TEST_ASSERT_INT_WITHIN(GRAMS(50), GRAMS(1500), ev.force); // Above the new baseline
+      }
+    }
+  }
+  // The weight, then a layer every 8 s from 40 s: 8 lifts, the last one not released yet
+  TEST_ASSERT_EQUAL(1 + 8, onsets);
+  TEST_ASSERT_EQUAL(7, releases);
+}
+
+// The firmware on the simulator: acquisition, the filter chain and the scheduler in front
+// of the detector, and the trigger pin pulsed for the printer controller within a sample
+// period of the release
+static void test_trigger_pin_on_the_simulator()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint64_t periodNs = 1000000000ULL / simConfig.sampleRateHz, release, worst = 0, end;
+  uint8_t c;
+  uint16_t matched = 0;
+
+  simConfig.trace = TRACE_PEEL;
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    simAddChip(douts[c], HX711_SCK);
+  }
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.data[EEPROM_ADDR] = (uint8_t)simConfig.countsPerGram;
+#ifdef PEEL_TRIGGER_PIN
+  simWatchPin(PEEL_TRIGGER_PIN);
+#endif
+  setup();
+  end = simNow() + 80000000000ULL;
+  while (simNow() < end)
+  {
+    loop();
+    simAdvance(simConfig.loopPassNs);
+  }
+#ifdef PEEL_TRIGGER_PIN
+  for (uint64_t rise : simPinRises())
+  {
+    if (simTraceLastRelease(rise, release) && rise - release < 4 * periodNs)
+    {
+      matched++;
+      worst = rise - release > worst ? rise - release : worst;
+    }
+  }
+  // The first layer or two go by while the filters settle after setup()
+  TEST_ASSERT_GREATER_OR_EQUAL(8, matched);
+  TEST_ASSERT_EQUAL(matched, simPinRises().size());
+  // Data-ready comes a conversion after the force it measured, and the pulse a sample after that
+  TEST_ASSERT_LESS_OR_EQUAL(3 * periodNs, worst);
+#endif
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_every_release_within_a_sample_at_80hz);
+  RUN_TEST(test_every_release_within_a_sample_at_10hz);
+  RUN_TEST(test_peaks_and_layer_times);
+  RUN_TEST(test_noise_and_drift);
+  RUN_TEST(test_small_bumps_are_not_peels);
+  RUN_TEST(test_static_load_becomes_the_baseline);
+  RUN_TEST(test_trigger_pin_on_the_simulator);
+  return UNITY_END();
+}
@@ -0,0 +1,218 @@
+// RunningStats and QuantileSketch (streamStats.h) over traces far longer than a print:
+// tens of millions of samples with steps, drift and a large offset, against exact integer
+// sums and the sorted samples.  The mean must follow a step however many samples came
+// before it, the SD must not lose the small spread of a large load, and the percentiles
+// must land within a fraction of a percentile of their true ranks.
+
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "streamStats.h"
+
+// Sums of the samples and their squares, exact
+struct Exact
+{
+  __int128 sum = 0, sq = 0;
+  uint64_t n = 0;
+
+  void add(int32_t x)
+  {
+    sum += x;
+    sq += (__int128)x * x;
+    n++;
+  }
+  double mean() const { return (double)sum / n; }
+  double sd() const { return sqrt((double)(sq * n - sum * sum) / n / (n - 1)); }
+  double rms() const { return sqrt((double)sq / n); }
+};
+
+static uint32_t noiseState;
+
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void both(RunningStats &stats, Exact &exact, int32_t x)
+{
+  stats.add(x);
+  exact.add(x);
+}
+
+static void checkAgainst(const RunningStats &stats, const Exact &exact, double meanMg, double sdPart)
+{
+  char line[120];
+
+  snprintf(line, sizeof(line), "%lu samples: mean %.1f mg (exact %.1f), SD %+.4f%%, RMS %+.4f%%",
+           (unsigned long)stats.count(), stats.mean(), exact.mean(), (stats.stddev() / exact.sd() - 1) * 100,
+           (stats.rms() / exact.rms() - 1) * 100);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL(exact.n, stats.count());
+  TEST_ASSERT_TRUE(fabs(stats.mean() - exact.mean()) <= meanMg);
+  TEST_ASSERT_TRUE(fabs(stats.stddev() / exact.sd() - 1) <= sdPart);
+  TEST_ASSERT_TRUE(fabs(stats.rms() / exact.rms() - 1) <= 1e-5);
+}
+
+void setUp()
+{
+  noiseState = 12345;
+}
+
+void tearDown()
+{
+}
+
+// 20M samples at 150 g, then 2M at 50 g: the mean must take the step, where a float
+// updated per sample stays at 150 g
+static void test_step_after_a_long_run()
+{
+  RunningStats stats;
+  Exact exact;
+  uint32_t i;
+
+  stats.reset();
+  for (i = 0; i < 20000000; i++)
+  {
+    both(stats, exact, lround(150000 + noise(5000)));
+  }
+  for (i = 0; i < 2000000; i++)
+  {
+    both(stats, exact, lround(50000 + noise(5000)));
+  }
+  checkAgainst(stats, exact, 1, 1e-4);
+  TEST_ASSERT_TRUE(fabs(stats.mean() - 140909) < 50);
+}
+
+// A small spread on a large load: 1 g of noise on 15 kg, for 10M samples.  The mean and
+// SD must not come out of the difference of two large sums.
+static void test_small_spread_on_a_large_load()
+{
+  RunningStats stats;
+  Exact exact;
+  uint32_t i;
+
+  stats.reset();
+  for (i = 0; i < 10000000; i++)
+  {
+    both(stats, exact, lround(15000000 + noise(1000)));
+  }
+  checkAgainst(stats, exact, 1, 1e-4);
+  TEST_ASSERT_TRUE(fabs(stats.stddev() - 1000) < 5);
+}
+
+// A day at 80Hz of a load drifting back and forth, with peels on it, and the extremes the
+// outlier check lets through
+static void test_drift_and_peels()
+{
+  RunningStats stats;
+  Exact exact;
+  uint32_t i;
+  double drift;
+
+  stats.reset();
+  both(stats, exact, 20000000);
+  both(stats, exact, -20000000);
+  for (i = 0; i < 80UL * 86400; i++)
+  {
+    drift = 20000 * sin(i / 80.0 / 3600);
+    both(stats, exact, lround(drift + (i % 800 < 160 ? 1500000.0 * (i % 800) / 160 : 0) + noise(300)));
+  }
+  checkAgainst(stats, exact, 0.5, 1e-4);
+}
+
+// Before a block fills, and after reset()
+static void test_short_runs()
+{
+  RunningStats stats;
+  Exact exact;
+  int32_t i;
+
+  stats.reset();
+  TEST_ASSERT_EQUAL(0, stats.count());
+  TEST_ASSERT_TRUE(stats.mean() == 0 && stats.stddev() == 0 && stats.rms() == 0);
+  stats.add(-7);
+  TEST_ASSERT_TRUE(stats.mean() == -7 && stats.stddev() == 0 && stats.rms() == 7);
+  stats.reset();
+  for (i = 0; i < RunningStats::BLOCK * 3 + 17; i++)
+  {
+    both(stats, exact, i * i % 1001 - 300);
+    TEST_ASSERT_TRUE(fabs(stats.mean() - exact.mean()) < 1e-3);
+    if (i)
+    {
+      TEST_ASSERT_TRUE(fabs(stats.stddev() / exact.sd() - 1) < 1e-5);
+    }
+  }
+}
+
+// Each percentile by the rank its estimate has among the sorted samples: 10M samples of a
+// print's force, mostly idle noise with peels on it
+static void test_percentile_ranks()
+{
+  static const uint8_t percent[] = {50, 95, 99};
+  QuantileSketch<sizeof(percent)> sketch(percent);
+  std::vector<int32_t> v;
+  uint32_t i;
+  char line[120];
+
+  v.reserve(10000000);
+  for (i = 0; i < 10000000; i++)
+  {
+    double t = i % 800 / 80.0, x = noise(50);
+    if (t < 2)
+    {
+      x += 1500000 * t / 2 * (1 + noise(0.05));
+    }
+    v.push_back(lround(x));
+    sketch.add(v.back());
+  }
+  std::sort(v.begin(), v.end());
+  for (uint8_t j = 0; j < sizeof(percent); j++)
+  {
+    double rank = 100.0 * (std::upper_bound(v.begin(), v.end(), sketch.value(j)) - v.begin()) / v.size();
+    int32_t truth = v[(size_t)(percent[j] / 100.0 * (v.size() - 1))];
+    snprintf(line, sizeof(line), "P%u: %.1f mg at rank %.3f (true %ld mg)", percent[j], sketch.value(j), rank,
+             (long)truth);
+    TEST_MESSAGE(line);
+    // Where the samples crowd together a rank is a fraction of the 0.01 g the stats are
+    // reported to, and that is all the sketch need find
+    TEST_ASSERT_TRUE(fabs(rank - percent[j]) < 0.5 || fabs(sketch.value(j) - truth) < 10);
+  }
+  TEST_ASSERT_EQUAL(10000000, sketch.count());
+}
+
+// Exact while the markers are still the sorted samples
+static void test_percentiles_exact_at_first()
+{
+  static const uint8_t percent[] = {25, 50};
+  QuantileSketch<sizeof(percent)> sketch(percent);
+  const float x[] = {9, 1, 8, 2, 7, 3}; // One short of the 7 markers
+
+  for (float y : x)
+  {
+    sketch.add(y);
+  }
+  TEST_ASSERT_TRUE(sketch.value(0) == 2.25f);
+  TEST_ASSERT_TRUE(sketch.value(1) == 5);
+  sketch.reset();
+  TEST_ASSERT_TRUE(sketch.value(0) == 0);
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_step_after_a_long_run);
+  RUN_TEST(test_small_spread_on_a_large_load);
+  RUN_TEST(test_drift_and_peels);
+  RUN_TEST(test_short_runs);
+  RUN_TEST(test_percentile_ranks);
+  RUN_TEST(test_percentiles_exact_at_first);
+  return UNITY_END();
+}
@@ -0,0 +1,281 @@
+// Tare and calibration (loadCell.cpp) on synthetic loads: steady ones under noise, loads
+// still settling, drifting or too noisy to take, fed at 80Hz through cellJobFeed() and
+// cellJobTick() as loop() does, with the simulator's clock for their timeouts.  Then the
+// blocking tare setup() does, against the HX711 model and with no chip at all.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <unity.h>
+#include <math.h>
+#include "setup.h"
+#include "sim.h"
+#include "loadCell.h"
+#include "acquisition.h"
+
+extern TFT_ILI9341 tft;
+extern boolean done;
+
+static const uint64_t PERIOD_NS = 1000000000ULL / 80;
+static const double SCALE = 212.5; // Counts per gram, the cell's own
+static const long OFFSET = 8000;   // Counts at zero load, per channel
+
+// The load on the cell: `end` grams, settling from `start` with time constant `tau`
+// seconds, drifting by `drift` g/s, plus Gaussian noise with a standard deviation of `noise`
+struct Load
+{
+  double start, end, tau, drift, noise;
+};
+
+static uint32_t noiseState;
+static double elapsed; // Seconds fed so far
+
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static double grams(const Load &load, double t)
+{
+  return load.end + (load.tau > 0 ? (load.start - load.end) * exp(-t / load.tau) : 0) + load.drift * t;
+}
+
+// One sample period of `load`, through the job as loop() runs it: what either call reported
+static uint8_t step(const Load &load)
+{
+  RawSample s;
+  uint8_t c, fed, ticked;
+  double g = grams(load, elapsed) + noise(load.noise);
+
+  simAdvance(PERIOD_NS);
+  elapsed += PERIOD_NS / 1e9;
+  s.t = micros();
+  s.input = ACQ_A128;
+  for (c = 0; c < LOADCELL_COUNT; c++)
+  {
+    s.count[c] = OFFSET + lround(g * SCALE / LOADCELL_COUNT);
+  }
+  fed = cellJobFeed(s);
+  ticked = cellJobTick(tft);
+  return fed != CELL_JOB_NONE ? fed : ticked;
+}
+
+// Feed `load` for up to `seconds`, stopping at the first time the job reports `until`:
+// when that was, or -1
+static double feedUntil(const Load &load, double seconds, uint8_t until)
+{
+  double end = elapsed + seconds;
+
+  while (elapsed < end)
+  {
+    if (step(load) == until)
+    {
+      return elapsed;
+    }
+  }
+  return -1;
+}
+
+// Force the offsets give for a load of `g` grams
+static double measured(double g)
+{
+  RawSample s;
+
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    s.count[c] = OFFSET + lround(g * SCALE / LOADCELL_COUNT);
+  }
+  return forceToGrams(totalForce(s));
+}
+
+static long offsetSum()
+{
+  long sum = 0;
+
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    sum += cellOffset[c];
+  }
+  return sum;
+}
+
+void setUp()
+{
+  noiseState = 12345;
+  elapsed = 0;
+  setCellScales(SCALE);
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    cellOffset[c] = OFFSET;
+  }
+}
+
+void tearDown()
+{
+  // Let anything left running time out, so the next test starts idle
+  Load none = {0, 0, 0, 0, 0};
+  feedUntil(none, (CAL_WAIT_MS + CAL_SHOW_MS) / 1000.0 + 1, 0xFF);
+}
+
+// A steady load under noise well below SETTLE_NOISE_GRAMS tares on the second window,
+// within a few standard deviations of a window's mean
+static void test_tare_through_noise()
+{
+  Load load = {0, 300, 0, 0, 20};
+  double at;
+
+  startTare();
+  at = feedUntil(load, TARE_TIMEOUT_MS / 1000.0, CELL_JOB_TARED);
+  TEST_ASSERT_TRUE(at > 0 && at <= 2.5 * SETTLE_SAMPLES / 80.0);
+  TEST_ASSERT_TRUE(fabs(measured(300)) <= 4 * 20 / sqrt(SETTLE_SAMPLES));
+  // Once
+  TEST_ASSERT_TRUE(feedUntil(load, TARE_TIMEOUT_MS / 1000.0, CELL_JOB_TARED) < 0);
+}
+
+// Something just put down, still sinking into place: no tare until consecutive windows
+// agree within SETTLE_GRAMS, and then at the load as it was
+static void test_tare_waits_for_the_load_to_settle()
+{
+  Load load = {2000, 500, 1, 0, 5};
+  double at, window = SETTLE_SAMPLES / 80.0;
+  char line[80];
+
+  startTare();
+  at = feedUntil(load, TARE_TIMEOUT_MS / 1000.0, CELL_JOB_TARED);
+  snprintf(line, sizeof(line), "Tared after %.2f s, %.1f g above the final load", at, grams(load, at) - 500);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(at > 0);
+  // The window before last still moved by more than SETTLE_GRAMS, the last one didn't
+  TEST_ASSERT_TRUE(grams(load, at - 3 * window) - grams(load, at - 2 * window) > SETTLE_GRAMS);
+  TEST_ASSERT_TRUE(grams(load, at - window) - grams(load, at) <= SETTLE_GRAMS);
+  TEST_ASSERT_TRUE(fabs(measured(grams(load, at))) <= 2 * SETTLE_GRAMS);
+}
+
+// A load swinging about, or one drifting faster than SETTLE_GRAMS a window, is never
+// taken: the tare gives up after TARE_TIMEOUT_MS and leaves the offsets alone
+static void test_tare_gives_up_on_noise_and_drift()
+{
+  const Load loads[] = {
+      {0, 300, 0, 0, 3 * SETTLE_NOISE_GRAMS},
+      {0, 300, 0, 2 * SETTLE_GRAMS * 80.0 / SETTLE_SAMPLES, 2},
+  };
+  Load quiet = {0, 300, 0, 0, 2};
+
+  for (const Load &load : loads)
+  {
+    startTare();
+    TEST_ASSERT_TRUE(feedUntil(load, TARE_TIMEOUT_MS / 1000.0 + 1, CELL_JOB_TARED) < 0);
+    TEST_ASSERT_EQUAL(OFFSET * LOADCELL_COUNT, offsetSum());
+    // Cancelled, not still waiting: a steady load now doesn't tare either
+    TEST_ASSERT_TRUE(feedUntil(quiet, 2, CELL_JOB_TARED) < 0);
+  }
+
+  // A cell creeping a gram a minute is steady enough
+  Load creep = {0, 300, 0, 1 / 60.0, 2};
+  startTare();
+  TEST_ASSERT_TRUE(feedUntil(creep, TARE_TIMEOUT_MS / 1000.0, CELL_JOB_TARED) > 0);
+}
+
+// Hang each of CAL_MASSES in turn, double-clicking for each, until the chart comes back
+static double calibrate(const Load *load)
+{
+  const float masses[] = CAL_MASSES;
+  double at = -1;
+  uint8_t i;
+
+  startCalibration(tft);
+  for (i = 0; i < sizeof(masses) / sizeof(masses[0]); i++)
+  {
+    Load hung = load[i];
+    hung.end += masses[i];
+    hung.start += masses[i];
+    done = true;
+    // Until it asks for the next mass, or gives up
+    while (done && calibrationShown() && elapsed < 200)
+    {
+      at = step(hung) == CELL_JOB_CALIBRATED ? elapsed : at;
+    }
+  }
+  Load none = {0, 0, 0, 0, 0};
+  return at > 0 ? at : feedUntil(none, CAL_SHOW_MS / 1000.0 + 1, CELL_JOB_CALIBRATED);
+}
+
+// Starting from a scale 30% out and a zero 100 g off, calibration under noise finds the
+// cell's own within the window means' noise
+static void test_calibration_finds_the_scale()
+{
+  const Load loads[] = {{0, 0, 0, 0, 10}, {50, 0, 0.5, 0, 10}}; // The mass swings a little as it's hung
+  char line[80];
+
+  setCellScales(SCALE * 0.7);
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    cellOffset[c] = OFFSET + lround(100 * SCALE / LOADCELL_COUNT);
+  }
+  TEST_ASSERT_TRUE(calibrate(loads) > 0);
+  snprintf(line, sizeof(line), "Calibrated: %.2f g at 0, %.2f g at %d g", measured(0), measured(REFERENCE_MASS),
+           REFERENCE_MASS);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_TRUE(fabs(measured(0)) <= 2);
+  TEST_ASSERT_TRUE(fabs(measured(REFERENCE_MASS) - REFERENCE_MASS) <= REFERENCE_MASS * 0.003);
+  TEST_ASSERT_FALSE(calibrationShown());
+}
+
+// A mass that keeps drifting never gives steady windows: calibration gives up after
+// CAL_TIMEOUT_MS, keeping the old scale and zero
+static void test_calibration_gives_up_on_a_drifting_mass()
+{
+  const Load loads[] = {{0, 0, 0, 0, 5}, {0, 0, 0, 2 * SETTLE_GRAMS * 80.0 / SETTLE_SAMPLES, 5}};
+  double at;
+
+  setCellScales(SCALE * 0.7);
+  at = elapsed;
+  TEST_ASSERT_TRUE(calibrate(loads) - at >= CAL_TIMEOUT_MS / 1000.0);
+  TEST_ASSERT_EQUAL(OFFSET * LOADCELL_COUNT, offsetSum());
+  TEST_ASSERT_TRUE(fabs(measured(REFERENCE_MASS) - REFERENCE_MASS / 0.7) <= 1);
+  TEST_ASSERT_FALSE(calibrationShown());
+}
+
+// setup()'s blocking tare: no samples at all (a cell unplugged) gives up in twice the time
+// they should take, offsets untouched.  With the chip there it tares as before.
+static void test_blocking_tare_times_out_without_samples()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint64_t start;
+
+  simConfig.trace = TRACE_FILE; // No file: nothing on the plate
+  simConfig.countsPerGram = SCALE;
+  simConfig.countsOffset = OFFSET;
+  acqBegin(douts, HX711_SCK);
+  start = simNow();
+  TEST_ASSERT_FALSE(tareCells(20));
+  TEST_ASSERT_INT_WITHIN(2, 2000 * 20 / HX711_RATE_HZ + 100, (simNow() - start) / 1000000);
+  TEST_ASSERT_EQUAL(OFFSET * LOADCELL_COUNT, offsetSum());
+
+  for (uint8_t c = 0; c < LOADCELL_COUNT; c++)
+  {
+    simAddChip(douts[c], HX711_SCK);
+    cellOffset[c] = 0;
+  }
+  start = simNow();
+  TEST_ASSERT_TRUE(tareCells(20));
+  TEST_ASSERT_TRUE(simNow() - start <= 22 * PERIOD_NS * (HX711_RATE_HZ == 80 ? 1 : 8));
+  TEST_ASSERT_INT_WITHIN(lround(20 * SCALE), OFFSET * LOADCELL_COUNT, offsetSum());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_tare_through_noise);
+  RUN_TEST(test_tare_waits_for_the_load_to_settle);
+  RUN_TEST(test_tare_gives_up_on_noise_and_drift);
+  RUN_TEST(test_calibration_finds_the_scale);
+  RUN_TEST(test_calibration_gives_up_on_a_drifting_mass);
+  RUN_TEST(test_blocking_tare_times_out_without_samples);
+  return UNITY_END();
+}
@@ -0,0 +1,175 @@
+// The timebase across both of the AVR clock's wrap points, on the simulator's clock started
+// just short of them: timeUs() on its own through a micros() wrap, then the whole firmware
+// through the millis() wrap, which micros() wraps with - 2^32 ms is exactly 1000 of its
+// periods.  The firmware must keep its schedule, its samples and its peel triggers.
+
+#include <Arduino.h>
+#include <TFT_Charts.h>
+#include <EEPROM.h>
+#include <unity.h>
+#include "setup.h"
+#include "sim.h"
+#include "timebase.h"
+#include "scheduler.h"
+
+void setup();
+void loop();
+
+extern Task tasks[];
+extern const uint8_t taskCount;
+
+static const uint64_t MICROS_WRAP_NS = 4294967296ULL * 1000;    // 71.6 minutes
+static const uint64_t MILLIS_WRAP_NS = 4294967296ULL * 1000000; // 49.7 days
+static const uint64_t SECOND_NS = 1000000000ULL;
+
+// Power up 20 s before a micros() wrap that isn't a millis() one, leaving a few more before
+// the millis() wrap
+static const uint64_t START_NS = MILLIS_WRAP_NS - 5 * MICROS_WRAP_NS - 20 * SECOND_NS;
+
+// Where the clock reads now, from power-up
+static uint64_t boardNs()
+{
+  return simConfig.startNs + simNow();
+}
+
+static void runFirmwareUntil(uint64_t ns)
+{
+  while (boardNs() < ns)
+  {
+    loop();
+    simAdvance(simConfig.loopPassNs);
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Called every 1.5 ms through the wrap, timeUs() goes up by exactly the time that passed,
+// while micros() drops back to 0
+static void test_time_us_through_the_micros_wrap()
+{
+  time_us first = timeUs(), last = first, t;
+  uint64_t startNs = simNow();
+  uint32_t drops = 0, prev = micros();
+
+  while (boardNs() < START_NS + 40 * SECOND_NS)
+  {
+    simAdvance(1500000);
+    t = timeUs();
+    TEST_ASSERT_TRUE(t > last);
+    TEST_ASSERT_TRUE(t - first == (simNow() - startNs) / 1000);
+    drops += (uint32_t)micros() < prev;
+    prev = micros();
+    last = t;
+  }
+  TEST_ASSERT_EQUAL(1, drops);
+}
+
+// Called less often than the wrap, it must still see every one: a call a few times an
+// hour, as the longest gap the firmware leaves is far shorter
+static void test_time_us_with_sparse_calls()
+{
+  time_us first = timeUs();
+  uint64_t startNs = simNow();
+  uint8_t i;
+
+  for (i = 0; i < 10; i++)
+  {
+    simAdvance(MICROS_WRAP_NS / 3);
+    TEST_ASSERT_TRUE(timeUs() - first == (simNow() - startNs) / 1000);
+  }
+}
+
+// The firmware from 40 s before the millis() wrap to 30 s after: after the wrap, no task
+// misses a deadline or starts later than it allows, no conversion is dropped, and every
+// peel release still pulses the trigger within a few sample periods
+static void test_firmware_through_the_millis_wrap()
+{
+  const uint8_t douts[] = LOADCELL_DOUTS;
+  uint64_t periodNs = SECOND_NS / simConfig.sampleRateHz, release, wrapAt, dropped;
+  uint16_t misses[16], i, matched = 0, releases = 0;
+  size_t risesBefore = 0;
+  char line[100];
+
+  // Jump to 40 s before the millis() wrap, as the board would get there, timeUs() included
+  while (boardNs() + MICROS_WRAP_NS / 3 < MILLIS_WRAP_NS - 40 * SECOND_NS)
+  {
+    simAdvance(MICROS_WRAP_NS / 3);
+    timeUs();
+  }
+  simAdvance(MILLIS_WRAP_NS - 40 * SECOND_NS - boardNs());
+  wrapAt = MILLIS_WRAP_NS - simConfig.startNs;
+
+  simConfig.trace = TRACE_PEEL;
+  for (i = 0; i < LOADCELL_COUNT; i++)
+  {
+    simAddChip(douts[i], HX711_SCK);
+  }
+  memset(EEPROM.data, 0xFF, sizeof(EEPROM.data));
+  EEPROM.data[EEPROM_ADDR] = (uint8_t)simConfig.countsPerGram;
+#ifdef PEEL_TRIGGER_PIN
+  simWatchPin(PEEL_TRIGGER_PIN);
+#endif
+  setup();
+  // Settled, then count from 10 s before the wrap
+  runFirmwareUntil(MILLIS_WRAP_NS - 10 * SECOND_NS);
+  for (i = 0; i < taskCount; i++)
+  {
+    misses[i] = tasks[i].misses;
+    tasks[i].maxLateUs = 0;
+  }
+  dropped = simStats.dropped;
+#ifdef PEEL_TRIGGER_PIN
+  risesBefore = simPinRises().size();
+#endif
+  runFirmwareUntil(MILLIS_WRAP_NS + 30 * SECOND_NS);
+  TEST_ASSERT_TRUE(millis() < 31000); // It did wrap
+
+  for (i = 0; i < taskCount; i++)
+  {
+    snprintf(line, sizeof(line), "%-8s across the wrap: late %lu us (deadline %u ms), %u misses", tasks[i].name,
+             (unsigned long)tasks[i].maxLateUs, tasks[i].deadlineMs, tasks[i].misses - misses[i]);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL(misses[i], tasks[i].misses);
+    TEST_ASSERT_TRUE(tasks[i].maxLateUs <= tasks[i].deadlineMs * 1000UL);
+  }
+  TEST_ASSERT_TRUE(simStats.dropped == dropped);
+
+#ifdef PEEL_TRIGGER_PIN
+  for (i = risesBefore; i < simPinRises().size(); i++)
+  {
+    uint64_t rise = simPinRises()[i];
+    if (simTraceLastRelease(rise, release) && rise - release < 4 * periodNs)
+    {
+      matched++;
+    }
+  }
+  // Releases in the trace over the same 40 s, on both sides of the wrap
+  for (uint64_t ns = wrapAt - 10 * SECOND_NS, last = 0; ns < wrapAt + 30 * SECOND_NS; ns += periodNs)
+  {
+    if (simTraceLastRelease(ns, release) && release != last && release >= wrapAt - 10 * SECOND_NS)
+    {
+      releases++;
+      last = release;
+    }
+  }
+  TEST_ASSERT_GREATER_OR_EQUAL(4, releases);
+  TEST_ASSERT_EQUAL(releases, matched);
+  TEST_ASSERT_EQUAL(matched, simPinRises().size() - risesBefore);
+#endif
+}
+
+int main()
+{
+  simConfig.startNs = START_NS;
+  UNITY_BEGIN();
+  RUN_TEST(test_time_us_through_the_micros_wrap);
+  RUN_TEST(test_time_us_with_sparse_calls);
+  RUN_TEST(test_firmware_through_the_millis_wrap);
+  return UNITY_END();
+}
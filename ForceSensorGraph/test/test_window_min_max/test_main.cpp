@@ -0,0 +1,144 @@
+// WindowMinMax against a scan of the window, over random walks with the chart queue's
+// push/pop pattern and with irregular ones.
+
+#include <unity.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "windowMinMax.h"
+
+// The window the tracker follows: a ring indexed by age, like fQ.peekIdx()
+template <uint16_t N>
+struct Window
+{
+  int32_t lo[N], hi[N];
+  uint16_t first = 0, count = 0;
+
+  int32_t getLo(uint16_t age) const { return lo[(first + age) % N]; }
+  int32_t getHi(uint16_t age) const { return hi[(first + age) % N]; }
+
+  void add(int32_t l, int32_t h)
+  {
+    lo[(first + count) % N] = l;
+    hi[(first + count) % N] = h;
+    count++;
+  }
+
+  void remove()
+  {
+    first = (first + 1) % N;
+    count--;
+  }
+
+  void scan(int32_t &min, int32_t &max) const
+  {
+    min = getLo(0);
+    max = getHi(0);
+    for (uint16_t i = 1; i < count; i++)
+    {
+      min = getLo(i) < min ? getLo(i) : min;
+      max = getHi(i) > max ? getHi(i) : max;
+    }
+  }
+};
+
+template <uint16_t N, typename Seq>
+static void checkAgainstScan(uint32_t steps, bool spans, bool fullOnly)
+{
+  static Window<N> w;
+  static WindowMinMax<N, Seq, int32_t> mm;
+  auto getLo = [](uint16_t age) { return w.getLo(age); };
+  auto getHi = [](uint16_t age) { return w.getHi(age); };
+  int32_t y = 0, lo, hi, min, max;
+
+  w.first = w.count = 0;
+  mm.clear();
+  srand(N);
+  for (uint32_t i = 0; i < steps; i++)
+  {
+    // Pop when full, as the chart queue does, or now and then at random
+    if (w.count == N || (!fullOnly && w.count && rand() % 3 == 0))
+    {
+      w.remove();
+      mm.pop(getLo, getHi);
+    }
+    // A random walk with plateaus, so equal values come up as often as new extremes
+    y += rand() % 4 == 0 ? 0 : rand() % 201 - 100;
+    lo = y;
+    hi = spans ? y + rand() % 50 : y;
+    w.add(lo, hi);
+    if (spans)
+    {
+      mm.push(lo, hi, getLo, getHi);
+    }
+    else
+    {
+      mm.push(lo, getLo);
+    }
+    w.scan(min, max);
+    TEST_ASSERT_EQUAL_INT32(min, mm.min());
+    TEST_ASSERT_EQUAL_INT32(max, mm.max());
+  }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_chart_queue_length()
+{
+  checkAgainstScan<100, uint8_t>(20000, true, true);
+}
+
+static void test_single_values()
+{
+  checkAgainstScan<100, uint8_t>(20000, false, true);
+}
+
+static void test_irregular_pops()
+{
+  checkAgainstScan<100, uint8_t>(20000, true, false);
+}
+
+// Sequence numbers wrap many times over
+static void test_short_window()
+{
+  checkAgainstScan<3, uint8_t>(5000, true, false);
+}
+
+static void test_long_window_uint16_seq()
+{
+  checkAgainstScan<2000, uint16_t>(100000, true, true);
+}
+
+static void test_clear_restarts()
+{
+  WindowMinMax<4, uint8_t, int32_t> mm;
+  int32_t v[] = {5, -7};
+  auto get = [&](uint16_t age) { return v[age]; };
+
+  mm.push(5, get);
+  mm.push(-7, get);
+  TEST_ASSERT_EQUAL_INT32(-7, mm.min());
+  TEST_ASSERT_EQUAL_INT32(5, mm.max());
+  mm.clear();
+  v[0] = 3;
+  mm.push(3, get);
+  TEST_ASSERT_EQUAL_INT32(3, mm.min());
+  TEST_ASSERT_EQUAL_INT32(3, mm.max());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_chart_queue_length);
+  RUN_TEST(test_single_values);
+  RUN_TEST(test_irregular_pops);
+  RUN_TEST(test_short_window);
+  RUN_TEST(test_long_window_uint16_seq);
+  RUN_TEST(test_clear_restarts);
+  return UNITY_END();
+}
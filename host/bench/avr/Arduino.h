@@ -0,0 +1,26 @@
+#pragma once
+
+// Just enough of the Arduino core for the board sketch's HX711 readers to build on the host,
+// against the simulated port and cycle counter in hx711Cycles.cpp.
+
+#include <stdint.h>
+
+typedef uint8_t byte;
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder);
+void noInterrupts();
+void interrupts();
+void delay(unsigned long ms);
+unsigned long millis();
+void yield();
@@ -0,0 +1,21 @@
+#pragma once
+
+// The parts of <avr/io.h> that hx711_fastio.hpp touches outside its port classes: the
+// status register's I flag, cli() and the cycle-exact delay, all counted by hx711Cycles.cpp.
+// No PORTx is defined, so the bench supplies its own simulated port classes.
+
+#include <stdint.h>
+
+struct SimStatusRegister
+{
+  operator uint8_t() const;
+  SimStatusRegister &operator=(uint8_t v);
+};
+
+extern SimStatusRegister SREG;
+
+void simCli();
+void simDelayCycles(uint32_t n);
+
+#define cli() simCli()
+#define __builtin_avr_delay_cycles(n) simDelayCycles(n)
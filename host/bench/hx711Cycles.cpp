@@ -0,0 +1,385 @@
+// Cycles the board sketch spends clocking conversions out of its HX711s, on a 16MHz
+// ATmega32U4: the library's HX711::read() (shiftIn(), digitalWrite(), digitalRead()), one
+// object and PD_SCK per cell, against hx711_fastio.hpp's HX711Bank on a shared PD_SCK.  Both
+// are the sketch's own code, built against the Arduino and <avr/io.h> stand-ins in avr/ and
+// a simulated port with HX711s on it, which check every value read back and the PD_SCK
+// timing.  Only I/O and interrupt masking are counted, the bit shuffling around it is left
+// out of both: digitalWrite() and digitalRead() at what ForceSensorGraph's simulator charges
+// for them (sim/include/sim.h), 2 cycles for an sbi/cbi, 1 for an in, cli or SREG access.
+//   make bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <Arduino.h>
+#include <avr/io.h>
+#include "HX711.h"
+#include "hx711_fastio.hpp"
+
+static const uint32_t CYCLES_PER_US = 16;
+static const uint32_t DIGITAL_WRITE_CYCLES = 56; // 3.5us
+static const uint32_t DIGITAL_READ_CYCLES = 48;  // 3.0us
+static const uint32_t SBI_CYCLES = 2;
+static const uint32_t IN_CYCLES = 1;
+static const uint32_t POWER_DOWN_CYCLES = 60 * CYCLES_PER_US; // PD_SCK high this long powers a chip down
+
+static const uint8_t MAX_CELLS = 4;
+static const uint8_t SCK_PIN = 7; // Pins 0-7 are port F, A0 = PF7 the shared PD_SCK...
+static const uint8_t DOUT_PINS[MAX_CELLS] = {6, 5, 4, 1}; // ...and A1 to A4 the DOUTs, as in the sketch
+static const uint8_t OWN_SCK_PIN = 8; // Pins 8 and up: a PD_SCK per cell, for the library
+static const int READS = 2000;
+
+// ---------------------------------------------------------------------------------------
+// The simulated MCU
+
+static uint64_t cycles;
+static bool irqOn = true;
+static uint64_t irqOffSince, maxIrqOff;
+static uint16_t outputs; // Output latch of every pin
+
+static void irqOff()
+{
+  if (irqOn)
+  {
+    irqOffSince = cycles;
+  }
+  irqOn = false;
+}
+
+static void irqBackOn()
+{
+  if (!irqOn && cycles - irqOffSince > maxIrqOff)
+  {
+    maxIrqOff = cycles - irqOffSince;
+  }
+  irqOn = true;
+}
+
+SimStatusRegister SREG;
+
+SimStatusRegister::operator uint8_t() const
+{
+  cycles += IN_CYCLES;
+  return irqOn ? 0x80 : 0;
+}
+
+SimStatusRegister &SimStatusRegister::operator=(uint8_t v)
+{
+  cycles += IN_CYCLES;
+  if (v & 0x80)
+  {
+    irqBackOn();
+  }
+  else
+  {
+    irqOff();
+  }
+  return *this;
+}
+
+void simCli()
+{
+  cycles += IN_CYCLES;
+  irqOff();
+}
+
+void simDelayCycles(uint32_t n)
+{
+  cycles += n;
+}
+
+// ---------------------------------------------------------------------------------------
+// HX711s.  DOUT goes low with a conversion waiting, each PD_SCK rising edge shifts out the
+// next bit, MSB first, and the 25th to 27th select the input for the next conversion.
+
+struct Chip
+{
+  uint8_t dout, sck;
+  uint32_t data;
+  uint8_t pulses;
+  bool ready;
+};
+
+static Chip chips[MAX_CELLS];
+static uint8_t nChips;
+static uint64_t sckHighSince[MAX_CELLS], maxSckHigh;
+static uint32_t powerDowns;
+
+static bool doutLevel(const Chip &c)
+{
+  if (!c.ready)
+  {
+    return HIGH;
+  }
+  return c.pulses == 0 ? LOW : (c.data >> (24 - c.pulses)) & 1;
+}
+
+static uint16_t pinLevels()
+{
+  uint16_t levels = outputs;
+  for (uint8_t c = 0; c < nChips; c++)
+  {
+    levels = doutLevel(chips[c]) ? levels | 1 << chips[c].dout : levels & ~(1 << chips[c].dout);
+  }
+  return levels;
+}
+
+static void setOutputs(uint16_t v)
+{
+  for (uint8_t c = 0; c < nChips; c++)
+  {
+    Chip &chip = chips[c];
+    bool was = outputs >> chip.sck & 1, is = v >> chip.sck & 1;
+    if (!was && is)
+    {
+      sckHighSince[c] = cycles;
+      if (chip.ready || chip.pulses < 27)
+      {
+        chip.pulses++;
+      }
+      if (chip.pulses == 25)
+      {
+        chip.ready = false;
+      }
+    }
+    else if (was && !is)
+    {
+      uint64_t high = cycles - sckHighSince[c];
+      maxSckHigh = high > maxSckHigh ? high : maxSckHigh;
+      powerDowns += high > POWER_DOWN_CYCLES;
+    }
+  }
+  outputs = v;
+}
+
+// A fresh conversion in every chip
+static void convert(const uint32_t *values)
+{
+  for (uint8_t c = 0; c < nChips; c++)
+  {
+    chips[c].data = values[c] & 0xFFFFFF;
+    chips[c].pulses = 0;
+    chips[c].ready = true;
+  }
+}
+
+static void addChips(uint8_t n, bool ownSck)
+{
+  nChips = n;
+  for (uint8_t c = 0; c < n; c++)
+  {
+    chips[c] = {DOUT_PINS[c], (uint8_t)(ownSck ? OWN_SCK_PIN + c : SCK_PIN), 0, 0, false};
+  }
+  outputs = 0;
+}
+
+// ---------------------------------------------------------------------------------------
+// Arduino core, at the simulator's costs
+
+void pinMode(uint8_t, uint8_t)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  cycles += DIGITAL_WRITE_CYCLES;
+  setOutputs(level ? outputs | 1 << pin : outputs & ~(1 << pin));
+}
+
+int digitalRead(uint8_t pin)
+{
+  cycles += DIGITAL_READ_CYCLES;
+  return pinLevels() >> pin & 1;
+}
+
+// As the AVR core's wiring_shift.c
+uint8_t shiftIn(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder)
+{
+  uint8_t value = 0;
+  for (uint8_t i = 0; i < 8; ++i)
+  {
+    digitalWrite(clockPin, HIGH);
+    if (bitOrder == LSBFIRST)
+      value |= digitalRead(dataPin) << i;
+    else
+      value |= digitalRead(dataPin) << (7 - i);
+    digitalWrite(clockPin, LOW);
+  }
+  return value;
+}
+
+void noInterrupts()
+{
+  cycles += IN_CYCLES;
+  irqOff();
+}
+
+void interrupts()
+{
+  cycles += IN_CYCLES;
+  irqBackOn();
+}
+
+void delay(unsigned long)
+{
+}
+
+unsigned long millis()
+{
+  return cycles / (CYCLES_PER_US * 1000);
+}
+
+void yield()
+{
+}
+
+// Port F, for HX711Bank: sbi/cbi to the output latch, in from the pins
+struct SimPortF
+{
+  struct Pins
+  {
+    operator uint8_t() const
+    {
+      cycles += IN_CYCLES;
+      return (uint8_t)pinLevels();
+    }
+  };
+  struct Latch
+  {
+    // Taking an int, like the register does after integer promotion: ~(1 << 7) and all
+    Latch &operator|=(int m)
+    {
+      cycles += SBI_CYCLES;
+      setOutputs(outputs | (m & 0xFF));
+      return *this;
+    }
+    Latch &operator&=(int m)
+    {
+      cycles += SBI_CYCLES;
+      setOutputs(outputs & (0xFF00 | (m & 0xFF)));
+      return *this;
+    }
+  };
+  struct Direction
+  {
+    Direction &operator|=(int) { return *this; }
+    Direction &operator&=(int) { return *this; }
+  };
+
+  static Pins in() { return Pins(); }
+  static Latch out() { return Latch(); }
+  static Direction ddr() { return Direction(); }
+};
+
+// ---------------------------------------------------------------------------------------
+
+struct Result
+{
+  uint64_t cycles;
+  uint64_t maxIrqOff, maxSckHigh;
+  uint32_t wrong, powerDowns;
+};
+
+static uint32_t nextValue()
+{
+  return (uint32_t)rand() ^ (uint32_t)rand() << 12;
+}
+
+static int32_t expected(uint32_t v)
+{
+  v &= 0xFFFFFF;
+  return v & 0x800000 ? (int32_t)v - 0x1000000 : (int32_t)v;
+}
+
+static void startRun(uint8_t n, bool ownSck)
+{
+  srand(n);
+  addChips(n, ownSck);
+  maxIrqOff = maxSckHigh = 0;
+  powerDowns = 0;
+}
+
+static Result finishRun(uint64_t total, uint32_t wrong)
+{
+  return {total / READS, maxIrqOff, maxSckHigh, wrong, powerDowns};
+}
+
+// One HX711 object and PD_SCK per cell, read in turn
+static Result runLibrary(uint8_t n)
+{
+  HX711 cells[MAX_CELLS];
+  uint32_t values[MAX_CELLS], wrong = 0;
+  uint64_t total = 0, start;
+
+  startRun(n, true);
+  for (uint8_t c = 0; c < n; c++)
+  {
+    cells[c].begin(DOUT_PINS[c], OWN_SCK_PIN + c);
+  }
+  for (int i = 0; i < READS; i++)
+  {
+    for (uint8_t c = 0; c < n; c++)
+    {
+      values[c] = nextValue();
+    }
+    convert(values);
+    start = cycles;
+    for (uint8_t c = 0; c < n; c++)
+    {
+      wrong += (int32_t)cells[c].read() != expected(values[c]); // Both readers assume a 32-bit long
+    }
+    total += cycles - start;
+  }
+  return finishRun(total, wrong);
+}
+
+template <class Bank>
+static Result runBank()
+{
+  Bank bank;
+  long counts[Bank::CHANNELS];
+  uint32_t values[Bank::CHANNELS], wrong = 0;
+  uint64_t total = 0, start;
+
+  startRun(Bank::CHANNELS, false);
+  bank.begin();
+  for (int i = 0; i < READS; i++)
+  {
+    for (uint8_t c = 0; c < Bank::CHANNELS; c++)
+    {
+      values[c] = nextValue();
+    }
+    convert(values);
+    start = cycles;
+    bank.read(counts);
+    total += cycles - start;
+    for (uint8_t c = 0; c < Bank::CHANNELS; c++)
+    {
+      wrong += (int32_t)counts[c] != expected(values[c]);
+    }
+  }
+  return finishRun(total, wrong);
+}
+
+static bool report(uint8_t n, const char *reader, const Result &r)
+{
+  printf("%5u  %-16s %8llu %8.1f %12.1f %15.2f %6u %12u\n", n, reader, (unsigned long long)r.cycles,
+         (double)r.cycles / CYCLES_PER_US, (double)r.maxIrqOff / CYCLES_PER_US,
+         (double)r.maxSckHigh / CYCLES_PER_US, r.wrong, r.powerDowns);
+  return r.wrong == 0 && r.powerDowns == 0;
+}
+
+int main()
+{
+  bool ok = true;
+
+  printf("HX711 transfer on a 16MHz ATmega32U4, %d reads each (I/O and interrupt masking only)\n", READS);
+  printf("%5s  %-16s %8s %8s %12s %15s %6s %12s\n", "cells", "reader", "cycles", "us", "irqs off us",
+         "PD_SCK high us", "wrong", "power-downs");
+  ok &= report(1, "HX711::read()", runLibrary(1));
+  ok &= report(1, "HX711Bank", runBank<HX711Bank<SimPortF, SimPortF, SCK_PIN, 6>>());
+  ok &= report(2, "HX711::read()", runLibrary(2));
+  ok &= report(2, "HX711Bank", runBank<HX711Bank<SimPortF, SimPortF, SCK_PIN, 6, 5>>());
+  ok &= report(4, "HX711::read()", runLibrary(4));
+  ok &= report(4, "HX711Bank", runBank<HX711Bank<SimPortF, SimPortF, SCK_PIN, 6, 5, 4, 1>>());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,222 @@
+// forcepeel's path over generated captures: 4 files of 4 cells at 80Hz, 5.5 hours each, as
+// the board's binary stream would be captured off the port - a FRAME_INFO per cell, then
+// two conversions a frame, through four micros() wraps each.  Each layer is a peel of a
+// known peak with HX711 noise on every cell.  The files are analysed with one job and then one
+// per CPU, as forcepeel does, and the host time per sample reported.  Then checks that every
+// layer was found once, with its peak, and that the jobs gave the same summaries.
+//   make bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "traceFile.h"
+
+static const uint8_t FILES = 4, CELLS = 4;
+static const uint32_t PERIOD_US = 12500;
+static const double LAYER_S = 8;
+static const uint32_t LAYERS = 2500; // Per file
+static const float SCALE = 212.5f;
+
+static uint32_t noiseState = 12345;
+
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// The peak of each layer, different from its neighbours
+static double peakOf(uint32_t layer)
+{
+  return 600 + (layer * 7919 % 1400);
+}
+
+// Grams on the plate at `phase` seconds into a layer: idle, the lift, the release and the
+// ringing after it
+static double peel(double phase, double peak)
+{
+  double lift = 0.3 * LAYER_S, release = 0.6 * LAYER_S, u;
+
+  if (phase < lift)
+  {
+    return 0;
+  }
+  if (phase < release)
+  {
+    u = (phase - lift) / (release - lift);
+    return peak * (1 - exp(-3 * u)) / (1 - exp(-3));
+  }
+  u = phase - release;
+  return peak * 0.15 * exp(-u / 0.08) * sin(2 * M_PI * 12 * u);
+}
+
+static bool writeCapture(const char *path)
+{
+  static const double share[CELLS] = {0.31, 0.27, 0.22, 0.20}; // Of the load, each cell
+  static const int32_t offset[CELLS] = {-8000, 12000, 3000, -15000};
+  std::vector<uint8_t> out;
+  uint8_t frame[FRAME_MAX_BYTES], flags[FRAME_MAX_SAMPLES];
+  uint16_t dt[FRAME_MAX_SAMPLES];
+  int32_t count[FRAME_MAX_SAMPLES];
+  uint32_t conversions = LAYERS * LAYER_S * 1e6 / PERIOD_US, i, boardT = 1000000;
+  uint16_t seq = 0;
+  uint8_t c, k;
+  FILE *f = fopen(path, "wb");
+
+  if (!f)
+  {
+    return false;
+  }
+  for (c = 0; c < CELLS; c++)
+  {
+    ForceInfo info = {offset[c], SCALE, 80, c};
+    out.insert(out.end(), frame, frame + encodeInfo(frame, info));
+  }
+  for (i = 0; i < conversions; i += 2)
+  {
+    for (k = 0; k < 2; k++)
+    {
+      double t = (i + k) * (PERIOD_US / 1e6);
+      double grams = peel(fmod(t, LAYER_S), peakOf(t / LAYER_S));
+      for (c = 0; c < CELLS; c++)
+      {
+        dt[k * CELLS + c] = k && !c ? PERIOD_US : 0;
+        count[k * CELLS + c] = lround(offset[c] + SCALE * (grams * share[c] + noise(0.1)));
+        flags[k * CELLS + c] = c << SAMPLE_CHANNEL_SHIFT;
+      }
+    }
+    out.insert(out.end(), frame, frame + encodeSamples(frame, seq, boardT, dt, count, flags, 2 * CELLS));
+    seq += 2 * CELLS;
+    boardT += 2 * PERIOD_US;
+    if (out.size() > (1 << 24))
+    {
+      fwrite(out.data(), 1, out.size(), f);
+      out.clear();
+    }
+  }
+  fwrite(out.data(), 1, out.size(), f);
+  return !fclose(f);
+}
+
+struct Job
+{
+  std::string path;
+  bool ok;
+  std::string error;
+  TraceStats stats;
+  FileSummary summary;
+};
+
+// forcepeel's workers: each takes the next file until there are none left
+static double analyse(std::vector<Job> &jobs, unsigned threads)
+{
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> pool;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned t = 0; t < threads; t++)
+  {
+    pool.emplace_back([&]() {
+      SampleBlock block;
+      size_t i;
+      while ((i = next++) < jobs.size())
+      {
+        PeelAnalyser analyser{PeelConfig()};
+        jobs[i].ok = analyseTrace(jobs[i].path.c_str(), analyser, block, jobs[i].stats, jobs[i].error);
+        jobs[i].summary = std::move(analyser.summary);
+      }
+    });
+  }
+  for (std::thread &t : pool)
+  {
+    t.join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *what, const std::vector<Job> &jobs, double seconds)
+{
+  uint64_t samples = 0, bytes = 0;
+
+  for (const Job &j : jobs)
+  {
+    samples += j.stats.samples;
+    bytes += j.stats.bytes;
+  }
+  printf("%-20s %.1fM samples, %.0f MB in %.2f s: %.1fM samples/s, %.1f ns a sample\n", what, samples / 1e6, bytes / 1e6,
+         seconds, samples / 1e6 / seconds, seconds * 1e9 / samples);
+}
+
+int main()
+{
+  char dir[] = "/tmp/peelBatchXXXXXX";
+  std::vector<Job> single(FILES), pooled;
+  unsigned cpus = std::thread::hardware_concurrency(), over = 0;
+  uint32_t found = 0, l;
+  bool ok = true;
+  double worstErr = 0, err;
+
+  if (!mkdtemp(dir))
+  {
+    perror("mkdtemp");
+    return 1;
+  }
+  for (uint8_t f = 0; f < FILES; f++)
+  {
+    single[f].path = std::string(dir) + "/capture" + std::to_string(f) + ".bin";
+    if (!writeCapture(single[f].path.c_str()))
+    {
+      perror(single[f].path.c_str());
+      return 1;
+    }
+  }
+  pooled = single;
+
+  report("1 job", single, analyse(single, 1));
+  cpus = cpus < 2 ? 2 : cpus; // Threads even on one CPU, for the comparison
+  report((std::to_string(cpus) + " jobs").c_str(), pooled, analyse(pooled, cpus));
+
+  for (uint8_t f = 0; f < FILES; f++)
+  {
+    const FileSummary &a = single[f].summary, &b = pooled[f].summary;
+    ok = ok && single[f].ok && pooled[f].ok && single[f].stats.format == TRACE_FRAMES;
+    ok = ok && !single[f].stats.badFrames && !single[f].stats.lostSamples && single[f].stats.channels == CELLS;
+    found += a.layers.size();
+    // Each layer by the time of its release
+    for (const LayerSummary &layer : a.layers)
+    {
+      l = (uint32_t)((layer.releaseS - a.firstS) / LAYER_S);
+      err = fabs(layer.peak - peakOf(l)) / peakOf(l);
+      over += err > 0.02;
+      worstErr = err > worstErr ? err : worstErr;
+    }
+    ok = ok && a.layers.size() == b.layers.size() && a.conversions == b.conversions;
+    for (size_t i = 0; ok && i < a.layers.size(); i++)
+    {
+      const LayerSummary &x = a.layers[i], &y = b.layers[i];
+      ok = x.onsetS == y.onsetS && x.releaseS == y.releaseS && x.peak == y.peak && x.filteredPeak == y.filteredPeak &&
+           x.impulse == y.impulse && x.idleSd == y.idleSd;
+    }
+  }
+  printf("%u layers found of %u, peaks within %.2f%% of the trace's (%u over 2%%); the jobs %s\n", found,
+         FILES * LAYERS, worstErr * 100, over, ok ? "agree" : "DISAGREE");
+
+  for (const Job &j : single)
+  {
+    unlink(j.path.c_str());
+  }
+  rmdir(dir);
+  return ok && found == FILES * LAYERS && !over ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+// forced's path for a long unattended run: 8 hours of 4 cells at 80Hz, sent as the board
+// sends it, fed a few frames at a time through FrameDecoder and RingSink into a ring log
+// that holds the last 2 hours.  Along the way the board resets every 97 minutes (micros()
+// and the sequence numbers start again), the port drops out and is reopened every 41
+// minutes, micros() wraps, and forced itself is restarted once.  Reports the host time and
+// heap allocations per sample, then checks that log time never goes back, that it stays
+// with the host's clock, and that find() gives what a scan gives.
+//   make bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <new>
+#include <chrono>
+#include <vector>
+#include "forceFrame.h"
+#include "ringLog.h"
+#include "ringSink.h"
+
+static const uint32_t PERIOD_US = 12500;
+static const uint8_t CELLS = 4;
+static const uint32_t CONVERSIONS = 8 * 3600 * 80;
+static const uint64_t CAPACITY = 2ULL * 3600 * 80 * CELLS;
+static const uint32_t PER_READ = 4; // Conversions per read() of the port
+static const uint32_t BOARD_RESET_EVERY = 97 * 60 * 80, RECONNECT_EVERY = 41 * 60 * 80;
+static const uint32_t RESTART_AT = 5 * 3600 * 80;
+static const uint64_t OFFLINE_US = 3000000, RESTART_OFFLINE_US = 10000000;
+static const int FINDS = 2000, SCANS = 50;
+
+// Heap allocations, counted while replaying
+static uint64_t allocations;
+
+void *operator new(size_t n)
+{
+  allocations++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+enum Event : uint8_t
+{
+  READ,
+  RECONNECT, // The port was reopened before this read
+  RESTART    // forced was restarted before this read
+};
+
+struct Read
+{
+  size_t offset, len;
+  uint64_t hostUs; // When the read returned
+  Event event;
+};
+
+static std::vector<uint8_t> stream;
+static std::vector<Read> reads;
+static std::vector<uint64_t> hostUsOf; // Host time of each conversion
+
+// The whole run, as bytes on the wire.  Each sample's count is its conversion number, so
+// the checks can tell which it was.
+static void makeStream()
+{
+  uint16_t dt[FRAME_MAX_SAMPLES] = {};
+  int32_t count[FRAME_MAX_SAMPLES];
+  uint8_t flags[FRAME_MAX_SAMPLES];
+  uint32_t boardT = 1500000, i, c, k;
+  uint16_t seq = 0;
+  uint64_t hostUs = 1760000000000000ULL;
+  Event next = READ;
+  size_t start, n;
+
+  hostUsOf.resize(CONVERSIONS);
+  stream.reserve((size_t)CONVERSIONS * CELLS / FRAME_MAX_SAMPLES * (6 + 6 + FRAME_MAX_SAMPLES * FRAME_SAMPLE_BYTES));
+  for (i = 0; i < CONVERSIONS; i += PER_READ)
+  {
+    start = stream.size();
+    // Two conversions to a frame, as the board's FrameWriter fills them
+    for (k = 0; k < PER_READ; k += 2)
+    {
+      for (c = 0; c < FRAME_MAX_SAMPLES; c++)
+      {
+        dt[c] = c == CELLS ? PERIOD_US : 0;
+        count[c] = i + k + c / CELLS;
+        flags[c] = (c % CELLS) << SAMPLE_CHANNEL_SHIFT;
+      }
+      n = stream.size();
+      stream.resize(n + FRAME_MAX_BYTES);
+      stream.resize(n + encodeSamples(stream.data() + n, seq, boardT, dt, count, flags, FRAME_MAX_SAMPLES));
+      seq += FRAME_MAX_SAMPLES;
+      boardT += 2 * PERIOD_US;
+    }
+    for (k = 0; k < PER_READ; k++)
+    {
+      hostUsOf[i + k] = hostUs + k * PERIOD_US;
+    }
+    reads.push_back({start, stream.size() - start, hostUs + (PER_READ - 1) * PERIOD_US, next});
+    hostUs += PER_READ * PERIOD_US;
+    next = READ;
+
+    if (i + PER_READ == RESTART_AT)
+    {
+      next = RESTART;
+      hostUs += RESTART_OFFLINE_US;
+      boardT += RESTART_OFFLINE_US;
+    }
+    else if ((i + PER_READ) % BOARD_RESET_EVERY == 0)
+    {
+      next = RECONNECT;
+      hostUs += OFFLINE_US;
+      boardT = 1500000;
+      seq = 0;
+    }
+    else if ((i + PER_READ) % RECONNECT_EVERY == 0)
+    {
+      next = RECONNECT;
+      hostUs += OFFLINE_US;
+      boardT += OFFLINE_US; // Still running, its samples lost with the port
+      seq += OFFLINE_US / PERIOD_US * CELLS;
+    }
+  }
+}
+
+int main()
+{
+  char path[] = "/tmp/ringReplayXXXXXX";
+  int fd = mkstemp(path);
+  bool ok = true;
+
+  if (fd < 0)
+  {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  makeStream();
+
+  RingLogWriter log;
+  RingSink sink(log, 0);
+  FrameDecoder decoder;
+  if (!log.open(path, CAPACITY))
+  {
+    perror(path);
+    return 1;
+  }
+
+  allocations = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (const Read &r : reads)
+  {
+    if (r.event == RECONNECT)
+    {
+      decoder.reset();
+      sink.restart();
+    }
+    else if (r.event == RESTART)
+    {
+      // A new forced on the same file: only the log carries over
+      log.close();
+      if (!log.open(path, CAPACITY))
+      {
+        perror(path);
+        return 1;
+      }
+      decoder.reset();
+    }
+    sink.hostUs = r.hostUs;
+    decoder.feed(stream.data() + r.offset, r.len, sink);
+  }
+  double replayNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  uint64_t replayAllocations = allocations;
+  log.sync();
+
+  RingLogReader reader;
+  if (!reader.open(path))
+  {
+    perror(path);
+    return 1;
+  }
+  uint64_t samples = (uint64_t)CONVERSIONS * CELLS, tail = reader.tail(), head = reader.head(), i;
+  printf("Ring log replay: %.0f h of %u cells at 80Hz into a %.0f h ring (%.0f MB), %llu bytes of frames\n",
+         CONVERSIONS / 80.0 / 3600, CELLS, CAPACITY / 80.0 / 3600 / CELLS,
+         (RINGLOG_HEADER_BYTES + CAPACITY * sizeof(RingRecord)) / 1e6, (unsigned long long)stream.size());
+  printf("%-34s %10.1f\n", "host ns per sample", replayNs / samples);
+  printf("%-34s %10llu\n", "heap allocations while replaying", (unsigned long long)replayAllocations);
+  ok &= head == samples && decoder.crcErrors == 0 && replayAllocations == 0;
+
+  // Log time never goes back, and keeps with the host clock: each record's conversion's
+  // host time, less the oldest's, against its log time, less the oldest's
+  uint64_t back = 0;
+  int64_t drift, maxDrift = 0;
+  const RingRecord &oldest = reader.at(tail);
+  for (i = tail; i < head; i++)
+  {
+    const RingRecord &r = reader.at(i);
+    back += i > tail && r.tUs < reader.at(i - 1).tUs;
+    drift = (int64_t)(r.tUs - oldest.tUs) - (int64_t)(hostUsOf[r.count] - hostUsOf[oldest.count]);
+    maxDrift = llabs(drift) > maxDrift ? llabs(drift) : maxDrift;
+  }
+  printf("%-34s %10llu\n", "log time going back", (unsigned long long)back);
+  printf("%-34s %10.1f\n", "most log time off host time, ms", maxDrift / 1e3);
+  // Each discontinuity can put log time off by up to a read's worth of conversions
+  ok &= back == 0 && maxDrift <= 10 * PER_READ * PERIOD_US;
+
+  // find() over random windows, timed, then the first few again against a scan
+  uint64_t from[FINDS], to[FINDS], first[FINDS], last[FINDS], wrong = 0,
+      span = reader.at(head - 1).tUs - oldest.tUs;
+  int q;
+  srand(1);
+  for (q = 0; q < FINDS; q++)
+  {
+    from[q] = oldest.tUs - 1000000 + ((uint64_t)rand() << 16 ^ rand()) % (span + 2000000);
+    to[q] = from[q] + rand() % 600000000;
+  }
+  t0 = std::chrono::steady_clock::now();
+  for (q = 0; q < FINDS; q++)
+  {
+    if (!reader.find(from[q], to[q], first[q], last[q]))
+    {
+      first[q] = last[q] = head;
+    }
+  }
+  double findNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  for (q = 0; q < SCANS; q++)
+  {
+    uint64_t scanFirst = head, scanLast = head;
+    for (i = tail; i < head; i++)
+    {
+      if (reader.at(i).tUs >= from[q] && scanFirst == head)
+      {
+        scanFirst = i;
+      }
+      if (reader.at(i).tUs >= to[q] && scanLast == head)
+      {
+        scanLast = i;
+      }
+    }
+    if (scanFirst >= scanLast)
+    {
+      scanFirst = scanLast = head;
+    }
+    wrong += first[q] != scanFirst || last[q] != scanLast;
+  }
+  printf("%-34s %10.1f\n", "host ns per find()", findNs / FINDS);
+  printf("%-34s %7d/%d\n", "find() unlike a scan", (int)wrong, SCANS);
+  ok &= wrong == 0;
+
+  unlink(path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Host time per interval of ForceSensorGraph's chart queue min/max: the WindowMinMax tracker
+// (include/windowMinMax.h) following each push and pop, against the scan getMinMax() used
+// to make, copying every interval out of the queue as fQ.peekIdx() does.  Both run the
+// chart's pattern, a push and, once the queue is full, a pop per interval, with the min/max
+// read after each.
+//   make bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+#include "windowMinMax.h"
+
+struct Span
+{
+  int32_t lo, hi;
+};
+
+static const uint32_t INTERVALS = 200000;
+
+// A queue of spans, read back by age with a copy like cppQueue::peekIdx()
+template <uint16_t N>
+struct Queue
+{
+  Span q[N];
+  uint16_t first = 0, count = 0;
+
+  void peekIdx(Span *s, uint16_t age) const { memcpy(s, &q[(first + age) % N], sizeof(Span)); }
+  void push(const Span &s) { q[(first + count++) % N] = s; }
+  void pop()
+  {
+    first = (first + 1) % N;
+    count--;
+  }
+};
+
+// A random walk, made up front so neither side pays for it
+static Span spans[INTERVALS];
+
+static void makeSpans()
+{
+  int32_t y = 0;
+
+  srand(1);
+  for (uint32_t i = 0; i < INTERVALS; i++)
+  {
+    y += rand() % 201 - 100;
+    spans[i] = {y, y + rand() % 50};
+  }
+}
+
+template <uint16_t N, typename Seq>
+static double tracker(int64_t &check)
+{
+  static Queue<N> q;
+  static WindowMinMax<N, Seq, int32_t> mm;
+  auto getLo = [](uint16_t age) { Span s; q.peekIdx(&s, age); return s.lo; };
+  auto getHi = [](uint16_t age) { Span s; q.peekIdx(&s, age); return s.hi; };
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < INTERVALS; i++)
+  {
+    if (q.count == N)
+    {
+      q.pop();
+      mm.pop(getLo, getHi);
+    }
+    const Span &s = spans[i];
+    q.push(s);
+    mm.push(s.lo, s.hi, getLo, getHi);
+    check += mm.min() + mm.max();
+  }
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / INTERVALS;
+}
+
+template <uint16_t N>
+static double scan(int64_t &check)
+{
+  static Queue<N> q;
+  Span s;
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < INTERVALS; i++)
+  {
+    if (q.count == N)
+    {
+      q.pop();
+    }
+    q.push(spans[i]);
+    q.peekIdx(&s, 0);
+    int32_t min = s.lo, max = s.hi;
+    for (uint16_t j = 1; j < q.count; j++)
+    {
+      q.peekIdx(&s, j);
+      min = s.lo < min ? s.lo : min;
+      max = s.hi > max ? s.hi : max;
+    }
+    check += min + max;
+  }
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / INTERVALS;
+}
+
+template <uint16_t N, typename Seq>
+static bool run()
+{
+  int64_t a = 0, b = 0;
+  double t = tracker<N, Seq>(a), s = scan<N>(b);
+
+  printf("%6u %12.1f %12.1f %8.1fx  %s\n", N, t, s, s / t, a == b ? "same" : "DIFFERENT");
+  return a == b;
+}
+
+int main()
+{
+  bool ok = true;
+
+  makeSpans();
+  printf("Chart queue min/max, host ns per interval (%u intervals)\n", INTERVALS);
+  printf("%6s %12s %12s %9s  %s\n", "length", "tracker", "scan", "speed-up", "results");
+  ok &= run<100, uint8_t>();
+  ok &= run<250, uint16_t>();
+  ok &= run<500, uint16_t>();
+  ok &= run<1000, uint16_t>();
+  ok &= run<2000, uint16_t>();
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// Binary stream sent by the Basic-Force-Sensor board sketch (STREAM_BINARY, frame.hpp).
+//
+//   0xA5 0x5A  type  len  payload[len]  crc16
+//
+// crc16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type, len and payload.  All
+// multi-byte fields are little-endian.
+//
+// FRAME_SAMPLES payload: seq u16 (of the first sample), t0 u32 (board micros() of the first
+// sample), then up to FRAME_MAX_SAMPLES x { dt u16 (us since the previous sample, 0 for the
+// first), count i24 (raw HX711 count), flags u8 (SAMPLE_* in bits 0-5, load cell channel in
+// bits 6-7) }.  The channels of one conversion are sent as consecutive samples with dt 0.
+// FRAME_INFO payload: offset i32 (tare, raw counts), scale f32 (counts per unit), rate u8 (Hz),
+// channel u8.  Boards with a single load cell may leave the channel out (len 9).
+// Grams = (count - offset) / scale, using the last FRAME_INFO for the sample's channel.
+// FRAME_BURST payload: burst u16, tTrigger u32 (board micros() of the trigger sample), pre u16,
+// post u16, source u8 (BURST_BY_*), channels u8.  Sent by a board that only captures around
+// triggers (ForceSensorGraph with BURST_SERIAL): each burst is its FRAME_INFOs, this header,
+// then pre samples before the trigger and post from it on, the trigger flagged SAMPLE_TRIGGER.
+// The sequence numbers carry on from burst to burst, so only samples lost on the way count
+// as lost.  A burst cut short on the board just ends early.
+
+#include <stdint.h>
+#include <stddef.h>
+
+const uint8_t FRAME_SYNC0 = 0xA5;
+const uint8_t FRAME_SYNC1 = 0x5A;
+const uint8_t FRAME_SAMPLES = 0x01;
+const uint8_t FRAME_INFO = 0x02;
+const uint8_t FRAME_BURST = 0x03;
+
+const uint8_t SAMPLE_TARED = 0x01;
+const uint8_t SAMPLE_BUTTON = 0x02;
+const uint8_t SAMPLE_SATURATED = 0x04;
+const uint8_t SAMPLE_TRIGGER = 0x08;
+const uint8_t SAMPLE_CHANNEL_SHIFT = 6;
+const uint8_t FRAME_MAX_CHANNELS = 4;
+
+const uint8_t BURST_BY_LEVEL = 0x01;
+const uint8_t BURST_BY_SLOPE = 0x02;
+const uint8_t BURST_BY_PIN = 0x04;
+
+const uint8_t FRAME_MAX_SAMPLES = 8;
+const uint8_t FRAME_SAMPLE_BYTES = 6;
+const size_t FRAME_MAX_BYTES = 4 + 255 + 2;
+
+struct ForceSample
+{
+  uint64_t tUs;  // Board time, unwrapped past the 71 minute micros() rollover
+  uint64_t seq;  // Sample number, unwrapped
+  int32_t count;   // Raw HX711 count
+  uint8_t flags;   // SAMPLE_*
+  uint8_t channel; // Load cell, 0 to FRAME_MAX_CHANNELS - 1
+};
+
+struct ForceInfo
+{
+  int32_t offset;
+  float scale;
+  uint8_t rateHz;
+  uint8_t channel;
+};
+
+struct ForceBurst
+{
+  uint16_t burst;     // Board's burst number
+  uint32_t tTrigger;  // Board micros() of the trigger sample
+  uint16_t pre, post; // Conversions before the trigger, and from it on
+  uint8_t source;     // BURST_BY_*
+  uint8_t channels;
+};
+
+// Receives what the decoder pulls out of the stream
+class FrameSink
+{
+public:
+  virtual ~FrameSink() {}
+  virtual void sample(const ForceSample &s) = 0;
+  virtual void info(const ForceInfo &) {}
+  virtual void burst(const ForceBurst &) {}
+};
+
+// Incremental decoder: feed it bytes as they arrive, in chunks of any size.  It never
+// allocates, resynchronises on the next sync word after a corrupt frame and keeps count of
+// what was lost.
+class FrameDecoder
+{
+public:
+  void feed(const uint8_t *data, size_t len, FrameSink &sink);
+  void reset();
+
+  uint64_t frames = 0;      // Valid frames
+  uint64_t crcErrors = 0;   // Frames dropped for a bad CRC or length
+  uint64_t skippedBytes = 0; // Bytes discarded while looking for a sync word
+  uint64_t lostSamples = 0; // Gaps in the sequence numbers
+
+private:
+  void frame(FrameSink &sink);
+
+  uint8_t buf[FRAME_MAX_BYTES];
+  size_t have = 0;
+  bool synced = false;
+  uint64_t lastSeq = 0, lastT = 0;
+};
+
+uint16_t frameCrc(uint16_t crc, uint8_t b);
+
+// Encoders, the same as the board's, for tools and simulations on the host.
+// out must hold FRAME_MAX_BYTES.  Return the frame length.
+size_t encodeSamples(uint8_t *out, uint16_t seq, uint32_t t0, const uint16_t *dt, const int32_t *count,
+                     const uint8_t *flags, uint8_t n);
+size_t encodeInfo(uint8_t *out, const ForceInfo &info);
+size_t encodeBurst(uint8_t *out, const ForceBurst &burst);
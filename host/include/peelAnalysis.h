@@ -0,0 +1,132 @@
+#pragma once
+
+// Offline peel analysis: the same segmentation as ForceSensorGraph's on-board detector
+// (peelDetector.cpp), run over recorded traces on the host, with a summary per layer.
+//
+// Samples arrive a SampleBlock at a time.  A block is a structure of arrays - the times in
+// one array, each load cell's grams in another - so the per-sample passes that need no
+// history (counts to grams, the sum over the cells, the outlier mask) are plain loops over
+// contiguous floats that the compiler turns into SIMD.  Only the passes with state (the
+// filters and the detector) walk the block a sample at a time, and that state carries over
+// from one block to the next, so a file of any length is analysed in constant memory.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include "forceFrame.h"
+
+// The detector and filter settings, defaulting to ForceSensorGraph's setup.h
+struct PeelConfig
+{
+  float onsetGrams = 50;      // Rise above the baseline that starts a peel...
+  float onsetSlope = 200;     // ...if it is still rising faster than this (g/s)
+  float minPeak = 200;        // Smaller peaks are noise, not peels (g)
+  float releasePercent = 50;  // Complete once the force drops below this percentage of the peak
+  float timeoutS = 20;        // A load that lasts longer is the new baseline, not a peel
+  float outlierGrams = 20000; // Readings beyond this are glitches
+  float lowpassHz = 10;       // Butterworth cutoff for the filtered peak (0 for none)
+  uint8_t median = 3;         // Median of this many samples before the low-pass (1 for none)
+};
+
+// One conversion per index, every cell at once
+struct SampleBlock
+{
+  static const size_t CAPACITY = 16384;
+
+  SampleBlock();
+  void clear() { n = 0; }
+
+  size_t n = 0;
+  uint8_t channels = 1;
+  std::vector<int64_t> tUs;                      // Board time
+  std::vector<int32_t> count[FRAME_MAX_CHANNELS]; // Raw counts, when the source has them
+  std::vector<float> grams[FRAME_MAX_CHANNELS];
+};
+
+struct LayerSummary
+{
+  uint32_t layer;        // 1, 2, ... in the file
+  double onsetS;         // Board time of the onset, the peak and the release
+  double peakS;
+  double releaseS;
+  float baseline;        // Unloaded reading the peel rose from (g)
+  float peak;            // Peak above the baseline, as the board reports it (g)
+  float filteredPeak;    // The same after the median and low-pass
+  float impulse;         // Force above the baseline integrated from the onset to the release (g s)
+  float riseRate;        // Peak over the time it took to reach it (g/s)
+  float idleSd;          // Standard deviation of the idle reading before the onset (g)
+  uint32_t samples;      // Conversions from the onset to the release
+  uint8_t channels;
+  float channelPeak[FRAME_MAX_CHANNELS]; // Each cell's share at the peak
+};
+
+struct FileSummary
+{
+  uint64_t conversions = 0;
+  uint64_t outliers = 0;
+  uint64_t timeouts = 0;  // Loads that became the new baseline
+  uint64_t dropped = 0;   // Peaks under minPeak
+  double firstS = 0, lastS = 0;
+  std::vector<LayerSummary> layers;
+};
+
+// Second order Butterworth low-pass, direct form II transposed
+class Biquad
+{
+public:
+  void design(float cutoffHz, float rateHz);
+  float update(float x);
+  void reset() { primed = false; }
+
+private:
+  float b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0, z1 = 0, z2 = 0;
+  bool pass = true, primed = false;
+};
+
+class PeelAnalyser
+{
+public:
+  explicit PeelAnalyser(const PeelConfig &config) : config(config) {}
+
+  // Analyse the next block of the file, in time order.  The sample rate is taken from the
+  // first block, for the filters.
+  void process(SampleBlock &block);
+  // The zero or scale changed (a tare on the board): start the baseline afresh
+  void rezero();
+
+  FileSummary summary;
+
+private:
+  enum State
+  {
+    IDLE,
+    LOADING,
+    SETTLING
+  };
+  static const uint8_t SLOPE_SAMPLES = 4; // Slope is measured over this many samples, as on the board
+
+  void startFilters(const SampleBlock &block);
+  float filter(float y);
+  void update(const SampleBlock &block, size_t i, float y, float yf);
+
+  PeelConfig config;
+  std::vector<float> total;
+  std::vector<uint8_t> outlier;
+  bool filtersReady = false;
+  float medianHist[15];
+  uint8_t medianN = 0, medianNext = 0;
+  Biquad lowpass;
+
+  uint8_t state = IDLE;
+  bool primed = false;
+  float baseline = 0, peak = 0, filteredPeak = 0, area = 0;
+  double idleMean = 0, idleM2 = 0; // Welford over the idle samples
+  uint64_t idleN = 0;
+  int64_t tPeak = 0, tState = 0, tOnset = 0, tLast = 0;
+  float onsetBaseline = 0, onsetIdleSd = 0;
+  uint32_t loadSamples = 0;
+  float channelPeak[FRAME_MAX_CHANNELS];
+  float lastY[SLOPE_SAMPLES];
+  int64_t lastT[SLOPE_SAMPLES];
+  uint8_t next = 0, filled = 0;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+// Fixed-size, memory-mapped ring of force samples.
+//
+// One writer (forced) appends records; any number of readers map the same file read-only
+// and look at the records in place.  The file is a 4 KB header followed by `capacity`
+// records.  `head` counts every record ever written, so record i lives in slot
+// i % capacity and the ring holds records [head - capacity, head).  The writer fills the slot
+// first and then publishes the new head, so a reader only has to check, after it has used a
+// record, that the writer has not lapped it in the meantime (stillValid()).
+//
+// find() needs the timestamps to count up, but the board's micros() starts again from zero
+// whenever it resets, and so does the decoder's unwrapping whenever it is reset (the port was
+// reopened) or forced restarts.  So records hold log time: board time plus an epoch that
+// logTime() moves on at each of those, so the first sample after one lands as long after the
+// newest record as the host clock says has passed in between.
+
+#include <stdint.h>
+#include <stddef.h>
+
+const char RINGLOG_MAGIC[8] = {'F', 'S', 'R', 'I', 'N', 'G', '0', '1'};
+const uint32_t RINGLOG_VERSION = 1;
+const size_t RINGLOG_HEADER_BYTES = 4096;
+
+struct RingRecord
+{
+  uint64_t tUs;    // Log time of the sample, microseconds: the board's, carried on across resets
+  uint32_t seq;    // Low 32 bits of the sample number
+  int32_t count;   // Raw HX711 count
+  float grams;     // Converted with the last offset/scale received, NaN if none yet
+  uint8_t channel; // Load cell number
+  uint8_t flags;   // SAMPLE_* from forceFrame.h
+  uint16_t reserved;
+};
+
+struct RingLogHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t recordBytes;
+  uint64_t capacity;
+  uint64_t head; // Records written so far; only access through __atomic builtins
+  uint64_t hostUs; // Host clock (CLOCK_REALTIME, us) when the newest record came in, 0 if unknown
+};
+
+class RingLogWriter
+{
+public:
+  ~RingLogWriter() { close(); }
+
+  // Create or reopen the ring.  An existing ring with the same capacity is appended to,
+  // after the newest record in it.
+  bool open(const char *path, uint64_t capacity);
+  void append(const RingRecord &r);
+
+  // Log time for a sample at board time boardUs that arrived at host time hostUs.  Never
+  // earlier than the newest record, even if the board's clock went back without a rebase().
+  uint64_t logTime(uint64_t boardUs, uint64_t hostUs);
+  // The board's time starts again with the next sample
+  void rebase() { rebasing = true; }
+  void sync(); // msync(), so a crash loses nothing that has been appended
+  void close();
+
+  uint64_t head() const;
+
+private:
+  int fd = -1;
+  size_t mapBytes = 0;
+  RingLogHeader *hdr = nullptr;
+  RingRecord *records = nullptr;
+  uint64_t epoch = 0; // Log time minus board time, modulo 2^64
+  bool rebasing = false;
+};
+
+class RingLogReader
+{
+public:
+  ~RingLogReader() { close(); }
+
+  bool open(const char *path);
+  void close();
+
+  uint64_t head() const;       // One past the newest record
+  uint64_t tail() const;       // Oldest record still in the ring
+  uint64_t capacity() const { return hdr ? hdr->capacity : 0; }
+
+  // Record by absolute index, valid for tail() <= i < head().  Points into the mapping.
+  const RingRecord &at(uint64_t i) const { return records[i % hdr->capacity]; }
+  // False if the writer may have overwritten record i since it was read
+  bool stillValid(uint64_t i) const { return i >= tail(); }
+
+  // Index range [first, last) of the records with from <= tUs < to, by binary search on
+  // the log timestamps.  Returns false if the ring holds nothing in that range.
+  bool find(uint64_t fromUs, uint64_t toUs, uint64_t &first, uint64_t &last) const;
+
+private:
+  uint64_t lowerBound(uint64_t lo, uint64_t hi, uint64_t tUs) const;
+
+  int fd = -1;
+  size_t mapBytes = 0;
+  const RingLogHeader *hdr = nullptr;
+  const RingRecord *records = nullptr;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+// FrameSink that appends the decoder's samples to a ring log (forced), with grams worked out
+// from the latest FRAME_INFO for each channel.  Records are tagged with the sample's load cell
+// channel plus `channel`, so several boards can log to separate files and still be told apart.
+
+#include "forceFrame.h"
+#include "ringLog.h"
+
+class RingSink : public FrameSink
+{
+public:
+  RingSink(RingLogWriter &log, uint8_t channel) : log(log), channel(channel) {}
+
+  void sample(const ForceSample &s) override;
+  void info(const ForceInfo &i) override;
+
+  // The decoder was reset (the port was reopened), so the board's time starts again
+  void restart() { log.rebase(); }
+
+  uint64_t hostUs = 0; // Host clock (CLOCK_REALTIME, us) when the bytes being fed came in
+  uint64_t samples = 0;
+
+private:
+  RingLogWriter &log;
+  uint8_t channel;
+  ForceInfo last[FRAME_MAX_CHANNELS] = {};
+  bool haveInfo[FRAME_MAX_CHANNELS] = {};
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// Recorded traces, in whatever form they were captured, fed to a PeelAnalyser a
+// SampleBlock at a time.  The file is mapped rather than read, and the format is told from
+// its first bytes:
+// - a ring log written by forced (ringLog.h)
+// - the board's binary stream as captured off the port, with or without text in between
+//   (ForceSensorGraph's BURST_SERIAL mixes in its peel lines), decoded with FrameDecoder
+// - text: forcecat/forcequery CSV ("t_us,seq,channel,count,grams,flags"), or a
+//   ForceSensorGraph serial log, of which only the "s,<ms>,<g>" sample lines are used
+// The channels of one conversion become one row of the block.  Raw counts are turned into
+// grams a block at a time with the last FRAME_INFO for each channel; a change of offset or
+// scale (a tare) ends the block and starts the baseline afresh.
+
+#include <stdint.h>
+#include <string>
+#include "peelAnalysis.h"
+
+enum TraceFormat
+{
+  TRACE_UNKNOWN,
+  TRACE_RING,
+  TRACE_FRAMES,
+  TRACE_CSV,
+  TRACE_SERIAL_LOG
+};
+
+struct TraceStats
+{
+  TraceFormat format = TRACE_UNKNOWN;
+  uint64_t bytes = 0;
+  uint64_t samples = 0;      // Readings, one per cell per conversion
+  uint64_t unscaled = 0;     // Raw samples before their channel's first FRAME_INFO, skipped
+  uint64_t badFrames = 0;    // Frames with a bad CRC or length
+  uint64_t lostSamples = 0;  // Gaps in the frame sequence numbers
+  uint64_t badLines = 0;     // Text lines that looked like samples but did not parse
+  uint8_t channels = 0;
+};
+
+const char *traceFormatName(TraceFormat format);
+
+// Analyse the whole of path.  False, with error set, if it cannot be read.
+bool analyseTrace(const char *path, PeelAnalyser &analyser, SampleBlock &block, TraceStats &stats,
+                  std::string &error);
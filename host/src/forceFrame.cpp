@@ -0,0 +1,269 @@
+#include <string.h>
+#include "forceFrame.h"
+
+static uint32_t get32(const uint8_t *p)
+{
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+// CRC-16/CCITT-FALSE a byte at a time: the eight shifts for each top byte, worked out at
+// compile time
+struct CrcTable
+{
+  constexpr CrcTable() : t()
+  {
+    for (int b = 0; b < 256; b++)
+    {
+      uint16_t crc = b << 8;
+      for (int i = 0; i < 8; i++)
+      {
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+      }
+      t[b] = crc;
+    }
+  }
+  uint16_t t[256];
+};
+
+static constexpr CrcTable crcTable;
+
+uint16_t frameCrc(uint16_t crc, uint8_t b)
+{
+  return (uint16_t)(crc << 8) ^ crcTable.t[(crc >> 8 ^ b) & 0xFF];
+}
+
+static size_t finish(uint8_t *out, uint8_t type, uint8_t len)
+{
+  uint16_t crc = 0xFFFF;
+  size_t i;
+
+  out[0] = FRAME_SYNC0;
+  out[1] = FRAME_SYNC1;
+  out[2] = type;
+  out[3] = len;
+  for (i = 2; i < 4u + len; i++)
+  {
+    crc = frameCrc(crc, out[i]);
+  }
+  out[4 + len] = crc;
+  out[5 + len] = crc >> 8;
+  return 6 + len;
+}
+
+size_t encodeSamples(uint8_t *out, uint16_t seq, uint32_t t0, const uint16_t *dt, const int32_t *count,
+                     const uint8_t *flags, uint8_t n)
+{
+  uint8_t *p = out + 4, *s;
+  uint8_t i;
+
+  p[0] = seq;
+  p[1] = seq >> 8;
+  put32(p + 2, t0);
+  for (i = 0; i < n; i++)
+  {
+    s = p + 6 + i * FRAME_SAMPLE_BYTES;
+    s[0] = i ? dt[i] : 0;
+    s[1] = (i ? dt[i] : 0) >> 8;
+    s[2] = count[i];
+    s[3] = count[i] >> 8;
+    s[4] = count[i] >> 16;
+    s[5] = flags ? flags[i] : 0;
+  }
+  return finish(out, FRAME_SAMPLES, 6 + n * FRAME_SAMPLE_BYTES);
+}
+
+size_t encodeInfo(uint8_t *out, const ForceInfo &info)
+{
+  put32(out + 4, (uint32_t)info.offset);
+  memcpy(out + 8, &info.scale, 4);
+  out[12] = info.rateHz;
+  out[13] = info.channel;
+  return finish(out, FRAME_INFO, 10);
+}
+
+size_t encodeBurst(uint8_t *out, const ForceBurst &burst)
+{
+  put16(out + 4, burst.burst);
+  put32(out + 6, burst.tTrigger);
+  put16(out + 10, burst.pre);
+  put16(out + 12, burst.post);
+  out[14] = burst.source;
+  out[15] = burst.channels;
+  return finish(out, FRAME_BURST, 12);
+}
+
+void FrameDecoder::reset()
+{
+  have = 0;
+  synced = false;
+}
+
+void FrameDecoder::feed(const uint8_t *data, size_t len, FrameSink &sink)
+{
+  size_t i, j, total, skip;
+  uint16_t crc;
+
+  for (i = 0; i < len; i++)
+  {
+    // In step with whole frames in data, as when reading a file: check them where they lie
+    // rather than a byte at a time through buf
+    if (!have && len - i >= 6 && data[i] == FRAME_SYNC0 && data[i + 1] == FRAME_SYNC1 &&
+        len - i >= (total = 6 + data[i + 3]))
+    {
+      crc = 0xFFFF;
+      for (j = 2; j < total - 2; j++)
+      {
+        crc = frameCrc(crc, data[i + j]);
+      }
+      if (crc == (data[i + total - 2] | data[i + total - 1] << 8))
+      {
+        memcpy(buf, data + i, total);
+        frame(sink);
+        i += total - 1;
+        continue;
+      }
+    }
+
+    buf[have++] = data[i];
+
+    // Hunt for the sync word
+    if (have == 1 && buf[0] != FRAME_SYNC0)
+    {
+      have = 0;
+      skippedBytes++;
+      continue;
+    }
+    if (have == 2 && buf[1] != FRAME_SYNC1)
+    {
+      // The second byte may itself start the sync word
+      have = buf[1] == FRAME_SYNC0 ? 1 : 0;
+      skippedBytes += 2 - have;
+      continue;
+    }
+
+    // Keep taking frames off the front while the buffer holds complete ones.  After a bad
+    // frame the rest of the buffer may already contain the start of the next one.
+    while (have >= 4 && have >= (total = 6 + buf[3]))
+    {
+      crc = 0xFFFF;
+      for (j = 2; j < total - 2; j++)
+      {
+        crc = frameCrc(crc, buf[j]);
+      }
+      if (crc == (buf[total - 2] | buf[total - 1] << 8))
+      {
+        frame(sink);
+        skip = total;
+      }
+      else
+      {
+        crcErrors++;
+        for (skip = 1; skip < have; skip++)
+        {
+          if (buf[skip] == FRAME_SYNC0 && (skip + 1 == have || buf[skip + 1] == FRAME_SYNC1))
+          {
+            break;
+          }
+        }
+        skippedBytes += skip;
+      }
+      memmove(buf, buf + skip, have - skip);
+      have -= skip;
+    }
+  }
+}
+
+void FrameDecoder::frame(FrameSink &sink)
+{
+  const uint8_t *p = buf + 4;
+  uint8_t type = buf[2], len = buf[3];
+  uint16_t seq16, gap;
+  uint32_t t32, dt;
+  uint8_t i, n;
+  ForceSample s;
+  ForceInfo info;
+  ForceBurst burst;
+
+  if (type == FRAME_INFO && (len == 9 || len == 10))
+  {
+    frames++;
+    info.offset = (int32_t)get32(p);
+    memcpy(&info.scale, p + 4, 4);
+    info.rateHz = p[8];
+    info.channel = len == 10 ? p[9] % FRAME_MAX_CHANNELS : 0;
+    sink.info(info);
+    return;
+  }
+  if (type == FRAME_BURST && len == 12)
+  {
+    frames++;
+    burst.burst = p[0] | p[1] << 8;
+    burst.tTrigger = get32(p + 2);
+    burst.pre = p[6] | p[7] << 8;
+    burst.post = p[8] | p[9] << 8;
+    burst.source = p[10];
+    burst.channels = p[11];
+    sink.burst(burst);
+    return;
+  }
+  if (type != FRAME_SAMPLES || len < 6 + FRAME_SAMPLE_BYTES || (len - 6) % FRAME_SAMPLE_BYTES)
+  {
+    // Unknown or malformed - skip it, a newer board may send more frame types
+    crcErrors += type == FRAME_SAMPLES;
+    return;
+  }
+  frames++;
+  n = (len - 6) / FRAME_SAMPLE_BYTES;
+  seq16 = p[0] | p[1] << 8;
+  t32 = get32(p + 2);
+
+  // Extend the 16-bit sequence number and 32-bit microseconds against the previous frame
+  if (!synced)
+  {
+    s.seq = seq16;
+    s.tUs = t32;
+    synced = true;
+  }
+  else
+  {
+    gap = seq16 - (uint16_t)lastSeq;
+    if (gap < 0x8000)
+    {
+      lostSamples += gap;
+      s.seq = lastSeq + gap;
+    }
+    else
+    {
+      s.seq = lastSeq; // Board restarted or stream replayed - carry on from here
+    }
+    s.tUs = lastT + (uint32_t)(t32 - (uint32_t)lastT);
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    const uint8_t *q = p + 6 + i * FRAME_SAMPLE_BYTES;
+    dt = q[0] | q[1] << 8;
+    s.tUs += i ? dt : 0;
+    s.count = (int32_t)((uint32_t)q[2] << 8 | (uint32_t)q[3] << 16 | (uint32_t)q[4] << 24) >> 8;
+    s.flags = q[5] & ((1 << SAMPLE_CHANNEL_SHIFT) - 1);
+    s.channel = q[5] >> SAMPLE_CHANNEL_SHIFT;
+    sink.sample(s);
+    s.seq++;
+  }
+  lastSeq = s.seq;
+  lastT = s.tUs;
+}
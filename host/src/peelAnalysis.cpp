@@ -0,0 +1,281 @@
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include "peelAnalysis.h"
+
+#define BASELINE_SHIFT 5   // Each new idle sample moves the baseline 1/32 of the way, as on the board
+#define GAP_US 1000000     // A gap this long in the recording (bursts, a restart) primes the baseline afresh
+
+SampleBlock::SampleBlock() : tUs(CAPACITY)
+{
+  for (uint8_t c = 0; c < FRAME_MAX_CHANNELS; c++)
+  {
+    count[c].resize(CAPACITY);
+    grams[c].resize(CAPACITY);
+  }
+}
+
+void Biquad::design(float cutoffHz, float rateHz)
+{
+  double k, norm;
+
+  pass = cutoffHz <= 0 || cutoffHz >= rateHz / 2;
+  if (pass)
+  {
+    return;
+  }
+  // Bilinear transform, cutoff prewarped
+  k = tan(M_PI * cutoffHz / rateHz);
+  norm = 1 / (1 + M_SQRT2 * k + k * k);
+  b0 = k * k * norm;
+  b1 = 2 * b0;
+  b2 = b0;
+  a1 = 2 * (k * k - 1) * norm;
+  a2 = (1 - M_SQRT2 * k + k * k) * norm;
+}
+
+float Biquad::update(float x)
+{
+  float y;
+
+  if (pass)
+  {
+    return x;
+  }
+  if (!primed)
+  {
+    // Start in the steady state for x: no transient from zero
+    z2 = (b2 - a2) * x;
+    z1 = (1 - b0) * x;
+    primed = true;
+  }
+  y = b0 * x + z1;
+  z1 = b1 * x - a1 * y + z2;
+  z2 = b2 * x - a2 * y;
+  return y;
+}
+
+void PeelAnalyser::rezero()
+{
+  state = IDLE;
+  primed = false;
+  next = filled = 0;
+  medianN = medianNext = 0;
+  lowpass.reset();
+  idleN = 0;
+  idleMean = idleM2 = 0;
+}
+
+void PeelAnalyser::startFilters(const SampleBlock &block)
+{
+  float rate = 80;
+
+  if (block.n > 1 && block.tUs[block.n - 1] > block.tUs[0])
+  {
+    rate = 1e6f * (block.n - 1) / (block.tUs[block.n - 1] - block.tUs[0]);
+  }
+  lowpass.design(config.lowpassHz, rate);
+  config.median = std::min<uint8_t>(std::max<uint8_t>(config.median | 1, 1), sizeof(medianHist) / sizeof(medianHist[0]));
+  total.resize(SampleBlock::CAPACITY);
+  outlier.resize(SampleBlock::CAPACITY);
+  filtersReady = true;
+}
+
+float PeelAnalyser::filter(float y)
+{
+  float sorted[sizeof(medianHist) / sizeof(medianHist[0])];
+  uint8_t i, j;
+
+  if (config.median > 1)
+  {
+    medianHist[medianNext] = y;
+    medianNext = medianNext + 1 < config.median ? medianNext + 1 : 0;
+    medianN = medianN < config.median ? medianN + 1 : medianN;
+    for (i = 0; i < medianN; i++)
+    {
+      for (j = i; j && sorted[j - 1] > medianHist[i]; j--)
+      {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = medianHist[i];
+    }
+    y = sorted[(medianN - 1) / 2];
+  }
+  return lowpass.update(y);
+}
+
+void PeelAnalyser::process(SampleBlock &block)
+{
+  size_t i, n = block.n;
+  uint8_t c;
+
+  if (!n)
+  {
+    return;
+  }
+  if (!filtersReady)
+  {
+    startFilters(block);
+  }
+
+  // The passes without history, over whole arrays
+  float *__restrict sum = total.data();
+  uint8_t *__restrict bad = outlier.data();
+  const float *__restrict g = block.grams[0].data();
+  const float limit = config.outlierGrams;
+  for (i = 0; i < n; i++)
+  {
+    sum[i] = g[i];
+  }
+  for (c = 1; c < block.channels; c++)
+  {
+    g = block.grams[c].data();
+    for (i = 0; i < n; i++)
+    {
+      sum[i] += g[i];
+    }
+  }
+  for (i = 0; i < n; i++)
+  {
+    bad[i] = !(fabsf(sum[i]) <= limit); // NaN too
+  }
+
+  // ...and the ones with, a sample at a time
+  for (i = 0; i < n; i++)
+  {
+    if (bad[i])
+    {
+      summary.outliers++;
+      continue;
+    }
+    if (primed && block.tUs[i] - tLast > GAP_US)
+    {
+      rezero();
+    }
+    tLast = block.tUs[i];
+    update(block, i, sum[i], filter(sum[i]));
+  }
+
+  if (!summary.conversions)
+  {
+    summary.firstS = block.tUs[0] / 1e6;
+  }
+  summary.lastS = block.tUs[n - 1] / 1e6;
+  summary.conversions += n;
+}
+
+// The board's detector (peelDetector.cpp) in floating point, with the peak after the
+// filters and the idle noise alongside
+void PeelAnalyser::update(const SampleBlock &block, size_t i, float y, float yf)
+{
+  int64_t t = block.tUs[i];
+  float rise = 0, steep = 0, yPrev = y, dt = 0, d;
+  uint8_t oldest, prev = next ? next - 1 : SLOPE_SAMPLES - 1, c;
+
+  if (!primed)
+  {
+    baseline = y;
+    primed = true;
+  }
+
+  oldest = filled < SLOPE_SAMPLES ? 0 : next;
+  if (filled)
+  {
+    rise = y - lastY[oldest];
+    yPrev = lastY[prev];
+    dt = (t - lastT[prev]) / 1e6f;
+    steep = config.onsetSlope * (t - lastT[oldest]) / 1e6f;
+  }
+  lastY[next] = y;
+  lastT[next] = t;
+  next = next + 1 < SLOPE_SAMPLES ? next + 1 : 0;
+  filled = filled < SLOPE_SAMPLES ? filled + 1 : filled;
+
+  switch (state)
+  {
+  case IDLE:
+    if (y - baseline > config.onsetGrams && rise > steep)
+    {
+      state = LOADING;
+      peak = y;
+      filteredPeak = yf;
+      tPeak = tState = tOnset = t;
+      area = 0;
+      loadSamples = 1;
+      onsetBaseline = baseline;
+      onsetIdleSd = idleN > 1 ? sqrt(idleM2 / (idleN - 1)) : 0;
+      for (c = 0; c < block.channels; c++)
+      {
+        channelPeak[c] = block.grams[c][i];
+      }
+      return;
+    }
+    baseline += (y - baseline) / (1 << BASELINE_SHIFT);
+    d = y - idleMean;
+    idleMean += d / ++idleN;
+    idleM2 += d * (y - idleMean);
+    break;
+
+  case LOADING:
+    area += ((y + yPrev) / 2 - baseline) * dt; // Trapezoids
+    loadSamples++;
+    filteredPeak = std::max(filteredPeak, yf);
+    if (y > peak)
+    {
+      peak = y;
+      tPeak = t;
+      for (c = 0; c < block.channels; c++)
+      {
+        channelPeak[c] = block.grams[c][i];
+      }
+    }
+    else if (rise < -steep && y - baseline < (peak - baseline) * config.releasePercent / 100)
+    {
+      if (peak - baseline < config.minPeak)
+      {
+        state = IDLE; // Just noise
+        summary.dropped++;
+        break;
+      }
+      state = SETTLING;
+      tState = t;
+
+      LayerSummary l;
+      l.layer = summary.layers.size() + 1;
+      l.onsetS = tOnset / 1e6;
+      l.peakS = tPeak / 1e6;
+      l.releaseS = t / 1e6;
+      l.baseline = onsetBaseline;
+      l.peak = peak - baseline;
+      l.filteredPeak = filteredPeak - baseline;
+      l.impulse = area;
+      l.riseRate = tPeak > tOnset ? l.peak * 1e6f / (tPeak - tOnset) : 0;
+      l.idleSd = onsetIdleSd;
+      l.samples = loadSamples;
+      l.channels = block.channels;
+      memset(l.channelPeak, 0, sizeof(l.channelPeak));
+      memcpy(l.channelPeak, channelPeak, block.channels * sizeof(float));
+      summary.layers.push_back(l);
+    }
+    break;
+
+  case SETTLING:
+    if (fabsf(y - baseline) < config.onsetGrams && fabsf(rise) < steep)
+    {
+      state = IDLE;
+      idleN = 0; // The noise before the next peel, not the ringing after this one
+      idleMean = idleM2 = 0;
+    }
+    break;
+  }
+
+  if (state != IDLE && t - tState > config.timeoutS * 1e6)
+  {
+    // Somebody put something on the plate, or took it off - treat it as the new zero
+    state = IDLE;
+    baseline = y;
+    summary.timeouts++;
+    idleN = 0;
+    idleMean = idleM2 = 0;
+  }
+}
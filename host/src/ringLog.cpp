@@ -0,0 +1,197 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ringLog.h"
+
+static size_t fileBytes(uint64_t capacity)
+{
+  return RINGLOG_HEADER_BYTES + capacity * sizeof(RingRecord);
+}
+
+bool RingLogWriter::open(const char *path, uint64_t capacity)
+{
+  struct stat st;
+  bool fresh;
+
+  close();
+  if (capacity == 0)
+  {
+    return false;
+  }
+  fd = ::open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    return false;
+  }
+  mapBytes = fileBytes(capacity);
+  fresh = fstat(fd, &st) != 0 || (size_t)st.st_size != mapBytes;
+  // Allocate the whole file up front so appending never has to grow it
+  if (fresh && (ftruncate(fd, 0) != 0 || ftruncate(fd, mapBytes) != 0))
+  {
+    close();
+    return false;
+  }
+  void *p = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    close();
+    return false;
+  }
+  hdr = (RingLogHeader *)p;
+  records = (RingRecord *)((char *)p + RINGLOG_HEADER_BYTES);
+
+  if (fresh || memcmp(hdr->magic, RINGLOG_MAGIC, sizeof(RINGLOG_MAGIC)) || hdr->version != RINGLOG_VERSION ||
+      hdr->recordBytes != sizeof(RingRecord) || hdr->capacity != capacity)
+  {
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->version = RINGLOG_VERSION;
+    hdr->recordBytes = sizeof(RingRecord);
+    hdr->capacity = capacity;
+    __atomic_store_n(&hdr->head, 0, __ATOMIC_RELEASE);
+    memcpy(hdr->magic, RINGLOG_MAGIC, sizeof(RINGLOG_MAGIC)); // Last, so readers never see a half-made header
+  }
+  // A fresh ring starts at board time.  Otherwise carry on after what is already there.
+  epoch = 0;
+  rebasing = head() != 0;
+  return true;
+}
+
+uint64_t RingLogWriter::logTime(uint64_t boardUs, uint64_t hostUs)
+{
+  uint64_t h = head(), newest = h ? records[(h - 1) % hdr->capacity].tUs : 0;
+
+  // The channels of one conversion share a timestamp, so only going back counts
+  if (rebasing || boardUs + epoch < newest)
+  {
+    epoch = newest + (hdr->hostUs && hostUs > hdr->hostUs ? hostUs - hdr->hostUs : 0) - boardUs;
+    rebasing = false;
+  }
+  hdr->hostUs = hostUs;
+  return boardUs + epoch;
+}
+
+void RingLogWriter::append(const RingRecord &r)
+{
+  uint64_t h = __atomic_load_n(&hdr->head, __ATOMIC_RELAXED);
+  records[h % hdr->capacity] = r;
+  __atomic_store_n(&hdr->head, h + 1, __ATOMIC_RELEASE);
+}
+
+void RingLogWriter::sync()
+{
+  if (hdr)
+  {
+    msync(hdr, mapBytes, MS_ASYNC);
+  }
+}
+
+uint64_t RingLogWriter::head() const
+{
+  return hdr ? __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) : 0;
+}
+
+void RingLogWriter::close()
+{
+  if (hdr)
+  {
+    msync(hdr, mapBytes, MS_SYNC);
+    munmap(hdr, mapBytes);
+  }
+  if (fd >= 0)
+  {
+    ::close(fd);
+  }
+  hdr = nullptr;
+  records = nullptr;
+  fd = -1;
+}
+
+bool RingLogReader::open(const char *path)
+{
+  struct stat st;
+  RingLogHeader h;
+
+  close();
+  fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < RINGLOG_HEADER_BYTES || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+      memcmp(h.magic, RINGLOG_MAGIC, sizeof(RINGLOG_MAGIC)) || h.version != RINGLOG_VERSION ||
+      h.recordBytes != sizeof(RingRecord) || (size_t)st.st_size != fileBytes(h.capacity))
+  {
+    close();
+    return false;
+  }
+  mapBytes = st.st_size;
+  void *p = mmap(nullptr, mapBytes, PROT_READ, MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+  {
+    close();
+    return false;
+  }
+  hdr = (const RingLogHeader *)p;
+  records = (const RingRecord *)((const char *)p + RINGLOG_HEADER_BYTES);
+  return true;
+}
+
+void RingLogReader::close()
+{
+  if (hdr)
+  {
+    munmap((void *)hdr, mapBytes);
+  }
+  if (fd >= 0)
+  {
+    ::close(fd);
+  }
+  hdr = nullptr;
+  records = nullptr;
+  fd = -1;
+}
+
+uint64_t RingLogReader::head() const
+{
+  return hdr ? __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE) : 0;
+}
+
+uint64_t RingLogReader::tail() const
+{
+  uint64_t h = head();
+  // Keep one slot of margin: the writer may be filling slot h % capacity right now
+  return h >= hdr->capacity ? h - hdr->capacity + 1 : 0;
+}
+
+// First index in [lo, hi) whose timestamp is >= tUs
+uint64_t RingLogReader::lowerBound(uint64_t lo, uint64_t hi, uint64_t tUs) const
+{
+  uint64_t mid;
+
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (at(mid).tUs < tUs)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+bool RingLogReader::find(uint64_t fromUs, uint64_t toUs, uint64_t &first, uint64_t &last) const
+{
+  uint64_t lo, hi;
+
+  if (!hdr || fromUs >= toUs)
+  {
+    return false;
+  }
+  lo = tail();
+  hi = head();
+  first = lowerBound(lo, hi, fromUs);
+  last = lowerBound(first, hi, toUs);
+  return first < last && stillValid(first);
+}
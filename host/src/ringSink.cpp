@@ -0,0 +1,23 @@
+#include <math.h>
+#include "ringSink.h"
+
+void RingSink::sample(const ForceSample &s)
+{
+  RingRecord r;
+  r.tUs = log.logTime(s.tUs, hostUs);
+  r.seq = (uint32_t)s.seq;
+  r.count = s.count;
+  const ForceInfo &i = last[s.channel];
+  r.grams = haveInfo[s.channel] && i.scale != 0 ? (s.count - i.offset) / i.scale : NAN;
+  r.channel = channel + s.channel;
+  r.flags = s.flags;
+  r.reserved = 0;
+  log.append(r);
+  samples++;
+}
+
+void RingSink::info(const ForceInfo &i)
+{
+  last[i.channel] = i;
+  haveInfo[i.channel] = true;
+}
@@ -0,0 +1,388 @@
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "traceFile.h"
+#include "ringLog.h"
+
+#define SNIFF_BYTES 65536 // How far into a file to look for the sync word
+
+const char *traceFormatName(TraceFormat format)
+{
+  switch (format)
+  {
+  case TRACE_RING:
+    return "ring";
+  case TRACE_FRAMES:
+    return "frames";
+  case TRACE_CSV:
+    return "csv";
+  case TRACE_SERIAL_LOG:
+    return "serial";
+  default:
+    return "unknown";
+  }
+}
+
+// Gathers the readings of each conversion into a row of the block, and hands the block to
+// the analyser whenever it fills.  The row being filled sits at index n, past the complete
+// ones; a cell missing from a conversion keeps its last reading.
+class BlockBuilder : public FrameSink
+{
+public:
+  BlockBuilder(SampleBlock &block, PeelAnalyser &analyser, TraceStats &stats)
+      : block(block), analyser(analyser), stats(stats)
+  {
+    block.clear();
+    block.channels = 1;
+  }
+
+  // A reading already in grams (text, ring logs)
+  void grams(int64_t tUs, uint8_t channel, float g)
+  {
+    size_t i = row(tUs, channel);
+    block.grams[channel][i] = lastGrams[channel] = g;
+  }
+
+  // A raw count off the binary stream
+  void sample(const ForceSample &s) override
+  {
+    if (!haveInfo[s.channel])
+    {
+      stats.unscaled++;
+      return;
+    }
+    size_t i = row(s.tUs, s.channel);
+    block.count[s.channel][i] = lastCount[s.channel] = s.count;
+    counts = true;
+  }
+
+  // Sent at start-up, after a tare and every so often: only a change matters
+  void info(const ForceInfo &i) override
+  {
+    ForceInfo &last = infos[i.channel];
+    if (haveInfo[i.channel] && last.offset == i.offset && last.scale == i.scale)
+    {
+      return;
+    }
+    flush(); // What came before goes by the old one
+    if (haveInfo[i.channel])
+    {
+      analyser.rezero();
+    }
+    last = i;
+    haveInfo[i.channel] = true;
+    lastCount[i.channel] = i.offset;
+  }
+
+  void finish()
+  {
+    commit();
+    flush();
+  }
+
+private:
+  // The row for a reading of channel at tUs: the open one, unless the time has moved on or
+  // this channel is already in it
+  size_t row(int64_t tUs, uint8_t channel)
+  {
+    size_t n, c;
+
+    if (channel >= block.channels)
+    {
+      // A cell we had not heard from: zero until now
+      for (c = block.channels; c <= channel; c++)
+      {
+        for (n = 0; n <= block.n; n++)
+        {
+          block.count[c][n] = lastCount[c];
+          block.grams[c][n] = 0;
+        }
+      }
+      block.channels = channel + 1;
+      stats.channels = std::max(stats.channels, block.channels);
+    }
+    if (!open || tUs != block.tUs[block.n] || seen & 1 << channel)
+    {
+      commit();
+      n = block.n;
+      block.tUs[n] = tUs;
+      for (c = 0; c < block.channels; c++)
+      {
+        block.count[c][n] = lastCount[c];
+        block.grams[c][n] = lastGrams[c];
+      }
+      open = true;
+      seen = 0;
+    }
+    seen |= 1 << channel;
+    stats.samples++;
+    return block.n;
+  }
+
+  void commit()
+  {
+    if (open && ++block.n == SampleBlock::CAPACITY)
+    {
+      open = false;
+      flush();
+    }
+    open = false;
+  }
+
+  // Counts to grams, a channel at a time, then analyse the complete rows and move the open
+  // one to the front
+  void flush()
+  {
+    size_t i, n = block.n;
+    uint8_t c;
+
+    if (!n)
+    {
+      return;
+    }
+    for (c = 0; counts && c < block.channels; c++)
+    {
+      const int32_t *__restrict raw = block.count[c].data();
+      float *__restrict g = block.grams[c].data();
+      const int32_t offset = infos[c].offset;
+      const float inv = haveInfo[c] && infos[c].scale != 0 ? 1 / infos[c].scale : 0;
+      for (i = 0; i < n; i++)
+      {
+        g[i] = (raw[i] - offset) * inv;
+      }
+    }
+    analyser.process(block);
+
+    if (open)
+    {
+      block.tUs[0] = block.tUs[n];
+      for (c = 0; c < block.channels; c++)
+      {
+        block.count[c][0] = block.count[c][n];
+        block.grams[c][0] = block.grams[c][n];
+      }
+    }
+    block.n = 0;
+  }
+
+  SampleBlock &block;
+  PeelAnalyser &analyser;
+  TraceStats &stats;
+  bool open = false, counts = false;
+  uint8_t seen = 0; // Channels already in the open row
+  int32_t lastCount[FRAME_MAX_CHANNELS] = {};
+  float lastGrams[FRAME_MAX_CHANNELS] = {};
+  ForceInfo infos[FRAME_MAX_CHANNELS] = {};
+  bool haveInfo[FRAME_MAX_CHANNELS] = {};
+};
+
+// Bounded number parsers: the mapping is not NUL-terminated
+static bool parseInt(const char *&p, const char *end, int64_t &v)
+{
+  bool negative = p < end && *p == '-';
+  const char *start;
+
+  p += negative;
+  start = p;
+  for (v = 0; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    v = v * 10 + (*p - '0');
+  }
+  v = negative ? -v : v;
+  return p > start;
+}
+
+static bool parseDecimal(const char *&p, const char *end, double &v)
+{
+  bool negative = p < end && *p == '-';
+  int64_t whole = 0, frac = 0, scale = 1;
+  const char *start;
+
+  p += negative;
+  start = p;
+  for (; p < end && *p >= '0' && *p <= '9'; p++)
+  {
+    whole = whole * 10 + (*p - '0');
+  }
+  if (p < end && *p == '.')
+  {
+    for (p++; p < end && *p >= '0' && *p <= '9' && scale < 1000000000000LL; p++)
+    {
+      frac = frac * 10 + (*p - '0');
+      scale *= 10;
+    }
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+      p++; // Beyond what a double keeps anyway
+    }
+  }
+  v = whole + (double)frac / scale;
+  v = negative ? -v : v;
+  return p > start;
+}
+
+static bool skipField(const char *&p, const char *end)
+{
+  while (p < end && *p != ',' && *p != '\n')
+  {
+    p++;
+  }
+  return p < end && *p++ == ',';
+}
+
+static bool comma(const char *&p, const char *end)
+{
+  return p < end && *p++ == ',';
+}
+
+// "t_us,seq,channel,count,grams,flags" or "s,<ms>,<g>" lines; anything else is passed over
+static void readText(const char *p, const char *end, TraceFormat format, BlockBuilder &builder, TraceStats &stats)
+{
+  const char *eol;
+  int64_t t, channel, count;
+  double ms, g;
+
+  for (; p < end; p = eol + 1)
+  {
+    eol = (const char *)memchr(p, '\n', end - p);
+    eol = eol ? eol : end;
+    if (format == TRACE_CSV)
+    {
+      if (*p < '0' || *p > '9')
+      {
+        continue; // The header
+      }
+      if (!parseInt(p, eol, t) || !comma(p, eol) || !skipField(p, eol) || !parseInt(p, eol, channel) ||
+          !comma(p, eol) || !parseInt(p, eol, count) || !comma(p, eol) || channel < 0 ||
+          channel >= FRAME_MAX_CHANNELS)
+      {
+        stats.badLines++;
+        continue;
+      }
+      if (!parseDecimal(p, eol, g))
+      {
+        stats.unscaled++; // "nan" before the first FRAME_INFO
+        continue;
+      }
+      builder.grams(t, channel, g);
+    }
+    else if (eol - p > 2 && p[0] == 's' && p[1] == ',')
+    {
+      p += 2;
+      if (!parseDecimal(p, eol, ms) || !comma(p, eol) || !parseDecimal(p, eol, g))
+      {
+        stats.badLines++;
+        continue;
+      }
+      builder.grams(llround(ms * 1000), 0, g);
+    }
+  }
+}
+
+static bool readRing(const char *path, BlockBuilder &builder, TraceStats &stats, std::string &error)
+{
+  RingLogReader log;
+  uint64_t i, head, tail;
+
+  if (!log.open(path))
+  {
+    error = "not a ring log";
+    return false;
+  }
+  head = log.head();
+  tail = log.tail();
+  for (i = tail; i < head; i++)
+  {
+    const RingRecord &r = log.at(i);
+    if (isnan(r.grams))
+    {
+      stats.unscaled++;
+      continue;
+    }
+    builder.grams(r.tUs, r.channel % FRAME_MAX_CHANNELS, r.grams); // Without forced's --channel offset
+  }
+  if (!log.stillValid(tail))
+  {
+    error = "overtaken by the writer";
+    return false;
+  }
+  return true;
+}
+
+bool analyseTrace(const char *path, PeelAnalyser &analyser, SampleBlock &block, TraceStats &stats,
+                  std::string &error)
+{
+  struct stat st;
+  const uint8_t *data;
+  size_t size, i;
+  int fd;
+  bool ok = true;
+  BlockBuilder builder(block, analyser, stats);
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0)
+  {
+    error = strerror(errno);
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    return false;
+  }
+  size = stats.bytes = st.st_size;
+  if (!size)
+  {
+    close(fd);
+    error = "empty";
+    return false;
+  }
+  data = (const uint8_t *)mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+  {
+    error = strerror(errno);
+    return false;
+  }
+  madvise((void *)data, size, MADV_SEQUENTIAL);
+
+  // What is it?
+  if (size >= sizeof(RINGLOG_MAGIC) && !memcmp(data, RINGLOG_MAGIC, sizeof(RINGLOG_MAGIC)))
+  {
+    stats.format = TRACE_RING;
+  }
+  else
+  {
+    stats.format = size >= 16 && !memcmp(data, "t_us,seq,channel", 16) ? TRACE_CSV : TRACE_SERIAL_LOG;
+    for (i = 0; i + 1 < size && i < SNIFF_BYTES; i++)
+    {
+      if (data[i] == FRAME_SYNC0 && data[i + 1] == FRAME_SYNC1)
+      {
+        stats.format = TRACE_FRAMES;
+        break;
+      }
+    }
+  }
+
+  if (stats.format == TRACE_RING)
+  {
+    ok = readRing(path, builder, stats, error);
+  }
+  else if (stats.format == TRACE_FRAMES)
+  {
+    FrameDecoder decoder;
+    decoder.feed(data, size, builder);
+    stats.badFrames = decoder.crcErrors;
+    stats.lostSamples = decoder.lostSamples;
+  }
+  else
+  {
+    readText((const char *)data, (const char *)data + size, stats.format, builder, stats);
+  }
+  builder.finish();
+  munmap((void *)data, size);
+  return ok;
+}
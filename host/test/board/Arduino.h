@@ -0,0 +1,33 @@
+#pragma once
+
+// Stand-in for the Arduino core, so the board sketch's stream encoders (frame.hpp, burst.hpp)
+// build on the host: Serial keeps whatever is written to it, and digitalRead() gives what the
+// test set.
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define INPUT_PULLUP 2
+
+struct BoardSerial
+{
+  std::vector<uint8_t> sent;
+
+  size_t write(const uint8_t *p, size_t n)
+  {
+    sent.insert(sent.end(), p, p + n);
+    return n;
+  }
+};
+
+extern BoardSerial Serial;
+
+// Pins a test holds low; the rest read high, as the pull-ups leave them
+inline bool boardPinLow[32];
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t pin) { return boardPinLow[pin % 32] ? LOW : HIGH; }
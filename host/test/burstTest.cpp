@@ -0,0 +1,355 @@
+// The board sketch's burst capture (burst.hpp) on synthetic trigger sequences: load steps
+// through the level, fast and slow ramps against the slope, and pulses on the trigger pin,
+// sent as the sketch's loop() sends them and read back through FrameDecoder.  Each burst
+// must carry its history and its post-trigger conversions, in order, the trigger sample
+// flagged, and nothing in between bursts.
+//   make test
+
+#include <math.h>
+#include <vector>
+#include <Arduino.h>
+#include "forceFrame.h"
+#include "check.h"
+
+// The board's headers have their own copies of forceFrame.h's constants
+namespace board
+{
+#include "frame.hpp"
+#include "burst.hpp"
+}
+
+BoardSerial Serial;
+
+static const uint8_t CHANNELS = 2, PRE = 40;
+static const uint16_t POST = 120;
+static const uint32_t PERIOD_US = 12500;
+static const float SCALE = 212.5f;
+static const long OFFSET = -4000;
+static const uint8_t PIN = 7;
+
+struct Collect : FrameSink
+{
+  std::vector<ForceSample> samples;
+  std::vector<ForceBurst> bursts;
+  std::vector<size_t> burstStart; // Index into samples of each burst's first
+
+  void sample(const ForceSample &s) override { samples.push_back(s); }
+  void info(const ForceInfo &) override {}
+  void burst(const ForceBurst &b) override
+  {
+    bursts.push_back(b);
+    burstStart.push_back(samples.size());
+  }
+};
+
+// The sketch's loop() for each conversion, with CAPTURE_BURSTS (Basic-Force-Sensor-V0.1-board.ino)
+struct Sketch
+{
+  board::BurstCapture<CHANNELS, PRE> bursts;
+  board::FrameWriter frames;
+  uint16_t burstNo = 0, postLeft = 0;
+  uint32_t t = 0x100000000ULL - 10000000; // micros() wraps 10 s in
+
+  Sketch(float level, float slope, int pin) : bursts(level, slope, pin, LOW)
+  {
+    Serial.sent.clear();
+    for (bool &low : boardPinLow)
+    {
+      low = false;
+    }
+    bursts.begin();
+  }
+
+  // A conversion with `grams` on the plate, half on each cell
+  void conversion(float grams)
+  {
+    long count[CHANNELS];
+    float total = 0;
+    uint8_t c, flags = 0;
+
+    t += PERIOD_US;
+    for (c = 0; c < CHANNELS; c++)
+    {
+      count[c] = lround(OFFSET + grams / CHANNELS * SCALE);
+      total += (count[c] - OFFSET) / SCALE;
+    }
+    uint8_t source = bursts.trigger(t, total);
+    if (!postLeft)
+    {
+      bursts.push(t, count, flags);
+      if (!source)
+      {
+        return;
+      }
+      for (c = 0; c < CHANNELS; c++)
+      {
+        frames.sendInfo(OFFSET, SCALE, 80, c);
+      }
+      frames.sendBurst(++burstNo, t, bursts.size() - 1, POST, source, CHANNELS);
+      for (uint8_t i = 0; i < bursts.size(); i++)
+      {
+        const auto &e = bursts.at(i);
+        uint8_t f = e.flags | (i + 1 == bursts.size() ? board::SAMPLE_TRIGGER : 0);
+        for (c = 0; c < CHANNELS; c++)
+        {
+          frames.add(e.t, e.count[c], f | (c << board::SAMPLE_CHANNEL_SHIFT));
+        }
+      }
+      bursts.clear();
+      postLeft = POST - 1;
+      return;
+    }
+    postLeft--;
+    for (c = 0; c < CHANNELS; c++)
+    {
+      frames.add(t, count[c], flags | (c << board::SAMPLE_CHANNEL_SHIFT));
+    }
+  }
+
+  Collect decode()
+  {
+    FrameDecoder d;
+    Collect sink;
+
+    frames.flush();
+    d.feed(Serial.sent.data(), Serial.sent.size(), sink);
+    return sink;
+  }
+};
+
+static float gramsOf(const ForceSample &s)
+{
+  return (s.count - OFFSET) / SCALE * CHANNELS;
+}
+
+// Every burst: its header's pre and post, then that many conversions a period apart on
+// both channels, the trigger flagged on the pre-th and nowhere else
+static void checkBursts(const Collect &sink)
+{
+  CHECK(!sink.bursts.empty());
+  for (size_t b = 0; b < sink.bursts.size(); b++)
+  {
+    const ForceBurst &h = sink.bursts[b];
+    size_t first = sink.burstStart[b], end = b + 1 < sink.bursts.size() ? sink.burstStart[b + 1] : sink.samples.size();
+
+    CHECK_EQ(h.burst, b + 1);
+    CHECK_EQ(h.post, POST);
+    CHECK_EQ(h.channels, CHANNELS);
+    CHECK_EQ(end - first, (size_t)(h.pre + h.post) * CHANNELS);
+    for (size_t i = first; i < end; i++)
+    {
+      const ForceSample &s = sink.samples[i];
+      size_t n = (i - first) / CHANNELS;
+      CHECK_EQ(s.channel, (i - first) % CHANNELS);
+      CHECK_EQ(s.tUs - sink.samples[first].tUs, n * PERIOD_US);
+      CHECK_EQ(!!(s.flags & SAMPLE_TRIGGER), n == h.pre);
+      if (n == h.pre)
+      {
+        CHECK_EQ((uint32_t)s.tUs, h.tTrigger);
+      }
+    }
+  }
+}
+
+// A load put on and taken off: a burst as it goes through the level, none while it stays
+// up, and another once it has been off (under half the level) and comes back
+static void testLevel()
+{
+  Sketch sk(100, 0, -1);
+  uint32_t i, cycle;
+
+  for (cycle = 0; cycle < 3; cycle++)
+  {
+    for (i = 0; i < 240; i++)
+    {
+      sk.conversion(0);
+    }
+    for (i = 0; i < 320; i++)
+    {
+      sk.conversion(i < 4 ? i * 40 : 300); // Up through 100 g on the 4th
+    }
+  }
+  Collect sink = sk.decode();
+  checkBursts(sink);
+  CHECK_EQ(sink.bursts.size(), 3);
+  for (size_t b = 0; b < 3; b++)
+  {
+    const ForceSample &trig = sink.samples[sink.burstStart[b] + PRE * CHANNELS];
+    CHECK_EQ(sink.bursts[b].pre, PRE);
+    CHECK_EQ(sink.bursts[b].source, BURST_BY_LEVEL);
+    CHECK(gramsOf(trig) >= 100);
+    CHECK(gramsOf(sink.samples[sink.burstStart[b] + (PRE - 1) * CHANNELS]) < 100);
+  }
+  // Across the micros() wrap and still a period apart
+  CHECK(sink.samples.back().tUs > 0x100000000ULL);
+}
+
+// A load hovering at the level fires once, and only fires again after dropping under half
+static void testLevelHysteresis()
+{
+  Sketch sk(100, 0, -1);
+  uint32_t i;
+
+  for (i = 0; i < 2000; i++)
+  {
+    sk.conversion(100 + 8 * sin(i * 0.7)); // In and out of the level every few conversions
+  }
+  for (i = 0; i < 200; i++)
+  {
+    sk.conversion(60); // Under the level, but not under half
+  }
+  for (i = 0; i < 200; i++)
+  {
+    sk.conversion(120);
+  }
+  Collect sink = sk.decode();
+  checkBursts(sink);
+  CHECK_EQ(sink.bursts.size(), 1);
+
+  for (i = 0; i < 200; i++)
+  {
+    sk.conversion(40);
+  }
+  sk.conversion(120);
+  for (i = 0; i < 200; i++)
+  {
+    sk.conversion(0);
+  }
+  sink = sk.decode();
+  CHECK_EQ(sink.bursts.size(), 2);
+}
+
+// The slope fires on a peel's fast lift within its 4 conversion window, not on a load put
+// down slowly, and re-arms once the lift eases off
+static void testSlope()
+{
+  Sketch sk(0, 500, -1);
+  uint32_t i, lifts;
+  float g = 0;
+
+  for (lifts = 0; lifts < 4; lifts++)
+  {
+    for (i = 0; i < 400; i++)
+    {
+      sk.conversion(g += 200 * PERIOD_US / 1e6); // 200 g/s: slower than the slope
+    }
+    for (i = 0; i < 80; i++)
+    {
+      sk.conversion(g += 3000 * PERIOD_US / 1e6); // 3 kg/s
+    }
+    g = 0;
+    for (i = 0; i < 200; i++)
+    {
+      sk.conversion(g);
+    }
+  }
+  Collect sink = sk.decode();
+  checkBursts(sink);
+  CHECK_EQ(sink.bursts.size(), 4);
+  for (size_t b = 0; b < sink.bursts.size(); b++)
+  {
+    CHECK_EQ(sink.bursts[b].source, BURST_BY_SLOPE);
+    // Fired on the lift itself, not the slow ramp before it
+    const ForceSample &trig = sink.samples[sink.burstStart[b] + sink.bursts[b].pre * CHANNELS];
+    const ForceSample &before = sink.samples[sink.burstStart[b] + (sink.bursts[b].pre - 1) * CHANNELS];
+    CHECK(gramsOf(trig) - gramsOf(before) > 3000 * PERIOD_US / 1e6 * 0.9);
+  }
+}
+
+// Pulses on the pin, as the printer's Z motor enable would give: one burst each, with the
+// history as it stands - short just after the start, and none from inside the last burst
+static void testPin()
+{
+  Sketch sk(0, 0, PIN);
+  const uint32_t pulses[] = {10, 500, 540, 1000, 1150};
+  uint32_t i, p = 0;
+
+  for (i = 0; i < 1500; i++)
+  {
+    boardPinLow[PIN] = p < 5 && i >= pulses[p] && i < pulses[p] + 3;
+    sk.conversion(50);
+    p += p < 5 && i == pulses[p] + 2;
+  }
+  Collect sink = sk.decode();
+  checkBursts(sink);
+  // 540 comes during the burst from 500, and is part of it
+  CHECK_EQ(sink.bursts.size(), 4);
+  CHECK_EQ(sink.bursts[0].pre, 10);
+  CHECK_EQ(sink.bursts[1].pre, PRE);
+  CHECK_EQ(sink.bursts[2].pre, PRE);
+  CHECK_EQ(sink.bursts[3].pre, 1150 - (1000 + POST)); // History from the end of the last
+  for (const ForceBurst &b : sink.bursts)
+  {
+    CHECK_EQ(b.source, BURST_BY_PIN);
+  }
+
+  // Held active, it fires once
+  Sketch held(0, 0, PIN);
+  boardPinLow[PIN] = true;
+  for (i = 0; i < 1000; i++)
+  {
+    held.conversion(50);
+  }
+  CHECK_EQ(held.decode().bursts.size(), 1);
+}
+
+// Several sources at once are all reported
+static void testSources()
+{
+  Sketch sk(100, 500, PIN);
+  uint32_t i;
+
+  for (i = 0; i < 100; i++)
+  {
+    sk.conversion(0);
+  }
+  boardPinLow[PIN] = true;
+  sk.conversion(1000);
+  Collect sink = sk.decode();
+  CHECK_EQ(sink.bursts.size(), 1);
+  CHECK_EQ(sink.bursts[0].source, BURST_BY_LEVEL | BURST_BY_SLOPE | BURST_BY_PIN);
+}
+
+// What bursts save on the link: a peel every 8 s, against streaming every conversion
+static void testLinkBytes()
+{
+  Sketch burst(100, 0, -1);
+  board::FrameWriter all;
+  uint32_t i, streamed;
+  double g;
+  char line[100];
+
+  for (i = 0; i < 80 * 600; i++)
+  {
+    g = fmod(i / 80.0, 8) < 2 ? 1500 * fmod(i / 80.0, 8) / 2 : 0; // 2 s lift, then 6 s idle
+    burst.conversion(g);
+  }
+  burst.frames.flush();
+  size_t burstBytes = Serial.sent.size();
+
+  Serial.sent.clear();
+  for (i = 0; i < 80 * 600; i++)
+  {
+    for (uint8_t c = 0; c < CHANNELS; c++)
+    {
+      all.add(i * PERIOD_US, 0, c << board::SAMPLE_CHANNEL_SHIFT);
+    }
+  }
+  all.flush();
+  streamed = Serial.sent.size();
+  snprintf(line, sizeof(line), "10 min, a peel every 8 s: %zu bytes in bursts, %u streaming everything", burstBytes,
+           streamed);
+  printf("  %s\n", line);
+  CHECK(burstBytes * 3 < streamed);
+}
+
+int main()
+{
+  RUN(testLevel);
+  RUN(testLevelHysteresis);
+  RUN(testSlope);
+  RUN(testPin);
+  RUN(testSources);
+  RUN(testLinkBytes);
+  return checkResult();
+}
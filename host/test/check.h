@@ -0,0 +1,47 @@
+#pragma once
+
+// Just enough of a test harness for make test: each test is a function of CHECKs, run by
+// RUN() from main(), which returns checkResult().
+
+#include <stdio.h>
+
+static int checkFailures = 0, checkTests = 0;
+
+#define CHECK(cond)                                                        \
+  do                                                                       \
+  {                                                                        \
+    if (!(cond))                                                           \
+    {                                                                      \
+      printf("%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+      checkFailures++;                                                     \
+      return;                                                              \
+    }                                                                      \
+  } while (0)
+
+// Like CHECK(a == b), showing both sides
+#define CHECK_EQ(a, b)                                                     \
+  do                                                                       \
+  {                                                                        \
+    long long a_ = (long long)(a), b_ = (long long)(b);                    \
+    if (a_ != b_)                                                          \
+    {                                                                      \
+      printf("%s:%d: %s: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, __func__, #a, #b, a_, b_); \
+      checkFailures++;                                                     \
+      return;                                                              \
+    }                                                                      \
+  } while (0)
+
+#define RUN(test)                                                          \
+  do                                                                       \
+  {                                                                        \
+    int before_ = checkFailures;                                           \
+    checkTests++;                                                          \
+    test();                                                                \
+    printf("%-40s %s\n", #test, checkFailures == before_ ? "ok" : "FAILED"); \
+  } while (0)
+
+static inline int checkResult()
+{
+  printf("%d tests, %d failed\n", checkTests, checkFailures);
+  return checkFailures ? 1 : 0;
+}
@@ -0,0 +1,277 @@
+// The binary stream end to end: the board sketch's FrameWriter (frame.hpp) into
+// FrameDecoder, fed in chunks of every size, across the micros() and sequence number
+// wraps, and through corrupted, truncated and padded streams.
+//   make test
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <Arduino.h>
+#include "forceFrame.h"
+#include "check.h"
+
+// frame.hpp has its own copies of forceFrame.h's constants, so it gets a namespace
+namespace board
+{
+#include "frame.hpp"
+}
+
+BoardSerial Serial;
+
+struct Sent
+{
+  uint64_t tUs; // Unwrapped, as the decoder should give it back
+  int32_t count;
+  uint8_t flags;
+};
+
+struct Collect : FrameSink
+{
+  std::vector<ForceSample> samples;
+  std::vector<ForceInfo> infos;
+  std::vector<ForceBurst> bursts;
+
+  void sample(const ForceSample &s) override { samples.push_back(s); }
+  void info(const ForceInfo &i) override { infos.push_back(i); }
+  void burst(const ForceBurst &b) override { bursts.push_back(b); }
+};
+
+static int32_t randomCount()
+{
+  return (int32_t)((uint32_t)rand() << 8 ^ (uint32_t)rand()) >> 8; // Anywhere in the 24-bit range
+}
+
+// n samples at periodUs from t0, through the board's writer.  Returns what was sent.
+static std::vector<Sent> writeSamples(board::FrameWriter &w, uint64_t t0, uint32_t periodUs, uint32_t n)
+{
+  std::vector<Sent> sent;
+  uint64_t t = t0;
+
+  for (uint32_t i = 0; i < n; i++, t += periodUs)
+  {
+    Sent s = {t, randomCount(), (uint8_t)(rand() % 16 | (i % 4) << SAMPLE_CHANNEL_SHIFT)};
+    w.add((uint32_t)t, s.count, s.flags);
+    sent.push_back(s);
+  }
+  w.flush();
+  return sent;
+}
+
+static void feedInChunks(FrameDecoder &d, const std::vector<uint8_t> &bytes, size_t maxChunk, Collect &sink)
+{
+  size_t i = 0, n;
+
+  while (i < bytes.size())
+  {
+    n = maxChunk == 1 ? 1 : 1 + rand() % maxChunk;
+    n = n < bytes.size() - i ? n : bytes.size() - i;
+    d.feed(bytes.data() + i, n, sink);
+    i += n;
+  }
+}
+
+static bool matches(const ForceSample &got, const Sent &sent)
+{
+  return got.tUs == sent.tUs && got.count == sent.count &&
+         got.flags == (sent.flags & ((1 << SAMPLE_CHANNEL_SHIFT) - 1)) &&
+         got.channel == sent.flags >> SAMPLE_CHANNEL_SHIFT;
+}
+
+static void testRoundTrip()
+{
+  const size_t chunks[] = {1, 7, 64, 100000};
+
+  for (size_t maxChunk : chunks)
+  {
+    board::FrameWriter w;
+    FrameDecoder d;
+    Collect sink;
+
+    srand(1);
+    Serial.sent.clear();
+    w.sendInfo(-123456, 212.5f, 80, 2);
+    std::vector<Sent> sent = writeSamples(w, 1000, 12500, 1001);
+    w.sendBurst(7, 0xDEADBEEF, 40, 120, BURST_BY_PIN, 4);
+    feedInChunks(d, Serial.sent, maxChunk, sink);
+
+    CHECK_EQ(sink.samples.size(), sent.size());
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+      CHECK(matches(sink.samples[i], sent[i]));
+      CHECK_EQ(sink.samples[i].seq, i);
+    }
+    CHECK_EQ(sink.infos.size(), 1);
+    CHECK_EQ(sink.infos[0].offset, -123456);
+    CHECK(sink.infos[0].scale == 212.5f);
+    CHECK_EQ(sink.infos[0].rateHz, 80);
+    CHECK_EQ(sink.infos[0].channel, 2);
+    CHECK_EQ(sink.bursts.size(), 1);
+    CHECK_EQ(sink.bursts[0].burst, 7);
+    CHECK_EQ(sink.bursts[0].tTrigger, 0xDEADBEEF);
+    CHECK_EQ(sink.bursts[0].pre, 40);
+    CHECK_EQ(sink.bursts[0].post, 120);
+    CHECK_EQ(sink.bursts[0].source, BURST_BY_PIN);
+    CHECK_EQ(sink.bursts[0].channels, 4);
+    CHECK_EQ(d.crcErrors, 0);
+    CHECK_EQ(d.skippedBytes, 0);
+    CHECK_EQ(d.lostSamples, 0);
+  }
+}
+
+// The host's encoders must produce the board's bytes exactly
+static void testHostEncodersMatchBoard()
+{
+  board::FrameWriter w;
+  uint8_t out[FRAME_MAX_BYTES];
+  uint16_t dt[FRAME_MAX_SAMPLES];
+  int32_t count[FRAME_MAX_SAMPLES];
+  uint8_t flags[FRAME_MAX_SAMPLES];
+  std::vector<uint8_t> host;
+  size_t n;
+
+  srand(2);
+  Serial.sent.clear();
+  for (uint8_t i = 0; i < FRAME_MAX_SAMPLES; i++)
+  {
+    dt[i] = i ? 12000 + rand() % 1000 : 0;
+    count[i] = randomCount();
+    flags[i] = rand() % 256;
+  }
+  uint32_t t = 0xFFFFF000; // Across the wrap, as the board's frames can be
+  for (uint8_t i = 0; i < FRAME_MAX_SAMPLES; i++)
+  {
+    t += dt[i];
+    w.add(t, count[i], flags[i]);
+  }
+  w.sendInfo(-5, 1.5f, 10, 3);
+  w.sendBurst(1, 2, 3, 4, BURST_BY_LEVEL, 1);
+
+  n = encodeSamples(out, 0, 0xFFFFF000, dt, count, flags, FRAME_MAX_SAMPLES);
+  host.insert(host.end(), out, out + n);
+  n = encodeInfo(out, {-5, 1.5f, 10, 3});
+  host.insert(host.end(), out, out + n);
+  n = encodeBurst(out, {1, 2, 3, 4, BURST_BY_LEVEL, 1});
+  host.insert(host.end(), out, out + n);
+  CHECK(host == Serial.sent);
+}
+
+// 80Hz from 5 s before micros() wraps, for long enough to wrap the 16-bit sequence number too
+static void testMicrosAndSequenceWrap()
+{
+  board::FrameWriter w;
+  FrameDecoder d;
+  Collect sink;
+
+  srand(3);
+  Serial.sent.clear();
+  std::vector<Sent> sent = writeSamples(w, 0x100000000ULL - 5000000, 12500, 70000);
+  feedInChunks(d, Serial.sent, 64, sink);
+
+  CHECK_EQ(sink.samples.size(), sent.size());
+  for (size_t i = 0; i < sent.size(); i++)
+  {
+    CHECK(matches(sink.samples[i], sent[i]));
+    CHECK_EQ(sink.samples[i].seq, i);
+  }
+  CHECK(sink.samples.back().tUs > 0x100000000ULL);
+  CHECK_EQ(d.lostSamples, 0);
+}
+
+// At 10Hz a conversion is more than the 16-bit dt can hold, so each gets its own frame
+static void testLongGaps()
+{
+  board::FrameWriter w;
+  FrameDecoder d;
+  Collect sink;
+
+  srand(4);
+  Serial.sent.clear();
+  std::vector<Sent> sent = writeSamples(w, 0xFFF00000, 100000, 200);
+  feedInChunks(d, Serial.sent, 64, sink);
+
+  CHECK_EQ(d.frames, 200);
+  CHECK_EQ(sink.samples.size(), sent.size());
+  for (size_t i = 0; i < sent.size(); i++)
+  {
+    CHECK(matches(sink.samples[i], sent[i]));
+  }
+}
+
+// Damage the stream frame by frame: flipped bits, dropped bytes, line noise between frames
+// (with false sync words in it) and a cut-off frame.  Every sample the decoder passes on must
+// be right, the damaged frames' samples must be counted as lost, and nothing else may be.
+static void testCorruptionAndResync()
+{
+  const size_t chunks[] = {1, 64, 1000000};
+
+  for (size_t maxChunk : chunks)
+  {
+    board::FrameWriter w;
+    FrameDecoder d;
+    Collect sink;
+    std::vector<uint8_t> stream;
+    std::vector<Sent> sent;
+    uint32_t damaged = 0, damagedSamples = 0;
+    size_t frameStart = 0, i;
+
+    srand(5);
+    Serial.sent.clear();
+    sent = writeSamples(w, 0, 12500, 8 * 400);
+
+    // Serial.sent is 400 whole frames of 8 samples
+    const size_t frameBytes = Serial.sent.size() / 400;
+    for (i = 0; i < 400; i++, frameStart += frameBytes)
+    {
+      std::vector<uint8_t> f(Serial.sent.begin() + frameStart, Serial.sent.begin() + frameStart + frameBytes);
+      switch (i % 10 == 3 ? rand() % 4 : -1)
+      {
+      case 0:
+        f[rand() % f.size()] ^= 1 << rand() % 8;
+        break;
+      case 1:
+        f.erase(f.begin() + rand() % f.size());
+        break;
+      case 2:
+        f.resize(rand() % f.size());
+        break;
+      case 3:
+        f.insert(f.begin() + 2 + rand() % (f.size() - 2), (uint8_t)rand());
+        break;
+      default:
+        // A false sync word holds back what follows until its length's worth has arrived,
+        // up to 261 bytes, so none just before the end of the stream
+        if (i % 7 == 5 && i < 390)
+        {
+          const uint8_t noise[] = {0x00, FRAME_SYNC0, 0x13, FRAME_SYNC0, FRAME_SYNC1, 0x01, 0xFF};
+          stream.insert(stream.end(), noise, noise + sizeof(noise));
+        }
+        stream.insert(stream.end(), f.begin(), f.end());
+        continue;
+      }
+      damaged++;
+      damagedSamples += 8;
+      stream.insert(stream.end(), f.begin(), f.end());
+    }
+    feedInChunks(d, stream, maxChunk, sink);
+
+    CHECK_EQ(sink.samples.size(), sent.size() - damagedSamples);
+    for (const ForceSample &s : sink.samples)
+    {
+      CHECK(s.seq < sent.size());
+      CHECK(matches(s, sent[s.seq]));
+    }
+    CHECK_EQ(d.lostSamples, damagedSamples);
+    CHECK(d.crcErrors >= damaged / 2);
+    CHECK(d.skippedBytes > 0);
+  }
+}
+
+int main()
+{
+  RUN(testRoundTrip);
+  RUN(testHostEncodersMatchBoard);
+  RUN(testMicrosAndSequenceWrap);
+  RUN(testLongGaps);
+  RUN(testCorruptionAndResync);
+  return checkResult();
+}
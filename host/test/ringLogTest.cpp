@@ -0,0 +1,232 @@
+// The ring log as forced writes it: the board sketch's FrameWriter (frame.hpp) through
+// FrameDecoder and RingSink into a RingLogWriter, read back with RingLogReader.  Log time has
+// to keep counting up through board resets, reconnects and forced restarts, or find()'s
+// binary search gives the wrong records.
+//   make test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <Arduino.h>
+#include "forceFrame.h"
+#include "ringLog.h"
+#include "ringSink.h"
+#include "check.h"
+
+namespace board
+{
+#include "frame.hpp"
+}
+
+BoardSerial Serial;
+
+static const uint32_t PERIOD_US = 12500;
+
+static char path[] = "/tmp/ringLogTestXXXXXX";
+
+// The board's side: conversions of `cells` channels from board time t, sent and fed to forced
+struct Board
+{
+  board::FrameWriter w;
+  FrameDecoder decoder;
+  uint32_t t = 0;
+
+  // n conversions, which arrive at host time hostUs onwards
+  void send(RingSink &sink, uint32_t n, uint8_t cells, uint64_t hostUs)
+  {
+    for (uint32_t i = 0; i < n; i++, t += PERIOD_US)
+    {
+      for (uint8_t c = 0; c < cells; c++)
+      {
+        w.add(t, (int32_t)i, c << SAMPLE_CHANNEL_SHIFT);
+      }
+      // forced reads what has arrived a few frames at a time
+      if (i % 4 == 3 || i == n - 1)
+      {
+        w.flush();
+        sink.hostUs = hostUs + (uint64_t)i * PERIOD_US;
+        decoder.feed(Serial.sent.data(), Serial.sent.size(), sink);
+        Serial.sent.clear();
+      }
+    }
+  }
+
+  // Reset: micros() starts again
+  void reset()
+  {
+    w = board::FrameWriter();
+    t = 0;
+  }
+};
+
+// Log time after a gap comes from the host clock when the read that brought the sample in
+// returned, so it can be late by up to one read's worth of conversions
+static bool afterGap(uint64_t tUs, uint64_t newest, uint64_t gapUs)
+{
+  return tUs >= newest + gapUs && tUs <= newest + gapUs + 4 * PERIOD_US;
+}
+
+static bool countsUp(const RingLogReader &log)
+{
+  for (uint64_t i = log.tail() + 1; i < log.head(); i++)
+  {
+    if (log.at(i).tUs < log.at(i - 1).tUs)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// find() against a scan of the ring
+static bool findsWhatAScanFinds(const RingLogReader &log, uint64_t fromUs, uint64_t toUs)
+{
+  uint64_t first = 0, last = 0, i, scanFirst = log.head(), scanLast = log.head();
+  bool found = log.find(fromUs, toUs, first, last);
+
+  for (i = log.tail(); i < log.head(); i++)
+  {
+    if (log.at(i).tUs >= fromUs && scanFirst == log.head())
+    {
+      scanFirst = i;
+    }
+    if (log.at(i).tUs >= toUs && scanLast == log.head())
+    {
+      scanLast = i;
+    }
+  }
+  if (scanFirst >= scanLast)
+  {
+    return !found;
+  }
+  return found && first == scanFirst && last == scanLast;
+}
+
+static void testAppendFindAndWrap()
+{
+  RingLogWriter w;
+  RingLogReader r;
+  RingSink sink(w, 0);
+  Board b;
+
+  unlink(path);
+  CHECK(w.open(path, 1000));
+  CHECK(r.open(path));
+  b.send(sink, 300, 2, 1000000);
+  CHECK_EQ(r.head(), 600);
+  CHECK_EQ(r.tail(), 0);
+  CHECK_EQ(r.at(0).tUs, 0); // A fresh log starts at board time
+  CHECK_EQ(r.at(599).tUs, 299 * PERIOD_US);
+  CHECK_EQ(r.at(599).channel, 1);
+
+  b.send(sink, 700, 2, 5000000);
+  CHECK_EQ(r.head(), 2000);
+  CHECK_EQ(r.tail(), 1001);
+  CHECK(countsUp(r));
+  for (uint64_t from = 0; from < 1100 * PERIOD_US; from += 37 * PERIOD_US + 1)
+  {
+    CHECK(findsWhatAScanFinds(r, from, from + 50 * PERIOD_US));
+  }
+}
+
+// The port is reopened after a board reset 20 s later: micros() is back at zero
+static void testBoardResetCarriesOn()
+{
+  RingLogWriter w;
+  RingLogReader r;
+  RingSink sink(w, 0);
+  Board b;
+
+  unlink(path);
+  CHECK(w.open(path, 10000));
+  CHECK(r.open(path));
+  b.t = 4290000000U; // Near enough the micros() wrap to cross it
+  b.send(sink, 1000, 4, 1000000);
+  uint64_t newest = r.at(r.head() - 1).tUs;
+  CHECK(newest > 0x100000000ULL);
+
+  b.decoder.reset();
+  sink.restart();
+  b.reset();
+  b.send(sink, 1000, 4, 1000000 + 1000 * PERIOD_US + 20000000);
+  CHECK_EQ(r.head(), 8000);
+  CHECK(afterGap(r.at(4000).tUs, newest, PERIOD_US + 20000000));
+  CHECK_EQ(r.at(4003).tUs, r.at(4000).tUs); // All four cells of a conversion together
+  CHECK(countsUp(r));
+  CHECK(findsWhatAScanFinds(r, newest - 10 * PERIOD_US, newest + 21000000));
+  CHECK(findsWhatAScanFinds(r, 0, newest));
+}
+
+// forced is restarted on the same log 2 minutes later, and the board was reset meanwhile
+static void testDaemonRestartCarriesOn()
+{
+  RingLogReader r;
+  Board b;
+  uint64_t newest;
+
+  unlink(path);
+  {
+    RingLogWriter w;
+    RingSink sink(w, 0);
+    CHECK(w.open(path, 10000));
+    b.t = 50000000;
+    b.send(sink, 500, 1, 7000000);
+  }
+  CHECK(r.open(path));
+  newest = r.at(r.head() - 1).tUs;
+  CHECK_EQ(newest, 50000000 + 499 * PERIOD_US);
+
+  RingLogWriter w;
+  RingSink sink(w, 0);
+  Board fresh;
+  CHECK(w.open(path, 10000));
+  fresh.t = 10000000;
+  fresh.send(sink, 500, 1, 7000000 + 499 * PERIOD_US + 120000000);
+  CHECK_EQ(r.head(), 1000);
+  CHECK(afterGap(r.at(500).tUs, newest, 120000000));
+  CHECK(countsUp(r));
+  CHECK(findsWhatAScanFinds(r, newest, newest + 120000000 + PERIOD_US));
+}
+
+// A board reset and decoder reset that nobody passed on with restart(), as a program of
+// its own driving RingSink might: board time goes back mid-stream.  Log time must not.
+static void testMissedRestartCarriesOn()
+{
+  RingLogWriter w;
+  RingLogReader r;
+  RingSink sink(w, 0);
+  Board b;
+
+  unlink(path);
+  CHECK(w.open(path, 10000));
+  CHECK(r.open(path));
+  b.t = 900000000;
+  b.send(sink, 400, 2, 1000000);
+  uint64_t newest = r.at(r.head() - 1).tUs;
+
+  b.reset();
+  b.decoder.reset();
+  b.send(sink, 400, 2, 1000000 + 400 * PERIOD_US + 3000000);
+  CHECK(countsUp(r));
+  CHECK(afterGap(r.at(800).tUs, newest, PERIOD_US + 3000000));
+  CHECK(findsWhatAScanFinds(r, newest, newest + 100 * PERIOD_US));
+}
+
+int main()
+{
+  int fd = mkstemp(path);
+
+  if (fd < 0)
+  {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  RUN(testAppendFindAndWrap);
+  RUN(testBoardResetCarriesOn);
+  RUN(testDaemonRestartCarriesOn);
+  RUN(testMissedRestartCarriesOn);
+  unlink(path);
+  return checkResult();
+}
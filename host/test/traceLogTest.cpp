@@ -0,0 +1,317 @@
+// ForceSensorGraph's compressed history (include/traceLog.h) on recorded peel traces: the
+// board's binary stream, decoded with FrameDecoder as forcecat would, fed a conversion at a
+// time into a TraceLog the size HISTORY_BYTES gives it.  Every sample must come back exact,
+// readers must survive the blocks they are in being dropped, and the report gives what it
+// holds against packing the samples raw, and what decoding it costs.
+// Without arguments it records its own traces: peels at 80Hz and 10Hz, with the HX711's
+// noise, drift and data-ready jitter, through the board sketch's FrameWriter.  Captures taken
+// off the port (channel 0 of each) can be given instead:
+//   make test
+//   test/traceLogTest capture.bin...
+
+#include <math.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include <Arduino.h>
+#include "forceFrame.h"
+#include "check.h"
+
+namespace board
+{
+#include "frame.hpp"
+}
+
+// setup.h's defaults, for one cell, and built as for the board: micros() in 4 us ticks
+#define LOADCELL_COUNT 1
+#define HISTORY_BYTES 768
+#define HISTORY_BLOCK_BYTES 128
+#define __AVR__
+#include "traceLog.h"
+#undef __AVR__
+
+BoardSerial Serial;
+
+typedef TraceLog<HISTORY_BYTES, HISTORY_BLOCK_BYTES> Log;
+
+static const uint8_t PACKED_BYTES = 4 + 3 * LOADCELL_COUNT; // A sample packed as tightly as it goes raw
+
+struct Channel0 : FrameSink
+{
+  std::vector<RawSample> samples;
+
+  void sample(const ForceSample &s) override
+  {
+    if (!s.channel)
+    {
+      RawSample r;
+      r.t = s.tUs;
+      r.count[0] = s.count;
+      r.input = ACQ_A128;
+      samples.push_back(r);
+    }
+  }
+  void info(const ForceInfo &) override {}
+  void burst(const ForceBurst &) override {}
+};
+
+static uint32_t noiseState = 12345;
+
+static double noise(double sd)
+{
+  double u1, u2;
+
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u1 = (noiseState + 1.0) / 4294967297.0;
+  noiseState = noiseState * 1664525u + 1013904223u;
+  u2 = noiseState / 4294967296.0;
+  return sd * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// One layer of grams at `phase` seconds into it: idle, the lift with the suction building up,
+// the release and the ringing after it, as the simulator's traces (sim/src/trace.cpp)
+static double peel(double phase, double period, double peak)
+{
+  double lift = 0.3 * period, release = 0.6 * period, u;
+
+  if (phase < lift)
+  {
+    return 0;
+  }
+  if (phase < release)
+  {
+    u = (phase - lift) / (release - lift);
+    return peak * (1 - exp(-3 * u)) / (1 - exp(-3));
+  }
+  u = phase - release;
+  return peak * 0.15 * exp(-u / 0.08) * sin(2 * M_PI * 12 * u);
+}
+
+// `seconds` of peels at rateHz, as the board sends them: 212 counts a gram, noiseCounts of
+// HX711 noise, a gram of drift a minute, and the data-ready time in micros()' 4 us ticks
+// with a few us of jitter.  Starts a few seconds short of the micros() wrap.
+static std::vector<RawSample> record(double seconds, uint8_t rateHz, double noiseCounts, double peak)
+{
+  board::FrameWriter frames;
+  FrameDecoder decoder;
+  Channel0 sink;
+  double t = 0, period = 1.0 / rateHz;
+  uint32_t us = 0xFFFFFFFF - 3000000;
+
+  Serial.sent.clear();
+  for (; t < seconds; t += period)
+  {
+    double grams = peel(fmod(t, 6), 6, peak) + t / 60;
+    frames.add(us, lround(-8000 + 212 * grams + noise(noiseCounts)), 0);
+    us += (lround(period * 1e6 + noise(3)) + 2) / 4 * 4;
+  }
+  frames.flush();
+  decoder.feed(Serial.sent.data(), Serial.sent.size(), sink);
+  return sink.samples;
+}
+
+static bool same(const RawSample &a, const RawSample &b)
+{
+  return a.t == b.t && a.count[0] == b.count[0];
+}
+
+// Everything the log holds must be the last samplesHeld() fed, in order
+static bool readsBack(const Log &log, const std::vector<RawSample> &fed, size_t upTo)
+{
+  Log::Cursor c = {};
+  RawSample s;
+  size_t i = upTo - log.samplesHeld();
+
+  log.rewind(c);
+  while (log.read(c, s))
+  {
+    if (i >= upTo || !same(s, fed[i++]))
+    {
+      return false;
+    }
+  }
+  return i == upTo && !c.lost;
+}
+
+struct Measured
+{
+  double samplesHeld, bytesPerSample; // Averaged over the trace once the log is full
+  double decodeNs, encodeNs;          // Host time per sample
+};
+
+// Feed `trace`, checking the log reads back at every 37th sample, and measure it
+static Measured feed(const std::vector<RawSample> &trace, bool &exact)
+{
+  static Log log;
+  Measured m = {0, 0, 0, 0};
+  uint32_t full = 0;
+  size_t i;
+
+  exact = true;
+  log.clear();
+  auto start = std::chrono::steady_clock::now();
+  for (i = 0; i < trace.size(); i++)
+  {
+    log.add(trace[i]);
+  }
+  m.encodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / trace.size();
+
+  log.clear();
+  for (i = 0; i < trace.size(); i++)
+  {
+    log.add(trace[i]);
+    if (i % 37 == 0)
+    {
+      exact = exact && readsBack(log, trace, i + 1);
+    }
+    if (log.bytesHeld() > HISTORY_BYTES - HISTORY_BLOCK_BYTES)
+    {
+      m.samplesHeld += log.samplesHeld();
+      m.bytesPerSample += (double)log.bytesHeld() / log.samplesHeld();
+      full++;
+    }
+  }
+  m.samplesHeld /= full;
+  m.bytesPerSample /= full;
+
+  // The whole log read back, as a dump does
+  Log::Cursor c = {};
+  RawSample s;
+  uint64_t decoded = 0;
+  start = std::chrono::steady_clock::now();
+  for (uint16_t pass = 0; pass < 2000; pass++)
+  {
+    log.rewind(c);
+    while (log.read(c, s))
+    {
+      decoded++;
+    }
+  }
+  m.decodeNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / decoded;
+  exact = exact && decoded == 2000ULL * log.samplesHeld();
+  return m;
+}
+
+static void report(const char *name, const std::vector<RawSample> &trace, const Measured &m)
+{
+  printf("  %-28s %8zu samples: %.0f held in %u bytes, %.2f bytes each, %.1fx packed (%.0f packed); "
+         "%.0f ns to decode a sample, %.0f to encode\n",
+         name, trace.size(), m.samplesHeld, HISTORY_BYTES, m.bytesPerSample, PACKED_BYTES / m.bytesPerSample,
+         (double)HISTORY_BYTES / PACKED_BYTES, m.decodeNs, m.encodeNs);
+}
+
+// An hour of peels at 80Hz with the quiet HX711 noise of a real cell: every sample back, and
+// the RAM holding at least 2.5 times what it would packed raw
+static void testPeels80Hz()
+{
+  std::vector<RawSample> trace = record(3600, 80, 8, 1500);
+  bool exact;
+  Measured m = feed(trace, exact);
+
+  report("80Hz, 8 counts noise", trace, m);
+  CHECK(trace.size() > 3600 * 80 - 2);
+  CHECK(exact);
+  CHECK(m.bytesPerSample * 2.5 < PACKED_BYTES);
+  CHECK(m.samplesHeld > 2.5 * HISTORY_BYTES / PACKED_BYTES);
+  // Well under the 12.5 ms between samples even on the board, at a few hundred times slower
+  CHECK(m.decodeNs < 1000);
+}
+
+// Noisier, and at 10Hz where the counts move further between samples: still exact, with
+// less to gain
+static void testNoisyAndSlow()
+{
+  std::vector<RawSample> noisy = record(1800, 80, 150, 1500), slow = record(3600, 10, 8, 1500);
+  bool exact;
+  Measured m = feed(noisy, exact);
+
+  report("80Hz, 150 counts noise", noisy, m);
+  CHECK(exact);
+  CHECK(m.bytesPerSample < PACKED_BYTES);
+
+  m = feed(slow, exact);
+  report("10Hz, 8 counts noise", slow, m);
+  CHECK(exact);
+  CHECK(m.bytesPerSample < PACKED_BYTES);
+}
+
+// A reader part way through when its block is dropped carries on from the oldest left,
+// counting what it lost, and what it reads is still exact
+static void testReaderAcrossDrops()
+{
+  static Log log;
+  std::vector<RawSample> trace = record(60, 80, 8, 1500);
+  Log::Cursor c = {};
+  RawSample s;
+  size_t fed = 0, i;
+
+  log.clear();
+  while (fed < 2000)
+  {
+    log.add(trace[fed++]);
+  }
+  log.rewind(c);
+  for (i = 0; i < 20; i++)
+  {
+    CHECK(log.read(c, s));
+  }
+  while (fed < 3000)
+  {
+    log.add(trace[fed++]);
+  }
+  CHECK(log.read(c, s));
+  CHECK(c.lost > 0);
+  i = fed - log.samplesHeld();
+  CHECK(same(s, trace[i++]));
+  while (log.read(c, s))
+  {
+    CHECK(same(s, trace[i++]));
+  }
+  CHECK_EQ(i, fed);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+  {
+    // Recorded captures: exact and measured, whatever they hold
+    for (int a = 1; a < argc; a++)
+    {
+      FILE *f = fopen(argv[a], "rb");
+      std::vector<uint8_t> bytes;
+      uint8_t buf[65536];
+      size_t n;
+      FrameDecoder decoder;
+      Channel0 sink;
+      bool exact;
+
+      if (!f)
+      {
+        perror(argv[a]);
+        return 1;
+      }
+      while ((n = fread(buf, 1, sizeof(buf), f)))
+      {
+        decoder.feed(buf, n, sink);
+      }
+      fclose(f);
+      if (sink.samples.size() < 2)
+      {
+        printf("%s: no samples\n", argv[a]);
+        return 1;
+      }
+      Measured m = feed(sink.samples, exact);
+      report(argv[a], sink.samples, m);
+      if (!exact)
+      {
+        printf("%s: the log did not read back exact\n", argv[a]);
+        return 1;
+      }
+    }
+    return 0;
+  }
+  RUN(testPeels80Hz);
+  RUN(testNoisyAndSlow);
+  RUN(testReaderAcrossDrops);
+  return checkResult();
+}
@@ -0,0 +1,100 @@
+// Decode the board's binary stream to CSV.
+//
+//   forcecat [--tare] [PORT_OR_FILE]
+//
+// Reads a serial port (e.g. /dev/ttyACM0), a capture file or stdin, and prints
+// "t_us,seq,channel,count,grams,flags" per sample.  --tare sends the '1' tare command first.
+// From a board sending bursts, each burst header is reported on stderr.
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include "forceFrame.h"
+
+class CsvSink : public FrameSink
+{
+public:
+  void sample(const ForceSample &s) override
+  {
+    const ForceInfo &i = last[s.channel];
+    double grams = haveInfo[s.channel] && i.scale != 0 ? (s.count - i.offset) / i.scale : 0;
+    printf("%llu,%llu,%u,%d,%.3f,%u\n", (unsigned long long)s.tUs, (unsigned long long)s.seq, s.channel, s.count,
+           grams, s.flags);
+  }
+  void info(const ForceInfo &i) override
+  {
+    last[i.channel] = i;
+    haveInfo[i.channel] = true;
+  }
+  void burst(const ForceBurst &b) override
+  {
+    fprintf(stderr, "burst %u at %lu us by%s%s%s: %u + %u samples\n", b.burst, (unsigned long)b.tTrigger,
+            b.source & BURST_BY_LEVEL ? " level" : "", b.source & BURST_BY_SLOPE ? " slope" : "",
+            b.source & BURST_BY_PIN ? " pin" : "", b.pre, b.post);
+    bursts++;
+  }
+
+  unsigned bursts = 0;
+
+private:
+  ForceInfo last[FRAME_MAX_CHANNELS] = {};
+  bool haveInfo[FRAME_MAX_CHANNELS] = {};
+};
+
+int main(int argc, char **argv)
+{
+  const char *path = 0;
+  bool tare = false;
+  uint8_t buf[4096];
+  ssize_t n;
+  int fd = 0, i;
+  struct termios tio;
+  FrameDecoder decoder;
+  CsvSink sink;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--tare"))
+      tare = true;
+    else if (argv[i][0] == '-' && argv[i][1])
+    {
+      fprintf(stderr, "usage: forcecat [--tare] [PORT_OR_FILE]\n");
+      return 2;
+    }
+    else
+      path = argv[i];
+  }
+
+  if (path && strcmp(path, "-"))
+  {
+    fd = open(path, tare ? O_RDWR | O_NOCTTY : O_RDONLY | O_NOCTTY);
+    if (fd < 0)
+    {
+      perror(path);
+      return 1;
+    }
+  }
+  if (isatty(fd) && tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+  }
+  if (tare && write(fd, "1", 1) != 1)
+  {
+    perror("tare");
+  }
+
+  printf("t_us,seq,channel,count,grams,flags\n");
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+  {
+    decoder.feed(buf, n, sink);
+  }
+
+  fprintf(stderr, "%llu frames, %llu bad, %llu bytes skipped, %llu samples lost",
+          (unsigned long long)decoder.frames, (unsigned long long)decoder.crcErrors,
+          (unsigned long long)decoder.skippedBytes, (unsigned long long)decoder.lostSamples);
+  fprintf(stderr, sink.bursts ? ", %u bursts\n" : "\n", sink.bursts);
+  return 0;
+}
@@ -0,0 +1,182 @@
+// Ingestion daemon: reads the board's binary stream and appends every sample to a
+// memory-mapped ring log that other tools read in place (ringLog.h, forcequery).
+//
+//   forced [--log FILE] [--hours H [--cells C] | --capacity RECORDS] [--channel N] [--tare] [--follow] SOURCE
+//
+// Every load cell's sample is a record, so --hours sizes the log for C cells (default 1) at
+// 80Hz.  Records are tagged with the sample's load cell channel plus N (default 0), so several
+// boards can log to separate files and still be told apart.  Their timestamps carry on across
+// board resets, reconnects and restarts of forced (see ringLog.h).
+// SOURCE is the serial port (e.g. /dev/ttyACM0), a pty, a capture file or "-" for stdin.
+// A serial port that disappears (USB unplugged, board reset) is reopened every second.
+// A file is read to the end, or followed like tail -f with --follow.
+// Nothing is allocated once the log is open, however long it runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include "forceFrame.h"
+#include "ringLog.h"
+#include "ringSink.h"
+
+#define SYNC_EVERY_S 10
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int)
+{
+  stopping = 1;
+}
+
+static uint64_t hostNowUs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int openSource(const char *path, bool tare)
+{
+  struct termios tio;
+  int fd = strcmp(path, "-") ? open(path, O_RDWR | O_NOCTTY) : 0;
+
+  if (fd < 0)
+  {
+    fd = open(path, O_RDONLY | O_NOCTTY); // A capture file we may not write to
+  }
+  if (fd >= 0 && isatty(fd) && tcgetattr(fd, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    if (tare && write(fd, "1", 1) != 1)
+    {
+      perror("tare");
+    }
+  }
+  return fd;
+}
+
+static void usage()
+{
+  fprintf(stderr, "usage: forced [--log FILE] [--hours H [--cells C] | --capacity RECORDS] [--channel N] [--tare] [--follow] SOURCE\n");
+  exit(2);
+}
+
+int main(int argc, char **argv)
+{
+  const char *logPath = "force.ring", *source = 0;
+  uint64_t capacity = 0;
+  double hours = 24; // A day at 80Hz, ~160MB a cell
+  unsigned cells = 1;
+  uint8_t channel = 0;
+  bool tare = false, follow = false, tty;
+  static uint8_t buf[4096];
+  time_t lastSync;
+  ssize_t n;
+  int fd, i;
+  struct sigaction sa;
+  RingLogWriter log;
+  FrameDecoder decoder;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--tare"))
+      tare = true;
+    else if (!strcmp(argv[i], "--follow"))
+      follow = true;
+    else if (!strcmp(argv[i], "--log") && i + 1 < argc)
+      logPath = argv[++i];
+    else if (!strcmp(argv[i], "--hours") && i + 1 < argc)
+      hours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--cells") && i + 1 < argc)
+      cells = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--capacity") && i + 1 < argc)
+      capacity = strtoull(argv[++i], 0, 10);
+    else if (!strcmp(argv[i], "--channel") && i + 1 < argc)
+      channel = atoi(argv[++i]);
+    else if (argv[i][0] == '-' && argv[i][1])
+      usage();
+    else
+      source = argv[i];
+  }
+  if (!source || cells < 1 || cells > FRAME_MAX_CHANNELS)
+    usage();
+  if (!capacity)
+    capacity = (uint64_t)(hours * 3600 * 80 * cells);
+
+  if (!log.open(logPath, capacity))
+  {
+    fprintf(stderr, "forced: cannot open ring log %s with %llu records: %s\n", logPath,
+            (unsigned long long)capacity, strerror(errno));
+    return 1;
+  }
+  RingSink sink(log, channel);
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal; // No SA_RESTART, so a blocked read() returns on a signal
+  sigaction(SIGINT, &sa, 0);
+  sigaction(SIGTERM, &sa, 0);
+
+  fd = openSource(source, tare);
+  if (fd < 0)
+  {
+    perror(source);
+    return 1;
+  }
+  tty = isatty(fd);
+  lastSync = time(0);
+
+  while (!stopping)
+  {
+    n = read(fd, buf, sizeof(buf));
+    if (n > 0)
+    {
+      sink.hostUs = hostNowUs();
+      decoder.feed(buf, n, sink);
+    }
+    else if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else if (tty)
+    {
+      // The port went away - wait for the board to come back
+      close(fd);
+      decoder.reset();
+      sink.restart();
+      while (!stopping && (fd = openSource(source, false)) < 0)
+      {
+        sleep(1);
+      }
+    }
+    else if (follow)
+    {
+      usleep(100000);
+    }
+    else
+    {
+      break;
+    }
+
+    if (time(0) - lastSync >= SYNC_EVERY_S)
+    {
+      log.sync();
+      lastSync = time(0);
+    }
+  }
+
+  log.close();
+  fprintf(stderr, "forced: %llu samples logged, %llu frames, %llu bad, %llu bytes skipped, %llu samples lost\n",
+          (unsigned long long)sink.samples, (unsigned long long)decoder.frames,
+          (unsigned long long)decoder.crcErrors, (unsigned long long)decoder.skippedBytes,
+          (unsigned long long)decoder.lostSamples);
+  return 0;
+}
@@ -0,0 +1,259 @@
+// Peel-by-peel summary of recorded traces: ring logs from forced, binary captures of the
+// port, forcecat/forcequery CSV or ForceSensorGraph serial logs, in any mix.
+//
+//   forcepeel [options] FILE...        one CSV row per layer, on stdout
+//   forcepeel --json [options] FILE... the same as JSON, with a summary per file
+//
+//   --jobs N             files analysed at once (default: one per CPU)
+//   --onset G            rise above the baseline that starts a peel (50)
+//   --slope G_PER_S      ...if it is still rising this fast (200)
+//   --min-peak G         smaller peaks are not counted (200)
+//   --release PCT        a peel ends below this percentage of its peak (50)
+//   --timeout S          a load held longer is the new zero (20)
+//   --lowpass HZ         Butterworth cutoff for the filtered peak, 0 for none (10)
+//   --median N           median filter length before the low-pass, 1 for none (3)
+//
+// Each file is analysed on its own, so they go to separate threads; the output is always
+// in the order the files were given.  Totals and throughput go to stderr.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "traceFile.h"
+
+struct Job
+{
+  const char *path;
+  bool ok;
+  std::string error;
+  TraceStats stats;
+  FileSummary summary;
+};
+
+static void usage()
+{
+  fprintf(stderr, "usage: forcepeel [--json] [--jobs N] [--onset G] [--slope G_PER_S] [--min-peak G] "
+                  "[--release PCT] [--timeout S] [--lowpass HZ] [--median N] FILE...\n");
+}
+
+static void worker(std::vector<Job> &jobs, std::atomic<size_t> &next, const PeelConfig &config)
+{
+  SampleBlock block;
+  size_t i;
+
+  while ((i = next++) < jobs.size())
+  {
+    PeelAnalyser analyser(config);
+    jobs[i].ok = analyseTrace(jobs[i].path, analyser, block, jobs[i].stats, jobs[i].error);
+    jobs[i].summary = std::move(analyser.summary);
+  }
+}
+
+static void printJsonString(const char *s)
+{
+  putchar('"');
+  for (; *s; s++)
+  {
+    if (*s == '"' || *s == '\\')
+    {
+      printf("\\%c", *s);
+    }
+    else if ((unsigned char)*s < 0x20)
+    {
+      printf("\\u%04x", *s);
+    }
+    else
+    {
+      putchar(*s);
+    }
+  }
+  putchar('"');
+}
+
+static void printCsv(const Job &job)
+{
+  for (const LayerSummary &l : job.summary.layers)
+  {
+    printf("%s,%u,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.2f,%.1f,%.2f,%u", job.path, l.layer, l.onsetS, l.peakS,
+           l.releaseS, l.releaseS - l.onsetS, l.baseline, l.peak, l.filteredPeak, l.impulse, l.riseRate,
+           l.idleSd, l.samples);
+    for (uint8_t c = 0; c < FRAME_MAX_CHANNELS; c++)
+    {
+      printf(",%.1f", l.channelPeak[c]);
+    }
+    putchar('\n');
+  }
+}
+
+static void printJson(const Job &job, bool first)
+{
+  const FileSummary &s = job.summary;
+  uint8_t c;
+
+  printf("%s\n  {\"file\":", first ? "" : ",");
+  printJsonString(job.path);
+  if (!job.ok)
+  {
+    printf(",\"error\":");
+    printJsonString(job.error.c_str());
+    printf("}");
+    return;
+  }
+  printf(",\"format\":\"%s\",\"conversions\":%llu,\"channels\":%u,\"seconds\":%.3f,\"outliers\":%llu,"
+         "\"timeouts\":%llu,\"layers\":[",
+         traceFormatName(job.stats.format), (unsigned long long)s.conversions, job.stats.channels,
+         s.lastS - s.firstS, (unsigned long long)s.outliers, (unsigned long long)s.timeouts);
+  for (const LayerSummary &l : s.layers)
+  {
+    printf("%s\n    {\"layer\":%u,\"onset_s\":%.3f,\"peak_s\":%.3f,\"release_s\":%.3f,\"baseline_g\":%.1f,"
+           "\"peak_g\":%.1f,\"filtered_peak_g\":%.1f,\"impulse_gs\":%.2f,\"rise_gps\":%.1f,\"idle_sd_g\":%.2f,"
+           "\"samples\":%u,\"cells_g\":[",
+           l.layer > 1 ? "," : "", l.layer, l.onsetS, l.peakS, l.releaseS, l.baseline, l.peak, l.filteredPeak,
+           l.impulse, l.riseRate, l.idleSd, l.samples);
+    for (c = 0; c < l.channels; c++)
+    {
+      printf("%s%.1f", c ? "," : "", l.channelPeak[c]);
+    }
+    printf("]}");
+  }
+  printf("%s]}", s.layers.empty() ? "" : "\n  ");
+}
+
+int main(int argc, char **argv)
+{
+  PeelConfig config;
+  bool json = false;
+  unsigned jobCount = std::thread::hardware_concurrency();
+  std::vector<Job> jobs;
+  std::vector<std::thread> threads;
+  std::atomic<size_t> next(0);
+  struct timespec t0, t1;
+  uint64_t samples = 0, layers = 0;
+  double seconds;
+  int i, failed = 0;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *opt = argv[i];
+    if (!strcmp(opt, "--json"))
+    {
+      json = true;
+      continue;
+    }
+    if (strncmp(opt, "--", 2))
+    {
+      jobs.push_back({opt, false, "", {}, {}});
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      usage();
+      return 2;
+    }
+    float v = atof(argv[++i]);
+    if (!strcmp(opt, "--jobs"))
+    {
+      jobCount = v;
+    }
+    else if (!strcmp(opt, "--onset"))
+    {
+      config.onsetGrams = v;
+    }
+    else if (!strcmp(opt, "--slope"))
+    {
+      config.onsetSlope = v;
+    }
+    else if (!strcmp(opt, "--min-peak"))
+    {
+      config.minPeak = v;
+    }
+    else if (!strcmp(opt, "--release"))
+    {
+      config.releasePercent = v;
+    }
+    else if (!strcmp(opt, "--timeout"))
+    {
+      config.timeoutS = v;
+    }
+    else if (!strcmp(opt, "--lowpass"))
+    {
+      config.lowpassHz = v;
+    }
+    else if (!strcmp(opt, "--median"))
+    {
+      config.median = v;
+    }
+    else
+    {
+      usage();
+      return 2;
+    }
+  }
+  if (jobs.empty())
+  {
+    usage();
+    return 2;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  jobCount = std::max(1u, std::min<unsigned>(jobCount, jobs.size()));
+  for (unsigned j = 1; j < jobCount; j++)
+  {
+    threads.emplace_back(worker, std::ref(jobs), std::ref(next), std::cref(config));
+  }
+  worker(jobs, next, config);
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+  if (json)
+  {
+    printf("{\"files\":[");
+  }
+  else
+  {
+    printf("file,layer,onset_s,peak_s,release_s,duration_s,baseline_g,peak_g,filtered_peak_g,impulse_gs,"
+           "rise_gps,idle_sd_g,samples,cell0_g,cell1_g,cell2_g,cell3_g\n");
+  }
+  for (size_t j = 0; j < jobs.size(); j++)
+  {
+    const Job &job = jobs[j];
+    if (!job.ok)
+    {
+      fprintf(stderr, "forcepeel: %s: %s\n", job.path, job.error.c_str());
+      failed++;
+    }
+    if (json)
+    {
+      printJson(job, !j);
+    }
+    else
+    {
+      printCsv(job);
+    }
+    if (job.stats.badFrames || job.stats.lostSamples || job.stats.badLines)
+    {
+      fprintf(stderr, "forcepeel: %s: %llu bad frames, %llu samples lost, %llu bad lines\n", job.path,
+              (unsigned long long)job.stats.badFrames, (unsigned long long)job.stats.lostSamples,
+              (unsigned long long)job.stats.badLines);
+    }
+    samples += job.stats.samples;
+    layers += job.summary.layers.size();
+  }
+  if (json)
+  {
+    printf("\n]}\n");
+  }
+
+  fprintf(stderr, "%zu files, %llu samples, %llu layers in %.2f s (%.1f M samples/s, %u threads)\n", jobs.size(),
+          (unsigned long long)samples, (unsigned long long)layers, seconds, samples / seconds / 1e6, jobCount);
+  return failed ? 1 : 0;
+}
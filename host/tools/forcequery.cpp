@@ -0,0 +1,57 @@
+// Read a ring log written by forced, in place.
+//
+//   forcequery LOG                 summary: capacity, records held, time span
+//   forcequery LOG FROM_S TO_S     records with FROM_S <= log time < TO_S, as CSV
+//
+// Log time is the board's time, carried on across board resets and reconnects (ringLog.h).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ringLog.h"
+
+int main(int argc, char **argv)
+{
+  RingLogReader log;
+  uint64_t first, last, i, head, tail;
+
+  if (argc != 2 && argc != 4)
+  {
+    fprintf(stderr, "usage: forcequery LOG [FROM_S TO_S]\n");
+    return 2;
+  }
+  if (!log.open(argv[1]))
+  {
+    fprintf(stderr, "forcequery: %s is not a ring log\n", argv[1]);
+    return 1;
+  }
+
+  if (argc == 2)
+  {
+    head = log.head();
+    tail = log.tail();
+    printf("capacity %llu records, %llu written, %llu held\n", (unsigned long long)log.capacity(),
+           (unsigned long long)head, (unsigned long long)(head - tail));
+    if (head > tail)
+    {
+      printf("log time %.3f s to %.3f s\n", log.at(tail).tUs / 1e6, log.at(head - 1).tUs / 1e6);
+    }
+    return 0;
+  }
+
+  printf("t_us,seq,channel,count,grams,flags\n");
+  if (!log.find((uint64_t)(atof(argv[2]) * 1e6), (uint64_t)(atof(argv[3]) * 1e6), first, last))
+  {
+    return 0;
+  }
+  for (i = first; i < last; i++)
+  {
+    RingRecord r = log.at(i);
+    if (!log.stillValid(i))
+    {
+      fprintf(stderr, "forcequery: overtaken by the writer at record %llu\n", (unsigned long long)i);
+      return 1;
+    }
+    printf("%llu,%u,%u,%d,%.3f,%u\n", (unsigned long long)r.tUs, r.seq, r.channel, r.count, r.grams, r.flags);
+  }
+  return 0;
+}